@@ -165,6 +165,23 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* Run-time statistics clocked by the DWT cycle counter and a global
+   context-switch counter: used by the PPG load statistics (ppg_load_stats). */
+#define DWT_CTRL_REG     (*(volatile uint32_t *)0xE0001000UL)
+#define DWT_CYCCNT_REG   (*(volatile uint32_t *)0xE0001004UL)
+#define DEMCR_REG        (*(volatile uint32_t *)0xE000EDFCUL)
+
+#define configGENERATE_RUN_TIME_STATS            1
+#define INCLUDE_xTaskGetIdleTaskHandle           1
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() \
+  do { DEMCR_REG |= (1UL << 24); DWT_CYCCNT_REG = 0; DWT_CTRL_REG |= 1UL; } while (0)
+#define portGET_RUN_TIME_COUNTER_VALUE()         (DWT_CYCCNT_REG)
+
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+  extern volatile uint32_t os_context_switches;
+#endif
+#define traceTASK_SWITCHED_IN()                  (os_context_switches++)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,178 @@
+/**
+ ******************************************************************************
+ * @file    adc_scan.h
+ * @author  A. Bellina
+ * @brief   Scan-mode ADC manager: every analog channel in one DMA stream.
+ *
+ * @details
+ * ADC1 converts the whole regular sequence (one rank per AdcScan_Rank_t)
+ * on each compare event of the acquisition timer, one scan per LED phase
+ * (led_phase.h). DMA2 Stream0 stores the results interleaved in a
+ * circular buffer:
+ *
+ *   [ s0.r0 s0.r1 ... | s1.r0 s1.r1 ... | ... ]   (s = scan, r = rank)
+ *
+ * Scan s is taken during LED phase s % ADC_SCAN_PHASES.
+ *
+ * The buffer is split in two halves of ADC_SCAN_HALF_SCANS scans. When a
+ * half is complete (DMA half/full transfer interrupt) every registered
+ * listener receives it as an AdcScan_Block_t, and reads the rank it
+ * owns through a strided view, without copying: all the scans of the
+ * rank, or only those of one LED phase. The other half is being
+ * filled meanwhile: a listener must be done within ADC_SCAN_HALF_SCANS
+ * trigger periods.
+ *
+ * Consumers that only need the most recent value (battery monitor) use
+ * AdcScan_Latest() from task context: no ADC restart, no blocking poll.
+ *
+ * The scan runs from AdcScan_Start() on, independently of PPG sessions.
+ * An overrun or a DMA error stops the DMA: the error callback restarts
+ * the scan on phase 0 and the block index skips the half that was being
+ * filled, so listeners see the missing periods as a gap.
+ * Adding a channel: one AdcScan_Rank_t entry before ADC_SCAN_RANKS and
+ * the matching HAL_ADC_ConfigChannel() rank in MX_ADC1_Init().
+ ******************************************************************************
+ */
+
+#ifndef ADC_SCAN_H
+#define ADC_SCAN_H
+
+#include "stm32f4xx_hal.h"
+#include "ppg_decimator.h"
+#include "led_phase.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Scans per acquisition period: one per LED phase */
+#define ADC_SCAN_PHASES            LED_PHASES
+
+/**
+ * Scans per DMA half-transfer, a multiple of ADC_SCAN_PHASES.
+ * One DMA interrupt every ADC_SCAN_HALF_SCANS trigger periods: 10 Hz
+ * whatever the oversampling ratio (the trigger runs at PPG_OVERSAMPLE x
+ * ADC_SCAN_PHASES x the processing rate).
+ */
+#ifndef ADC_SCAN_HALF_SCANS
+#define ADC_SCAN_HALF_SCANS        (10U * PPG_OVERSAMPLE * ADC_SCAN_PHASES)
+#endif
+
+/** Block listeners (ISR callbacks) */
+#define ADC_SCAN_MAX_LISTENERS     2U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Ranks of the regular sequence, in conversion order (MX_ADC1_Init) */
+typedef enum
+{
+    ADC_SCAN_PHOTODIODE = 0,   /**< PA0 / ADC1_IN0: PPG photodiode */
+    ADC_SCAN_BATTERY,          /**< PA1 / ADC1_IN1: battery voltage divider */
+    ADC_SCAN_RANKS
+} AdcScan_Rank_t;
+
+/** Zero-copy view of one rank inside a block */
+typedef struct
+{
+    const uint16_t *base;      /**< First sample of the rank */
+    uint32_t        stride;    /**< Distance between samples [uint16_t] */
+    uint32_t        count;     /**< Samples in the view */
+} AdcScan_View_t;
+
+/** Half of the DMA buffer, ready to be read */
+typedef struct
+{
+    const uint16_t *data;      /**< ADC_SCAN_HALF_SCANS x ADC_SCAN_RANKS, interleaved */
+    uint32_t        scans;     /**< Complete scans in data */
+    uint32_t        first;     /**< Index of the first scan since AdcScan_Start() (phase 0) */
+} AdcScan_Block_t;
+
+/** Listener called from the DMA interrupt for every completed block */
+typedef void (*AdcScan_Listener_t)(const AdcScan_Block_t *block);
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bind the ADC (scan mode, DMA circular) and its trigger timer.
+ *
+ * @param[in] adc     ADC configured with ADC_SCAN_RANKS regular ranks.
+ * @param[in] trigger Timer whose compare channel triggers one scan.
+ * @param[in] channel Compare channel (TIM_CHANNEL_x) in PWM mode.
+ */
+void AdcScan_Init(ADC_HandleTypeDef *adc, TIM_HandleTypeDef *trigger, uint32_t channel);
+
+/**
+ * @brief Register a block listener (before AdcScan_Start()).
+ *
+ * @param[in] listener Callback, runs in the DMA interrupt.
+ *
+ * @return false if ADC_SCAN_MAX_LISTENERS are already registered.
+ */
+bool AdcScan_AddListener(AdcScan_Listener_t listener);
+
+/**
+ * @brief Start the circular DMA, then the trigger timer from 0.
+ *
+ * Also rewinds the LED phases (LedPhase_Rewind()): scan 0 is phase 0.
+ *
+ * @return true if the scan is running.
+ */
+bool AdcScan_Start(void);
+
+/**
+ * @brief Stop the trigger timer, then the ADC and its DMA.
+ */
+void AdcScan_Stop(void);
+
+/**
+ * @brief Strided view of one rank of a block.
+ *
+ * @param[in] block Block received by a listener.
+ * @param[in] rank  Rank to read.
+ *
+ * @return View of block->scans samples (sample k: view.base[k * view.stride]).
+ */
+AdcScan_View_t AdcScan_GetView(const AdcScan_Block_t *block, AdcScan_Rank_t rank);
+
+/**
+ * @brief Strided view of one rank during one LED phase.
+ *
+ * @param[in] block Block received by a listener.
+ * @param[in] rank  Rank to read.
+ * @param[in] phase LED phase (0..ADC_SCAN_PHASES-1).
+ *
+ * @return View of block->scans / ADC_SCAN_PHASES samples, one per acquisition period.
+ */
+AdcScan_View_t AdcScan_GetPhaseView(const AdcScan_Block_t *block, AdcScan_Rank_t rank,
+                                    LedPhase_t phase);
+
+/**
+ * @brief Most recent conversion of a rank.
+ *
+ * @param[in]  rank  Rank to read.
+ * @param[out] value Last 12-bit value of the rank.
+ *
+ * @return false until the first block is complete, or after a restart
+ *         until the next one.
+ */
+bool AdcScan_Latest(AdcScan_Rank_t rank, uint16_t *value);
+
+/**
+ * @brief Index of the next block: completed halves since AdcScan_Start(),
+ *        plus those skipped by restarts. Unchanged while the scan is stopped.
+ */
+uint32_t AdcScan_GetBlockCount(void);
+
+/**
+ * @brief Failures since AdcScan_Init(): ADC overruns and DMA transfer
+ *        errors (each restarts the scan), failed starts.
+ */
+uint32_t AdcScan_GetErrors(void);
+
+#endif /* ADC_SCAN_H */
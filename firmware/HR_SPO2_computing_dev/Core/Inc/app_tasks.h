@@ -7,6 +7,9 @@ extern "C" {
 
 #include "cmsis_os.h"
 
+/** push_button event flag: start button pressed (set by the EXTI callback) */
+#define APP_EVENT_BUTTON    (1UL << 0)
+
 /**
  * @defgroup AppTasks Application Tasks
  * @brief FreeRTOS application-level tasks
@@ -25,12 +28,6 @@ void Start_HR_SPO2_task(void *argument);
  */
 void Start_Battery_monitor(void *argument);
 
-/**
- * @brief Task that publishes data over MQTT
- * @param argument FreeRTOS task argument (unused)
- */
-void Start_publisher(void *argument);
-
 /**
  * @brief Task that handles data logging to storage
  * @param argument FreeRTOS task argument (unused)
@@ -38,10 +35,10 @@ void Start_publisher(void *argument);
 void Start_Datalogging(void *argument);
 
 /**
- * @brief Task that manages data visualization and display updates
+ * @brief Task that receives the simulation link frames (USE_SIMULATION)
  * @param argument FreeRTOS task argument (unused)
  */
-void Start_Displaying(void *argument);
+void Start_Sim_link(void *argument);
 
 /** @} */
 
@@ -6,16 +6,21 @@
  *
  * @details
  * This module provides APIs to measure battery level using the ADC and to
- * evaluate thresholds for battery alarms. It is meant to be used inside a
+ * evaluate thresholds for battery alarms. The battery voltage is the
+ * ADC_SCAN_BATTERY rank of the ADC scan (adc_scan.h): reading it never
+ * blocks nor disturbs the PPG acquisition. It is meant to be used inside a
  * FreeRTOS task but can also be called from bare-metal code.
  *
  * Features:
- * - ADC acquisition wrapper
+ * - Latest value of the ADC scan, no conversion polling
+ * - Stale reading flagged when no scan completed since the previous update
+ *   (scan stopped, restarted after an overrun): the alarm LED is lit then,
+ *   as for a low battery
  * - Configurable voltage thresholds
  * - Integration with GPIO alarm LED
  *
  * Dependencies:
- * - HAL ADC driver
+ * - ADC scan manager (adc_scan.h)
  * - HAL GPIO driver
  *
  * Version:
@@ -28,31 +33,43 @@
 
 #include "stm32f4xx_hal.h"
 #include <stdint.h>
+#include <stdbool.h>
+
+/** Result of BatteryMonitor_Update() */
+typedef struct
+{
+    uint16_t raw;      /**< Battery rank [12-bit ADC counts], 0 if never read */
+    bool     stale;    /**< No new scan since the previous update: raw is an old value */
+    bool     low;      /**< Fresh raw below the alarm threshold */
+} BatteryMonitor_Reading_t;
 
 /**
  * @brief  Initializes the HW to perform Battery monitoring.
  *
- * @param[in]   adc        ADC_HandleTypeDef pointer descriptor to select ADC.
  * @param[in]   ledPort    GPIO_TypeDef pointer descriptor to select port for alarm
  * @param[in]   ledPin     uint16_t to select the pin on MCU to perform alarm
  *
  * @return void
  */
 
-void BatteryMonitor_Init(ADC_HandleTypeDef *adc, GPIO_TypeDef *ledPort, uint16_t ledPin);
+void BatteryMonitor_Init(GPIO_TypeDef *ledPort, uint16_t ledPin);
 
 /**
  * @brief  Algorithm to check the voltage level of Battery with HW configured by calling BatteryMonitor() and manage alarm output.
  *
  * @param[in]  void 
  *
- * @pre     BatteryMonitor_Init() must be called before this function.
- * @post    Turns on the led when Battery level voltage goes under the threshold.
+ * @pre     BatteryMonitor_Init() must be called and the ADC scan started
+ *          (AdcScan_Start()) before this function.
+ * @post    Turns on the led when Battery level voltage goes under the threshold,
+ *          or when the reading is stale.
  *
+ * @return The reading; stale if the ADC scan has not delivered a block
+ *         since the previous call.
  *
  * @warning connect the HW with the right configured pins and ADC.  
  */
 
-void BatteryMonitor_Update(void);
+BatteryMonitor_Reading_t BatteryMonitor_Update(void);
 
 #endif
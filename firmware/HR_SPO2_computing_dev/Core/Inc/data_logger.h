@@ -0,0 +1,149 @@
+/**
+ ******************************************************************************
+ * @file    data_logger.h
+ * @author  A. Bellina
+ * @brief   Session logger: processed frames to the SD card (FatFs).
+ *
+ * @details
+ * Two tasks, so the card never holds up the frame queue:
+ *   - packer (DataLogger_PackStep(), logger consumer of ppg_processing.h):
+ *     encodes each frame into the buffer being filled and releases the
+ *     frame at once
+ *   - writer (DataLogger_WriteStep()): writes each full buffer with one
+ *     f_write() and gives it back
+ *
+ * Buffers are DATALOG_BUFFER_SECTORS whole sectors (ping-pong with the
+ * default DATALOG_BUFFERS = 2). Every write starts on a sector boundary
+ * and, but for the last one of a session (zero padded), covers whole
+ * sectors: FatFs transfers them straight from the buffer (multi-sector
+ * CMD25, sd_spi.h), never through its sector window, so no partial
+ * sector is read back and rewritten.
+ *
+ * Each session goes to a new file, PPG<nnnnn>.BIN, allocated for the
+ * whole session length at the start (f_expand): one contiguous cluster
+ * run, mapped by a fast seek table, so writing never reads or extends
+ * the FAT. The file is truncated to the data at the end of the session.
+ * Without a contiguous free area the file grows cluster by cluster.
+ * f_sync() runs at most every DATALOG_SYNC_MS, after a buffer write.
+ *
+ * The packer never waits for the writer: a frame that finds no free
+ * buffer is dropped (counted) rather than held in the frame queue.
+ *
+ * File contents: the compact session log of ppg_log_format.h, a session
+ * header (rate profile, LED timing, firmware build) then CRC-checked
+ * blocks of predicted / Rice coded frames (ppg_codec.h): about 0.6 bytes
+ * a sample at 1000 Hz and 1.2 at 100 Hz, against 2 for the raw sample.
+ * host/tools/ppg_log_dump.c decodes it (datalog_stats.bytes / raw_bytes:
+ * log size against the raw samples).
+ ******************************************************************************
+ */
+
+#ifndef DATA_LOGGER_H
+#define DATA_LOGGER_H
+
+#include "ppg_frame.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Sector size [bytes] (FatFs _MAX_SS) */
+#define DATALOG_SECTOR_SIZE      512U
+
+/**
+ * Sectors per buffer, power of two: a write never spans a cluster end
+ * unaligned. A buffer holds the largest frame of the build (PPG_LOG_FRAME_MAX,
+ * about 18 bytes a sample with all channels): 8 up to PPG_BLOCK_SIZE 21.
+ */
+#ifndef DATALOG_BUFFER_SECTORS
+#if (PPG_FRAME_MAX_SAMPLES <= 210U)
+#define DATALOG_BUFFER_SECTORS   8U
+#elif (PPG_FRAME_MAX_SAMPLES <= 440U)
+#define DATALOG_BUFFER_SECTORS   16U
+#else
+#define DATALOG_BUFFER_SECTORS   32U
+#endif
+#endif
+
+#define DATALOG_BUFFER_SIZE      (DATALOG_BUFFER_SECTORS * DATALOG_SECTOR_SIZE)
+
+/** Buffers between packer and writer (2: ping-pong) */
+#ifndef DATALOG_BUFFERS
+#define DATALOG_BUFFERS          2U
+#endif
+
+/** Shortest interval between two f_sync() [ms] */
+#ifndef DATALOG_SYNC_MS
+#define DATALOG_SYNC_MS          1000U
+#endif
+
+/** Packer wait for a frame while a session is open [ms]; the session ends on it once stopped */
+#define DATALOG_FRAME_TIMEOUT_MS 500U
+
+/** Allocation per frame besides two bytes a sample [bytes]: tag, results, block share (PPG_LOG_BANDPASS: more) */
+#define DATALOG_FRAME_OVERHEAD   8U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Logger counters since boot */
+typedef struct
+{
+    uint32_t sessions;          /**< Log files opened */
+    uint32_t frames;            /**< Frames packed */
+    uint32_t frames_lost;       /**< Sequence gaps: frames dropped before the logger queue */
+    uint32_t frames_dropped;    /**< Frames with no free buffer (writer behind) */
+    uint32_t buffers;           /**< Buffers written */
+    uint32_t bytes;             /**< Log bytes written */
+    uint32_t raw_bytes;         /**< Samples packed, as raw 16-bit values (bytes / raw_bytes: log size ratio) */
+    uint32_t syncs;             /**< f_sync() calls */
+    uint32_t fragmented;        /**< Sessions without a contiguous preallocation */
+    uint32_t write_max_ms;      /**< Longest buffer write */
+    uint32_t errors;            /**< Mount, open, write or close failures */
+} DataLogger_Stats_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public data (visible for JLink / JScope)                                   */
+/* ------------------------------------------------------------------------- */
+
+/** Logger counters */
+extern volatile DataLogger_Stats_t datalog_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Create the buffer queues.
+ *
+ * @note Call once before the scheduler starts, after MX_FATFS_Init().
+ *
+ * @return false if the queues cannot be allocated.
+ */
+bool DataLogger_Init(void);
+
+/**
+ * @brief Pack the next frame of the logger queue.
+ *
+ * Blocks until a frame arrives. The first frame of a session opens a
+ * log file; the last one (end of the session length, or none for
+ * DATALOG_FRAME_TIMEOUT_MS once stopped) closes it.
+ *
+ * @note Body of the packer task.
+ */
+void DataLogger_PackStep(void);
+
+/**
+ * @brief Write the next full buffer.
+ *
+ * Blocks until the packer hands over a buffer; opens, writes, syncs and
+ * closes the log files (the only FatFs user of the volume).
+ *
+ * @note Body of the writer task.
+ */
+void DataLogger_WriteStep(void);
+
+#endif /* DATA_LOGGER_H */
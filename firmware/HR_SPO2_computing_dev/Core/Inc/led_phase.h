@@ -0,0 +1,133 @@
+/**
+ ******************************************************************************
+ * @file    led_phase.h
+ * @author  A. Bellina
+ * @brief   Hardware-timed RED / IR / dark LED phase scheduler.
+ *
+ * @details
+ * Every acquisition period is split in LED_PHASES equal phases:
+ *
+ *   | RED on | IR on | both off |  | RED on | ...
+ *      ^        ^        ^            (^ = ADC scan trigger)
+ *
+ * TIM1 counts one phase per update event. At each update DMA2 Stream5
+ * (TIM1_UP request) copies the GPIO BSRR word of the next phase from a
+ * circular table into the LED port: the LEDs switch with no interrupt
+ * and no CPU jitter. TIM1 compare channel 1 (PWM mode 2) rises
+ * LED_PHASE_SAMPLE_LEAD_US before the end of each phase and triggers
+ * the ADC scan (adc_scan.h): the photodiode is sampled after the longest
+ * possible settling time, before the next LED switch. Scan s therefore
+ * belongs to phase s % LED_PHASES, and RED, IR and ambient come from the
+ * same acquisition period.
+ *
+ * The phase timing is derived from the acquisition rate and the timer
+ * clock (LedPhase_GetTiming()). The phase ticks are rounded down to whole
+ * timer ticks: at 16 MHz the period error is below 0.01%, far within the
+ * HSI tolerance.
+ *
+ * The scan and the LED DMA run continuously (the battery channel needs
+ * the scan); LedPhase_SetEnabled() only chooses whether the table lights
+ * the LEDs, so the phase alignment is never lost.
+ ******************************************************************************
+ */
+
+#ifndef LED_PHASE_H
+#define LED_PHASE_H
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** ADC trigger before the end of each phase [us] (photodiode rank done before the switch) */
+#define LED_PHASE_SAMPLE_LEAD_US       5U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Phases of one acquisition period, in time order */
+typedef enum
+{
+    LED_PHASE_RED = 0,   /**< RED LED on */
+    LED_PHASE_IR,        /**< IR LED on */
+    LED_PHASE_DARK,      /**< Both off: ambient light */
+    LED_PHASES
+} LedPhase_t;
+
+/** Phase timer settings for an acquisition rate */
+typedef struct
+{
+    uint16_t prescaler;   /**< PSC */
+    uint16_t period;      /**< ARR: one phase */
+    uint16_t pulse;       /**< CCR1: ADC trigger, LED_PHASE_SAMPLE_LEAD_US before the end */
+} LedPhase_Timing_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Arm the LED DMA on the phase timer, LEDs off.
+ *
+ * Call with the timer stopped, before AdcScan_Start() starts it from 0:
+ * the first phase is then LED_PHASE_RED for the LEDs and the ADC alike.
+ *
+ * @param[in] tim     Phase timer (TIM1) with its update DMA linked.
+ * @param[in] port    GPIO port of both LEDs.
+ * @param[in] red_pin RED LED pin.
+ * @param[in] ir_pin  IR LED pin.
+ *
+ * @return false if the DMA could not be started.
+ */
+bool LedPhase_Init(TIM_HandleTypeDef *tim, GPIO_TypeDef *port, uint16_t red_pin, uint16_t ir_pin);
+
+/**
+ * @brief Compute the phase timer settings.
+ *
+ * @param[in]  rate_hz        Acquisition periods per second.
+ * @param[in]  timer_clock_hz Phase timer counter clock [Hz].
+ * @param[out] timing         Settings.
+ *
+ * @return false if a phase is too short for the ADC trigger lead.
+ */
+bool LedPhase_GetTiming(uint32_t rate_hz, uint32_t timer_clock_hz, LedPhase_Timing_t *timing);
+
+/**
+ * @brief Change the acquisition rate of the running phase timer.
+ *
+ * The phase order, hence the LED / ADC alignment, is kept; the current
+ * phase is cut short. Call between sessions.
+ *
+ * @param[in] rate_hz        Acquisition periods per second.
+ * @param[in] timer_clock_hz Phase timer counter clock [Hz].
+ *
+ * @return false if the rate is out of range (timer unchanged).
+ */
+bool LedPhase_SetRate(uint32_t rate_hz, uint32_t timer_clock_hz);
+
+/**
+ * @brief Light the LEDs in their phases, or keep them off.
+ *
+ * Takes effect at the next phase boundary: the first period after
+ * enabling may be incomplete.
+ *
+ * @param[in] enabled true during a PPG session.
+ */
+void LedPhase_SetEnabled(bool enabled);
+
+/**
+ * @brief Restart the LED sequence on LED_PHASE_RED.
+ *
+ * Call with the timer stopped, before it restarts from 0 (AdcScan_Start()):
+ * the LEDs take the first phase pattern and the DMA the first table
+ * entry, so a restarted scan begins on phase 0 like at boot.
+ *
+ * @return false if the DMA could not be restarted.
+ */
+bool LedPhase_Rewind(void);
+
+#endif /* LED_PHASE_H */
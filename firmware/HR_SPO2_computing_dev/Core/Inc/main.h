@@ -38,6 +38,7 @@ extern "C" {
 /* USER CODE BEGIN ET */
 extern UART_HandleTypeDef huart2;
 extern ADC_HandleTypeDef hadc1;
+extern TIM_HandleTypeDef htim9;
 /* USER CODE END ET */
 
 /* Exported constants --------------------------------------------------------*/
@@ -67,6 +68,8 @@ void Error_Handler(void);
 #define Red_PWM_LED_GPIO_Port GPIOA
 #define Battery_Alarm_Led_Pin GPIO_PIN_7
 #define Battery_Alarm_Led_GPIO_Port GPIOA
+#define SD_CS_Pin GPIO_PIN_12
+#define SD_CS_GPIO_Port GPIOB
 
 /* USER CODE BEGIN Private defines */
 
@@ -0,0 +1,134 @@
+/**
+ ******************************************************************************
+ * @file    ppg_beat_detector.h
+ * @author  A. Bellina
+ * @brief   Streaming PPG beat detector and per-beat heart rate.
+ *
+ * @details
+ * Detects systolic peaks on the band-passed PPG signal one sample at a
+ * time, with O(1) work and a fixed, small state (no signal buffering):
+ *   - slope-based detection: a beat starts when the first difference
+ *     x[n] - x[n-1] exceeds an adaptive threshold and ends at the next
+ *     zero crossing of the slope (systolic peak)
+ *   - adaptive threshold: half of the running average of the maximum
+ *     upstroke slope of recent beats, slowly decaying while no beat is
+ *     found so the detector re-acquires after amplitude drops
+ *   - refractory period: no new beat within PPG_BEAT_REFRACTORY_MS of the
+ *     previous one (caps detection at 240 bpm), extended to half the
+ *     average beat interval once the rhythm is known (rejects dicrotic
+ *     notches and noise bumps)
+ *
+ * A new HR value is produced at every beat, averaged over the last
+ * PPG_BEAT_HISTORY valid beat-to-beat intervals.
+ ******************************************************************************
+ */
+
+#ifndef PPG_BEAT_DETECTOR_H
+#define PPG_BEAT_DETECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Minimum time between two beats [ms] (240 bpm) */
+#define PPG_BEAT_REFRACTORY_MS     250U
+
+/** Longest accepted beat-to-beat interval [ms] (30 bpm) */
+#define PPG_BEAT_MAX_INTERVAL_MS   2000U
+
+/** Initial learning time used to seed the threshold [ms] */
+#define PPG_BEAT_LEARN_MS          2000U
+
+/** Number of intervals averaged for the reported HR */
+#define PPG_BEAT_HISTORY           4U
+
+/** Lowest slope threshold (Q15 LSB per sample), rejects noise on flat input */
+#define PPG_BEAT_MIN_SLOPE         8
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Detected beat */
+typedef struct
+{
+    uint32_t sample_index;   /**< Sample index of the systolic peak */
+    uint32_t interval;       /**< Samples since the previous beat (0 if none/invalid) */
+    float    hr_bpm;         /**< HR averaged over the last intervals (0 until known) */
+} PPG_Beat_t;
+
+/** Beat detector state */
+typedef struct
+{
+    uint16_t fs;                    /**< Sampling rate [Hz] */
+    uint16_t refractory;            /**< Refractory period [samples] */
+    uint16_t max_interval;          /**< Longest valid interval [samples] */
+    uint16_t learn_samples;         /**< Learning period [samples] */
+
+    uint32_t n;                     /**< Samples processed, blanked ones included */
+    uint32_t learned;               /**< Samples learned from (blanked ones excluded) */
+    int16_t  prev;                  /**< Previous input sample */
+    bool     rising;                /**< Inside a detected upstroke */
+
+    int32_t  threshold;             /**< Current slope threshold */
+    int32_t  slope_avg;             /**< Running average of beat upstroke slopes */
+    int32_t  slope_max;             /**< Max slope of the current upstroke */
+
+    uint32_t last_beat;             /**< Sample index of the previous beat */
+    bool     have_beat;             /**< last_beat is valid */
+
+    uint32_t intervals[PPG_BEAT_HISTORY];  /**< Last valid intervals [samples] */
+    uint32_t interval_sum;          /**< Sum of intervals[] */
+    uint8_t  interval_index;        /**< Next write position in intervals[] */
+    uint8_t  interval_count;        /**< Valid entries in intervals[] */
+} PPG_BeatDetector_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize the beat detector.
+ *
+ * @param[out] det   Detector state.
+ * @param[in]  fs_hz Sampling rate of the input signal [Hz].
+ */
+void PPG_BeatDetector_Init(PPG_BeatDetector_t *det, uint16_t fs_hz);
+
+/**
+ * @brief Restart detection (keeps the sampling rate).
+ *
+ * @param[in,out] det Detector state.
+ */
+void PPG_BeatDetector_Reset(PPG_BeatDetector_t *det);
+
+/**
+ * @brief Process one band-passed sample.
+ *
+ * @param[in,out] det  Detector state.
+ * @param[in]     x    Band-passed sample (Q15, DC removed).
+ * @param[out]    beat Filled when a beat is detected (may be NULL).
+ *
+ * @retval true  A beat was detected on this sample.
+ * @retval false No beat.
+ */
+bool PPG_BeatDetector_Update(PPG_BeatDetector_t *det, int16_t x, PPG_Beat_t *beat);
+
+/**
+ * @brief Skip one sample of a blanked span (input switch, settling).
+ *
+ * Any upstroke in progress is dropped and the next beat starts a new
+ * interval; the threshold and the interval history are kept. The sample
+ * clock advances, so beat indices, the refractory period and the
+ * interval timeout stay on the real sample clock; learning only counts
+ * the samples it saw.
+ *
+ * @param[in,out] det Detector state.
+ * @param[in]     x   Band-passed sample (only kept as the previous one).
+ */
+void PPG_BeatDetector_Blank(PPG_BeatDetector_t *det, int16_t x);
+
+#endif /* PPG_BEAT_DETECTOR_H */
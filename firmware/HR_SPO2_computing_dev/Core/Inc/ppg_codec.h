@@ -0,0 +1,178 @@
+/**
+ ******************************************************************************
+ * @file    ppg_codec.h
+ * @author  A. Bellina
+ * @brief   Lossless sample codec: fixed linear prediction + adaptive Rice.
+ *
+ * @details
+ * Streaming, per channel, for the session log (ppg_log_format.h) and any
+ * other byte stream (telemetry):
+ *   - each sample is predicted from the previous ones by a fixed
+ *     polynomial predictor of order 1..3:
+ *       1: x[n-1]
+ *       2: 2 x[n-1] - x[n-2]
+ *       3: 3 x[n-1] - 3 x[n-2] + x[n-3]
+ *     a smooth PPG leaves a residual of about the noise
+ *   - the zig-zag mapped residual u is Rice coded with parameter k:
+ *     u >> k in unary (zeros, then a one), then the k low bits of u
+ *   - k follows the mean of u (running sum and count, halved every
+ *     PPG_CODEC_RESET samples, as LOCO-I / JPEG-LS): no side information
+ *   - a residual whose unary part would reach PPG_CODEC_QMAX is escaped:
+ *     PPG_CODEC_QMAX zeros, then u in PPG_CODEC_ESCAPE_BITS bits
+ *
+ * PPG_Codec_Reset() is a reset point: the next sample is stored raw
+ * (16 bits), the following ones use the orders their history allows, and
+ * k restarts from PPG_CODEC_INIT_K. Decoding can start at any reset
+ * point. Encoding and decoding a sample take a bounded number of steps:
+ * at most 3 multiply-adds, one division, one CLZ and PPG_CODEC_QMAX +
+ * PPG_CODEC_ESCAPE_BITS bits.
+ *
+ * Bits are packed MSB first. The caller aligns the stream to a byte
+ * when it needs to (PPG_BitWriter_Flush()), and may interleave its own
+ * fields (PPG_BitWriter_Put()) or write the stream in pieces
+ * (PPG_BitWriter_Resume()).
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host
+ * (see host/CMakeLists.txt, host/bench/bench_codec.c).
+ ******************************************************************************
+ */
+
+#ifndef PPG_CODEC_H
+#define PPG_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+#define PPG_CODEC_MAX_ORDER     3U
+
+/** Unary length that escapes a residual */
+#define PPG_CODEC_QMAX          16U
+
+/** Escaped residual: |x - prediction| < 5 * 2^16, zig-zag below 2^20 */
+#define PPG_CODEC_ESCAPE_BITS   20U
+
+/** Samples between two halvings of the k statistics */
+#define PPG_CODEC_RESET         32U
+
+/** k after a reset point */
+#define PPG_CODEC_INIT_K        3U
+
+/** Largest encoding of one sample [bits] */
+#define PPG_CODEC_MAX_BITS      (PPG_CODEC_QMAX + PPG_CODEC_ESCAPE_BITS)
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** State of one channel, encoder and decoder alike */
+typedef struct
+{
+    int32_t  hist[PPG_CODEC_MAX_ORDER];  /**< x[n-1], x[n-2], x[n-3] */
+    uint32_t have;                       /**< Samples since the reset point (up to the order) */
+    uint32_t sum;                        /**< Sum of the recent zig-zag residuals */
+    uint32_t count;                      /**< Residuals in sum */
+} PPG_CodecChannel_t;
+
+/** Bit packer into a byte buffer */
+typedef struct
+{
+    uint8_t  *buf;
+    size_t    pos;                      /**< Whole bytes written */
+    uint32_t  acc;                      /**< Pending bits, low end */
+    uint32_t  bits;                     /**< Pending bit count (0..7 between calls) */
+} PPG_BitWriter_t;
+
+/** Bit reader over a byte range */
+typedef struct
+{
+    const uint8_t *buf;
+    size_t         pos;                 /**< Bytes consumed */
+    size_t         end;
+    uint32_t       acc;
+    uint32_t       bits;
+    bool           ok;                  /**< Cleared on a read past the end */
+} PPG_BitReader_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Reset point: forget the history and the k statistics.
+ *
+ * @param[out] ch Channel state.
+ */
+void PPG_Codec_Reset(PPG_CodecChannel_t *ch);
+
+/**
+ * @brief Encode samples of one channel.
+ *
+ * @param[in,out] ch    Channel state.
+ * @param[in]     order Predictor order, 1..PPG_CODEC_MAX_ORDER.
+ * @param[in,out] bw    Output, room for n * PPG_CODEC_MAX_BITS bits.
+ * @param[in]     x     Samples.
+ * @param[in]     n     Number of samples.
+ */
+void PPG_Codec_Encode(PPG_CodecChannel_t *ch, uint32_t order, PPG_BitWriter_t *bw,
+                      const uint16_t *x, uint32_t n);
+
+/**
+ * @brief Decode samples of one channel.
+ *
+ * @param[in,out] ch    Channel state.
+ * @param[in]     order Predictor order used by the encoder.
+ * @param[in,out] br    Input.
+ * @param[out]    x     Samples.
+ * @param[in]     n     Number of samples.
+ *
+ * @return false on a read past the end or a sample out of 0..65535.
+ */
+bool PPG_Codec_Decode(PPG_CodecChannel_t *ch, uint32_t order, PPG_BitReader_t *br,
+                      uint16_t *x, uint32_t n);
+
+/**
+ * @brief Start packing bits at buf.
+ */
+void PPG_BitWriter_Init(PPG_BitWriter_t *bw, uint8_t *buf);
+
+/**
+ * @brief Continue packing at buf, the pending bits kept: the stream goes
+ *        out in pieces, each one ending at the last whole byte.
+ */
+void PPG_BitWriter_Resume(PPG_BitWriter_t *bw, uint8_t *buf);
+
+/**
+ * @brief Append the n low bits of v (n <= 24).
+ */
+void PPG_BitWriter_Put(PPG_BitWriter_t *bw, uint32_t v, uint32_t n);
+
+/**
+ * @brief Pad the pending bits with zeros to a whole byte.
+ *
+ * @return Bytes written since PPG_BitWriter_Init() or PPG_BitWriter_Resume().
+ */
+size_t PPG_BitWriter_Flush(PPG_BitWriter_t *bw);
+
+/**
+ * @brief Start reading bits from buf[0..len).
+ */
+void PPG_BitReader_Init(PPG_BitReader_t *br, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Read n bits (n <= 24); zeros past the end (br->ok cleared).
+ */
+uint32_t PPG_BitReader_Get(PPG_BitReader_t *br, uint32_t n);
+
+/**
+ * @brief Drop the bits left in the current byte.
+ *
+ * @return Bytes consumed since PPG_BitReader_Init().
+ */
+size_t PPG_BitReader_Align(PPG_BitReader_t *br);
+
+#endif /* PPG_CODEC_H */
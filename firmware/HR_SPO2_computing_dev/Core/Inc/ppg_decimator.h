@@ -0,0 +1,111 @@
+/**
+ ******************************************************************************
+ * @file    ppg_decimator.h
+ * @author  A. Bellina
+ * @brief   CIC decimator from the oversampled ADC rate to PPG_FS.
+ *
+ * @details
+ * Cascaded integrator-comb (Hogenauer) decimator of order PPG_CIC_ORDER
+ * and ratio R, differential delay 1:
+ *   - per input sample: PPG_CIC_ORDER integrator additions
+ *   - per output sample: PPG_CIC_ORDER comb subtractions and one
+ *     multiply-shift that removes the R^N gain
+ * No multiplications at the input rate and no coefficient tables. The
+ * integrators wrap modulo 2^32, which is harmless for a CIC as long as
+ * 12 + N * log2(R) <= 32 bits.
+ *
+ * The response has nulls at every multiple of the output rate: exactly
+ * the bands that would alias onto 0..PPG_FS/2, unlike the plain
+ * x[::R] slicing of the notebook. The passband droop at 4 Hz (HR band)
+ * for a 100 Hz output is below 0.1 dB, so no compensation filter is
+ * needed. Averaging R samples lowers the white ADC noise by sqrt(R)
+ * before the result is rounded back to 12 bits.
+ *
+ * Hardware independent: built on the host by host/CMakeLists.txt
+ * (bench_decimator).
+ ******************************************************************************
+ */
+
+#ifndef PPG_DECIMATOR_H
+#define PPG_DECIMATOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * ADC samples per processed sample (oversampling ratio R).
+ * 1 disables oversampling. Set from CMake with -DPPG_OVERSAMPLE=<n>.
+ */
+#ifndef PPG_OVERSAMPLE
+#define PPG_OVERSAMPLE         1U
+#endif
+
+/** CIC order N (integrator / comb stages) */
+#ifndef PPG_CIC_ORDER
+#define PPG_CIC_ORDER          3U
+#endif
+
+/** Largest ratio keeping 12 + N * log2(R) within 32 bits for N = 3..4 */
+#define PPG_CIC_MAX_RATIO      32U
+
+#if (PPG_OVERSAMPLE < 1U) || (PPG_OVERSAMPLE > PPG_CIC_MAX_RATIO)
+#error "PPG_OVERSAMPLE must be in range 1..PPG_CIC_MAX_RATIO"
+#endif
+
+#if (PPG_CIC_ORDER < 1U) || (PPG_CIC_ORDER > 4U)
+#error "PPG_CIC_ORDER must be in range 1..4"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** CIC decimator state */
+typedef struct
+{
+    uint32_t integ[PPG_CIC_ORDER];   /**< Integrator outputs (mod 2^32) */
+    uint32_t delay[PPG_CIC_ORDER];   /**< Previous comb inputs */
+    uint32_t ratio;                  /**< Decimation ratio R */
+    uint32_t phase;                  /**< Input samples since the last output */
+    uint32_t gain_inv;               /**< 2^32 / R^N, rounded (Q32) */
+} PPG_CIC_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize a decimator.
+ *
+ * @param[out] cic   Decimator state.
+ * @param[in]  ratio Decimation ratio R (1..PPG_CIC_MAX_RATIO).
+ *
+ * @return false if the ratio is out of range.
+ */
+bool PPG_CIC_Init(PPG_CIC_t *cic, uint32_t ratio);
+
+/**
+ * @brief Clear the integrators and combs (keeps the ratio).
+ *
+ * The first PPG_CIC_ORDER outputs after a reset are the filter ramp-up.
+ *
+ * @param[in,out] cic Decimator state.
+ */
+void PPG_CIC_Reset(PPG_CIC_t *cic);
+
+/**
+ * @brief Push one ADC sample.
+ *
+ * @param[in,out] cic Decimator state.
+ * @param[in]     x   12-bit input sample.
+ * @param[out]    y   12-bit output sample, written when true is returned.
+ *
+ * @return true every R-th input, when an output sample is ready.
+ */
+bool PPG_CIC_Process(PPG_CIC_t *cic, uint16_t x, uint16_t *y);
+
+#endif /* PPG_DECIMATOR_H */
@@ -0,0 +1,102 @@
+/**
+ ******************************************************************************
+ * @file    ppg_filter_bank.h
+ * @author  A. Bellina
+ * @brief   Per-channel moving-average filter bank for PPG signals.
+ *
+ * @details
+ * Holds one moving-average (boxcar) state per acquisition channel
+ * (RED, IR, ambient, battery; see ppg_frame.h). Each state keeps a
+ * running sum, so the per-sample cost is constant (one add, one
+ * subtract, one divide) regardless of the window length.
+ *
+ * The window length is fixed at compile time through PPG_FILTER_WINDOW
+ * (default 16 taps, up to 65535). Power-of-two lengths let the compiler
+ * turn the final division into a shift once the window is full.
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host
+ * (see host/CMakeLists.txt).
+ ******************************************************************************
+ */
+
+#ifndef PPG_FILTER_BANK_H
+#define PPG_FILTER_BANK_H
+
+#include "ppg_frame.h"
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Moving Average filter window (taps) */
+#ifndef PPG_FILTER_WINDOW
+#define PPG_FILTER_WINDOW      16U
+#endif
+
+#if (PPG_FILTER_WINDOW < 1U) || (PPG_FILTER_WINDOW > 65535U)
+#error "PPG_FILTER_WINDOW must be in range 1..65535"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Moving-average state of one channel */
+typedef struct
+{
+    uint16_t buffer[PPG_FILTER_WINDOW];   /**< Last PPG_FILTER_WINDOW samples */
+    uint32_t sum;                         /**< Running sum of buffer[0..count) */
+    uint16_t index;                       /**< Next write position */
+    uint16_t count;                       /**< Valid samples (<= window) */
+} PPG_MovingAverage_t;
+
+/** One moving-average state per acquisition channel */
+typedef struct
+{
+    PPG_MovingAverage_t channel[PPG_CH_COUNT];
+} PPG_FilterBank_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Reset all channels of the filter bank.
+ *
+ * @param[out] bank Filter bank to reset.
+ */
+void PPG_FilterBank_Reset(PPG_FilterBank_t *bank);
+
+/**
+ * @brief Reset a single moving-average state.
+ *
+ * @param[out] ma Moving-average state to reset.
+ */
+void PPG_MovingAverage_Reset(PPG_MovingAverage_t *ma);
+
+/**
+ * @brief Push one sample into a moving-average state.
+ *
+ * Until the window is full the output is the mean of the samples
+ * received so far.
+ *
+ * @param[in,out] ma     Moving-average state.
+ * @param[in]     sample New input sample.
+ *
+ * @return Filtered output (mean of the window).
+ */
+uint16_t PPG_MovingAverage_Update(PPG_MovingAverage_t *ma, uint16_t sample);
+
+/**
+ * @brief Push one sample into the selected channel of the bank.
+ *
+ * @param[in,out] bank    Filter bank.
+ * @param[in]     channel Channel to update (must be < PPG_CH_COUNT).
+ * @param[in]     sample  New input sample.
+ *
+ * @return Filtered output of that channel.
+ */
+uint16_t PPG_FilterBank_Update(PPG_FilterBank_t *bank, PPG_Channel_t channel, uint16_t sample);
+
+#endif /* PPG_FILTER_BANK_H */
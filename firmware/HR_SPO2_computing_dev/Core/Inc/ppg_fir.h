@@ -0,0 +1,102 @@
+/**
+ ******************************************************************************
+ * @file    ppg_fir.h
+ * @author  A. Bellina
+ * @brief   Fixed-point FIR filter engine (Q15 data, Q31 accumulator).
+ *
+ * @details
+ * Direct-form FIR filter for PPG signals:
+ *   - Q15 input/output samples and Q15 coefficients
+ *   - 32-bit (Q30 products summed in Q31 range) accumulator
+ *   - output rounded and saturated back to Q15
+ *
+ * On Cortex-M4 the inner loop uses the SMLAD dual 16x16 MAC instruction
+ * (two taps per instruction). On other targets (host build) the same
+ * arithmetic is emulated in portable C, so both builds are bit-exact.
+ *
+ * The delay line is a double-length buffer: every sample is written
+ * twice, so the last num_taps samples are always contiguous and the MAC
+ * loop needs no modulo addressing.
+ *
+ * The accumulator does not saturate: the coefficient set must satisfy
+ * sum(|h|) < 2.0 (checked by offline_analysis/scripts/export_fir_coeffs.py).
+ *
+ * Estimated cost per output sample: ceil(num_taps / 2) SMLAD plus two
+ * loads each, ~2.5 cycles per tap pair on the M4 (~170 cycles for the
+ * 128-tap band-pass: ~1.7 us at 100 MHz, ~10.6 us at the current 16 MHz
+ * HSI clock).
+ ******************************************************************************
+ */
+
+#ifndef PPG_FIR_H
+#define PPG_FIR_H
+
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** FIR filter instance */
+typedef struct
+{
+    const int16_t *coeffs;    /**< Q15 taps h[0..num_taps), natural order */
+    int16_t       *state;     /**< Delay line, 2 * num_taps entries (caller-provided) */
+    uint16_t       num_taps;  /**< Filter length */
+    uint16_t       index;     /**< Position of the newest sample in state */
+} PPG_FIR_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize a FIR filter instance.
+ *
+ * @param[out] fir      Filter instance.
+ * @param[in]  coeffs   Q15 coefficients, num_taps entries (kept by reference).
+ * @param[in]  num_taps Number of taps (>= 1).
+ * @param[in]  state    Delay line buffer of 2 * num_taps entries.
+ */
+void PPG_FIR_Init(PPG_FIR_t *fir, const int16_t *coeffs, uint16_t num_taps, int16_t *state);
+
+/**
+ * @brief Clear the delay line of a FIR filter.
+ *
+ * @param[in,out] fir Filter instance.
+ */
+void PPG_FIR_Reset(PPG_FIR_t *fir);
+
+/**
+ * @brief Filter one Q15 sample.
+ *
+ * @param[in,out] fir Filter instance.
+ * @param[in]     x   New Q15 input sample.
+ *
+ * @return Q15 output sample (rounded, saturated).
+ */
+int16_t PPG_FIR_Process(PPG_FIR_t *fir, int16_t x);
+
+/**
+ * @brief Filter a block of Q15 samples.
+ *
+ * @param[in,out] fir Filter instance.
+ * @param[in]     in  Input samples.
+ * @param[out]    out Output samples (may alias in).
+ * @param[in]     n   Number of samples.
+ */
+void PPG_FIR_ProcessBlock(PPG_FIR_t *fir, const int16_t *in, int16_t *out, uint16_t n);
+
+/**
+ * @brief Convert a 12-bit ADC code to Q15 (mid-scale removed).
+ *
+ * @param[in] adc 12-bit ADC sample (0..4095).
+ *
+ * @return Q15 sample in [-1.0, 1.0).
+ */
+static inline int16_t PPG_FIR_FromAdc12(uint16_t adc)
+{
+    return (int16_t)(((int32_t)(adc & 0x0FFFU) - 2048) * 16);
+}
+
+#endif /* PPG_FIR_H */
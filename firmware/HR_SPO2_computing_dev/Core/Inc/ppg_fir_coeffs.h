@@ -0,0 +1,49 @@
+/**
+ ******************************************************************************
+ * @file    ppg_fir_coeffs.h
+ * @brief   HR band-pass FIR coefficients (Q15).
+ *
+ * @details
+ * GENERATED by offline_analysis/scripts/export_fir_coeffs.py - do not edit.
+ *
+ * Design: scipy.signal.firwin, Hamming window, zero DC gain
+ *   - fs       : 100 Hz
+ *   - band     : 0.5 - 4.0 Hz
+ *   - num taps : 128
+ *   - sum(|h|) : 1.7318
+ ******************************************************************************
+ */
+
+#ifndef PPG_FIR_COEFFS_H
+#define PPG_FIR_COEFFS_H
+
+#include <stdint.h>
+
+/** Sampling rate the band-pass was designed for [Hz] */
+#define PPG_FIR_BP_FS          100U
+
+/** Number of taps of the HR band-pass */
+#define PPG_FIR_BP_NUM_TAPS    128U
+
+/** HR band-pass taps h[0..PPG_FIR_BP_NUM_TAPS), Q15 */
+static const int16_t ppg_fir_bp_coeffs[PPG_FIR_BP_NUM_TAPS] __attribute__((aligned(4))) =
+{
+      -113,   -110,   -108,   -105,   -102,   -100,    -98,    -98,
+       -98,   -100,   -104,   -110,   -118,   -129,   -142,   -157,
+      -173,   -190,   -207,   -222,   -234,   -242,   -246,   -244,
+      -236,   -223,   -203,   -180,   -154,   -127,   -102,    -82,
+       -69,    -66,    -76,   -100,   -140,   -194,   -262,   -343,
+      -431,   -523,   -614,   -696,   -764,   -812,   -832,   -820,
+      -772,   -684,   -557,   -389,   -186,     49,    308,    584,
+       866,   1145,   1409,   1648,   1853,   2014,   2126,   2185,
+      2185,   2126,   2014,   1853,   1648,   1409,   1145,    866,
+       584,    308,     49,   -186,   -389,   -557,   -684,   -772,
+      -820,   -832,   -812,   -764,   -696,   -614,   -523,   -431,
+      -343,   -262,   -194,   -140,   -100,    -76,    -66,    -69,
+       -82,   -102,   -127,   -154,   -180,   -203,   -223,   -236,
+      -244,   -246,   -242,   -234,   -222,   -207,   -190,   -173,
+      -157,   -142,   -129,   -118,   -110,   -104,   -100,    -98,
+       -98,    -98,   -100,   -102,   -105,   -108,   -110,   -113,
+};
+
+#endif /* PPG_FIR_COEFFS_H */
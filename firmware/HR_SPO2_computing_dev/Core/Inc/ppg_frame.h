@@ -0,0 +1,181 @@
+/**
+ ******************************************************************************
+ * @file    ppg_frame.h
+ * @author  A. Bellina
+ * @brief   Multi-channel timestamped sample frames and frame pool.
+ *
+ * @details
+ * A frame carries one acquisition block of every channel (RED, IR,
+ * ambient, battery) in structure-of-arrays layout, together with:
+ *   - a sequence number, incremented for every block acquired, so any
+ *     consumer detects dropped blocks as gaps
+ *   - the sample clock (TIM9 period count) of its first sample
+ *   - the processing results of the block, filled by the processing task
+ *
+ * Frames live in a fixed pool and are passed between tasks by pointer
+ * (acquisition -> processing -> logging). Each holder owns
+ * one reference; the frame returns to the pool when the last holder
+ * releases it. Reference counts are updated atomically, so frames can be
+ * acquired from an ISR and released from any task.
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host
+ * (see host/CMakeLists.txt).
+ ******************************************************************************
+ */
+
+#ifndef PPG_FRAME_H
+#define PPG_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * Samples per channel in a frame (acquisition block).
+ *
+ * The processing task wakes once per frame. 1 keeps one task wakeup per
+ * sample. Set from CMake with -DPPG_BLOCK_SIZE=<n>.
+ */
+#ifndef PPG_BLOCK_SIZE
+#define PPG_BLOCK_SIZE         1U
+#endif
+
+/**
+ * Highest capture-to-PPG_FS decimation a frame can hold: 10 for the
+ * 1000 Hz rate profile (ppg_rate.h). 1 saves RAM when only the 100 Hz
+ * profile is used.
+ */
+#ifndef PPG_FRAME_MAX_DECIMATION
+#define PPG_FRAME_MAX_DECIMATION  10U
+#endif
+
+/** Capture samples per channel a frame can hold */
+#define PPG_FRAME_MAX_SAMPLES  (PPG_BLOCK_SIZE * PPG_FRAME_MAX_DECIMATION)
+
+/**
+ * PPG_FS results per frame: PPG_BLOCK_SIZE, one more when the capture
+ * rate is not a multiple of PPG_FS (250 Hz)
+ */
+#define PPG_FRAME_MAX_OUTPUTS  (PPG_BLOCK_SIZE + 1U)
+
+/** Frames in the pool: one filling, the rest queued or held by consumers */
+#if (PPG_BLOCK_SIZE == 1U)
+#define PPG_FRAME_POOL_SIZE    32U
+#else
+#define PPG_FRAME_POOL_SIZE    8U
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Acquisition channels carried by a frame */
+typedef enum
+{
+    PPG_CH_RED = 0,
+    PPG_CH_IR,
+    PPG_CH_AMBIENT,
+    PPG_CH_BATTERY,
+    PPG_CH_COUNT
+} PPG_Channel_t;
+
+/** Bit of a channel in PPG_Frame_t::channel_mask */
+#define PPG_CH_MASK(ch)        (1U << (ch))
+
+/** Acquisition mode of a frame (PPG_Frame_t::flags) */
+#define PPG_FRAME_FLAG_SIMULTANEOUS  0x0001U  /**< RED and IR in every sample (else one window channel per sample) */
+
+/** Processing events within a frame (PPG_FrameResults_t::events) */
+#define PPG_FRAME_EVENT_WINDOW   0x0001U    /**< An acquisition window starts (alternating LEDs) */
+#define PPG_FRAME_EVENT_SETTLED  0x0002U    /**< Settling and band-pass delay over: SpO2 accumulates */
+
+/** Processing results of one frame */
+typedef struct
+{
+    int16_t  bandpassed[PPG_FRAME_MAX_OUTPUTS]; /**< HR band-pass output per PPG_FS sample, Q15 */
+    uint16_t count;                             /**< PPG_FS samples in bandpassed[] */
+    uint16_t events;                            /**< PPG_FRAME_EVENT_* */
+    float    hr_bpm;                            /**< Beat-to-beat HR at the end of the frame */
+    float    hr_spectral_bpm;                   /**< Spectral HR at the end of the frame */
+    float    spo2_percent;                      /**< SpO2 at the end of the frame */
+    uint32_t beat_count;                        /**< Beats detected since the session start */
+} PPG_FrameResults_t;
+
+/** One acquisition block of all channels */
+typedef struct
+{
+    uint32_t sequence;                                     /**< Block number since PPG_Start() */
+    uint32_t timestamp;                                    /**< Sample clock of samples[.][0] */
+    uint32_t queued_at;                                    /**< Profiling time base when queued (ppg_profile.h) */
+    uint16_t count;                                        /**< Valid samples per channel */
+    uint16_t channel_mask;                                 /**< PPG_CH_MASK() of the channels written */
+    uint16_t flags;                                        /**< PPG_FRAME_FLAG_* */
+    uint16_t samples[PPG_CH_COUNT][PPG_FRAME_MAX_SAMPLES]; /**< Raw 12-bit ADC samples, capture rate */
+    PPG_FrameResults_t results;                            /**< Filled by the processing task */
+    uint32_t refs;                                         /**< Holders (0 = free in the pool) */
+} PPG_Frame_t;
+
+/** Fixed pool of frames */
+typedef struct
+{
+    PPG_Frame_t frames[PPG_FRAME_POOL_SIZE];
+    uint32_t    next;                               /**< Where the next search starts */
+} PPG_FramePool_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Mark every frame of the pool as free.
+ *
+ * @param[out] pool Frame pool.
+ */
+void PPG_FramePool_Init(PPG_FramePool_t *pool);
+
+/**
+ * @brief Take a free frame (ISR safe, single producer).
+ *
+ * Frames are handed out in ring order. The frame is cleared, stamped and
+ * returned with one reference owned by the caller.
+ *
+ * @param[in,out] pool      Frame pool.
+ * @param[in]     sequence  Block number of the new frame.
+ * @param[in]     timestamp Sample clock of its first sample.
+ *
+ * @return The frame, or NULL if every frame is still held.
+ */
+PPG_Frame_t *PPG_FramePool_Acquire(PPG_FramePool_t *pool, uint32_t sequence, uint32_t timestamp);
+
+/**
+ * @brief Add references before handing a frame to more holders.
+ *
+ * @param[in,out] frame Frame already held by the caller.
+ * @param[in]     count References to add.
+ */
+void PPG_Frame_Retain(PPG_Frame_t *frame, uint32_t count);
+
+/**
+ * @brief Drop one reference.
+ *
+ * @param[in,out] frame Frame held by the caller (not usable afterwards).
+ *
+ * @retval true  Last reference: the frame is back in the pool.
+ * @retval false Other holders remain.
+ */
+bool PPG_Frame_Release(PPG_Frame_t *frame);
+
+/**
+ * @brief Check the sequence of a received frame.
+ *
+ * @param[in,out] expected Sequence number expected next (updated).
+ * @param[in]     frame    Received frame.
+ *
+ * @return Number of frames missing before this one.
+ */
+uint32_t PPG_Frame_CheckSequence(uint32_t *expected, const PPG_Frame_t *frame);
+
+#endif /* PPG_FRAME_H */
@@ -0,0 +1,141 @@
+/**
+ ******************************************************************************
+ * @file    ppg_hr_spectral.h
+ * @author  A. Bellina
+ * @brief   Streaming spectral HR estimator (Goertzel bank).
+ *
+ * @details
+ * On-device counterpart of the Welch PSD used in filter_design.ipynb
+ * (Hamming window, 10 s segments, 50 % overlap, 0.5-4 Hz peak search):
+ *   - one Goertzel resonator per DFT bin of the 30-240 bpm band, updated
+ *     at every sample (bounded work: 3 flops per bin and segment)
+ *   - two segment instances staggered by half a segment give the 50 %
+ *     overlap; the Hamming window is generated by a rotating phasor
+ *   - at the end of each segment the bin powers are averaged into a PSD
+ *     (mean of the first PPG_SPECTRAL_AVG segments, then exponential)
+ *   - HR = dominant PSD bin refined by parabolic interpolation
+ *
+ * Only two state floats per bin and segment are kept: about 1 KB of RAM
+ * against 8 KB of samples and complex FFT buffers for a 1000-point FFT.
+ *
+ * The bin grid depends only on the segment length in time, so the same
+ * configuration holds for any sampling rate.
+ ******************************************************************************
+ */
+
+#ifndef PPG_HR_SPECTRAL_H
+#define PPG_HR_SPECTRAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Segment length [ms]: frequency resolution is 1000 / PPG_SPECTRAL_SEGMENT_MS Hz */
+#define PPG_SPECTRAL_SEGMENT_MS    10000U
+
+/** HR search band [bpm] (notebook: 0.5-4 Hz) */
+#define PPG_SPECTRAL_MIN_BPM       30U
+#define PPG_SPECTRAL_MAX_BPM       240U
+
+/** Segments averaged before the PSD switches to an exponential average */
+#ifndef PPG_SPECTRAL_AVG
+#define PPG_SPECTRAL_AVG           4U
+#endif
+
+/** First and last DFT bin of the search band */
+#define PPG_SPECTRAL_FIRST_BIN     ((PPG_SPECTRAL_MIN_BPM * PPG_SPECTRAL_SEGMENT_MS) / 60000U)
+#define PPG_SPECTRAL_LAST_BIN      ((PPG_SPECTRAL_MAX_BPM * PPG_SPECTRAL_SEGMENT_MS) / 60000U)
+
+/** Number of Goertzel bins (36 for 10 s segments) */
+#define PPG_SPECTRAL_NUM_BINS      (PPG_SPECTRAL_LAST_BIN - PPG_SPECTRAL_FIRST_BIN + 1U)
+
+/** Overlapping segment instances (50 % overlap) */
+#define PPG_SPECTRAL_SEGMENTS      2U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** One windowed segment in progress */
+typedef struct
+{
+    float    s1[PPG_SPECTRAL_NUM_BINS];   /**< Goertzel state s[n-1] */
+    float    s2[PPG_SPECTRAL_NUM_BINS];   /**< Goertzel state s[n-2] */
+    float    win_cos;                     /**< cos(2 pi pos / N) of the Hamming window */
+    float    win_sin;                     /**< sin(2 pi pos / N) */
+    uint32_t pos;                         /**< Samples accumulated in this segment */
+    bool     active;                      /**< Segment started */
+} PPG_SpectralSegment_t;
+
+/** Spectral HR estimate */
+typedef struct
+{
+    float hr_bpm;      /**< Interpolated peak frequency [bpm] */
+    float peak_hz;     /**< Interpolated peak frequency [Hz] */
+    float quality;     /**< Peak bin power / total band power (0..1) */
+} PPG_SpectralHR_t;
+
+/** Spectral estimator state */
+typedef struct
+{
+    uint16_t fs;                                /**< Sampling rate [Hz] */
+    uint32_t seg_len;                           /**< Samples per segment N */
+    uint32_t hop;                               /**< Samples between segment starts */
+    uint32_t n;                                 /**< Samples processed */
+
+    float    coeff[PPG_SPECTRAL_NUM_BINS];      /**< 2 cos(2 pi k / N) */
+    float    rot_cos;                           /**< Window phasor step cos(2 pi / N) */
+    float    rot_sin;                           /**< Window phasor step sin(2 pi / N) */
+    float    win_norm;                          /**< 1 / sum(w^2), PSD normalization */
+
+    PPG_SpectralSegment_t segment[PPG_SPECTRAL_SEGMENTS];
+
+    float    psd[PPG_SPECTRAL_NUM_BINS];        /**< Averaged bin power */
+    uint32_t segments_done;                     /**< Segments averaged into psd[] */
+} PPG_Spectral_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize the spectral estimator.
+ *
+ * @param[out] sp    Estimator state.
+ * @param[in]  fs_hz Sampling rate of the input signal [Hz].
+ */
+void PPG_Spectral_Init(PPG_Spectral_t *sp, uint16_t fs_hz);
+
+/**
+ * @brief Restart segments and PSD average (keeps the sampling rate).
+ *
+ * @param[in,out] sp Estimator state.
+ */
+void PPG_Spectral_Reset(PPG_Spectral_t *sp);
+
+/**
+ * @brief Process one sample.
+ *
+ * @param[in,out] sp  Estimator state.
+ * @param[in]     x   Input sample (band-passed, Q15, DC removed).
+ * @param[out]    est Filled when a segment completes (may be NULL).
+ *
+ * @retval true  A segment completed: the PSD and the estimate were updated.
+ * @retval false No new estimate.
+ */
+bool PPG_Spectral_Update(PPG_Spectral_t *sp, int16_t x, PPG_SpectralHR_t *est);
+
+/**
+ * @brief Frequency of a PSD bin.
+ *
+ * @param[in] sp  Estimator state.
+ * @param[in] bin Index in psd[] (0 .. PPG_SPECTRAL_NUM_BINS - 1).
+ *
+ * @return Bin frequency [Hz].
+ */
+float PPG_Spectral_BinHz(const PPG_Spectral_t *sp, uint32_t bin);
+
+#endif /* PPG_HR_SPECTRAL_H */
@@ -0,0 +1,162 @@
+/**
+ ******************************************************************************
+ * @file    ppg_integrity.h
+ * @author  A. Bellina
+ * @brief   Sample-timing integrity monitor: jitter, missed events, drops.
+ *
+ * @details
+ * Proves that the acquisition keeps time and loses nothing, while it runs:
+ *   - timed sources (sample tick, ADC block, frame) record one hardware
+ *     timestamp per event (DWT CYCCNT on target, see ppg_profile.h). Each
+ *     interval is compared with the nominal one of the rate profile:
+ *     |interval - nominal| goes into a histogram by octave (0, 1, 2-3,
+ *     4-7, ... ticks); an interval of 1.5 nominal or more is late and
+ *     counts the events missed in between instead
+ *   - the acquisition period index is checked for continuity: every
+ *     skipped period is a gap (ADC overrun, simulation underrun)
+ *   - counters of every place a frame can be dropped (pool empty, ring
+ *     full, consumer queue full) and of the sequence gaps seen by the
+ *     processing task
+ *
+ * Recording is O(1), without a lock: each source and counter must be
+ * updated from a single context. A copy taken while events are recorded
+ * may be off by the events of the copy itself.
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host.
+ ******************************************************************************
+ */
+
+#ifndef PPG_INTEGRITY_H
+#define PPG_INTEGRITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Jitter histogram buckets: 0, then one per octave up to 2^32 ticks */
+#define PPG_INTEGRITY_BUCKETS  33U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Timed sources */
+typedef enum
+{
+    PPG_INTEG_SAMPLE_TICK = 0,  /**< TIM9 update: one per acquisition period */
+    PPG_INTEG_ADC_BLOCK,        /**< ADC DMA half-transfer (hardware) */
+    PPG_INTEG_FRAME,            /**< Frame handed to the processing task */
+    PPG_INTEG_SOURCE_COUNT
+} PPG_IntegritySource_t;
+
+/** Loss counters */
+typedef enum
+{
+    PPG_INTEG_PERIOD_GAPS = 0,  /**< Acquisition periods skipped (index jumps) */
+    PPG_INTEG_POOL_EMPTY,       /**< Frames dropped: no free frame in the pool */
+    PPG_INTEG_RING_OVERRUNS,    /**< Frames dropped: processing ring full */
+    PPG_INTEG_SEQUENCE_GAPS,    /**< Frames missing at the processing task */
+    PPG_INTEG_CONSUMER_DROPS,   /**< Frames not queued to a full consumer queue */
+    PPG_INTEG_COUNTER_COUNT
+} PPG_IntegrityCounter_t;
+
+/** Interval statistics of one source */
+typedef struct
+{
+    uint32_t nominal;                          /**< Expected interval [ticks], 0: not timed */
+    uint32_t last;                             /**< Timestamp of the last event [ticks] */
+    uint32_t events;                           /**< Events recorded (intervals + 1) */
+    uint32_t min;                              /**< Shortest interval [ticks] */
+    uint32_t max;                              /**< Longest interval [ticks] */
+    uint32_t late;                             /**< Intervals of 1.5 nominal or more */
+    uint32_t missed;                           /**< Events missing inside the late intervals */
+    uint32_t worst;                            /**< Largest |interval - nominal| on time [ticks] */
+    uint32_t hist[PPG_INTEGRITY_BUCKETS];      /**< |interval - nominal| on time, by octave */
+} PPG_IntegrityTiming_t;
+
+/** Monitor state, also its statistics */
+typedef struct
+{
+    PPG_IntegrityTiming_t timing[PPG_INTEG_SOURCE_COUNT];
+    uint32_t              counters[PPG_INTEG_COUNTER_COUNT];
+    uint32_t              next_period;         /**< Next acquisition period index expected */
+    bool                  period_synced;       /**< next_period is known */
+} PPG_Integrity_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Clear every statistic, keep the nominal intervals.
+ *
+ * @note Call while no source records (between sessions).
+ */
+void PPG_Integrity_Reset(PPG_Integrity_t *mon);
+
+/**
+ * @brief Set the expected interval of a source.
+ *
+ * @param[in,out] mon     Monitor.
+ * @param[in]     src     Timed source.
+ * @param[in]     nominal Interval [ticks], 0 to record events without timing them.
+ */
+void PPG_Integrity_SetNominal(PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t nominal);
+
+/**
+ * @brief Record one event of a source.
+ *
+ * @param[in,out] mon Monitor.
+ * @param[in]     src Timed source.
+ * @param[in]     now Hardware timestamp of the event [ticks].
+ */
+void PPG_Integrity_Mark(PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t now);
+
+/**
+ * @brief Check the continuity of the acquisition period index.
+ *
+ * Skipped indexes add to PPG_INTEG_PERIOD_GAPS; an older index (restart)
+ * resynchronizes without a gap.
+ *
+ * @param[in,out] mon    Monitor.
+ * @param[in]     period Index of the period acquired.
+ */
+void PPG_Integrity_CheckPeriod(PPG_Integrity_t *mon, uint32_t period);
+
+/**
+ * @brief Add to a loss counter.
+ */
+static inline void PPG_Integrity_Count(PPG_Integrity_t *mon, PPG_IntegrityCounter_t counter, uint32_t n)
+{
+    mon->counters[counter] += n;
+}
+
+/**
+ * @brief Jitter percentile of a source.
+ *
+ * @param[in] mon     Monitor.
+ * @param[in] src     Timed source.
+ * @param[in] percent Percentile (0..100) of the on-time intervals.
+ *
+ * @return Upper bound of |interval - nominal| [ticks] (octave resolution,
+ *         capped at the worst case), 0 if no interval was timed.
+ */
+uint32_t PPG_Integrity_Jitter(const PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t percent);
+
+/**
+ * @brief Write the statistics as text: one line per source, then the counters.
+ *
+ * @param[in]  mon     Monitor.
+ * @param[in]  tick_hz Timestamp frequency, for the conversion to ns.
+ * @param[out] buf     Output buffer.
+ * @param[in]  size    Buffer size [bytes].
+ *
+ * @return Characters written (without the terminator).
+ */
+size_t PPG_Integrity_Format(const PPG_Integrity_t *mon, uint32_t tick_hz, char *buf, size_t size);
+
+#endif /* PPG_INTEGRITY_H */
@@ -0,0 +1,209 @@
+/**
+ ******************************************************************************
+ * @file    ppg_link.h
+ * @author  A. Bellina
+ * @brief   Framed binary protocol of the simulation UART link.
+ *
+ * @details
+ * Every message is a frame (little-endian):
+ *
+ *   offset  size  field
+ *   0       2     sync word 0xA5 0x5A
+ *   2       1     type (PPG_LinkType_t)
+ *   3       1     payload length n (0..PPG_LINK_MAX_PAYLOAD)
+ *   4       2     sequence number, per direction, +1 per frame
+ *   6       n     payload
+ *   6+n     2     CRC-16/CCITT-FALSE of bytes 2..6+n-1
+ *
+ * The parser hunts for the sync word, so a lost or corrupted byte costs
+ * at most the frames it touches: the stream resynchronises by itself. A
+ * frame failing its CRC is rescanned for a sync word from the byte after
+ * its own, so a corrupted length field cannot swallow the frames behind
+ * it (the PC side resyncs the same way).
+ * Sequence gaps tell the receiver how many frames were lost.
+ *
+ * Payloads (PPG_LINK_* offsets below):
+ *   - START  (MCU -> PC) session start: acquisition rate [Hz], channel
+ *     mask wanted, nominal session length and first credit limit
+ *   - DATA   (PC -> MCU) `count` sample periods starting at period
+ *     `first`, each holding one uint16 per channel of `mask`, channels
+ *     in ascending order
+ *   - CREDIT (MCU -> PC) flow control: the PC may send the periods
+ *     below `limit`; also the next period expected and error counters
+ *   - STOP   (MCU -> PC) session end and its counters
+ *   - REPORT (MCU -> PC) timing integrity of the session so far
+ *     (ppg_integrity.h), periodically and just before STOP
+ *
+ * Flow control is credit based: limit = periods consumed + free room of
+ * the MCU queue, so the PC never overruns it and a lost CREDIT frame is
+ * made good by the next one.
+ *
+ * The module has no HAL/RTOS dependency; simulation/wait_measure_trigger.py
+ * implements the PC side.
+ ******************************************************************************
+ */
+
+#ifndef PPG_LINK_H
+#define PPG_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+#define PPG_LINK_SYNC0          0xA5U
+#define PPG_LINK_SYNC1          0x5AU
+
+#define PPG_LINK_HEADER_SIZE    6U      /**< Sync, type, length, sequence */
+#define PPG_LINK_CRC_SIZE       2U
+#define PPG_LINK_MAX_PAYLOAD    255U
+#define PPG_LINK_MAX_FRAME      (PPG_LINK_HEADER_SIZE + PPG_LINK_MAX_PAYLOAD + PPG_LINK_CRC_SIZE)
+#define PPG_LINK_RESCAN_SIZE    (2U * PPG_LINK_MAX_FRAME)   /**< Bytes of rejected frames pending a rescan */
+
+/* START payload */
+#define PPG_LINK_START_RATE     0U      /**< uint16: sample periods per second */
+#define PPG_LINK_START_MASK     2U      /**< uint8: PPG_CH_MASK() of the channels wanted */
+#define PPG_LINK_START_PERIODS  4U      /**< uint32: nominal session length [periods] */
+#define PPG_LINK_START_LIMIT    8U      /**< uint32: first credit limit */
+#define PPG_LINK_START_SIZE     12U
+
+/* DATA payload */
+#define PPG_LINK_DATA_FIRST     0U      /**< uint32: index of the first period */
+#define PPG_LINK_DATA_MASK      4U      /**< uint8: channels of every period */
+#define PPG_LINK_DATA_COUNT     5U      /**< uint8: periods in the frame */
+#define PPG_LINK_DATA_SAMPLES   6U      /**< uint16[count][channels] */
+
+/* CREDIT payload */
+#define PPG_LINK_CREDIT_LIMIT   0U      /**< uint32: periods below this index may be sent */
+#define PPG_LINK_CREDIT_NEXT    4U      /**< uint32: next period expected */
+#define PPG_LINK_CREDIT_LOST    8U      /**< uint16: DATA frames lost (sequence gaps) */
+#define PPG_LINK_CREDIT_CRC     10U     /**< uint16: frames rejected (CRC, length) */
+#define PPG_LINK_CREDIT_SIZE    12U
+
+/* STOP payload */
+#define PPG_LINK_STOP_PERIODS   0U      /**< uint32: periods consumed */
+#define PPG_LINK_STOP_UNDERRUNS 4U      /**< uint32: ticks with no period queued */
+#define PPG_LINK_STOP_LOST      8U      /**< uint16: DATA frames lost */
+#define PPG_LINK_STOP_CRC       10U     /**< uint16: frames rejected */
+#define PPG_LINK_STOP_SIZE      12U
+
+/* REPORT payload */
+#define PPG_LINK_REPORT_TICKS   0U      /**< uint32: sample ticks recorded */
+#define PPG_LINK_REPORT_MISSED  4U      /**< uint32: sample ticks missed (late intervals) */
+#define PPG_LINK_REPORT_P99     8U      /**< uint32: sample tick jitter, p99 bound [ns] */
+#define PPG_LINK_REPORT_WORST   12U     /**< uint32: sample tick jitter, worst [ns] */
+#define PPG_LINK_REPORT_GAPS    16U     /**< uint32: acquisition periods skipped */
+#define PPG_LINK_REPORT_DROPS   20U     /**< uint32: frames dropped (pool empty, ring full) */
+#define PPG_LINK_REPORT_SEQ     24U     /**< uint32: frame sequence gaps at processing */
+#define PPG_LINK_REPORT_QUEUES  28U     /**< uint32: frames not queued to a full consumer queue */
+#define PPG_LINK_REPORT_SIZE    32U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Frame types */
+typedef enum
+{
+    PPG_LINK_START  = 0x01,
+    PPG_LINK_DATA   = 0x02,
+    PPG_LINK_CREDIT = 0x03,
+    PPG_LINK_STOP   = 0x04,
+    PPG_LINK_REPORT = 0x05
+} PPG_LinkType_t;
+
+/** Received frame */
+typedef struct
+{
+    uint8_t  type;
+    uint8_t  length;
+    uint16_t sequence;
+    uint8_t  payload[PPG_LINK_MAX_PAYLOAD];
+} PPG_LinkFrame_t;
+
+/** Byte-stream parser */
+typedef struct
+{
+    PPG_LinkFrame_t frame;       /**< Frame being received */
+    uint16_t        index;       /**< Bytes of the current frame received */
+    uint16_t        crc;         /**< CRC of the bytes received so far */
+    uint16_t        crc_rx;      /**< Received CRC */
+    uint32_t        crc_errors;  /**< Frames rejected since the last reset */
+    uint8_t         rescan[PPG_LINK_RESCAN_SIZE]; /**< Bytes to parse again before new ones */
+    uint16_t        rescan_pos;  /**< Next byte of rescan[] to parse */
+    uint16_t        rescan_len;  /**< Bytes in rescan[] */
+} PPG_LinkParser_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief CRC-16/CCITT-FALSE (poly 0x1021), continued from crc.
+ *
+ * @param[in] crc  0xFFFF for a new CRC.
+ * @param[in] data Bytes.
+ * @param[in] len  Number of bytes.
+ */
+uint16_t PPG_Link_Crc16(uint16_t crc, const uint8_t *data, size_t len);
+
+/**
+ * @brief Build a frame.
+ *
+ * @param[out] buf      Destination, at least PPG_LINK_HEADER_SIZE + len + PPG_LINK_CRC_SIZE bytes.
+ * @param[in]  type     PPG_LinkType_t.
+ * @param[in]  sequence Sequence number.
+ * @param[in]  payload  Payload (may be NULL if len is 0).
+ * @param[in]  len      Payload length.
+ *
+ * @return Frame length [bytes].
+ */
+size_t PPG_Link_Encode(uint8_t *buf, uint8_t type, uint16_t sequence,
+                       const uint8_t *payload, uint8_t len);
+
+/**
+ * @brief Restart the parser on a sync word hunt and clear its counters.
+ *
+ * @param[out] parser Parser state.
+ */
+void PPG_Link_ParserReset(PPG_LinkParser_t *parser);
+
+/**
+ * @brief Feed one received byte.
+ *
+ * @param[in,out] parser Parser state.
+ * @param[in]     byte   Received byte.
+ *
+ * @return The complete frame once its CRC checks, else NULL. Valid until
+ *         the next call. A frame found while rescanning a rejected one may
+ *         be returned before the byte is parsed; the byte is then queued.
+ */
+const PPG_LinkFrame_t *PPG_Link_Parse(PPG_LinkParser_t *parser, uint8_t byte);
+
+/** Little-endian payload accessors */
+static inline void PPG_Link_Put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void PPG_Link_Put32(uint8_t *p, uint32_t v)
+{
+    PPG_Link_Put16(p, (uint16_t)v);
+    PPG_Link_Put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline uint16_t PPG_Link_Get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static inline uint32_t PPG_Link_Get32(const uint8_t *p)
+{
+    return PPG_Link_Get16(p) | ((uint32_t)PPG_Link_Get16(p + 2) << 16);
+}
+
+#endif /* PPG_LINK_H */
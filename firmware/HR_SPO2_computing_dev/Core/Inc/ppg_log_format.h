@@ -0,0 +1,556 @@
+/**
+ ******************************************************************************
+ * @file    ppg_log_format.h
+ * @author  A. Bellina
+ * @brief   Compact binary session log: encoder and decoder.
+ *
+ * @details
+ * A log file (data_logger.h) is a session header followed by blocks and,
+ * once the session is closed, by the session index and a trailer.
+ *
+ * Session header, PPG_LOG_HEADER_SIZE bytes, little-endian (PPG_LOG_HDR_*
+ * offsets below): magic "PPGL", format version, rate profile (capture and
+ * acquisition rate, PPG_FS, samples per frame, session length), channels
+ * logged, LED on time and drive level, firmware build, and a
+ * CRC-16/CCITT-FALSE of the bytes before it.
+ *
+ * Block: a run of up to PPG_LOG_BLOCK_FRAMES frames, decodable on its own.
+ * After the sync word a block is one bit stream (MSB first, ppg_codec.h),
+ * padded to a byte only at its end:
+ *
+ *   2        sync word 0x5A 0xB1
+ *   varint   sequence of the first frame
+ *   varint   timestamp (sample clock) of the first frame
+ *   frames, each led by a tag (PPG_LOG_TAG_*): a 1 bit for a plain frame
+ *   (PPG_LOG_TAG_FRAME alone), else a 0 bit and PPG_LOG_TAG_BITS tag bits:
+ *     [GAP]     varint frames missing before it, zig-zag varint timestamp
+ *               offset from the end of the previous frame
+ *     [LAYOUT]  varint count, varint channel_mask (first frame, on change)
+ *     samples   for each channel of the mask, count samples coded as the
+ *               header flags tell (PPG_LOG_FLAG_ORDER()):
+ *                 order 0: zig-zag varint deltas from the previous sample
+ *                          of the channel (0 at block start)
+ *                 order 1..3: ppg_codec.h linear prediction + Rice;
+ *                          each channel runs across the frames of the
+ *                          block, whose start is a codec reset point
+ *     [band-pass] varint outputs, then as many zig-zag varint deltas;
+ *               only with PPG_LOG_FLAG_BANDPASS (always before version 4)
+ *     [RESULTS] varint HR, spectral HR [0.01 bpm], SpO2 [0.01 %] and beat
+ *               count (first frame, on change)
+ *     [EVENTS]  varint PPG_FRAME_EVENT_* (window start, settled)
+ *   tag 0       end of the block, then zero bits to a byte
+ *   2        CRC-16/CCITT-FALSE of the block from the sync word, started
+ *            from the session header CRC instead of 0xFFFF
+ *
+ * Varints are LEB128 (7 bits per 8-bit group, low first); zig-zag maps
+ * signed deltas to 0, -1, 1, -2, ... A PPG sample moves a few LSB per
+ * capture period, so a delta takes one byte instead of two; the predictor
+ * and the Rice code bring it to a few bits (host/bench/bench_codec.c).
+ * A frame of one sample costs its tag bit and its coded samples. Before
+ * version 5 the tags are bytes and the samples of each frame are padded
+ * to a byte (version 1: order 0 only). The band-pass output is derived
+ * data, as large as the samples: it is left out unless a debug build asks
+ * for it (PPG_LOG_BANDPASS). The CRC seed ties every block to its
+ * session: blocks left from an earlier session in the preallocated file area (not truncated after a power loss) are
+ * rejected like corrupted ones. The decoder hunts for the sync word
+ * after a bad block, losing only that block. HR and SpO2 are stored to
+ * 0.01; everything else is lossless.
+ *
+ * Session index (version 3, PPG_LOG_IDX_* offsets below), written after
+ * the last block when the session closes:
+ *   - head: magic "PPGI", entry and event counts, blocks per entry,
+ *     totals and the sample clock at the end of the session
+ *   - entries: one per PPG_LogIndex_t::stride blocks (1, 2, 4, ... as the
+ *     session grows, at most PPG_LOG_INDEX_ENTRIES), with the file offset,
+ *     sequence and timestamp of the first block, the min / max of each
+ *     channel, the last HR and SpO2 and the events within
+ *   - events (PPG_LogEventType_t), the first PPG_LOG_INDEX_EVENTS of the
+ *     session, to the frame
+ *   - CRC-16 started from the session header CRC
+ * then the trailer, the index offset and "PPGX", so a reader finds the
+ * index from the end of the file. A reader positions itself at any time
+ * by bisecting the blocks between two entries (a few blocks decoded),
+ * and draws an overview from the entries alone. A log cut short (power
+ * loss) has no index; it is still decodable, and scanning it rebuilds
+ * the index (PPG_LogReader_BuildIndex()).
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host
+ * (see host/CMakeLists.txt, host/tools/ppg_log_dump.c).
+ ******************************************************************************
+ */
+
+#ifndef PPG_LOG_FORMAT_H
+#define PPG_LOG_FORMAT_H
+
+#include "ppg_frame.h"
+#include "ppg_codec.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+#define PPG_LOG_VERSION         5U
+
+/** Sample coding written by the logger: predictor order 1..3, 0 for varint deltas */
+#ifndef PPG_LOG_PREDICTOR_ORDER
+#define PPG_LOG_PREDICTOR_ORDER 1U
+#endif
+
+/** Log the band-pass output of every frame (debug: about doubles the log) */
+#ifndef PPG_LOG_BANDPASS
+#define PPG_LOG_BANDPASS        0U
+#endif
+
+/** Firmware build written to the header (set from CMake: git describe) */
+#ifndef PPG_BUILD_ID
+#define PPG_BUILD_ID            __DATE__ " " __TIME__
+#endif
+
+/**
+ * Frames per block: about 256 PPG_FS samples (2.56 s) whatever PPG_BLOCK_SIZE.
+ * Each block costs its sync word, start, first layout and results, codec
+ * reset and CRC, and one index entry: shorter blocks seek and resync finer
+ * but, with frames of one sample, cost more than the samples they save.
+ */
+#ifndef PPG_LOG_BLOCK_FRAMES
+#define PPG_LOG_BLOCK_FRAMES    ((256U + PPG_BLOCK_SIZE - 1U) / PPG_BLOCK_SIZE)
+#endif
+
+/** Index entries kept while logging: 36 bytes of RAM each */
+#ifndef PPG_LOG_INDEX_ENTRIES
+#define PPG_LOG_INDEX_ENTRIES   128U
+#endif
+
+/** Events kept in the index (the frames carry every one) */
+#ifndef PPG_LOG_INDEX_EVENTS
+#define PPG_LOG_INDEX_EVENTS    32U
+#endif
+
+/** Largest frame the decoder accepts [samples per channel]: 256, or the frames of this build */
+#ifndef PPG_LOG_MAX_SAMPLES
+#define PPG_LOG_MAX_SAMPLES     ((PPG_FRAME_MAX_SAMPLES > 256U) ? PPG_FRAME_MAX_SAMPLES : 256U)
+#endif
+
+#define PPG_LOG_SYNC0           0x5AU
+#define PPG_LOG_SYNC1           0xB1U
+
+/* Session header */
+#define PPG_LOG_HEADER_SIZE     64U
+#define PPG_LOG_HDR_MAGIC       0U      /**< char[4]: "PPGL" */
+#define PPG_LOG_HDR_VERSION     4U      /**< uint16: PPG_LOG_VERSION */
+#define PPG_LOG_HDR_SIZE        6U      /**< uint16: header size, blocks start there */
+#define PPG_LOG_HDR_CAPTURE_HZ  8U      /**< uint32: frame sample rate [Hz] */
+#define PPG_LOG_HDR_ACQ_HZ      12U     /**< uint32: acquisition period rate [Hz] */
+#define PPG_LOG_HDR_TOTAL       16U     /**< uint32: session length [capture samples] */
+#define PPG_LOG_HDR_START_MS    20U     /**< uint32: system time at the session start [ms] */
+#define PPG_LOG_HDR_PPG_FS      24U     /**< uint16: processing rate [Hz] */
+#define PPG_LOG_HDR_FRAME       26U     /**< uint16: capture samples per frame */
+#define PPG_LOG_HDR_MASK        28U     /**< uint16: PPG_CH_MASK() of the first frame (each frame has its own) */
+#define PPG_LOG_HDR_FLAGS       30U     /**< uint16: PPG_LOG_FLAG_* */
+#define PPG_LOG_HDR_LED_US      32U     /**< uint16[2]: RED, IR on time per period [us] */
+#define PPG_LOG_HDR_LED_LEVEL   36U     /**< uint16[2]: RED, IR drive [0.1 % of full scale] */
+#define PPG_LOG_HDR_BUILD       40U     /**< char[22]: firmware build, NUL padded */
+#define PPG_LOG_HDR_CRC         62U     /**< uint16: CRC-16/CCITT-FALSE of bytes 0..61 */
+
+#define PPG_LOG_BUILD_SIZE      22U
+
+/** Header flags */
+#define PPG_LOG_FLAG_SIMULATION 0x0001U /**< Samples from the simulation link, LEDs off */
+#define PPG_LOG_FLAG_BANDPASS   0x0002U /**< Frames carry the band-pass output */
+#define PPG_LOG_FLAG_ORDER_MASK 0x0030U /**< Sample coding: predictor order, 0 = varint deltas */
+#define PPG_LOG_FLAG_ORDER(n)   ((uint16_t)(((n) << 4) & PPG_LOG_FLAG_ORDER_MASK))
+#define PPG_LOG_FLAG_GET_ORDER(f) (((uint32_t)(f) & PPG_LOG_FLAG_ORDER_MASK) >> 4)
+
+/** Whether the frames of a log (PPG_LogHeader_t *) carry the band-pass output */
+#define PPG_LOG_HAS_BANDPASS(h) (((h)->version < 4U) || (((h)->flags & PPG_LOG_FLAG_BANDPASS) != 0U))
+
+/** Frame tag bits */
+#define PPG_LOG_TAG_FRAME       0x01U   /**< A frame follows (0: end of the block) */
+#define PPG_LOG_TAG_GAP         0x02U   /**< Sequence / timestamp jump */
+#define PPG_LOG_TAG_LAYOUT      0x04U   /**< Sample count and channel mask */
+#define PPG_LOG_TAG_RESULTS     0x08U   /**< HR, SpO2, beat count */
+#define PPG_LOG_TAG_EVENTS      0x10U   /**< Frame events */
+#define PPG_LOG_TAG_BITS        5U      /**< Tag bits after the 0 bit */
+
+/** Largest encoding of a 32-bit varint [bytes] */
+#define PPG_LOG_VARINT_MAX      5U
+
+/** Largest end of a block: pending bits and tag, CRC */
+#define PPG_LOG_END_SIZE        4U
+
+/** Largest PPG_LogEncoder_Frame() output: end of a block, new block header, frame */
+#define PPG_LOG_FRAME_MAX       (PPG_LOG_END_SIZE + 2U + (2U * PPG_LOG_VARINT_MAX) +   \
+                                 2U + (2U * PPG_LOG_VARINT_MAX) + 6U +                 \
+                                 (((PPG_CH_COUNT * PPG_FRAME_MAX_SAMPLES *             \
+                                    PPG_CODEC_MAX_BITS) + 7U) / 8U) +                  \
+                                 3U + (PPG_FRAME_MAX_OUTPUTS * 3U) +                   \
+                                 (5U * PPG_LOG_VARINT_MAX))
+
+/* Session index */
+#define PPG_LOG_IDX_MAGIC       0U      /**< char[4]: "PPGI" */
+#define PPG_LOG_IDX_ENTRIES     4U      /**< uint16: entries */
+#define PPG_LOG_IDX_EVENTS      6U      /**< uint16: events */
+#define PPG_LOG_IDX_STRIDE      8U      /**< uint32: blocks per entry */
+#define PPG_LOG_IDX_BLOCKS      12U     /**< uint32: blocks in the log */
+#define PPG_LOG_IDX_FRAMES      16U     /**< uint32: frames in the log */
+#define PPG_LOG_IDX_DROPPED     20U     /**< uint32: events left out of the index */
+#define PPG_LOG_IDX_END_TS      24U     /**< uint32: sample clock after the last frame */
+#define PPG_LOG_IDX_HEAD_SIZE   28U
+
+/* Index entry */
+#define PPG_LOG_IDX_E_OFFSET    0U      /**< uint32: file offset of the first block */
+#define PPG_LOG_IDX_E_SEQUENCE  4U      /**< uint32: its first sequence */
+#define PPG_LOG_IDX_E_TIMESTAMP 8U      /**< uint32: its first timestamp */
+#define PPG_LOG_IDX_E_MIN       12U     /**< uint16[PPG_CH_COUNT]: sample min (0xFFFF: channel absent) */
+#define PPG_LOG_IDX_E_MAX       20U     /**< uint16[PPG_CH_COUNT]: sample max */
+#define PPG_LOG_IDX_E_HR        28U     /**< uint16: last HR [0.01 bpm] */
+#define PPG_LOG_IDX_E_SPO2      30U     /**< uint16: last SpO2 [0.01 %] */
+#define PPG_LOG_IDX_E_EVENTS    32U     /**< uint16: PPG_LOG_EVENT_BIT() of the events within */
+#define PPG_LOG_IDX_ENTRY_SIZE  34U
+
+/* Index event */
+#define PPG_LOG_IDX_V_TIMESTAMP 0U      /**< uint32: timestamp of the frame */
+#define PPG_LOG_IDX_V_TYPE      4U      /**< uint16: PPG_LogEventType_t */
+#define PPG_LOG_IDX_V_VALUE     6U      /**< uint16: channel mask, or frames lost */
+#define PPG_LOG_IDX_EVENT_SIZE  8U
+
+/** Trailer: uint32 index offset, "PPGX" */
+#define PPG_LOG_TRAILER_SIZE    8U
+
+/** Largest index with its CRC and trailer [bytes] */
+#define PPG_LOG_INDEX_MAX_SIZE  (PPG_LOG_IDX_HEAD_SIZE +                              \
+                                 (PPG_LOG_INDEX_ENTRIES * PPG_LOG_IDX_ENTRY_SIZE) +    \
+                                 (PPG_LOG_INDEX_EVENTS * PPG_LOG_IDX_EVENT_SIZE) +     \
+                                 2U + PPG_LOG_TRAILER_SIZE)
+
+/** Largest PPG_LogIndex_Encode() piece [bytes] */
+#define PPG_LOG_INDEX_PIECE_MAX PPG_LOG_IDX_ENTRY_SIZE
+
+#define PPG_LOG_EVENT_BIT(type) ((uint16_t)(1U << (type)))
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Index event types */
+typedef enum
+{
+    PPG_LOG_EVENT_START = 0,            /**< First frame (start button) */
+    PPG_LOG_EVENT_END,                  /**< End of the last frame */
+    PPG_LOG_EVENT_GAP,                  /**< Frames missing before this one (value: count) */
+    PPG_LOG_EVENT_WINDOW,               /**< Acquisition window start (value: channel mask) */
+    PPG_LOG_EVENT_SETTLED,              /**< Settling over, SpO2 accumulates (value: channel mask) */
+    PPG_LOG_EVENT_COUNT
+} PPG_LogEventType_t;
+
+/** Session header contents */
+typedef struct
+{
+    uint16_t version;
+    uint32_t capture_hz;
+    uint32_t acq_hz;
+    uint32_t total_samples;
+    uint32_t start_ms;
+    uint16_t ppg_fs;
+    uint16_t frame_samples;
+    uint16_t channel_mask;
+    uint16_t flags;
+    uint16_t led_us[2];                 /**< RED, IR */
+    uint16_t led_level[2];              /**< RED, IR [0.1 %] */
+    char     build[PPG_LOG_BUILD_SIZE + 1U];
+    uint16_t crc;                       /**< Seed of the block CRCs */
+} PPG_LogHeader_t;
+
+/** Values a block carries from frame to frame */
+typedef struct
+{
+    uint32_t sequence;                  /**< Expected next */
+    uint32_t timestamp;                 /**< Expected next */
+    uint16_t count;
+    uint16_t channel_mask;
+    uint16_t last[PPG_CH_COUNT];        /**< Previous sample of each channel (order 0) */
+    PPG_CodecChannel_t codec[PPG_CH_COUNT]; /**< Predictor and Rice state (order 1..3) */
+    int16_t  last_bandpassed;
+    uint32_t results[4];                /**< HR, spectral HR, SpO2 [0.01], beats */
+} PPG_LogState_t;
+
+/** Encoder of one session */
+typedef struct
+{
+    PPG_LogState_t  state;
+    uint16_t        seed;               /**< Header CRC */
+    uint16_t        order;              /**< Sample coding (PPG_LOG_FLAG_ORDER()) */
+    bool            bandpass;           /**< PPG_LOG_FLAG_BANDPASS */
+    PPG_BitWriter_t bits;               /**< Bits of the open block not yet output */
+    uint16_t        crc;                /**< CRC of the open block so far */
+    uint16_t        frames;             /**< Frames in the open block (0: none open) */
+    uint16_t        block_start;        /**< Offset of the new block in the last frame output (frames == 1) */
+} PPG_LogEncoder_t;
+
+/** Decoded frame */
+typedef struct
+{
+    uint32_t sequence;
+    uint32_t timestamp;
+    uint16_t count;
+    uint16_t channel_mask;
+    uint16_t samples[PPG_CH_COUNT][PPG_LOG_MAX_SAMPLES];
+    uint16_t outputs;                   /**< 0 without PPG_LOG_HAS_BANDPASS() */
+    int16_t  bandpassed[PPG_LOG_MAX_SAMPLES + 1U];
+    float    hr_bpm;
+    float    hr_spectral_bpm;
+    float    spo2_percent;
+    uint32_t beat_count;
+    uint16_t events;                    /**< PPG_FRAME_EVENT_* */
+} PPG_LogFrame_t;
+
+/** Index entry: a run of blocks */
+typedef struct
+{
+    uint32_t offset;                    /**< File offset of the first block */
+    uint32_t sequence;
+    uint32_t timestamp;
+    uint16_t min[PPG_CH_COUNT];         /**< 0xFFFF (above max): channel absent */
+    uint16_t max[PPG_CH_COUNT];
+    uint16_t hr;                        /**< Last HR [0.01 bpm] */
+    uint16_t spo2;                      /**< Last SpO2 [0.01 %] */
+    uint16_t events;                    /**< PPG_LOG_EVENT_BIT() of the events within */
+} PPG_LogIndexEntry_t;
+
+/** Index event */
+typedef struct
+{
+    uint32_t timestamp;
+    uint16_t type;                      /**< PPG_LogEventType_t */
+    uint16_t value;
+} PPG_LogEvent_t;
+
+/** Session index being built, bounded whatever the session length */
+typedef struct
+{
+    PPG_LogIndexEntry_t entries[PPG_LOG_INDEX_ENTRIES];
+    PPG_LogEvent_t      events[PPG_LOG_INDEX_EVENTS];
+    uint32_t entry_count;
+    uint32_t event_count;
+    uint32_t stride;                    /**< Blocks per entry (doubles when the entries are full) */
+    uint32_t entry_blocks;              /**< Blocks in the last entry */
+    uint32_t blocks;
+    uint32_t frames;
+    uint32_t dropped;                   /**< Events past PPG_LOG_INDEX_EVENTS */
+    uint32_t sequence;                  /**< Expected next */
+    uint32_t end_timestamp;             /**< Sample clock after the last frame */
+} PPG_LogIndex_t;
+
+/** PPG_LogIndex_Encode() progress */
+typedef struct
+{
+    uint32_t part;
+    uint32_t offset;                    /**< Of the index in the file */
+    uint16_t crc;
+} PPG_LogIndexWriter_t;
+
+/** Index of a log in memory (PPG_LogReader_t::index) */
+typedef struct
+{
+    const uint8_t *data;                /**< Index head (NULL: none) */
+    uint32_t entries;
+    uint32_t events;
+    uint32_t stride;
+    uint32_t blocks;
+    uint32_t frames;
+    uint32_t dropped;
+    uint32_t end_timestamp;
+} PPG_LogIndexView_t;
+
+/** Decoder over a whole log file in memory */
+typedef struct
+{
+    const uint8_t  *data;
+    size_t          size;
+    size_t          pos;                /**< Next byte to decode between blocks */
+    size_t          block_end;          /**< CRC of the current block (0: between blocks) */
+    PPG_LogHeader_t header;
+    PPG_LogState_t  state;
+    uint32_t        blocks;             /**< Blocks decoded */
+    uint32_t        bad_blocks;         /**< Sync words not followed by a valid block */
+    uint32_t        frames;             /**< Frames decoded */
+    size_t          skipped;            /**< Bytes outside valid blocks */
+    size_t          block_start;        /**< Offset of the current block */
+    PPG_BitReader_t bits;               /**< Within the current block */
+    PPG_LogIndexView_t index;           /**< From the end of the file, or PPG_LogReader_BuildIndex() */
+} PPG_LogReader_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Build the session header; its CRC (header->crc) is filled in.
+ *
+ * @param[out]    buf    PPG_LOG_HEADER_SIZE bytes.
+ * @param[in,out] header Contents (version and build as given).
+ */
+void PPG_Log_EncodeHeader(uint8_t *buf, PPG_LogHeader_t *header);
+
+/**
+ * @brief Parse and check a session header.
+ *
+ * @param[in]  buf    Start of the log.
+ * @param[in]  len    Bytes available.
+ * @param[out] header Contents.
+ *
+ * @return false if the magic, the version, the size or the CRC is wrong.
+ */
+bool PPG_Log_DecodeHeader(const uint8_t *buf, size_t len, PPG_LogHeader_t *header);
+
+/**
+ * @brief Start the encoding of a session.
+ *
+ * @param[out] enc    Encoder.
+ * @param[in]  header Header written before the blocks (its CRC seeds them,
+ *                    its flags give the sample coding and whether the
+ *                    band-pass output is kept).
+ */
+void PPG_LogEncoder_Init(PPG_LogEncoder_t *enc, const PPG_LogHeader_t *header);
+
+/**
+ * @brief Encode a frame, ending a full block and starting a new one as needed.
+ *
+ * The encoder state advances: save a copy of it to undo a frame that is
+ * not stored.
+ *
+ * @param[in,out] enc   Encoder.
+ * @param[in]     frame Frame (count <= PPG_FRAME_MAX_SAMPLES).
+ * @param[out]    buf   PPG_LOG_FRAME_MAX bytes.
+ *
+ * @return Bytes written.
+ */
+size_t PPG_LogEncoder_Frame(PPG_LogEncoder_t *enc, const PPG_Frame_t *frame, uint8_t *buf);
+
+/**
+ * @brief End the open block, if any (end of the session).
+ *
+ * @param[in,out] enc Encoder.
+ * @param[out]    buf PPG_LOG_END_SIZE bytes.
+ *
+ * @return Bytes written (0 when no block is open).
+ */
+size_t PPG_LogEncoder_End(PPG_LogEncoder_t *enc, uint8_t *buf);
+
+/**
+ * @brief Start a session index.
+ *
+ * @param[out] idx Index.
+ */
+void PPG_LogIndex_Init(PPG_LogIndex_t *idx);
+
+/**
+ * @brief Add a frame stored by PPG_LogEncoder_Frame().
+ *
+ * @param[in,out] idx    Index.
+ * @param[in]     enc    Encoder, after the frame.
+ * @param[in]     offset File offset of the frame output.
+ * @param[in]     frame  Frame.
+ */
+void PPG_LogIndex_Frame(PPG_LogIndex_t *idx, const PPG_LogEncoder_t *enc, uint32_t offset,
+                        const PPG_Frame_t *frame);
+
+/**
+ * @brief End the session and start writing its index.
+ *
+ * @param[in,out] idx    Index (the end event is added).
+ * @param[out]    w      Writer for PPG_LogIndex_Encode().
+ * @param[in]     seed   Session header CRC.
+ * @param[in]     offset File offset of the index: after the last block.
+ */
+void PPG_LogIndex_Finish(PPG_LogIndex_t *idx, PPG_LogIndexWriter_t *w, uint16_t seed, uint32_t offset);
+
+/**
+ * @brief Next piece of the index, its CRC and the trailer.
+ *
+ * @param[in]     idx Index.
+ * @param[in,out] w   Writer.
+ * @param[out]    buf PPG_LOG_INDEX_PIECE_MAX bytes.
+ *
+ * @return Bytes written, 0 once the trailer is out.
+ */
+size_t PPG_LogIndex_Encode(const PPG_LogIndex_t *idx, PPG_LogIndexWriter_t *w, uint8_t *buf);
+
+/**
+ * @brief Start decoding a log held in memory.
+ *
+ * A valid index at the end of the log is attached (reader->index); the
+ * blocks end where it starts.
+ *
+ * @param[out] reader Decoder.
+ * @param[in]  data   Log file contents (kept, not copied; a mapping is
+ *                    only read where it is decoded).
+ * @param[in]  size   Bytes.
+ *
+ * @return false if the session header is not valid.
+ */
+bool PPG_LogReader_Open(PPG_LogReader_t *reader, const uint8_t *data, size_t size);
+
+/**
+ * @brief Decode the next frame, skipping blocks that fail their CRC.
+ *
+ * @param[in,out] reader Decoder.
+ * @param[out]    frame  Next frame.
+ *
+ * @return false at the end of the log.
+ */
+bool PPG_LogReader_Next(PPG_LogReader_t *reader, PPG_LogFrame_t *frame);
+
+/**
+ * @brief Back to the first block, counters cleared.
+ *
+ * @param[in,out] reader Decoder.
+ */
+void PPG_LogReader_Rewind(PPG_LogReader_t *reader);
+
+/**
+ * @brief Continue from the last block starting at or before a timestamp.
+ *
+ * Bisects the blocks between the two index entries around it (the whole
+ * log without an index): only a few blocks are checked.
+ *
+ * @param[in,out] reader    Decoder.
+ * @param[in]     timestamp Sample clock; before the first block: from it.
+ * @param[out]    scratch   Decoded frame (work area).
+ *
+ * @return false if the log has no valid block.
+ */
+bool PPG_LogReader_Seek(PPG_LogReader_t *reader, uint32_t timestamp, PPG_LogFrame_t *scratch);
+
+/**
+ * @brief Read an index entry.
+ *
+ * @return false past reader->index.entries.
+ */
+bool PPG_LogReader_IndexEntry(const PPG_LogReader_t *reader, uint32_t i, PPG_LogIndexEntry_t *entry);
+
+/**
+ * @brief Read an index event.
+ *
+ * @return false past reader->index.events.
+ */
+bool PPG_LogReader_IndexEvent(const PPG_LogReader_t *reader, uint32_t i, PPG_LogEvent_t *event);
+
+/**
+ * @brief Index a log without one (cut short) by decoding it all.
+ *
+ * The index is encoded into buf and attached to the reader, which starts
+ * over from the first block.
+ *
+ * @param[in,out] reader  Decoder.
+ * @param[out]    idx     Index being built.
+ * @param[out]    buf     PPG_LOG_INDEX_MAX_SIZE bytes, kept by the reader.
+ * @param[out]    scratch Decoded frame.
+ */
+void PPG_LogReader_BuildIndex(PPG_LogReader_t *reader, PPG_LogIndex_t *idx, uint8_t *buf,
+                              PPG_LogFrame_t *scratch);
+
+#endif /* PPG_LOG_FORMAT_H */
@@ -0,0 +1,184 @@
+/**
+ ******************************************************************************
+ * @file    ppg_pipeline.h
+ * @author  A. Bellina
+ * @brief   Hardware-independent PPG processing pipeline.
+ *
+ * @details
+ * Chains every DSP stage on the samples of an acquisition frame:
+ *   - CIC resampling from the capture rate to PPG_FS (ppg_decimator.h,
+ *     ratio set by the rate profile, see ppg_rate.h)
+ *   - moving-average filter bank (ppg_filter_bank.h)
+ *   - Q15 HR band-pass FIR (ppg_fir.h, ppg_fir_coeffs.h)
+ *   - SpO2 AC/DC tracking (ppg_spo2.h)
+ *   - beat detector and per-beat HR (ppg_beat_detector.h)
+ *   - spectral HR (ppg_hr_spectral.h)
+ *
+ * Two acquisition modes, chosen per frame from its
+ * PPG_FRAME_FLAG_SIMULTANEOUS flag (set by the producer):
+ *   - windowed (single photodiode stream, simulation): each sample is
+ *     RED or IR according to its acquisition window
+ *   - simultaneous (LED phase scheduler, led_phase.h): RED, IR and
+ *     ambient in every sample period. Ambient is subtracted from RED and
+ *     IR, HR runs on IR and both channels feed SpO2 continuously, each
+ *     through its own band-pass FIR
+ *
+ * The pipeline owns all the DSP state and has no HAL/RTOS dependency:
+ * ppg_processing.c is the firmware adapter (acquisition, queues, session
+ * control, JScope variables) and host/CMakeLists.txt builds the same
+ * code as the ppg_dsp library for benchmarks and off-target checks.
+ ******************************************************************************
+ */
+
+#ifndef PPG_PIPELINE_H
+#define PPG_PIPELINE_H
+
+#include "ppg_frame.h"
+#include "ppg_filter_bank.h"
+#include "ppg_fir.h"
+#include "ppg_beat_detector.h"
+#include "ppg_spo2.h"
+#include "ppg_hr_spectral.h"
+#include "ppg_decimator.h"
+#include "ppg_rate.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Number of samples for one PPG acquisition session */
+#define PPG_FS              100                                            /**< DSP rate [Hz], capture rate: ppg_rate.h */
+#define PPG_WINDOW_SEC      5
+#define PPG_NUM_WINDOWS     6
+
+#define PPG_TOTAL_SAMPLES   (PPG_FS * PPG_WINDOW_SEC * PPG_NUM_WINDOWS)   /**< 30 s @ 100 Hz */
+
+/**
+ * Samples per acquisition window. Windows alternate RED, IR, RED, ...
+ * (WINDOW_ORDER in simulation/wait_measure_trigger.py).
+ */
+#define PPG_WINDOW_SAMPLES     (PPG_FS * PPG_WINDOW_SEC)
+
+/** Number of samples for photodiode settling time */
+#define SETTLING_TIME          15U     /**< 15 ms @ 100 Hz */
+
+/** HR band-pass length, checked against ppg_fir_coeffs.h in ppg_pipeline.c */
+#define PPG_PIPELINE_FIR_TAPS  128U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Latest pipeline outputs */
+typedef struct
+{
+    uint16_t filtered[PPG_CH_COUNT];   /**< Last moving-average output per channel */
+    PPG_Channel_t channel;             /**< Channel of the last sample */
+    int16_t  bandpassed;               /**< Last HR band-pass output, Q15 */
+    float    hr_bpm;                   /**< Per-beat HR (0 until known) */
+    float    hr_spectral_bpm;          /**< Spectral HR (0 until the first segment) */
+    float    spo2_percent;             /**< SpO2 (0 until known) */
+    float    spo2_ratio;               /**< Ratio of ratios of the last SpO2 */
+    uint32_t beat_count;               /**< Beats detected since the last reset */
+    uint16_t events;                   /**< PPG_FRAME_EVENT_* of the current frame */
+} PPG_PipelineOutput_t;
+
+/** Pipeline state: every DSP stage */
+typedef struct
+{
+    PPG_FilterBank_t     filter_bank;
+    PPG_FIR_t            bp_fir;                                    /**< HR channel (IR when simultaneous) */
+    int16_t              bp_fir_state[2U * PPG_PIPELINE_FIR_TAPS];
+    PPG_FIR_t            red_fir;                                   /**< RED AC (simultaneous mode) */
+    int16_t              red_fir_state[2U * PPG_PIPELINE_FIR_TAPS];
+    PPG_BeatDetector_t   beat_detector;
+    PPG_SpO2_t           spo2;
+    PPG_Spectral_t       spectral;
+    PPG_CIC_t            decimator[PPG_CH_COUNT];                   /**< Capture rate -> PPG_FS ([0] for a windowed stream) */
+    uint32_t             interpolation;                             /**< Holds of each capture sample */
+    uint32_t             frame_samples;                             /**< Capture samples per frame */
+    PPG_PipelineOutput_t out;
+} PPG_Pipeline_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize every stage for PPG_FS, frames at PPG_FS.
+ *
+ * @param[out] pipeline Pipeline state.
+ */
+void PPG_Pipeline_Init(PPG_Pipeline_t *pipeline);
+
+/**
+ * @brief Take frames at the capture rate of a profile.
+ *
+ * Restarts the decimators: call between sessions.
+ *
+ * @param[in,out] pipeline Pipeline state.
+ * @param[in]     rate     Settings of the profile (ppg_rate.h).
+ *
+ * @return false if the ratio is out of range (PPG_FRAME_MAX_DECIMATION).
+ */
+bool PPG_Pipeline_SetRate(PPG_Pipeline_t *pipeline, const PPG_RateConfig_t *rate);
+
+/**
+ * @brief Restart every stage and clear the outputs (new session).
+ *
+ * @param[in,out] pipeline Pipeline state.
+ */
+void PPG_Pipeline_Reset(PPG_Pipeline_t *pipeline);
+
+/**
+ * @brief Channel acquired during the window that contains sample n.
+ *
+ * @param[in] n Sample index since the session start.
+ *
+ * @return PPG_CH_RED or PPG_CH_IR.
+ */
+PPG_Channel_t PPG_Pipeline_WindowChannel(uint32_t n);
+
+/**
+ * @brief Run every stage on a single sample.
+ *
+ * @param[in,out] pipeline Pipeline state (outputs in pipeline->out).
+ * @param[in]     n        Sample index since the session start.
+ * @param[in]     channel  Channel acquired at sample n.
+ * @param[in]     sample   Raw 12-bit ADC sample.
+ */
+void PPG_Pipeline_ProcessSample(PPG_Pipeline_t *pipeline, uint32_t n,
+                                PPG_Channel_t channel, uint16_t sample);
+
+/**
+ * @brief Run every stage on one simultaneous RED / IR / ambient sample.
+ *
+ * @param[in,out] pipeline Pipeline state (outputs in pipeline->out).
+ * @param[in]     n        Sample index since the session start.
+ * @param[in]     red      Raw 12-bit ADC sample, RED phase.
+ * @param[in]     ir       Raw 12-bit ADC sample, IR phase.
+ * @param[in]     ambient  Raw 12-bit ADC sample, dark phase (0 if not acquired).
+ */
+void PPG_Pipeline_ProcessSimultaneous(PPG_Pipeline_t *pipeline, uint32_t n,
+                                      uint16_t red, uint16_t ir, uint16_t ambient);
+
+/**
+ * @brief Run every stage on the frame->count samples of a frame.
+ *
+ * The capture samples are first resampled to PPG_FS: a frame holds about
+ * PPG_BLOCK_SIZE samples at PPG_FS, whatever the rate profile
+ * (frame->results.count).
+ * Frames flagged PPG_FRAME_FLAG_SIMULTANEOUS are processed as simultaneous
+ * samples, others take each sample from the channel of its acquisition
+ * window (a frame may cross a window edge and hold both channels).
+ * The band-pass output of each PPG_FS sample and the latest HR/SpO2 are
+ * stored in frame->results.
+ *
+ * @param[in,out] pipeline Pipeline state.
+ * @param[in,out] frame    Acquisition frame.
+ */
+void PPG_Pipeline_ProcessFrame(PPG_Pipeline_t *pipeline, PPG_Frame_t *frame);
+
+#endif /* PPG_PIPELINE_H */
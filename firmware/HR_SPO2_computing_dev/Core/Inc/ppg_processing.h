@@ -6,19 +6,40 @@
  *          optional LED autocalibration (real hardware only).
  *
  * @details
- * This module provides a clean processing pipeline for PPG signals
- * (RED/IR channels). It supports:
- *   - Moving Average filtering
- *   - HR estimation
- *   - SpO2 estimation (ratio-of-ratios method)
+ * This module is the firmware adapter of the PPG processing pipeline
+ * (RED/IR channels). The DSP itself lives in ppg_pipeline.h, free of
+ * HAL/RTOS dependencies:
+ *   - Moving Average filtering (per-channel filter bank, see ppg_filter_bank.h)
+ *   - HR band-pass filtering (Q15 FIR, see ppg_fir.h)
+ *   - HR estimation (streaming beat detector, see ppg_beat_detector.h)
+ *   - Spectral HR estimation (Goertzel bank, see ppg_hr_spectral.h)
+ *   - SpO2 estimation (ratio-of-ratios method, see ppg_spo2.h)
+ *
+ * This module adds the acquisition (frames, see ppg_frame.h), the
+ * lock-free frame ring to the processing task (ppg_ring.h), the RTOS
+ * queue to the logging task, session control and the
+ * JScope variables:
  *   - Optional autocalibration to select LED PWM levels
  *   - Support for real hardware or simulation mode
  *
- * The acquisition is driven externally (e.g. TIM interrupt @ 100 Hz).
+ * Acquisition, at the capture rate of the selected profile (ppg_rate.h):
+ *   - hardware: photodiode rank of the ADC scan (adc_scan.h), read in
+ *     place from each DMA half-buffer and copied into frames
+ *   - simulation: sample periods streamed over the framed UART link
+ *     (ppg_sim.h), one per TIM9 tick
+ *   - both are decimated by PPG_OVERSAMPLE (ppg_decimator.h) in
+ *     PPG_AcquireFromISR()
  *
  * Preprocessor flags:
- *   - USE_SIMULATION: disables ADC reads and enables UART-driven samples
+ *   - USE_SIMULATION: disables ADC reads and enables the UART link
  *   - USE_AUTOCALIBRATION: enables PWM autocalibration (real mode only)
+ *   - PPG_PROFILE_UART: prints the stage profile (ppg_profile.h) on USART2
+ *     at the end of each session
+ *
+ * Sample timing and losses are checked while running (ppg_integrity.h):
+ * PPG_GetIntegrity(), and a report every PPG_INTEGRITY_REPORT_S and at
+ * the end of each session on USART2 (text on hardware, REPORT frames of
+ * the simulation link).
  *
  * Selected variables are exposed for JLink/JScope plotting.
  ******************************************************************************
@@ -28,6 +49,11 @@
 #define PPG_PROCESSING_H
 
 #include "main.h"
+#include "ppg_pipeline.h"
+#include "ppg_rate.h"
+#include "ppg_integrity.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -35,21 +61,56 @@
 /* Configuration                                                             */
 /* ------------------------------------------------------------------------- */
 
-/** UART buffer size for simulation (ADC sample = 2 bytes) */
-#define BUFFER_SIZE            2U
+/*
+ * Session length and acquisition windows (PPG_FS, PPG_TOTAL_SAMPLES, ...)
+ * are set in ppg_pipeline.h at the DSP rate, block size (PPG_BLOCK_SIZE)
+ * and frame pool size in ppg_frame.h. The capture rate and what derives
+ * from it come from the rate profile (ppg_rate.h, PPG_SetRate()).
+ */
 
-/** Number of samples for one PPG acquisition session */
-#define PPG_FS              100
-#define PPG_WINDOW_SEC      5
-#define PPG_NUM_WINDOWS     6
+/** Depth of the frame ring between acquisition and processing (power of two) */
+#define PPG_FRAME_RING_LENGTH  PPG_FRAME_POOL_SIZE
 
-#define PPG_TOTAL_SAMPLES   (PPG_FS * PPG_WINDOW_SEC * PPG_NUM_WINDOWS)   /**< 30 s @ 100 Hz */
+/** Frames taken from the ring per processing step */
+#define PPG_PROCESS_BATCH      4U
 
-/** Moving Average filter window */
-#define PPG_FILTER_WINDOW      16U
+/** Depth of each consumer frame queue */
+#define PPG_CONSUMER_QUEUE_LENGTH  (PPG_FRAME_POOL_SIZE / 4U)
 
-/** Number of samples for photodiode settling time */
-#define SETTLING_TIME          15U     /**< 15 ms @ 100 Hz */
+/** Seconds between two integrity reports while running, 0: end of session only */
+#ifndef PPG_INTEGRITY_REPORT_S
+#define PPG_INTEGRITY_REPORT_S  5U
+#endif
+
+/**
+ * Event flag set while no session is in progress (PPG_BindEvents()):
+ * cleared by PPG_Start(), set once the processing task has drained the
+ * last frames of the session. Bits below are free for the application.
+ */
+#define PPG_EVENT_IDLE         (1UL << 8)
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Consumers of processed frames */
+typedef enum
+{
+    PPG_CONSUMER_LOGGER = 0,
+    PPG_CONSUMER_COUNT
+} PPG_Consumer_t;
+
+/** Scheduling and CPU load statistics of the PPG processing path */
+typedef struct
+{
+    uint32_t blocks;              /**< Frames processed since PPG_Start() */
+    uint32_t block_overruns;      /**< Frames dropped: pool exhausted or processing ring full */
+    uint32_t consumer_drops;      /**< Frames not delivered to a full consumer queue */
+    uint32_t acq_errors;          /**< ADC scan errors (overrun, DMA) since PPG_Start() */
+    uint32_t wakeups_per_s;       /**< Processing task wakeups in the last second */
+    uint32_t ctx_switches_per_s;  /**< RTOS context switches (all tasks) in the last second */
+    uint32_t cpu_load_permille;   /**< Non-idle CPU time in the last second [1/1000] */
+} PPG_LoadStats_t;
 
 /* ------------------------------------------------------------------------- */
 /* Public data (visible for JLink / JScope)                                   */
@@ -58,29 +119,38 @@
 #ifdef USE_SIMULATION
 /** Last simulated ADC input sample (12-bit) */
 extern volatile uint16_t adc_raw;
-
-/** UART RX buffer for simulated samples */
-extern uint8_t usart_rx_buffer[BUFFER_SIZE];
-
-/** Flag set when a new UART sample is ready */
-extern volatile uint8_t uart_ready;
 #endif
 
 /** Last filtered signal (generic / simulation debug) */
 extern volatile float filtered_signal;
 
+/** Last HR band-pass (0.5-4 Hz) output, Q15 */
+extern volatile int16_t ppg_bandpassed;
+
 /** Last filtered RED sample */
 extern volatile uint32_t ppg_red_filtered;
 
 /** Last filtered IR sample */
 extern volatile uint32_t ppg_ir_filtered;
 
-/** Last computed heart rate (bpm) */
+/** Last computed heart rate (bpm), updated at every detected beat */
 extern volatile float ppg_heart_rate_bpm;
 
-/** Last computed SpO2 (%) */
+/** Spectral heart rate (bpm), updated every 5 s once the first 10 s segment is complete */
+extern volatile float ppg_hr_spectral_bpm;
+
+/** Beats detected since PPG_Start() */
+extern volatile uint32_t ppg_beat_count;
+
+/** Last computed SpO2 (%), updated at every beat once RED and IR are known */
 extern volatile float ppg_spo2_percent;
 
+/** Last ratio of ratios R = (AC_red / DC_red) / (AC_ir / DC_ir) */
+extern volatile float ppg_spo2_ratio;
+
+/** Processing load statistics, refreshed once per second while running */
+extern volatile PPG_LoadStats_t ppg_load_stats;
+
 /* ------------------------------------------------------------------------- */
 /* Public API                                                                */
 /* ------------------------------------------------------------------------- */
@@ -88,18 +158,30 @@ extern volatile float ppg_spo2_percent;
 /**
  * @brief Initialize the PPG processing module.
  *
- * @param[in] adc_red ADC handle for RED channel (ignored in simulation).
- * @param[in] adc_ir  ADC handle for IR channel (ignored in simulation).
+ * On hardware, subscribes to the ADC scan blocks (adc_scan.h): call
+ * before AdcScan_Start().
  *
  * @note Must be called once at startup.
  */
-void PPG_Init(ADC_HandleTypeDef *adc_red, ADC_HandleTypeDef *adc_ir);
+void PPG_Init(void);
+
+/**
+ * @brief Publish the session state on an event flags object.
+ *
+ * PPG_EVENT_IDLE is kept up to date on events, so tasks can block on the
+ * end of a session (PPG_WaitUntilDone()) instead of polling.
+ *
+ * @param[in] events Event flags shared with the application.
+ */
+void PPG_BindEvents(osEventFlagsId_t events);
 
 /**
  * @brief Start a new PPG acquisition session.
  *
- * Resets internal state and enables sampling.
- * The acquisition will automatically stop after PPG_TOTAL_SAMPLES.
+ * Resets internal state and enables sampling. The ADC scan keeps
+ * running between sessions: samples are only taken while running.
+ * The acquisition will automatically stop after PPG_TOTAL_SAMPLES
+ * (PPG_RateConfig_t::total_samples at the capture rate).
  */
 void PPG_Start(void);
 
@@ -112,14 +194,101 @@ void PPG_Start(void);
 void PPG_Stop(void);
 
 
+/**
+ * @brief Select the capture-rate profile (between sessions).
+ *
+ * Reprograms the sample tick timer (TIM9) and, on hardware, the LED
+ * phase timer from the actual timer clock. Frame length, session length
+ * and pipeline decimation follow the profile from the next PPG_Start().
+ *
+ * @param[in] rate Profile.
+ *
+ * @return false while a session is running, or if the profile does not
+ *         fit the timer clock (previous profile kept).
+ */
+bool PPG_SetRate(PPG_Rate_t rate);
+
+/**
+ * @brief Settings of the current rate profile.
+ *
+ * Valid from reset on (PPG_RATE_DEFAULT): the timer initialization reads
+ * it before PPG_Init().
+ *
+ * @return NULL if the default profile does not fit the timer clock.
+ */
+const PPG_RateConfig_t *PPG_GetRateConfig(void);
+
+/**
+ * @brief Copy the integrity statistics of the current (or last) session.
+ *
+ * Timing of the sample tick, ADC blocks and frames against the rate
+ * profile, skipped acquisition periods, and frames dropped anywhere
+ * between acquisition and the consumers (ppg_integrity.h). Timestamps
+ * are in ppg_profile_tick_hz ticks.
+ *
+ * @param[out] stats Statistics since PPG_Start().
+ */
+void PPG_GetIntegrity(PPG_Integrity_t *stats);
+
 /**
  * @brief Execute one PPG processing step.
  *
- * This function must be called periodically (e.g. 100 Hz),
- * typically from a timer interrupt.
+ * Blocks until the next acquisition frame (PPG_BLOCK_SIZE samples per
+ * channel) is available, then for each frame queued, up to
+ * PPG_PROCESS_BATCH: runs every pipeline stage over it, stores the
+ * results in the frame and hands it to the consumers.
+ * Returns immediately if acquisition is not running, and once the
+ * session has stopped (PPG_EVENT_IDLE then set).
+ *
+ * @note Intended for use inside a FreeRTOS task.
  */
 void PPG_ProcessStep(void);
 
+/**
+ * @brief Wait for the next processed frame of a consumer.
+ *
+ * Frames are skipped (sequence gap) when the consumer queue is full.
+ *
+ * @param[in] consumer   Consumer queue to read.
+ * @param[in] timeout_ms Maximum wait [ms] (osWaitForever to block).
+ *
+ * @return Frame holding one reference for the caller, or NULL on timeout.
+ *         Give it back with PPG_ReleaseFrame().
+ */
+PPG_Frame_t *PPG_ReceiveFrame(PPG_Consumer_t consumer, uint32_t timeout_ms);
+
+/**
+ * @brief Release a frame obtained from PPG_ReceiveFrame().
+ *
+ * @param[in] frame Frame (not usable afterwards).
+ */
+void PPG_ReleaseFrame(PPG_Frame_t *frame);
+
+/**
+ * @brief Acquire one sample period (ISR context).
+ *
+ * Decimates each channel by PPG_OVERSAMPLE and appends the result to the
+ * frame being filled every PPG_OVERSAMPLE periods, while running.
+ * Frames hold PPG_RateConfig_t::frame_samples capture samples.
+ *
+ * @param[in]  samples Raw 12-bit samples by PPG_Channel_t, only those in mask are read.
+ * @param[in]  mask    PPG_CH_MASK() of the channels acquired in this period.
+ * @param[in]  clock   Acquisition period index (capture rate * PPG_OVERSAMPLE clock).
+ * @param[out] pxHigherPriorityTaskWoken Set if the processing task was woken.
+ */
+void PPG_AcquireFromISR(const uint16_t samples[PPG_CH_COUNT], uint16_t mask,
+                        uint32_t clock, BaseType_t *pxHigherPriorityTaskWoken);
+
+/**
+ * @brief Advance the sample clock used to timestamp frames.
+ *
+ * In simulation, also hands the next received period to the acquisition
+ * path (ppg_sim.h).
+ *
+ * @note Call from the TIM9 period elapsed interrupt.
+ */
+void PPG_SampleTickFromISR(void);
+
 /**
  * @brief Check if PPG acquisition is currently running.
  *
@@ -131,16 +300,11 @@ bool PPG_IsRunning(void);
 /**
  * @brief Block until PPG acquisition is complete.
  *
- * @note Intended for use inside a FreeRTOS task.
- */
-void PPG_WaitUntilDone(void);
-
-/**
- * @brief Push one simulated ADC sample (UART mode only).
+ * Waits on PPG_EVENT_IDLE without clearing it (no timeout, no polling).
  *
- * @param[in] sample 12-bit ADC value
+ * @note Intended for use inside a FreeRTOS task, after PPG_BindEvents().
  */
-void PPG_PushSimulatedSample(uint16_t sample);
+void PPG_WaitUntilDone(void);
 
 /**
  * @brief Run LED autocalibration (real hardware only).
@@ -0,0 +1,165 @@
+/**
+ ******************************************************************************
+ * @file    ppg_profile.h
+ * @author  A. Bellina
+ * @brief   Cycle-accurate profiling of the PPG acquisition and pipeline.
+ *
+ * @details
+ * Lightweight begin/end markers around each stage, accumulated per stage:
+ *   - count, min, max, mean (sum) of the measured durations
+ *   - a logarithmic histogram (4 buckets per octave) giving percentiles
+ *     within ~20 % without storing samples
+ *
+ * Time base:
+ *   - Cortex-M: DWT CYCCNT, i.e. CPU cycles (enabled by PPG_Profile_Init)
+ *   - host x86-64: TSC (rdtsc), calibrated against clock_gettime
+ *   - other hosts: clock_gettime(CLOCK_MONOTONIC) in ns
+ *
+ * Recording is O(1) and ISR safe as long as each stage is recorded from a
+ * single context. Percentiles are computed by PPG_Profile_Report(), out
+ * of the hot path, and exported through the JScope-visible ppg_profile[]
+ * array or as text (PPG_Profile_Format()).
+ *
+ * Build with -DPPG_PROFILE_ENABLE=0 to compile every marker out.
+ ******************************************************************************
+ */
+
+#ifndef PPG_PROFILE_H
+#define PPG_PROFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** 1: markers record durations, 0: markers compile to nothing */
+#ifndef PPG_PROFILE_ENABLE
+#define PPG_PROFILE_ENABLE     1
+#endif
+
+/** Histogram buckets: 4 exact (0..3), then 4 per octave up to 2^32 */
+#define PPG_PROFILE_BUCKETS    124U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Profiled stages */
+typedef enum
+{
+    PPG_PROF_ACQ_ISR = 0,     /**< Sample push into the frame (ISR) */
+    PPG_PROF_DECIMATOR,       /**< CIC decimator, per ADC sample (ISR) */
+    PPG_PROF_QUEUE_HOP,       /**< Frame queued -> received by the processing task */
+    PPG_PROF_FRAME,           /**< Whole frame through the pipeline */
+    PPG_PROF_FILTER_BANK,     /**< Moving-average filter bank, per sample */
+    PPG_PROF_FIR,             /**< HR band-pass FIR, per sample */
+    PPG_PROF_SPO2,            /**< SpO2 AC/DC tracking, per sample */
+    PPG_PROF_BEAT,            /**< Beat detector (+ SpO2 per beat), per sample */
+    PPG_PROF_SPECTRAL,        /**< Goertzel spectral HR, per sample */
+    PPG_PROF_LOG_ENCODE,      /**< Session log encoding, per frame (data_logger.c) */
+    PPG_PROF_COUNT
+} PPG_ProfileStage_t;
+
+/** Accumulator of one stage */
+typedef struct
+{
+    uint32_t count;                          /**< Recorded durations */
+    uint32_t min;                            /**< Shortest [ticks] */
+    uint32_t max;                            /**< Longest [ticks] */
+    uint64_t sum;                            /**< Sum [ticks] */
+    uint16_t hist[PPG_PROFILE_BUCKETS];      /**< Log histogram (halved when a bucket saturates) */
+} PPG_ProfileStat_t;
+
+/** Summary of one stage, in ticks (JScope / UART export) */
+typedef struct
+{
+    uint32_t count;
+    uint32_t min;
+    uint32_t mean;
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+} PPG_ProfileReport_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public data (visible for JLink / JScope)                                   */
+/* ------------------------------------------------------------------------- */
+
+/** Per-stage summary, refreshed by PPG_Profile_Report() */
+extern volatile PPG_ProfileReport_t ppg_profile[PPG_PROF_COUNT];
+
+/** Ticks per second of the profiling time base */
+extern volatile uint32_t ppg_profile_tick_hz;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Start the time base and clear every accumulator.
+ *
+ * @param[in] tick_hz Counter frequency (SystemCoreClock on target),
+ *                    0 to let the host time base calibrate itself.
+ */
+void PPG_Profile_Init(uint32_t tick_hz);
+
+/**
+ * @brief Clear every accumulator (keeps the time base).
+ */
+void PPG_Profile_Reset(void);
+
+/**
+ * @brief Current value of the time base [ticks].
+ */
+uint32_t PPG_Profile_Now(void);
+
+/**
+ * @brief Add one duration to a stage.
+ *
+ * @param[in] stage Profiled stage.
+ * @param[in] ticks Duration [ticks].
+ */
+void PPG_Profile_Record(PPG_ProfileStage_t stage, uint32_t ticks);
+
+/**
+ * @brief Compute min/mean/percentiles of every stage into ppg_profile[].
+ */
+void PPG_Profile_Report(void);
+
+/**
+ * @brief Percentile of a stage from its histogram.
+ *
+ * @param[in] stage   Profiled stage.
+ * @param[in] percent Percentile (0..100).
+ *
+ * @return Estimated duration [ticks], 0 if nothing was recorded.
+ */
+uint32_t PPG_Profile_Percentile(PPG_ProfileStage_t stage, uint32_t percent);
+
+/**
+ * @brief Write the last report as text, one line per stage.
+ *
+ * @param[out] buf  Output buffer.
+ * @param[in]  size Buffer size [bytes].
+ *
+ * @return Characters written (without the terminator).
+ */
+size_t PPG_Profile_Format(char *buf, size_t size);
+
+/* ------------------------------------------------------------------------- */
+/* Markers                                                                   */
+/* ------------------------------------------------------------------------- */
+
+#if PPG_PROFILE_ENABLE
+/** Open a profiled scope: declares the start time of `stage` */
+#define PPG_PROFILE_BEGIN(stage)  uint32_t ppg_prof_t0_##stage = PPG_Profile_Now()
+/** Close the scope opened by PPG_PROFILE_BEGIN(stage) */
+#define PPG_PROFILE_END(stage)    PPG_Profile_Record((stage), PPG_Profile_Now() - ppg_prof_t0_##stage)
+#else
+#define PPG_PROFILE_BEGIN(stage)  do { } while (0)
+#define PPG_PROFILE_END(stage)    do { } while (0)
+#endif
+
+#endif /* PPG_PROFILE_H */
@@ -0,0 +1,110 @@
+/**
+ ******************************************************************************
+ * @file    ppg_rate.h
+ * @author  A. Bellina
+ * @brief   Capture-rate profiles and the settings derived from them.
+ *
+ * @details
+ * A profile sets the rate of the samples carried by the frames (the
+ * capture rate, logged as acquired): 100, 250, 500 or 1000 Hz. Every
+ * setting that depends on it is computed here instead of by hand:
+ *   - sample tick timer (TIM9) prescaler and period, from the actual
+ *     timer clock, one update per acquisition period
+ *     (capture rate * PPG_OVERSAMPLE)
+ *   - resampling from the capture rate to PPG_FS: the DSP stages keep
+ *     running at PPG_FS, where the band-pass FIR is designed
+ *     (ppg_fir_coeffs.h), behind a CIC stage in the pipeline. The ratio
+ *     is interpolation / decimation in lowest terms: each capture sample
+ *     is held interpolation times, then decimated (250 Hz: 2 / 5)
+ *   - capture samples per frame (about PPG_BLOCK_SIZE PPG_FS samples):
+ *     frame, ring and consumer queue depths keep the same duration at
+ *     any rate
+ *   - session length in capture samples (PPG_TOTAL_SAMPLES at PPG_FS)
+ *
+ * The LED phase timer settings are derived by led_phase.h from the
+ * acquisition rate and the timer clock of this configuration.
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host.
+ ******************************************************************************
+ */
+
+#ifndef PPG_RATE_H
+#define PPG_RATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Capture-rate profiles */
+typedef enum
+{
+    PPG_RATE_100HZ = 0,
+    PPG_RATE_250HZ,
+    PPG_RATE_500HZ,
+    PPG_RATE_1000HZ,
+    PPG_RATE_COUNT
+} PPG_Rate_t;
+
+/** Settings derived from a profile */
+typedef struct
+{
+    uint32_t capture_hz;       /**< Frame sample rate [Hz] */
+    uint32_t acq_hz;           /**< Acquisition period rate: capture_hz * PPG_OVERSAMPLE [Hz] */
+    uint32_t timer_clock_hz;   /**< Timer counter clock the settings are computed for [Hz] */
+    uint16_t tick_prescaler;   /**< Sample tick timer PSC */
+    uint16_t tick_period;      /**< Sample tick timer ARR */
+    uint16_t interpolation;    /**< Holds of each capture sample before the decimation */
+    uint16_t decimation;       /**< CIC ratio down to PPG_FS */
+    uint16_t frame_samples;    /**< Capture samples per frame */
+    uint32_t total_samples;    /**< Session length [capture samples] */
+} PPG_RateConfig_t;
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Profile at startup [Hz]. Set from CMake with -DPPG_RATE_HZ=<n>. */
+#ifndef PPG_RATE_DEFAULT_HZ
+#define PPG_RATE_DEFAULT_HZ    100U
+#endif
+
+#if (PPG_RATE_DEFAULT_HZ == 100U)
+#define PPG_RATE_DEFAULT       PPG_RATE_100HZ
+#elif (PPG_RATE_DEFAULT_HZ == 250U)
+#define PPG_RATE_DEFAULT       PPG_RATE_250HZ
+#elif (PPG_RATE_DEFAULT_HZ == 500U)
+#define PPG_RATE_DEFAULT       PPG_RATE_500HZ
+#elif (PPG_RATE_DEFAULT_HZ == 1000U)
+#define PPG_RATE_DEFAULT       PPG_RATE_1000HZ
+#else
+#error "PPG_RATE_DEFAULT_HZ must be 100, 250, 500 or 1000"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Capture rate of a profile.
+ *
+ * @return Rate [Hz], 0 for an unknown profile.
+ */
+uint32_t PPG_Rate_Hz(PPG_Rate_t rate);
+
+/**
+ * @brief Derive every rate-dependent setting of a profile.
+ *
+ * @param[in]  rate           Profile.
+ * @param[in]  timer_clock_hz Counter clock of the sample tick timer [Hz].
+ * @param[out] cfg            Settings.
+ *
+ * @return false if the profile is unknown, needs more decimation than a
+ *         frame holds (PPG_FRAME_MAX_DECIMATION), or the acquisition
+ *         rate is not an exact division of the timer clock.
+ */
+bool PPG_Rate_GetConfig(PPG_Rate_t rate, uint32_t timer_clock_hz, PPG_RateConfig_t *cfg);
+
+#endif /* PPG_RATE_H */
@@ -0,0 +1,103 @@
+/**
+ ******************************************************************************
+ * @file    ppg_ring.h
+ * @author  A. Bellina
+ * @brief   Lock-free single-producer / single-consumer pointer ring.
+ *
+ * @details
+ * Hands items (frame pointers) from one producer, typically an ISR, to
+ * one consumer task without a critical section or a copy of the item:
+ *   - head and tail are free-running counts, each written by one side
+ *     only; the capacity is a power of two, so the slot is count & mask
+ *   - the producer fills the slot, then publishes head with a release
+ *     store; the consumer reads head with an acquire load before the
+ *     slot (and the reverse for tail). On Cortex-M4 these are a DMB
+ *     around plain word accesses; on the host the same code is correct
+ *     across cores (host/bench/stress_ring.c)
+ *   - a push on a full ring fails and counts an overrun, the item stays
+ *     with the producer
+ *
+ * The ring does not block: the producer signals the consumer (task
+ * notification) after a successful push.
+ *
+ * The module has no HAL/RTOS dependency and also builds on the host.
+ ******************************************************************************
+ */
+
+#ifndef PPG_RING_H
+#define PPG_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** SPSC ring of pointers */
+typedef struct
+{
+    void   **slots;       /**< Storage, capacity entries */
+    uint32_t mask;        /**< capacity - 1 */
+    uint32_t head;        /**< Items pushed (producer) */
+    uint32_t tail;        /**< Items popped (consumer) */
+    uint32_t overruns;    /**< Pushes refused on a full ring (producer) */
+} PPG_Ring_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bind the storage and empty the ring (neither side running).
+ *
+ * @param[out] ring     Ring.
+ * @param[in]  slots    Storage of capacity pointers.
+ * @param[in]  capacity Power of two.
+ *
+ * @return false if capacity is not a power of two.
+ */
+bool PPG_Ring_Init(PPG_Ring_t *ring, void **slots, uint32_t capacity);
+
+/**
+ * @brief Append one item (producer only).
+ *
+ * @param[in,out] ring Ring.
+ * @param[in]     item Item, handed over to the consumer on success.
+ *
+ * @return false if the ring is full (overrun counted).
+ */
+bool PPG_Ring_Push(PPG_Ring_t *ring, void *item);
+
+/**
+ * @brief Take up to max items in FIFO order (consumer only).
+ *
+ * @param[in,out] ring  Ring.
+ * @param[out]    items Destination of max pointers.
+ * @param[in]     max   Items wanted.
+ *
+ * @return Items taken, 0 if the ring is empty.
+ */
+uint32_t PPG_Ring_PopBatch(PPG_Ring_t *ring, void **items, uint32_t max);
+
+/**
+ * @brief Take one item (consumer only).
+ *
+ * @return false if the ring is empty.
+ */
+static inline bool PPG_Ring_Pop(PPG_Ring_t *ring, void **item)
+{
+    return PPG_Ring_PopBatch(ring, item, 1U) != 0U;
+}
+
+/**
+ * @brief Items queued, from either side (a snapshot).
+ */
+uint32_t PPG_Ring_Count(const PPG_Ring_t *ring);
+
+/**
+ * @brief Pushes refused since PPG_Ring_Init().
+ */
+uint32_t PPG_Ring_Overruns(const PPG_Ring_t *ring);
+
+#endif /* PPG_RING_H */
@@ -0,0 +1,125 @@
+/**
+ ******************************************************************************
+ * @file    ppg_sim.h
+ * @author  A. Bellina
+ * @brief   Simulated acquisition over the framed UART link (USE_SIMULATION).
+ *
+ * @details
+ * Replaces the ADC with sample periods streamed by
+ * simulation/wait_measure_trigger.py in DATA frames (ppg_link.h):
+ *   - PPG_Sim_Start() sends START with the acquisition rate (capture
+ *     rate * PPG_OVERSAMPLE, see ppg_rate.h) and the channels wanted
+ *     (RED, IR, ambient), then grants the first credits
+ *   - the link task (PPG_Sim_ReceiveStep()) drains the bytes of the UART
+ *     receive engine (uart_rx.h) in bulk, parses the DATA frames and
+ *     queues their periods in a FIFO of PPG_SIM_FIFO_PERIODS
+ *   - the MCU stays the timing master: every TIM9 tick takes one period
+ *     from the FIFO into the acquisition path (PPG_AcquireFromISR()),
+ *     exactly like an ADC scan
+ *   - CREDIT frames return the room freed, every PPG_SIM_CREDIT_BATCH
+ *     periods and at least every 100 ms
+ *
+ * Lost DATA frames show as sequence gaps and skipped period indexes;
+ * their periods are counted and never waited for. Counters are in
+ * ppg_sim_stats (JScope). The timing integrity of the session
+ * (ppg_integrity.h) goes to the PC in REPORT frames (PPG_Sim_Report()).
+ ******************************************************************************
+ */
+
+#ifndef PPG_SIM_H
+#define PPG_SIM_H
+
+#include "main.h"
+#include "ppg_integrity.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Sample periods queued between the UART and the sample tick (power of two) */
+#define PPG_SIM_FIFO_PERIODS    256U
+
+/** Periods consumed before a CREDIT frame is sent */
+#define PPG_SIM_CREDIT_BATCH    (PPG_SIM_FIFO_PERIODS / 4U)
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Link counters of the current session */
+typedef struct
+{
+    uint32_t frames;        /**< DATA frames received */
+    uint32_t periods;       /**< Sample periods handed to the acquisition path */
+    uint32_t lost_frames;   /**< DATA frames missing (sequence gaps) */
+    uint32_t lost_periods;  /**< Sample periods missing (index gaps) */
+    uint32_t crc_errors;    /**< Frames rejected by the parser */
+    uint32_t underruns;     /**< Sample ticks with an empty FIFO */
+    uint32_t overflows;     /**< Periods dropped on a full FIFO (credit violation) */
+    uint32_t uart_errors;   /**< UART errors and receive ring overruns (uart_rx.h) */
+} PPG_SimStats_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public data (visible for JLink / JScope)                                   */
+/* ------------------------------------------------------------------------- */
+
+extern volatile PPG_SimStats_t ppg_sim_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bind the link UART (transmit side).
+ *
+ * @param[in] uart UART shared with the simulation script; its reception
+ *                 runs through UartRx_Start().
+ */
+void PPG_Sim_Init(UART_HandleTypeDef *uart);
+
+/**
+ * @brief Start a session: send START; the link task then clears the FIFO.
+ *
+ * @param[in] periods Nominal session length [sample periods].
+ * @param[in] rate_hz Sample periods per second (TIM9 tick rate).
+ */
+void PPG_Sim_Start(uint32_t periods, uint32_t rate_hz);
+
+/**
+ * @brief End the session: STOP is sent at the next sample tick.
+ */
+void PPG_Sim_Stop(void);
+
+/**
+ * @brief Queue a REPORT frame with the integrity statistics.
+ *
+ * Sent at a later sample tick, when no CREDIT is due; a report still
+ * pending is replaced. A report queued before PPG_Sim_Stop() goes out
+ * ahead of STOP.
+ *
+ * @param[in] stats   Integrity statistics (copy).
+ * @param[in] tick_hz Frequency of their timestamps.
+ */
+void PPG_Sim_Report(const PPG_Integrity_t *stats, uint32_t tick_hz);
+
+/**
+ * @brief Parse the received bytes and queue the periods of DATA frames.
+ *
+ * Blocks until bytes arrive (uart_rx.h).
+ *
+ * @note Intended for use inside the FreeRTOS link task.
+ */
+void PPG_Sim_ReceiveStep(void);
+
+/**
+ * @brief Hand one queued period to the acquisition path and send credits.
+ *
+ * @param[in] clock Sample clock (TIM9 period count) of this tick.
+ *
+ * @note Call from the TIM9 period elapsed interrupt.
+ */
+void PPG_Sim_TickFromISR(uint32_t clock);
+
+#endif /* PPG_SIM_H */
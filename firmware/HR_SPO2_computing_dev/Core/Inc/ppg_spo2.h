@@ -0,0 +1,129 @@
+/**
+ ******************************************************************************
+ * @file    ppg_spo2.h
+ * @author  A. Bellina
+ * @brief   Streaming SpO2 estimation (ratio-of-ratios).
+ *
+ * @details
+ * Computes SpO2 beat by beat without storing the RED/IR signals:
+ *   - DC: first-order IIR low-pass of the raw ADC signal per channel
+ *     (time constant PPG_SPO2_DC_TAU_MS)
+ *   - AC: peak-to-trough of the band-passed signal over each beat,
+ *     delimited by the beat detector
+ *   - R = (AC_red / DC_red) / (AC_ir / DC_ir), converted to SpO2 through
+ *     a calibration table with linear interpolation
+ *
+ * Channels may be acquired simultaneously or in alternating windows: each
+ * channel keeps its last complete-beat AC/DC, and a new SpO2 value is
+ * published at every beat once both channels have one.
+ ******************************************************************************
+ */
+
+#ifndef PPG_SPO2_H
+#define PPG_SPO2_H
+
+#include "ppg_filter_bank.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** DC tracking IIR time constant [ms] */
+#define PPG_SPO2_DC_TAU_MS       1500U
+
+/** Lowest DC level accepted for a ratio [ADC counts] */
+#define PPG_SPO2_MIN_DC          64.0f
+
+/** Calibration table: R from 0 to (PPG_SPO2_CAL_POINTS - 1) * PPG_SPO2_CAL_STEP */
+#define PPG_SPO2_CAL_POINTS      21U
+#define PPG_SPO2_CAL_STEP        0.1f
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Per-channel AC/DC tracker */
+typedef struct
+{
+    float    dc;          /**< IIR low-pass of the raw signal [ADC counts] */
+    float    ac;          /**< Peak-to-trough of the last complete beat [ADC counts] */
+    int16_t  beat_max;    /**< Band-passed maximum in the current beat (Q15) */
+    int16_t  beat_min;    /**< Band-passed minimum in the current beat (Q15) */
+    uint32_t samples;     /**< Samples received in the current beat */
+    bool     dc_valid;    /**< dc initialized */
+    bool     ac_valid;    /**< ac holds a complete beat */
+    bool     partial;     /**< Current beat started before a discard: not usable */
+} PPG_SpO2_Channel_t;
+
+/** SpO2 engine state (RED and IR channels) */
+typedef struct
+{
+    PPG_SpO2_Channel_t red;
+    PPG_SpO2_Channel_t ir;
+    float              dc_alpha;   /**< IIR coefficient 1 - exp(-1 / (fs * tau)) */
+} PPG_SpO2_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Initialize the SpO2 engine.
+ *
+ * @param[out] spo2  Engine state.
+ * @param[in]  fs_hz Sampling rate of each channel [Hz].
+ */
+void PPG_SpO2_Init(PPG_SpO2_t *spo2, uint16_t fs_hz);
+
+/**
+ * @brief Forget all AC/DC estimates.
+ *
+ * @param[in,out] spo2 Engine state.
+ */
+void PPG_SpO2_Reset(PPG_SpO2_t *spo2);
+
+/**
+ * @brief Push one sample of a channel.
+ *
+ * @param[in,out] spo2     Engine state.
+ * @param[in]     channel  PPG_CH_RED or PPG_CH_IR (others are ignored).
+ * @param[in]     raw      Raw 12-bit ADC sample (for DC).
+ * @param[in]     bandpass Band-passed sample, Q15 (for AC).
+ */
+void PPG_SpO2_Update(PPG_SpO2_t *spo2, PPG_Channel_t channel, uint16_t raw, int16_t bandpass);
+
+/**
+ * @brief Mark the current beat of a channel as incomplete.
+ *
+ * Call when a channel (re)starts in the middle of a beat, e.g. after an
+ * LED/window switch, so its partial peak-to-trough is not used.
+ *
+ * @param[in,out] spo2    Engine state.
+ * @param[in]     channel PPG_CH_RED or PPG_CH_IR.
+ */
+void PPG_SpO2_Discard(PPG_SpO2_t *spo2, PPG_Channel_t channel);
+
+/**
+ * @brief Close the current beat and compute SpO2.
+ *
+ * @param[in,out] spo2    Engine state.
+ * @param[out]    percent SpO2 [%] (written only on success).
+ * @param[out]    ratio   Ratio of ratios R (written only on success, may be NULL).
+ *
+ * @retval true  A new SpO2 value is available.
+ * @retval false AC/DC not yet known for both channels.
+ */
+bool PPG_SpO2_OnBeat(PPG_SpO2_t *spo2, float *percent, float *ratio);
+
+/**
+ * @brief Convert a ratio of ratios to SpO2 with the calibration table.
+ *
+ * @param[in] ratio R = (AC_red / DC_red) / (AC_ir / DC_ir).
+ *
+ * @return SpO2 [%], clamped to 0..100.
+ */
+float PPG_SpO2_FromRatio(float ratio);
+
+#endif /* PPG_SPO2_H */
@@ -0,0 +1,160 @@
+/**
+ ******************************************************************************
+ * @file    sd_spi.h
+ * @author  A. Bellina
+ * @brief   SD card block driver over SPI with DMA (FatFs drive, user_diskio.c).
+ *
+ * @details
+ * SD (v1, v2 standard and high capacity) cards in SPI mode on SPI2, chip
+ * select on a GPIO:
+ *   - identification (CMD0, CMD8, ACMD41, CMD58) at SD_SPI_INIT_HZ, then
+ *     the clock is switched to the fastest rate up to SD_SPI_FAST_HZ
+ *   - several sectors per command: CMD18 reads until CMD12, CMD25 writes
+ *     until the stop token, announced by ACMD23 so the card can pre-erase
+ *     the blocks it is about to write
+ *   - every 512-byte data block moves by DMA (SPI2 RX / TX streams); the
+ *     calling task blocks on a task notification until the transfer ends
+ *   - waits for the card (busy after a write, data token before a read)
+ *     probe a few bytes, then block the calling task one RTOS tick between
+ *     probes instead of spinning: programming a block takes milliseconds
+ *   - after a write the card is left programming; the next command (or
+ *     SdSpi_Sync()) waits for it, so the caller overlaps that time
+ *
+ * Calls are made from one task at a time (FatFs serialises the volume,
+ * _FS_REENTRANT); not from an ISR or before the scheduler runs.
+ ******************************************************************************
+ */
+
+#ifndef SD_SPI_H
+#define SD_SPI_H
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Sector (data block) size [bytes] */
+#define SD_SPI_SECTOR_SIZE     512U
+
+/** SPI clock during identification [Hz] (100..400 kHz) */
+#define SD_SPI_INIT_HZ         400000U
+
+/** Highest SPI clock after identification [Hz] (default speed cards: 25 MHz) */
+#ifndef SD_SPI_FAST_HZ
+#define SD_SPI_FAST_HZ         25000000U
+#endif
+
+/** Bytes probed before a wait blocks the calling task */
+#define SD_SPI_SPIN_BYTES      32U
+
+/** Timeouts [ms] */
+#define SD_SPI_INIT_TIMEOUT_MS   1000U   /**< ACMD41 until the card leaves idle */
+#define SD_SPI_READ_TIMEOUT_MS   200U    /**< Data token of a read block */
+#define SD_SPI_BUSY_TIMEOUT_MS   500U    /**< Card busy (programming, before a command) */
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Card generations */
+typedef enum
+{
+    SD_SPI_CARD_NONE = 0,
+    SD_SPI_CARD_SDV1,           /**< SD 1.x, byte addressed */
+    SD_SPI_CARD_SDV2,           /**< SD 2.0+ standard capacity, byte addressed */
+    SD_SPI_CARD_SDHC            /**< SDHC / SDXC, block addressed */
+} SdSpi_Card_t;
+
+/** Transfer counters since SdSpi_Init() */
+typedef struct
+{
+    uint32_t read_cmds;         /**< CMD17 / CMD18 issued */
+    uint32_t write_cmds;        /**< CMD24 / CMD25 issued */
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t busy_blocks;       /**< RTOS ticks the caller was blocked waiting for the card */
+    uint32_t errors;            /**< Commands rejected, tokens missing, timeouts */
+} SdSpi_Stats_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Bind the SPI (with RX / TX DMA linked) and the chip select pin.
+ *
+ * The card is not accessed: SdSpi_InitCard() identifies it.
+ *
+ * @param[in] spi     SPI master, 8-bit, mode 0, software NSS.
+ * @param[in] cs_port Chip select port.
+ * @param[in] cs_pin  Chip select pin (output, high = deselected).
+ *
+ * @return false if an argument is missing.
+ */
+bool SdSpi_Init(SPI_HandleTypeDef *spi, GPIO_TypeDef *cs_port, uint16_t cs_pin);
+
+/**
+ * @brief Identify the card, read its size, switch to the fast clock.
+ *
+ * @return true if a card is ready for transfers.
+ */
+bool SdSpi_InitCard(void);
+
+/**
+ * @brief Card generation, SD_SPI_CARD_NONE until SdSpi_InitCard() succeeds.
+ */
+SdSpi_Card_t SdSpi_GetCardType(void);
+
+/**
+ * @brief Read consecutive sectors (CMD17, or CMD18 + CMD12).
+ *
+ * @param[out] buf    count * SD_SPI_SECTOR_SIZE bytes.
+ * @param[in]  sector First sector (LBA).
+ * @param[in]  count  Sectors.
+ *
+ * @return false on a card error or timeout.
+ */
+bool SdSpi_Read(uint8_t *buf, uint32_t sector, uint32_t count);
+
+/**
+ * @brief Write consecutive sectors (CMD24, or ACMD23 + CMD25 + stop token).
+ *
+ * Returns once the card has accepted the last block; it may still be
+ * programming (SdSpi_Sync()).
+ *
+ * @param[in] buf    count * SD_SPI_SECTOR_SIZE bytes.
+ * @param[in] sector First sector (LBA).
+ * @param[in] count  Sectors.
+ *
+ * @return false on a card error or timeout.
+ */
+bool SdSpi_Write(const uint8_t *buf, uint32_t sector, uint32_t count);
+
+/**
+ * @brief Wait until the card has finished programming.
+ *
+ * @return false on timeout.
+ */
+bool SdSpi_Sync(void);
+
+/**
+ * @brief Card capacity [sectors], 0 before SdSpi_InitCard().
+ */
+uint32_t SdSpi_GetSectorCount(void);
+
+/**
+ * @brief Erase block (allocation unit) size [sectors], 1 if unknown.
+ */
+uint32_t SdSpi_GetEraseBlock(void);
+
+/**
+ * @brief Copy the transfer counters.
+ *
+ * @param[out] stats Counters since SdSpi_Init().
+ */
+void SdSpi_GetStats(SdSpi_Stats_t *stats);
+
+#endif /* SD_SPI_H */
@@ -0,0 +1,98 @@
+/**
+ ******************************************************************************
+ * @file    uart_rx.h
+ * @author  A. Bellina
+ * @brief   UART receive engine: circular DMA with idle-line events.
+ *
+ * @details
+ * The receiver DMA runs continuously in circular mode over a byte ring of
+ * UART_RX_RING_SIZE bytes (HAL_UARTEx_ReceiveToIdle_DMA): no transfer is
+ * ever re-armed, so no byte can arrive while reception is stopped.
+ *
+ * The half-transfer, transfer-complete and idle-line events publish the
+ * DMA write position as a free-running byte count and wake the reader
+ * task. The reader then gets the received bytes in place, in at most two
+ * contiguous spans per lap, and consumes them in bulk:
+ *
+ *   n = UartRx_Wait(&data, timeout);   parse data[0..n-1]
+ *   UartRx_Consume(n);
+ *
+ * One interrupt per burst (idle line) or per half ring, instead of one
+ * per byte or per transfer. Single reader task.
+ *
+ * Bytes stay valid until the DMA comes round again: the reader must keep
+ * up within UART_RX_RING_SIZE byte times (89 ms at 115200 baud with 1024
+ * bytes). A reader that falls a whole lap behind loses what it has not
+ * read (counted as an overrun); a UART error restarts the DMA on the next
+ * lap (counted as an error). Either way the stream resumes by itself.
+ ******************************************************************************
+ */
+
+#ifndef UART_RX_H
+#define UART_RX_H
+
+#include "stm32f4xx_hal.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** DMA ring size [bytes], power of two */
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE      1024U
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Receive counters since UartRx_Start() */
+typedef struct
+{
+    uint32_t bytes;      /**< Bytes received */
+    uint32_t events;     /**< DMA half / full and idle-line interrupts */
+    uint32_t overruns;   /**< Reader a whole ring behind: unread bytes lost */
+    uint32_t errors;     /**< UART overrun / framing / noise errors (DMA restarted) */
+} UartRx_Stats_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Start the circular reception (DMA stream in circular mode).
+ *
+ * @param[in] uart UART with a linked RX DMA stream.
+ *
+ * @return true if the reception is running.
+ */
+bool UartRx_Start(UART_HandleTypeDef *uart);
+
+/**
+ * @brief Wait for received bytes (task context, single reader).
+ *
+ * @param[out] data       First unread byte, in the DMA ring.
+ * @param[in]  timeout_ms Maximum wait [ms] (osWaitForever to block).
+ *
+ * @return Unread bytes contiguous from data, 0 on timeout. More may be
+ *         pending past the end of the ring: call again after consuming.
+ */
+uint32_t UartRx_Wait(const uint8_t **data, uint32_t timeout_ms);
+
+/**
+ * @brief Release bytes returned by UartRx_Wait().
+ *
+ * @param[in] n Bytes read, at most the count returned.
+ */
+void UartRx_Consume(uint32_t n);
+
+/**
+ * @brief Copy the receive counters.
+ *
+ * @param[out] stats Counters since UartRx_Start().
+ */
+void UartRx_GetStats(UartRx_Stats_t *stats);
+
+#endif /* UART_RX_H */
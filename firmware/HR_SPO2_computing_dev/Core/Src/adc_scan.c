@@ -0,0 +1,196 @@
+/**
+ ******************************************************************************
+ * @file    adc_scan.c
+ * @brief   Scan-mode ADC manager implementation.
+ ******************************************************************************
+ */
+
+#include "adc_scan.h"
+#include <stddef.h>
+
+#define ADC_SCAN_HALF_SAMPLES   (ADC_SCAN_HALF_SCANS * ADC_SCAN_RANKS)
+
+_Static_assert((ADC_SCAN_HALF_SCANS % ADC_SCAN_PHASES) == 0U,
+               "ADC_SCAN_HALF_SCANS must be a multiple of ADC_SCAN_PHASES");
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static ADC_HandleTypeDef *scan_adc     = NULL;
+static TIM_HandleTypeDef *scan_trigger = NULL;
+static uint32_t           scan_channel = 0;
+
+static AdcScan_Listener_t scan_listeners[ADC_SCAN_MAX_LISTENERS];
+static uint32_t           scan_listener_count = 0;
+
+/* Circular DMA target: two halves of ADC_SCAN_HALF_SCANS interleaved scans */
+static uint16_t scan_buffer[2U * ADC_SCAN_HALF_SAMPLES] __attribute__((aligned(4)));
+
+static volatile uint32_t scan_blocks = 0;          /* Completed halves since start */
+static volatile const uint16_t *scan_last = NULL;   /* Last completed half */
+static volatile uint32_t scan_errors = 0;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** Hand one completed half to every listener (DMA ISR context) */
+static void AdcScan_Dispatch(const uint16_t *half)
+{
+    AdcScan_Block_t block;
+
+    block.data  = half;
+    block.scans = ADC_SCAN_HALF_SCANS;
+    block.first = scan_blocks * ADC_SCAN_HALF_SCANS;
+
+    scan_last = half;
+    scan_blocks++;
+
+    for (uint32_t i = 0; i < scan_listener_count; i++)
+        scan_listeners[i](&block);
+}
+
+/**
+ * Stop, realign the LED phases, then start the circular DMA and the
+ * trigger timer from 0; the first block gets index `first_block`.
+ */
+static bool AdcScan_Run(uint32_t first_block)
+{
+    if ((scan_adc == NULL) || (scan_trigger == NULL))
+        return false;
+
+    AdcScan_Stop();
+
+    scan_blocks = first_block;
+    scan_last   = NULL;
+    __HAL_TIM_SET_COUNTER(scan_trigger, 0);
+
+    if (!LedPhase_Rewind() ||
+        (HAL_ADC_Start_DMA(scan_adc, (uint32_t *)scan_buffer, 2U * ADC_SCAN_HALF_SAMPLES) != HAL_OK))
+    {
+        scan_errors++;
+        return false;
+    }
+
+    if (HAL_TIM_PWM_Start(scan_trigger, scan_channel) != HAL_OK)
+    {
+        HAL_ADC_Stop_DMA(scan_adc);
+        scan_errors++;
+        return false;
+    }
+
+    return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void AdcScan_Init(ADC_HandleTypeDef *adc, TIM_HandleTypeDef *trigger, uint32_t channel)
+{
+    scan_adc     = adc;
+    scan_trigger = trigger;
+    scan_channel = channel;
+    scan_errors  = 0;
+}
+
+bool AdcScan_AddListener(AdcScan_Listener_t listener)
+{
+    if ((listener == NULL) || (scan_listener_count >= ADC_SCAN_MAX_LISTENERS))
+        return false;
+
+    scan_listeners[scan_listener_count++] = listener;
+    return true;
+}
+
+bool AdcScan_Start(void)
+{
+    return AdcScan_Run(0U);
+}
+
+void AdcScan_Stop(void)
+{
+    if ((scan_adc == NULL) || (scan_trigger == NULL))
+        return;
+
+    /* Without trigger no conversion happens, even if the ADC stop fails */
+    HAL_TIM_PWM_Stop(scan_trigger, scan_channel);
+    HAL_ADC_Stop_DMA(scan_adc);
+}
+
+AdcScan_View_t AdcScan_GetView(const AdcScan_Block_t *block, AdcScan_Rank_t rank)
+{
+    AdcScan_View_t view;
+
+    view.base   = &block->data[rank];
+    view.stride = ADC_SCAN_RANKS;
+    view.count  = block->scans;
+
+    return view;
+}
+
+AdcScan_View_t AdcScan_GetPhaseView(const AdcScan_Block_t *block, AdcScan_Rank_t rank,
+                                    LedPhase_t phase)
+{
+    AdcScan_View_t view;
+
+    /* Blocks start on phase 0 (ADC_SCAN_HALF_SCANS multiple of the phases) */
+    view.base   = &block->data[(uint32_t)phase * ADC_SCAN_RANKS + rank];
+    view.stride = ADC_SCAN_RANKS * ADC_SCAN_PHASES;
+    view.count  = block->scans / ADC_SCAN_PHASES;
+
+    return view;
+}
+
+bool AdcScan_Latest(AdcScan_Rank_t rank, uint16_t *value)
+{
+    const uint16_t *half = (const uint16_t *)scan_last;
+
+    if ((half == NULL) || ((uint32_t)rank >= ADC_SCAN_RANKS))
+        return false;
+
+    /* Last scan of the last completed half: not rewritten for a half period */
+    *value = half[(ADC_SCAN_HALF_SCANS - 1U) * ADC_SCAN_RANKS + rank] & 0x0FFFU;
+    return true;
+}
+
+uint32_t AdcScan_GetBlockCount(void)
+{
+    return scan_blocks;
+}
+
+uint32_t AdcScan_GetErrors(void)
+{
+    return scan_errors;
+}
+
+/* ------------------------------------------------------------------------- */
+/* ADC DMA ISR hooks                                                         */
+/* ------------------------------------------------------------------------- */
+
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc == scan_adc)
+        AdcScan_Dispatch(&scan_buffer[0]);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc == scan_adc)
+        AdcScan_Dispatch(&scan_buffer[ADC_SCAN_HALF_SAMPLES]);
+}
+
+/*
+ * Overrun (ADC IRQ) or DMA transfer error: the DMA has stopped. Restart
+ * the scan; the half being filled is lost, so the block index skips it
+ * and the listeners see the periods missing (acquisition gap).
+ */
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc)
+{
+    if (hadc != scan_adc)
+        return;
+
+    scan_errors++;
+    (void)AdcScan_Run(scan_blocks + 1U);
+}
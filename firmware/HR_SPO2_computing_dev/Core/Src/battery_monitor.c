@@ -7,41 +7,58 @@
 
 
 #include "battery_monitor.h"
+#include "adc_scan.h"
 
-static ADC_HandleTypeDef *hadc_private;
 static GPIO_TypeDef *led_port_private;
 static uint16_t led_pin_private;
 
+static BatteryMonitor_Reading_t last_reading;
+static uint32_t last_block = 0;     /* AdcScan_GetBlockCount() at the last fresh reading */
+static bool     have_block = false; /* last_block is valid */
+
 #define BATTERY_THRESHOLD 3354  // to configure better in future versions
 
 
 
-void BatteryMonitor_Init(ADC_HandleTypeDef *adc, GPIO_TypeDef *ledPort, uint16_t ledPin)
+void BatteryMonitor_Init(GPIO_TypeDef *ledPort, uint16_t ledPin)
 {
-    hadc_private = adc;
     led_port_private = ledPort;
     led_pin_private = ledPin;
+
+    last_reading.raw   = 0;
+    last_reading.stale = true;
+    last_reading.low   = false;
+    last_block = 0;
+    have_block = false;
 }
 
 
 
-void BatteryMonitor_Update(void)
+BatteryMonitor_Reading_t BatteryMonitor_Update(void)
 {
-    uint32_t adcValue = 0;
+    uint16_t adcValue = 0;
+    uint32_t block = AdcScan_GetBlockCount();
 
-    HAL_ADC_Start(hadc_private);
+    /* Latest battery rank of the ADC scan: no conversion to start or wait for.
+     * Same block as last time (scan stopped) or none since a restart: stale */
+    bool fresh = AdcScan_Latest(ADC_SCAN_BATTERY, &adcValue) &&
+                 (!have_block || (block != last_block));
 
-    if (HAL_ADC_PollForConversion(hadc_private, HAL_MAX_DELAY) == HAL_OK)
+    if (fresh)
     {
-        adcValue = HAL_ADC_GetValue(hadc_private);
-
-        if (adcValue < BATTERY_THRESHOLD)
-            HAL_GPIO_WritePin(led_port_private, led_pin_private, GPIO_PIN_SET);
-        else
-            HAL_GPIO_WritePin(led_port_private, led_pin_private, GPIO_PIN_RESET);
+        last_reading.raw = adcValue;
+        last_reading.low = (adcValue < BATTERY_THRESHOLD);
+        last_block = block;
+        have_block = true;
     }
+    last_reading.stale = !fresh;
+
+    if (last_reading.stale || last_reading.low)
+        HAL_GPIO_WritePin(led_port_private, led_pin_private, GPIO_PIN_SET);
+    else
+        HAL_GPIO_WritePin(led_port_private, led_pin_private, GPIO_PIN_RESET);
 
-    HAL_ADC_Stop(hadc_private);
+    return last_reading;
 }
 
-/*End of file*/
\ No newline at end of file
+/*End of file*/
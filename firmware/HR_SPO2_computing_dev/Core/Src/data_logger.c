@@ -0,0 +1,521 @@
+/**
+ ******************************************************************************
+ * @file    data_logger.c
+ * @brief   Session logger implementation.
+ ******************************************************************************
+ */
+
+#include "data_logger.h"
+#include "ppg_processing.h"
+#include "ppg_log_format.h"
+#include "ppg_profile.h"
+#include "led_phase.h"
+#include "fatfs.h"
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+#include <stdio.h>
+#include <string.h>
+
+#if ((DATALOG_BUFFER_SECTORS & (DATALOG_BUFFER_SECTORS - 1U)) != 0U)
+#error "DATALOG_BUFFER_SECTORS must be a power of two"
+#endif
+
+_Static_assert((PPG_LOG_HEADER_SIZE + PPG_LOG_FRAME_MAX + PPG_LOG_END_SIZE) <= DATALOG_BUFFER_SIZE,
+               "the first frame of a session must fit in one buffer");
+
+/** Buffer flags */
+#define DATALOG_BUF_OPEN       (1UL << 0)   /* First buffer of a session: new file */
+#define DATALOG_BUF_CLOSE      (1UL << 1)   /* Last buffer of a session (may be partial) */
+
+/** Fast seek table: length, then (run length, start cluster) pairs and a terminator */
+#define DATALOG_CLMT_LENGTH    8U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+    uint8_t  data[DATALOG_BUFFER_SIZE];
+    uint32_t len;               /* Log bytes */
+    uint32_t flags;             /* DATALOG_BUF_* */
+    uint32_t session_bytes;     /* Allocation of the file (DATALOG_BUF_OPEN) */
+} DataLog_Buffer_t;
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+volatile DataLogger_Stats_t datalog_stats;
+
+static DataLog_Buffer_t log_buffers[DATALOG_BUFFERS];
+
+/* Buffer ownership: free -> packer -> full -> writer -> free */
+static QueueHandle_t free_queue = NULL;
+static QueueHandle_t full_queue = NULL;
+
+/* Packer */
+static DataLog_Buffer_t *fill = NULL;
+static bool     pack_open         = false;
+static bool     pack_open_pending = false;  /* No buffer carries DATALOG_BUF_OPEN yet */
+static uint32_t pack_expected     = 0;
+static uint32_t pack_last_frame   = 0;
+static uint32_t pack_session_bytes = 0;
+static bool     pack_header_pending = false;   /* Session header not packed yet */
+static PPG_LogHeader_t  pack_header;
+static PPG_LogEncoder_t pack_enc;
+static uint8_t          pack_scratch[PPG_LOG_FRAME_MAX];
+static PPG_LogIndex_t   pack_index;
+static uint32_t         pack_bytes = 0;         /* Log bytes of the session so far */
+
+/* Writer */
+static FIL *const log_file = &USERFile;
+static bool       log_mounted   = false;
+static bool       log_file_open = false;
+static uint32_t   log_index     = 0;        /* Number of the next file */
+static uint32_t   log_bytes     = 0;        /* Log bytes in the open file */
+static TickType_t log_last_sync = 0;
+static DWORD      log_clmt[DATALOG_CLMT_LENGTH];
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers: packer                                                   */
+/* ------------------------------------------------------------------------- */
+
+/** Buffer being filled, taken from the free queue without waiting */
+static DataLog_Buffer_t *DataLogger_Fill(void)
+{
+    if ((fill == NULL) && (xQueueReceive(free_queue, &fill, 0) != pdPASS))
+        return NULL;
+
+    if (pack_open_pending)
+    {
+        fill->flags        |= DATALOG_BUF_OPEN;
+        fill->session_bytes = pack_session_bytes;
+        pack_open_pending   = false;
+    }
+
+    return fill;
+}
+
+/** Same, waiting for the writer to free one (end of a session only) */
+static DataLog_Buffer_t *DataLogger_FillWait(void)
+{
+    if (fill == NULL)
+        (void)xQueueReceive(free_queue, &fill, portMAX_DELAY);
+
+    return DataLogger_Fill();
+}
+
+static void DataLogger_Handoff(void)
+{
+    /* Never full: it holds at most every buffer */
+    (void)xQueueSend(full_queue, &fill, 0);
+    fill = NULL;
+}
+
+/** Append to the log, across buffers (space checked by the caller while the session runs) */
+static void DataLogger_Put(const void *data, uint32_t len)
+{
+    const uint8_t *src = data;
+
+    pack_bytes += len;
+
+    while (len > 0U)
+    {
+        DataLog_Buffer_t *buf = DataLogger_FillWait();
+        uint32_t n = DATALOG_BUFFER_SIZE - buf->len;
+
+        if (n > len)
+            n = len;
+
+        memcpy(&buf->data[buf->len], src, n);
+        buf->len += n;
+        src      += n;
+        len      -= n;
+
+        if (buf->len == DATALOG_BUFFER_SIZE)
+            DataLogger_Handoff();
+    }
+}
+
+/** The frame's samples as raw 16-bit values: the compression reference */
+static uint32_t DataLogger_RawSize(const PPG_Frame_t *frame)
+{
+    uint32_t channels = (uint32_t)__builtin_popcount(frame->channel_mask & (PPG_CH_MASK(PPG_CH_COUNT) - 1U));
+
+    return channels * frame->count * 2U;
+}
+
+static void DataLogger_PackFrame(const PPG_Frame_t *frame)
+{
+    uint8_t          header[PPG_LOG_HEADER_SIZE];
+    PPG_LogEncoder_t saved = pack_enc;
+    uint32_t         head  = 0;
+
+    if (pack_header_pending)
+    {
+        PPG_Log_EncodeHeader(header, &pack_header);
+        PPG_LogEncoder_Init(&pack_enc, &pack_header);
+        saved = pack_enc;
+        head  = PPG_LOG_HEADER_SIZE;
+    }
+
+    PPG_PROFILE_BEGIN(PPG_PROF_LOG_ENCODE);
+    uint32_t          len = (uint32_t)PPG_LogEncoder_Frame(&pack_enc, frame, pack_scratch);
+    PPG_PROFILE_END(PPG_PROF_LOG_ENCODE);
+
+    DataLog_Buffer_t *buf = DataLogger_Fill();
+
+    /* Room for the frame and the end of its block; the spill-over needs the next buffer free as well */
+    if ((buf == NULL) ||
+        (((head + len + PPG_LOG_END_SIZE) > (DATALOG_BUFFER_SIZE - buf->len)) &&
+         (uxQueueMessagesWaiting(free_queue) == 0U)))
+    {
+        pack_enc = saved;
+        datalog_stats.frames_dropped++;
+        return;
+    }
+
+    if (pack_header_pending)
+    {
+        DataLogger_Put(header, head);
+        pack_header_pending = false;
+    }
+
+    PPG_LogIndex_Frame(&pack_index, &pack_enc, pack_bytes, frame);
+    DataLogger_Put(pack_scratch, len);
+    datalog_stats.frames++;
+    datalog_stats.raw_bytes += DataLogger_RawSize(frame);
+}
+
+/** Session header from the rate profile, the LED timing and the first frame */
+static void DataLogger_FillHeader(const PPG_RateConfig_t *cfg, const PPG_Frame_t *frame)
+{
+    PPG_LogHeader_t *h = &pack_header;
+
+    memset(h, 0, sizeof(*h));
+    h->version       = PPG_LOG_VERSION;
+    h->capture_hz    = cfg->capture_hz;
+    h->acq_hz        = cfg->acq_hz;
+    h->total_samples = cfg->total_samples;
+    h->start_ms      = (uint32_t)xTaskGetTickCount() * portTICK_PERIOD_MS;
+    h->ppg_fs        = PPG_FS;
+    h->frame_samples = cfg->frame_samples;
+    h->channel_mask  = frame->channel_mask;
+    h->flags         = PPG_LOG_FLAG_ORDER(PPG_LOG_PREDICTOR_ORDER) |
+                       ((PPG_LOG_BANDPASS != 0U) ? PPG_LOG_FLAG_BANDPASS : 0U);
+    strncpy(h->build, PPG_BUILD_ID, PPG_LOG_BUILD_SIZE);
+
+#ifdef USE_SIMULATION
+    h->flags |= PPG_LOG_FLAG_SIMULATION;
+#else
+    /* GPIO-switched LEDs: fully on for one phase of each acquisition period */
+    LedPhase_Timing_t t;
+
+    if (LedPhase_GetTiming(cfg->acq_hz, cfg->timer_clock_hz, &t))
+    {
+        uint64_t ticks = ((uint64_t)t.period + 1U) * ((uint64_t)t.prescaler + 1U);
+        uint16_t us    = (uint16_t)((ticks * 1000000U) / cfg->timer_clock_hz);
+
+        for (uint32_t i = 0; i < 2U; i++)
+        {
+            h->led_us[i]    = us;
+            h->led_level[i] = 1000U;
+        }
+    }
+#endif
+}
+
+static bool DataLogger_BeginSession(const PPG_Frame_t *frame)
+{
+    const PPG_RateConfig_t *cfg = PPG_GetRateConfig();
+
+    if ((cfg == NULL) || (cfg->frame_samples == 0U))
+        return false;
+
+    /*
+     * Allocation for every frame of the session with all channels, at two
+     * bytes a sample (deltas within +-8191) plus the frame overhead, and
+     * the index; a noisier session extends the file past it
+     */
+    uint32_t frames = (cfg->total_samples + cfg->frame_samples - 1U) / cfg->frame_samples;
+    uint32_t per_frame = DATALOG_FRAME_OVERHEAD + (PPG_CH_COUNT * cfg->frame_samples * 2U);
+    uint32_t bytes  = PPG_LOG_HEADER_SIZE + (frames * per_frame) + PPG_LOG_INDEX_MAX_SIZE;
+
+    pack_session_bytes = (bytes + DATALOG_BUFFER_SIZE - 1U) & ~(DATALOG_BUFFER_SIZE - 1U);
+    pack_last_frame    = frames - 1U;
+    pack_expected      = 0;
+    pack_open          = true;
+    pack_open_pending  = true;
+    pack_header_pending = true;
+    pack_bytes         = 0;
+
+    PPG_LogIndex_Init(&pack_index);
+    DataLogger_FillHeader(cfg, frame);
+    return true;
+}
+
+static void DataLogger_EndSession(void)
+{
+    uint8_t              end[PPG_LOG_END_SIZE];
+    uint8_t              piece[PPG_LOG_INDEX_PIECE_MAX];
+    PPG_LogIndexWriter_t w;
+    size_t               n;
+
+    pack_open = false;
+
+    /* Nothing packed: no file */
+    if (pack_open_pending)
+    {
+        pack_open_pending = false;
+        return;
+    }
+
+    /* The writer always gives buffers back: short waits, session over */
+    DataLogger_Put(end, (uint32_t)PPG_LogEncoder_End(&pack_enc, end));
+
+    /* Index and trailer after the last block */
+    PPG_LogIndex_Finish(&pack_index, &w, pack_header.crc, pack_bytes);
+    while ((n = PPG_LogIndex_Encode(&pack_index, &w, piece)) > 0U)
+        DataLogger_Put(piece, (uint32_t)n);
+
+    DataLogger_FillWait()->flags |= DATALOG_BUF_CLOSE;
+    DataLogger_Handoff();
+}
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers: writer                                                   */
+/* ------------------------------------------------------------------------- */
+
+/** File number of PPGnnnnn.BIN, or -1 */
+static int32_t DataLogger_ParseIndex(const char *name)
+{
+    int32_t n = 0;
+
+    if (strncmp(name, "PPG", 3U) != 0)
+        return -1;
+
+    for (uint32_t i = 3U; i < 8U; i++)
+    {
+        if ((name[i] < '0') || (name[i] > '9'))
+            return -1;
+        n = (n * 10) + (name[i] - '0');
+    }
+
+    return (strcmp(&name[8], ".BIN") == 0) ? n : -1;
+}
+
+/** Mount the card once and number the next file after the existing logs */
+static bool DataLogger_Mount(void)
+{
+    DIR     dir;
+    FILINFO info;
+
+    if (log_mounted)
+        return true;
+
+    if (f_mount(&USERFatFS, USERPath, 1) != FR_OK)
+        return false;
+
+    log_index = 0;
+    if (f_opendir(&dir, USERPath) == FR_OK)
+    {
+        while ((f_readdir(&dir, &info) == FR_OK) && (info.fname[0] != '\0'))
+        {
+            int32_t n = DataLogger_ParseIndex(info.fname);
+
+            if ((n >= 0) && ((uint32_t)n >= log_index))
+                log_index = (uint32_t)n + 1U;
+        }
+        (void)f_closedir(&dir);
+    }
+
+    log_mounted = true;
+    return true;
+}
+
+static void DataLogger_OpenFile(uint32_t session_bytes)
+{
+    char name[20];
+
+    if (!DataLogger_Mount())
+    {
+        datalog_stats.errors++;
+        return;
+    }
+
+    snprintf(name, sizeof(name), "%sPPG%05lu.BIN", USERPath, (unsigned long)(log_index % 100000U));
+    log_index++;
+
+    if (f_open(log_file, name, FA_CREATE_NEW | FA_WRITE) != FR_OK)
+    {
+        /* Card removed or full: mount again at the next session */
+        log_mounted = false;
+        datalog_stats.errors++;
+        return;
+    }
+
+    /* One contiguous run mapped by the fast seek table: writes never touch the FAT */
+    log_file->cltbl = NULL;
+    if (f_expand(log_file, session_bytes, 1) == FR_OK)
+    {
+        log_clmt[0]     = DATALOG_CLMT_LENGTH;
+        log_file->cltbl = log_clmt;
+
+        if ((f_lseek(log_file, CREATE_LINKMAP) != FR_OK) || (f_lseek(log_file, 0) != FR_OK))
+            log_file->cltbl = NULL;
+    }
+    else
+    {
+        datalog_stats.fragmented++;
+    }
+
+    /* Allocation and directory entry on the card before the first data */
+    (void)f_sync(log_file);
+
+    log_file_open = true;
+    log_bytes     = 0;
+    log_last_sync = xTaskGetTickCount();
+    datalog_stats.sessions++;
+}
+
+static void DataLogger_CloseFile(void)
+{
+    /* Drop the padding of the last buffer and the unused allocation */
+    FRESULT res = f_lseek(log_file, log_bytes);
+
+    log_file->cltbl = NULL;
+    if (res == FR_OK)
+        res = f_truncate(log_file);
+
+    if ((f_close(log_file) != FR_OK) || (res != FR_OK))
+        datalog_stats.errors++;
+
+    log_file_open = false;
+}
+
+static void DataLogger_WriteBuffer(DataLog_Buffer_t *buf)
+{
+    /* Whole sectors: a partial last buffer is padded, truncated at the close */
+    uint32_t   size  = (buf->len + DATALOG_SECTOR_SIZE - 1U) & ~(DATALOG_SECTOR_SIZE - 1U);
+    TickType_t start = xTaskGetTickCount();
+    UINT       done  = 0;
+    UINT       more  = 0;
+
+    memset(&buf->data[buf->len], 0, size - buf->len);
+
+    FRESULT res = f_write(log_file, buf->data, size, &done);
+
+    /* Past the allocation: the rest extends the file on the FAT */
+    if ((res == FR_OK) && (done < size) && (log_file->cltbl != NULL))
+    {
+        log_file->cltbl = NULL;
+        res   = f_write(log_file, &buf->data[done], size - done, &more);
+        done += more;
+    }
+
+    if ((res != FR_OK) || (done != size))
+    {
+        datalog_stats.errors++;
+        DataLogger_CloseFile();
+        return;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    uint32_t   ms  = (uint32_t)(now - start) * portTICK_PERIOD_MS;
+
+    if (ms > datalog_stats.write_max_ms)
+        datalog_stats.write_max_ms = ms;
+
+    log_bytes += buf->len;
+    datalog_stats.buffers++;
+    datalog_stats.bytes += buf->len;
+
+    if ((now - log_last_sync) >= pdMS_TO_TICKS(DATALOG_SYNC_MS))
+    {
+        (void)f_sync(log_file);
+        log_last_sync = xTaskGetTickCount();
+        datalog_stats.syncs++;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool DataLogger_Init(void)
+{
+    if (free_queue == NULL)
+    {
+        free_queue = xQueueCreate(DATALOG_BUFFERS, sizeof(DataLog_Buffer_t *));
+        full_queue = xQueueCreate(DATALOG_BUFFERS, sizeof(DataLog_Buffer_t *));
+
+        if ((free_queue == NULL) || (full_queue == NULL))
+            return false;
+
+        for (uint32_t i = 0; i < DATALOG_BUFFERS; i++)
+        {
+            DataLog_Buffer_t *buf = &log_buffers[i];
+
+            (void)xQueueSend(free_queue, &buf, 0);
+        }
+    }
+
+    return true;
+}
+
+void DataLogger_PackStep(void)
+{
+    PPG_Frame_t *frame = PPG_ReceiveFrame(PPG_CONSUMER_LOGGER,
+                                          pack_open ? DATALOG_FRAME_TIMEOUT_MS : osWaitForever);
+
+    if (frame == NULL)
+    {
+        /* Stopped before the session length, or its last frame was lost */
+        if (pack_open && !PPG_IsRunning())
+            DataLogger_EndSession();
+        return;
+    }
+
+    /* Sequence back to the start: a new session */
+    if (pack_open && (frame->sequence < pack_expected))
+        DataLogger_EndSession();
+
+    /* An empty frame cannot start a session (past its end) */
+    if (pack_open || ((frame->count > 0U) && DataLogger_BeginSession(frame)))
+    {
+        datalog_stats.frames_lost += PPG_Frame_CheckSequence(&pack_expected, frame);
+        DataLogger_PackFrame(frame);
+
+        if (frame->sequence >= pack_last_frame)
+            DataLogger_EndSession();
+    }
+
+    PPG_ReleaseFrame(frame);
+}
+
+void DataLogger_WriteStep(void)
+{
+    DataLog_Buffer_t *buf;
+
+    if (xQueueReceive(full_queue, &buf, portMAX_DELAY) != pdPASS)
+        return;
+
+    if ((buf->flags & DATALOG_BUF_OPEN) != 0U)
+    {
+        if (log_file_open)
+            DataLogger_CloseFile();
+        DataLogger_OpenFile(buf->session_bytes);
+    }
+
+    if (log_file_open && (buf->len > 0U))
+        DataLogger_WriteBuffer(buf);
+
+    if (log_file_open && ((buf->flags & DATALOG_BUF_CLOSE) != 0U))
+        DataLogger_CloseFile();
+
+    buf->len   = 0;
+    buf->flags = 0;
+    (void)xQueueSend(free_queue, &buf, 0);
+}
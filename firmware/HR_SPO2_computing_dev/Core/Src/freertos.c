@@ -48,6 +48,8 @@ osSemaphoreId_t Tick100HzHandle;
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN Variables */
+/** Context switches since boot (incremented by traceTASK_SWITCHED_IN) */
+volatile uint32_t os_context_switches = 0;
 
 /* USER CODE END Variables */
 
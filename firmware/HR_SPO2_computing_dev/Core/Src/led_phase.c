@@ -0,0 +1,133 @@
+/**
+ ******************************************************************************
+ * @file    led_phase.c
+ * @brief   LED phase scheduler implementation.
+ ******************************************************************************
+ */
+
+#include "led_phase.h"
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static TIM_HandleTypeDef *led_tim  = NULL;
+static GPIO_TypeDef      *led_port = NULL;
+static uint32_t           led_red  = 0;
+static uint32_t           led_ir   = 0;
+
+/*
+ * BSRR words read by the DMA, one per update event. The update that ends
+ * phase p starts phase p + 1: entry j holds the pattern of phase j + 1.
+ */
+static volatile uint32_t led_table[LED_PHASES] __attribute__((aligned(4)));
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** BSRR word of a phase: low half sets pins, high half resets them */
+static uint32_t LedPhase_Pattern(LedPhase_t phase, bool enabled)
+{
+    uint32_t off = (led_red | led_ir) << 16;
+
+    if (!enabled)
+        return off;
+
+    switch (phase)
+    {
+    case LED_PHASE_RED: return led_red | (led_ir << 16);
+    case LED_PHASE_IR:  return led_ir  | (led_red << 16);
+    default:            return off;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool LedPhase_Init(TIM_HandleTypeDef *tim, GPIO_TypeDef *port, uint16_t red_pin, uint16_t ir_pin)
+{
+    led_tim  = tim;
+    led_port = port;
+    led_red  = red_pin;
+    led_ir   = ir_pin;
+
+    LedPhase_SetEnabled(false);
+    led_port->BSRR = LedPhase_Pattern(LED_PHASE_DARK, false);
+
+    /* DMA2 reaches the AHB1 GPIO registers (DMA1 cannot) */
+    if (HAL_DMA_Start(tim->hdma[TIM_DMA_ID_UPDATE], (uint32_t)led_table,
+                      (uint32_t)&led_port->BSRR, LED_PHASES) != HAL_OK)
+        return false;
+
+    __HAL_TIM_ENABLE_DMA(tim, TIM_DMA_UPDATE);
+    return true;
+}
+
+bool LedPhase_GetTiming(uint32_t rate_hz, uint32_t timer_clock_hz, LedPhase_Timing_t *timing)
+{
+    if ((timing == NULL) || (rate_hz == 0U))
+        return false;
+
+    /* Smallest prescaler that fits one phase in 16 bits */
+    uint32_t ticks = timer_clock_hz / (rate_hz * LED_PHASES);
+    uint32_t psc   = (ticks + 65535U) / 65536U;
+
+    if ((psc == 0U) || (psc > 65536U))
+        return false;
+
+    uint32_t period = ticks / psc;
+    uint32_t lead   = (uint32_t)(((uint64_t)timer_clock_hz * LED_PHASE_SAMPLE_LEAD_US / psc + 500000U) / 1000000U);
+
+    if (lead == 0U)
+        lead = 1U;
+    if (period <= (2U * lead))
+        return false;
+
+    timing->prescaler = (uint16_t)(psc - 1U);
+    timing->period    = (uint16_t)(period - 1U);
+    timing->pulse     = (uint16_t)(period - lead);
+    return true;
+}
+
+bool LedPhase_SetRate(uint32_t rate_hz, uint32_t timer_clock_hz)
+{
+    LedPhase_Timing_t t;
+
+    if ((led_tim == NULL) || !LedPhase_GetTiming(rate_hz, timer_clock_hz, &t))
+        return false;
+
+    /* No update event: it would request an LED DMA transfer and shift the phases */
+    __HAL_TIM_SET_PRESCALER(led_tim, t.prescaler);
+    __HAL_TIM_SET_COMPARE(led_tim, TIM_CHANNEL_1, t.pulse);
+    __HAL_TIM_SET_AUTORELOAD(led_tim, t.period);
+    __HAL_TIM_SET_COUNTER(led_tim, 0U);
+    return true;
+}
+
+void LedPhase_SetEnabled(bool enabled)
+{
+    for (uint32_t j = 0; j < LED_PHASES; j++)
+        led_table[j] = LedPhase_Pattern((LedPhase_t)((j + 1U) % LED_PHASES), enabled);
+
+    if (!enabled && (led_port != NULL))
+        led_port->BSRR = LedPhase_Pattern(LED_PHASE_DARK, false);
+}
+
+bool LedPhase_Rewind(void)
+{
+    if (led_tim == NULL)
+        return false;
+
+    DMA_HandleTypeDef *dma = led_tim->hdma[TIM_DMA_ID_UPDATE];
+
+    if (HAL_DMA_Abort(dma) != HAL_OK)
+        return false;
+
+    /* Last entry: pattern of phase 0 */
+    led_port->BSRR = led_table[LED_PHASES - 1U];
+
+    return HAL_DMA_Start(dma, (uint32_t)led_table, (uint32_t)&led_port->BSRR, LED_PHASES) == HAL_OK;
+}
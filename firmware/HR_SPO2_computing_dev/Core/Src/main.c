@@ -24,8 +24,14 @@
 
 #include "app_tasks.h"
 
+#include "adc_scan.h"
 #include "battery_monitor.h"
+#include "data_logger.h"
+#include "led_phase.h"
 #include "ppg_processing.h"
+#include "ppg_sim.h"
+#include "sd_spi.h"
+#include "uart_rx.h"
 
 #include "queue.h"
 #include "semphr.h"
@@ -44,6 +50,10 @@ ADC_HandleTypeDef hadc1;
 DMA_HandleTypeDef hdma_adc1;
 
 SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi2_rx;
+DMA_HandleTypeDef hdma_spi2_tx;
+TIM_HandleTypeDef htim1;
+DMA_HandleTypeDef hdma_tim1_up;
 TIM_HandleTypeDef htim9;
 
 UART_HandleTypeDef huart2;
@@ -83,22 +93,9 @@ const osThreadAttr_t Battery_monitor_attributes = {
   .priority = (osPriority_t) osPriorityLow,
 };
 
-/* Definitions for MQTT_publisher */
-osThreadId_t MQTT_publisherHandle;
-uint32_t MQTT_publisherBuffer[1024];
-osStaticThreadDef_t MQTT_publisherControlBlock;
-const osThreadAttr_t MQTT_publisher_attributes = {
-  .name = "MQTT_publisher",
-  .cb_mem = &MQTT_publisherControlBlock,
-  .cb_size = sizeof(MQTT_publisherControlBlock),
-  .stack_mem = &MQTT_publisherBuffer[0],
-  .stack_size = sizeof(MQTT_publisherBuffer),
-  .priority = (osPriority_t) osPriorityLow,
-};
-
-/* Definitions for Datalogger */
+/* Definitions for Datalogger: frame packer */
 osThreadId_t DataloggerHandle;
-uint32_t DataloggerBuffer[128];
+uint32_t DataloggerBuffer[256];
 osStaticThreadDef_t DataloggerControlBlock;
 const osThreadAttr_t Datalogger_attributes = {
   .name = "Datalogger",
@@ -109,19 +106,34 @@ const osThreadAttr_t Datalogger_attributes = {
   .priority = (osPriority_t) osPriorityLow,
 };
 
-/* Definitions for Display_data */
-osThreadId_t Display_dataHandle;
-uint32_t Display_dataBuffer[512];
-osStaticThreadDef_t Display_dataControlBlock;
-const osThreadAttr_t Display_data_attributes = {
-  .name = "Display_data",
-  .cb_mem = &Display_dataControlBlock,
-  .cb_size = sizeof(Display_dataControlBlock),
-  .stack_mem = &Display_dataBuffer[0],
-  .stack_size = sizeof(Display_dataBuffer),
+/* Definitions for Log_writer: FatFs user, blocks on the SD card */
+osThreadId_t Log_writerHandle;
+uint32_t Log_writerBuffer[512];
+osStaticThreadDef_t Log_writerControlBlock;
+const osThreadAttr_t Log_writer_attributes = {
+  .name = "Log_writer",
+  .cb_mem = &Log_writerControlBlock,
+  .cb_size = sizeof(Log_writerControlBlock),
+  .stack_mem = &Log_writerBuffer[0],
+  .stack_size = sizeof(Log_writerBuffer),
   .priority = (osPriority_t) osPriorityLow,
 };
 
+#ifdef USE_SIMULATION
+/* Definitions for Sim_link: above the processing task, keeps the FIFO fed */
+osThreadId_t Sim_linkHandle;
+uint32_t Sim_linkBuffer[256];
+osStaticThreadDef_t Sim_linkControlBlock;
+const osThreadAttr_t Sim_link_attributes = {
+  .name = "Sim_link",
+  .cb_mem = &Sim_linkControlBlock,
+  .cb_size = sizeof(Sim_linkControlBlock),
+  .stack_mem = &Sim_linkBuffer[0],
+  .stack_size = sizeof(Sim_linkBuffer),
+  .priority = (osPriority_t) osPriorityAboveNormal,
+};
+#endif
+
 /* Definitions for Start_measure */
 osSemaphoreId_t Start_measureHandle;
 osStaticSemaphoreDef_t Start_measureControlBlock;
@@ -147,14 +159,15 @@ static void MX_DMA_Init(void);
 static void MX_ADC1_Init(void);
 static void MX_SPI2_Init(void);
 static void MX_USART2_UART_Init(void);
+static void MX_TIM1_Init(void);
 static void MX_TIM9_Init(void);
 
 void StartDefaultTask(void *argument);
 void Start_HR_SPO2_task(void *argument);
 void Start_Battery_monitor(void *argument);
-void Start_publisher(void *argument);
 void Start_Datalogging(void *argument);
-void Start_Displaying(void *argument);
+void Start_Log_writer(void *argument);
+void Start_Sim_link(void *argument);
 
 /* USER CODE BEGIN 0 */
 
@@ -162,51 +175,50 @@ void Start_HR_SPO2_task(void *argument)
 {
     for (;;)
     {
-        PPG_ProcessStep();
-        osDelay(1);
+        /* Idle between sessions: released by the default task on start */
+        osSemaphoreAcquire(Start_measureHandle, osWaitForever);
+
+        while (PPG_IsRunning())
+            PPG_ProcessStep();      /* blocks until the next sample block */
     }
 }
 
-void Start_Battery_monitor(void *argument)
+#ifdef USE_SIMULATION
+void Start_Sim_link(void *argument)
 {
-    BatteryMonitor_Init(&hadc1, GPIOA, Battery_Alarm_Led_Pin);
-
     for (;;)
-    {
-        BatteryMonitor_Update();
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
+        PPG_Sim_ReceiveStep();      /* blocks until UART bytes arrive */
 }
+#endif
 
-void Start_publisher(void *argument)
+void Start_Battery_monitor(void *argument)
 {
+    BatteryMonitor_Init(GPIOA, Battery_Alarm_Led_Pin);
+
     for (;;)
     {
-        osDelay(1000);
+        BatteryMonitor_Update();
+        vTaskDelay(pdMS_TO_TICKS(500));
     }
 }
 
-void Start_Displaying(void *argument)
+void Start_Datalogging(void *argument)
 {
     for (;;)
-    {
-        osDelay(1000);
-    }
+        DataLogger_PackStep();      /* blocks until the next frame */
 }
 
-void Start_Datalogging(void *argument)
+void Start_Log_writer(void *argument)
 {
     for (;;)
-    {
-        osDelay(1000);
-    }
+        DataLogger_WriteStep();     /* blocks until a log buffer is full */
 }
 /**
  * @brief  GPIO EXTI callback.
  *
  * This function is called by the HAL when an external interrupt
- * occurs on a configured GPIO pin and transmits a character through 
- * UART2 interface (SIMULATION only).
+ * occurs on a configured GPIO pin. The start button only raises
+ * APP_EVENT_BUTTON: the default task starts the session.
  *
  * @param[in] GPIO_Pin  Specifies the pins connected to EXTI line.
  *
@@ -218,9 +230,7 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 {
     if (GPIO_Pin == Start_measure_button_Pin)
     {
-        uint8_t c = 'C';
-        HAL_UART_Transmit(&huart2, &c, 1, HAL_MAX_DELAY);
-        PPG_Start();
+        osEventFlagsSet(push_buttonHandle, APP_EVENT_BUTTON);
     }
 }
 
@@ -239,30 +249,51 @@ int main(void)
   MX_DMA_Init();
   MX_ADC1_Init();
   MX_SPI2_Init();
+  if (!SdSpi_Init(&hspi2, SD_CS_GPIO_Port, SD_CS_Pin))
+  {
+    Error_Handler();
+  }
   MX_FATFS_Init();
+  if (!DataLogger_Init())
+  {
+    Error_Handler();
+  }
   MX_USART2_UART_Init();
+  MX_TIM1_Init();
   MX_TIM9_Init();
 
   HAL_TIM_Base_Start_IT(&htim9);
 
+  /* LED DMA armed first: TIM1 then starts on the RED phase for LEDs and ADC */
+  AdcScan_Init(&hadc1, &htim1, TIM_CHANNEL_1);
+  PPG_Init();
+  if (!LedPhase_Init(&htim1, GPIOA, Red_PWM_LED_Pin, IR_PWM_LED_Pin) || !AdcScan_Start())
+  {
+    Error_Handler();
+  }
+
 #ifdef USE_SIMULATION
-  PPG_Init(0, 0);
-#else
-  PPG_Init(&hadc1, &hadc1);
+  /* Circular reception from boot on: no byte can arrive unarmed */
+  if (!UartRx_Start(&huart2))
+  {
+    Error_Handler();
+  }
 #endif
 
   osKernelInitialize();
 
   Start_measureHandle = osSemaphoreNew(1, 0, &Start_measure_attributes);
+  push_buttonHandle = osEventFlagsNew(&push_button_attributes);
+  PPG_BindEvents(push_buttonHandle);
 
   defaultTaskHandle = osThreadNew(StartDefaultTask, NULL, &defaultTask_attributes);
   HR_SPO2_calc_taHandle = osThreadNew(Start_HR_SPO2_task, NULL, &HR_SPO2_calc_ta_attributes);
   Battery_monitorHandle = osThreadNew(Start_Battery_monitor, NULL, &Battery_monitor_attributes);
-  MQTT_publisherHandle = osThreadNew(Start_publisher, NULL, &MQTT_publisher_attributes);
   DataloggerHandle = osThreadNew(Start_Datalogging, NULL, &Datalogger_attributes);
-  Display_dataHandle = osThreadNew(Start_Displaying, NULL, &Display_data_attributes);
-
-  push_buttonHandle = osEventFlagsNew(&push_button_attributes);
+  Log_writerHandle = osThreadNew(Start_Log_writer, NULL, &Log_writer_attributes);
+#ifdef USE_SIMULATION
+  Sim_linkHandle = osThreadNew(Start_Sim_link, NULL, &Sim_link_attributes);
+#endif
 
   osKernelStart();
 
@@ -316,32 +347,47 @@ static void MX_ADC1_Init(void)
 {
   ADC_ChannelConfTypeDef sConfig = {0};
 
+  /*
+   * Regular group in scan mode: one sequence of every AdcScan_Rank_t per
+   * TIM1 CC1 rising edge (end of each LED phase), moved by DMA2 Stream0
+   * into the interleaved circular buffer of adc_scan.c
+   */
   hadc1.Instance = ADC1;
   hadc1.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV2;
   hadc1.Init.Resolution = ADC_RESOLUTION_12B;
-  hadc1.Init.ScanConvMode = DISABLE;
-  hadc1.Init.ContinuousConvMode = ENABLE;
+  hadc1.Init.ScanConvMode = ENABLE;
+  hadc1.Init.ContinuousConvMode = DISABLE;
   hadc1.Init.DiscontinuousConvMode = DISABLE;
-  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
-  hadc1.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+  hadc1.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_RISING;
+  hadc1.Init.ExternalTrigConv = ADC_EXTERNALTRIGCONV_T1_CC1;
   hadc1.Init.DataAlign = ADC_DATAALIGN_RIGHT;
-  hadc1.Init.NbrOfConversion = 1;
-  hadc1.Init.DMAContinuousRequests = DISABLE;
-  hadc1.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+  hadc1.Init.NbrOfConversion = ADC_SCAN_RANKS;
+  hadc1.Init.DMAContinuousRequests = ENABLE;
+  hadc1.Init.EOCSelection = ADC_EOC_SEQ_CONV;
 
   if (HAL_ADC_Init(&hadc1) != HAL_OK)
   {
     Error_Handler();
   }
 
+  /* Rank order must match AdcScan_Rank_t */
   sConfig.Channel = ADC_CHANNEL_0;
-  sConfig.Rank = 1;
+  sConfig.Rank = ADC_SCAN_PHOTODIODE + 1;
   sConfig.SamplingTime = ADC_SAMPLETIME_15CYCLES;
 
   if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
   {
     Error_Handler();
   }
+
+  sConfig.Channel = ADC_CHANNEL_1;
+  sConfig.Rank = ADC_SCAN_BATTERY + 1;
+  sConfig.SamplingTime = ADC_SAMPLETIME_84CYCLES;   /* high-impedance divider */
+
+  if (HAL_ADC_ConfigChannel(&hadc1, &sConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
 }
 
 /**
@@ -370,6 +416,67 @@ static void MX_SPI2_Init(void)
   }
 }
 
+/**
+  * @brief TIM1 Initialization Function
+  * @note  LED phase clock (led_phase.h): one update per phase at
+  *        acquisition rate * LED_PHASES (rate profile, ppg_rate.h), timing
+  *        from LedPhase_GetTiming(), LED BSRR written by DMA2
+  *        Stream5 on update, CC1 (PWM mode 2) rising near the end of each
+  *        phase as ADC1 scan trigger (adc_scan.c). No output pin.
+  * @param None
+  * @retval None
+  */
+static void MX_TIM1_Init(void)
+{
+  TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  TIM_OC_InitTypeDef sConfigOC = {0};
+  const PPG_RateConfig_t *rate = PPG_GetRateConfig();
+  LedPhase_Timing_t timing;
+
+  if ((rate == NULL) || !LedPhase_GetTiming(rate->acq_hz, rate->timer_clock_hz, &timing))
+  {
+    Error_Handler();
+  }
+
+  htim1.Instance = TIM1;
+  htim1.Init.Prescaler = timing.prescaler;
+  htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
+  htim1.Init.Period = timing.period;
+  htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+  htim1.Init.RepetitionCounter = 0;
+  htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+
+  if (HAL_TIM_Base_Init(&htim1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sClockSourceConfig.ClockSource = TIM_CLOCKSOURCE_INTERNAL;
+
+  if (HAL_TIM_ConfigClockSource(&htim1, &sClockSourceConfig) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  if (HAL_TIM_PWM_Init(&htim1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  sConfigOC.OCMode = TIM_OCMODE_PWM2;
+  sConfigOC.Pulse = timing.pulse;
+  sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+  sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+  sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+  sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+  sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+
+  if (HAL_TIM_PWM_ConfigChannel(&htim1, &sConfigOC, TIM_CHANNEL_1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+}
+
 /**
   * @brief TIM9 Initialization Function
   * @param None
@@ -378,11 +485,18 @@ static void MX_SPI2_Init(void)
 static void MX_TIM9_Init(void)
 {
   TIM_ClockConfigTypeDef sClockSourceConfig = {0};
+  const PPG_RateConfig_t *rate = PPG_GetRateConfig();
+
+  if (rate == NULL)
+  {
+    Error_Handler();
+  }
 
   htim9.Instance = TIM9;
-  htim9.Init.Prescaler = 1599;
+  /* One update per acquisition period, derived from the timer clock (ppg_rate.h) */
+  htim9.Init.Prescaler = rate->tick_prescaler;
   htim9.Init.CounterMode = TIM_COUNTERMODE_UP;
-  htim9.Init.Period = 99;
+  htim9.Init.Period = rate->tick_period;
   htim9.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
   htim9.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
 
@@ -429,6 +543,12 @@ static void MX_DMA_Init(void)
   __HAL_RCC_DMA2_CLK_ENABLE();
   __HAL_RCC_DMA1_CLK_ENABLE();
 
+  HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+
+  HAL_NVIC_SetPriority(DMA1_Stream4_IRQn, 5, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream4_IRQn);
+
   HAL_NVIC_SetPriority(DMA1_Stream5_IRQn, 5, 0);
   HAL_NVIC_EnableIRQ(DMA1_Stream5_IRQn);
 
@@ -453,6 +573,9 @@ static void MX_GPIO_Init(void)
                     IR_PWM_LED_Pin | Red_PWM_LED_Pin | Battery_Alarm_Led_Pin,
                     GPIO_PIN_RESET);
 
+  /* SD card deselected */
+  HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, GPIO_PIN_SET);
+
   GPIO_InitStruct.Pin = Start_measure_button_Pin;
   GPIO_InitStruct.Mode = GPIO_MODE_IT_RISING;
   GPIO_InitStruct.Pull = GPIO_PULLDOWN;
@@ -466,12 +589,18 @@ static void MX_GPIO_Init(void)
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
   HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
 
+  GPIO_InitStruct.Pin = SD_CS_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_PULLUP;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+  HAL_GPIO_Init(SD_CS_GPIO_Port, &GPIO_InitStruct);
+
   HAL_NVIC_SetPriority(EXTI15_10_IRQn, 5, 0);
   HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
 }
 
 /**
-  * @brief  Function implementing the defaultTask thread.
+  * @brief  Function implementing the defaultTask thread: session start.
   * @param  argument: Not used
   * @retval None
   */
@@ -479,31 +608,39 @@ static void MX_GPIO_Init(void)
 void StartDefaultTask(void *argument)
 {
   /* USER CODE BEGIN 5 */
-  /* Infinite loop */
+  /* Session control: sleeps until the start button */
   for(;;)
   {
-    osDelay(1);
+    osEventFlagsWait(push_buttonHandle, APP_EVENT_BUTTON, osFlagsWaitAny, osWaitForever);
+
+    /* Presses (and bounces) during a session are ignored */
+    if ((osEventFlagsGet(push_buttonHandle) & PPG_EVENT_IDLE) == 0U)
+      continue;
+
+    /* In simulation, PPG_Start() opens the UART link session */
+    PPG_Start();
+    osSemaphoreRelease(Start_measureHandle);
   }
   /* USER CODE END 5 */
 }
 
 /**
   * @brief Period elapsed callback in non blocking mode
-  * @note  Called when TIM9 interrupt occurs
+  * @note  Called when TIM2 (HAL time base) or TIM9 interrupt occurs
   * @param htim TIM handle
   */
 void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
 {
+  if (htim->Instance == TIM2)
+  {
+    HAL_IncTick();
+    return;
+  }
+
   if (htim->Instance != TIM9)
     return;
 
-#ifdef USE_SIMULATION
-  if (PPG_IsRunning())
-  {
-    uint8_t req = 'R';
-    HAL_UART_Transmit_IT(&huart2, &req, 1);
-  }
-#endif
+  PPG_SampleTickFromISR();
 }
 
 /**
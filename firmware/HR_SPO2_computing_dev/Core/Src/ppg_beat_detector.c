@@ -0,0 +1,176 @@
+/**
+ ******************************************************************************
+ * @file    ppg_beat_detector.c
+ * @brief   Streaming PPG beat detector implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_beat_detector.h"
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static uint16_t PPG_Beat_MsToSamples(uint16_t fs, uint32_t ms)
+{
+    return (uint16_t)((ms * fs) / 1000U);
+}
+
+static void PPG_Beat_AddInterval(PPG_BeatDetector_t *det, uint32_t interval)
+{
+    if (det->interval_count == PPG_BEAT_HISTORY)
+        det->interval_sum -= det->intervals[det->interval_index];
+    else
+        det->interval_count++;
+
+    det->intervals[det->interval_index] = interval;
+    det->interval_sum += interval;
+    det->interval_index = (uint8_t)((det->interval_index + 1U) % PPG_BEAT_HISTORY);
+}
+
+/** Threshold = half the average upstroke slope, never below the noise floor */
+static int32_t PPG_Beat_Threshold(int32_t slope_avg)
+{
+    int32_t th = slope_avg / 2;
+    return (th < PPG_BEAT_MIN_SLOPE) ? PPG_BEAT_MIN_SLOPE : th;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_BeatDetector_Init(PPG_BeatDetector_t *det, uint16_t fs_hz)
+{
+    det->fs            = fs_hz;
+    det->refractory    = PPG_Beat_MsToSamples(fs_hz, PPG_BEAT_REFRACTORY_MS);
+    det->max_interval  = PPG_Beat_MsToSamples(fs_hz, PPG_BEAT_MAX_INTERVAL_MS);
+    det->learn_samples = PPG_Beat_MsToSamples(fs_hz, PPG_BEAT_LEARN_MS);
+
+    PPG_BeatDetector_Reset(det);
+}
+
+void PPG_BeatDetector_Reset(PPG_BeatDetector_t *det)
+{
+    det->n         = 0;
+    det->learned   = 0;
+    det->prev      = 0;
+    det->rising    = false;
+    det->threshold = INT32_MAX;     /* no detection while learning */
+    det->slope_avg = 0;
+    det->slope_max = 0;
+    det->last_beat = 0;
+    det->have_beat = false;
+
+    for (uint8_t i = 0; i < PPG_BEAT_HISTORY; i++)
+        det->intervals[i] = 0;
+
+    det->interval_sum   = 0;
+    det->interval_index = 0;
+    det->interval_count = 0;
+}
+
+bool PPG_BeatDetector_Update(PPG_BeatDetector_t *det, int16_t x, PPG_Beat_t *beat)
+{
+    int32_t slope = (int32_t)x - (int32_t)det->prev;
+    bool detected = false;
+
+    det->prev = x;
+    det->n++;
+
+    /* Learning: seed the average upstroke slope with the largest one seen */
+    if (det->learned < det->learn_samples)
+    {
+        if (slope > det->slope_avg)
+            det->slope_avg = slope;
+
+        if (++det->learned == det->learn_samples)
+            det->threshold = PPG_Beat_Threshold(det->slope_avg);
+
+        return false;
+    }
+
+    if (det->rising)
+    {
+        if (slope > det->slope_max)
+            det->slope_max = slope;
+
+        /* Slope sign change: the previous sample was the systolic peak */
+        if (slope <= 0)
+        {
+            uint32_t peak = det->n - 2U;
+
+            det->rising = false;
+            detected    = true;
+
+            /* Adapt: slope_avg += (slope_max - slope_avg) / 4 */
+            det->slope_avg += (det->slope_max - det->slope_avg) / 4;
+            det->threshold  = PPG_Beat_Threshold(det->slope_avg);
+
+            uint32_t interval = 0;
+
+            if (det->have_beat)
+            {
+                interval = peak - det->last_beat;
+                if (interval <= det->max_interval)
+                    PPG_Beat_AddInterval(det, interval);
+                else
+                    interval = 0;
+            }
+
+            det->last_beat = peak;
+            det->have_beat = true;
+
+            if (beat != NULL)
+            {
+                beat->sample_index = peak;
+                beat->interval     = interval;
+                beat->hr_bpm       = (det->interval_count > 0U)
+                    ? (60.0f * (float)det->fs * (float)det->interval_count) / (float)det->interval_sum
+                    : 0.0f;
+            }
+        }
+        return detected;
+    }
+
+    /* Refractory: fixed minimum, or half the current beat interval */
+    uint32_t blank = det->refractory;
+    if (det->interval_count > 0U)
+    {
+        uint32_t half_interval = det->interval_sum / (2U * det->interval_count);
+        if (half_interval > blank)
+            blank = half_interval;
+    }
+
+    bool refractory = det->have_beat && ((det->n - 1U - det->last_beat) < blank);
+
+    if (!refractory && (slope > det->threshold))
+    {
+        det->rising    = true;
+        det->slope_max = slope;
+        return false;
+    }
+
+    /* No upstroke: let the threshold decay (~5 s time constant at 100 Hz) */
+    if (det->threshold > PPG_BEAT_MIN_SLOPE)
+        det->threshold -= (det->threshold >> 9) + 1;
+
+    /* Lost rhythm: the next beat starts a new interval history */
+    if (det->have_beat && ((det->n - 1U - det->last_beat) > det->max_interval))
+    {
+        det->have_beat      = false;
+        det->interval_count = 0;
+        det->interval_sum   = 0;
+        det->interval_index = 0;
+    }
+
+    return false;
+}
+
+void PPG_BeatDetector_Blank(PPG_BeatDetector_t *det, int16_t x)
+{
+    det->prev      = x;
+    det->rising    = false;
+    det->have_beat = false;
+    det->n++;
+}
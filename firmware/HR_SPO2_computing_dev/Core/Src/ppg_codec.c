@@ -0,0 +1,240 @@
+/**
+ ******************************************************************************
+ * @file    ppg_codec.c
+ * @brief   Lossless sample codec implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_codec.h"
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** One more byte into the accumulator (zeros past the end) */
+static inline void PPG_BitReader_Fill(PPG_BitReader_t *br)
+{
+    uint8_t b = 0;
+
+    if (br->pos < br->end)
+        b = br->buf[br->pos++];
+    else
+        br->ok = false;
+
+    br->acc   = (br->acc << 8) | b;
+    br->bits += 8U;
+}
+
+/** Zeros up to the next one (consumed), at most max (the one left unread) */
+static inline uint32_t PPG_BitReader_Unary(PPG_BitReader_t *br, uint32_t max)
+{
+    uint32_t q = 0;
+
+    for (;;)
+    {
+        if (br->bits == 0U)
+            PPG_BitReader_Fill(br);
+
+        uint32_t v = br->acc & ((1UL << br->bits) - 1U);
+        uint32_t z = (v != 0U) ? (br->bits - (32U - (uint32_t)__builtin_clz(v))) : br->bits;
+
+        if ((q + z) >= max)
+        {
+            br->bits -= max - q;
+            return max;
+        }
+
+        q        += z;
+        br->bits -= z;
+        if (v != 0U)
+        {
+            br->bits--;
+            return q;
+        }
+        if (!br->ok)
+            return max;
+    }
+}
+
+static inline int32_t PPG_Codec_Predict(const PPG_CodecChannel_t *ch, uint32_t order)
+{
+    const int32_t *h = ch->hist;
+
+    switch (order)
+    {
+    case 1U:
+        return h[0];
+    case 2U:
+        return (2 * h[0]) - h[1];
+    default:
+        return (3 * (h[0] - h[1])) + h[2];
+    }
+}
+
+/** Rice parameter: smallest k with count * 2^k >= sum */
+static inline uint32_t PPG_Codec_K(const PPG_CodecChannel_t *ch)
+{
+    uint32_t m = (ch->sum + ch->count - 1U) / ch->count;
+
+    return (m <= 1U) ? 0U : (32U - (uint32_t)__builtin_clz(m - 1U));
+}
+
+static inline void PPG_Codec_Adapt(PPG_CodecChannel_t *ch, uint32_t u)
+{
+    ch->sum += u;
+    if (++ch->count >= PPG_CODEC_RESET)
+    {
+        ch->sum   >>= 1;
+        ch->count >>= 1;
+    }
+}
+
+static inline void PPG_Codec_Push(PPG_CodecChannel_t *ch, int32_t x, uint32_t order)
+{
+    ch->hist[2] = ch->hist[1];
+    ch->hist[1] = ch->hist[0];
+    ch->hist[0] = x;
+    if (ch->have < order)
+        ch->have++;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Codec_Reset(PPG_CodecChannel_t *ch)
+{
+    memset(ch, 0, sizeof(*ch));
+    ch->sum   = 1UL << PPG_CODEC_INIT_K;
+    ch->count = 1U;
+}
+
+void PPG_Codec_Encode(PPG_CodecChannel_t *ch, uint32_t order, PPG_BitWriter_t *bw,
+                      const uint16_t *x, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (ch->have == 0U)
+        {
+            PPG_BitWriter_Put(bw, x[i], 16U);
+            PPG_Codec_Push(ch, x[i], order);
+            continue;
+        }
+
+        int32_t  e = (int32_t)x[i] - PPG_Codec_Predict(ch, ch->have);
+        uint32_t u = ((uint32_t)e << 1) ^ (uint32_t)(e >> 31);
+        uint32_t k = PPG_Codec_K(ch);
+        uint32_t q = u >> k;
+
+        if (q < PPG_CODEC_QMAX)
+        {
+            PPG_BitWriter_Put(bw, 1U, q + 1U);
+            if (k > 0U)
+                PPG_BitWriter_Put(bw, u & ((1UL << k) - 1U), k);
+        }
+        else
+        {
+            PPG_BitWriter_Put(bw, 0U, PPG_CODEC_QMAX);
+            PPG_BitWriter_Put(bw, u, PPG_CODEC_ESCAPE_BITS);
+        }
+
+        PPG_Codec_Adapt(ch, u);
+        PPG_Codec_Push(ch, x[i], order);
+    }
+}
+
+bool PPG_Codec_Decode(PPG_CodecChannel_t *ch, uint32_t order, PPG_BitReader_t *br,
+                      uint16_t *x, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (ch->have == 0U)
+        {
+            x[i] = (uint16_t)PPG_BitReader_Get(br, 16U);
+            PPG_Codec_Push(ch, x[i], order);
+            continue;
+        }
+
+        uint32_t k = PPG_Codec_K(ch);
+        uint32_t q = PPG_BitReader_Unary(br, PPG_CODEC_QMAX);
+        uint32_t u;
+
+        if (q < PPG_CODEC_QMAX)
+            u = (q << k) | ((k > 0U) ? PPG_BitReader_Get(br, k) : 0U);
+        else
+            u = PPG_BitReader_Get(br, PPG_CODEC_ESCAPE_BITS);
+
+        int32_t v = PPG_Codec_Predict(ch, ch->have) + ((int32_t)(u >> 1) ^ -(int32_t)(u & 1U));
+
+        if (!br->ok || (v < 0) || (v > (int32_t)UINT16_MAX))
+            return false;
+
+        x[i] = (uint16_t)v;
+        PPG_Codec_Adapt(ch, u);
+        PPG_Codec_Push(ch, v, order);
+    }
+
+    return br->ok;
+}
+
+void PPG_BitWriter_Init(PPG_BitWriter_t *bw, uint8_t *buf)
+{
+    bw->buf  = buf;
+    bw->pos  = 0;
+    bw->acc  = 0;
+    bw->bits = 0;
+}
+
+void PPG_BitWriter_Resume(PPG_BitWriter_t *bw, uint8_t *buf)
+{
+    bw->buf = buf;
+    bw->pos = 0;
+}
+
+void PPG_BitWriter_Put(PPG_BitWriter_t *bw, uint32_t v, uint32_t n)
+{
+    bw->acc   = (bw->acc << n) | v;
+    bw->bits += n;
+
+    while (bw->bits >= 8U)
+    {
+        bw->bits -= 8U;
+        bw->buf[bw->pos++] = (uint8_t)(bw->acc >> bw->bits);
+    }
+}
+
+size_t PPG_BitWriter_Flush(PPG_BitWriter_t *bw)
+{
+    if (bw->bits > 0U)
+        PPG_BitWriter_Put(bw, 0U, 8U - bw->bits);
+    return bw->pos;
+}
+
+void PPG_BitReader_Init(PPG_BitReader_t *br, const uint8_t *buf, size_t len)
+{
+    br->buf  = buf;
+    br->pos  = 0;
+    br->end  = len;
+    br->acc  = 0;
+    br->bits = 0;
+    br->ok   = true;
+}
+
+uint32_t PPG_BitReader_Get(PPG_BitReader_t *br, uint32_t n)
+{
+    while (br->bits < n)
+        PPG_BitReader_Fill(br);
+
+    br->bits -= n;
+    return (br->acc >> br->bits) & ((1UL << n) - 1U);
+}
+
+size_t PPG_BitReader_Align(PPG_BitReader_t *br)
+{
+    /* Whole bytes still in the accumulator go back to the input (none read past the end) */
+    if (br->ok)
+        br->pos -= br->bits / 8U;
+    br->bits = 0;
+    return br->pos;
+}
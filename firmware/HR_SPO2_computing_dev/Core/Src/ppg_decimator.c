@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * @file    ppg_decimator.c
+ * @brief   CIC decimator implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_decimator.h"
+#include <stddef.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool PPG_CIC_Init(PPG_CIC_t *cic, uint32_t ratio)
+{
+    if ((cic == NULL) || (ratio < 1U) || (ratio > PPG_CIC_MAX_RATIO))
+        return false;
+
+    uint64_t gain = 1U;
+    for (uint32_t i = 0; i < PPG_CIC_ORDER; i++)
+        gain *= ratio;
+
+    cic->ratio = ratio;
+
+    /* R^N = 1 (no decimation) would need 2^32: handled as a pass-through */
+    cic->gain_inv = (gain > 1U) ? (uint32_t)(((1ULL << 32) + gain / 2U) / gain) : 0U;
+
+    PPG_CIC_Reset(cic);
+    return true;
+}
+
+void PPG_CIC_Reset(PPG_CIC_t *cic)
+{
+    memset(cic->integ, 0, sizeof(cic->integ));
+    memset(cic->delay, 0, sizeof(cic->delay));
+    cic->phase = 0;
+}
+
+bool PPG_CIC_Process(PPG_CIC_t *cic, uint16_t x, uint16_t *y)
+{
+    if (cic->ratio == 1U)
+    {
+        *y = x & 0x0FFF;
+        return true;
+    }
+
+    /* Integrators at the input rate */
+    uint32_t acc = x & 0x0FFFU;
+    for (uint32_t i = 0; i < PPG_CIC_ORDER; i++)
+    {
+        cic->integ[i] += acc;
+        acc = cic->integ[i];
+    }
+
+    if (++cic->phase < cic->ratio)
+        return false;
+    cic->phase = 0;
+
+    /* Combs at the output rate */
+    for (uint32_t i = 0; i < PPG_CIC_ORDER; i++)
+    {
+        uint32_t in = acc;
+        acc -= cic->delay[i];
+        cic->delay[i] = in;
+    }
+
+    /* Remove the R^N gain, rounded to the nearest 12-bit code */
+    uint32_t out = (uint32_t)(((uint64_t)acc * cic->gain_inv + (1ULL << 31)) >> 32);
+
+    *y = (uint16_t)((out > 0x0FFFU) ? 0x0FFFU : out);
+    return true;
+}
@@ -0,0 +1,53 @@
+/**
+ ******************************************************************************
+ * @file    ppg_filter_bank.c
+ * @brief   Per-channel moving-average filter bank implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_filter_bank.h"
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_MovingAverage_Reset(PPG_MovingAverage_t *ma)
+{
+    for (uint16_t i = 0; i < PPG_FILTER_WINDOW; i++)
+        ma->buffer[i] = 0;
+
+    ma->sum   = 0;
+    ma->index = 0;
+    ma->count = 0;
+}
+
+void PPG_FilterBank_Reset(PPG_FilterBank_t *bank)
+{
+    for (uint8_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_MovingAverage_Reset(&bank->channel[ch]);
+}
+
+uint16_t PPG_MovingAverage_Update(PPG_MovingAverage_t *ma, uint16_t sample)
+{
+    /* Oldest sample leaves the window, newest one enters it */
+    ma->sum -= ma->buffer[ma->index];
+    ma->sum += sample;
+    ma->buffer[ma->index] = sample;
+
+    if (++ma->index >= PPG_FILTER_WINDOW)
+        ma->index = 0;
+
+    if (ma->count < PPG_FILTER_WINDOW)
+    {
+        ma->count++;
+        return (uint16_t)(ma->sum / ma->count);
+    }
+
+    /* Constant divisor: shift for power-of-two windows */
+    return (uint16_t)(ma->sum / PPG_FILTER_WINDOW);
+}
+
+uint16_t PPG_FilterBank_Update(PPG_FilterBank_t *bank, PPG_Channel_t channel, uint16_t sample)
+{
+    return PPG_MovingAverage_Update(&bank->channel[channel], sample);
+}
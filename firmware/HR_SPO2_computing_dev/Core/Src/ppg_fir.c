@@ -0,0 +1,118 @@
+/**
+ ******************************************************************************
+ * @file    ppg_fir.c
+ * @brief   Fixed-point FIR filter engine implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_fir.h"
+#include <string.h>
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "stm32f4xx.h"          /* CMSIS __SMLAD / __SSAT intrinsics */
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** Load two consecutive Q15 values as one 32-bit word (unaligned allowed) */
+static inline uint32_t PPG_FIR_Load2(const int16_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+
+#define PPG_FIR_SMLAD(x, y, acc)  ((int32_t)__SMLAD((x), (y), (uint32_t)(acc)))
+#define PPG_FIR_SAT16(v)          ((int16_t)__SSAT((v), 16))
+
+#else
+
+/** Portable SMLAD: acc + x.lo * y.lo + x.hi * y.hi, wrapping like the M4 */
+static inline int32_t PPG_FIR_SMLAD(uint32_t x, uint32_t y, int32_t acc)
+{
+    int32_t lo = (int32_t)(int16_t)(x & 0xFFFFU) * (int32_t)(int16_t)(y & 0xFFFFU);
+    int32_t hi = (int32_t)(int16_t)(x >> 16)     * (int32_t)(int16_t)(y >> 16);
+
+    return (int32_t)((uint32_t)acc + (uint32_t)lo + (uint32_t)hi);
+}
+
+static inline int16_t PPG_FIR_SAT16(int32_t v)
+{
+    if (v > INT16_MAX)
+        return INT16_MAX;
+    if (v < INT16_MIN)
+        return INT16_MIN;
+    return (int16_t)v;
+}
+
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_FIR_Init(PPG_FIR_t *fir, const int16_t *coeffs, uint16_t num_taps, int16_t *state)
+{
+    fir->coeffs   = coeffs;
+    fir->state    = state;
+    fir->num_taps = num_taps;
+
+    PPG_FIR_Reset(fir);
+}
+
+void PPG_FIR_Reset(PPG_FIR_t *fir)
+{
+    memset(fir->state, 0, 2U * fir->num_taps * sizeof(int16_t));
+    fir->index = 0;
+}
+
+int16_t PPG_FIR_Process(PPG_FIR_t *fir, int16_t x)
+{
+    const uint16_t n = fir->num_taps;
+
+    /* Newest sample goes one slot "down"; older samples follow it */
+    fir->index = (fir->index == 0U) ? (uint16_t)(n - 1U) : (uint16_t)(fir->index - 1U);
+    fir->state[fir->index]     = x;
+    fir->state[fir->index + n] = x;
+
+    /* w[k] = x[n - k], contiguous thanks to the duplicated delay line */
+    const int16_t *w = &fir->state[fir->index];
+    const int16_t *h = fir->coeffs;
+
+    int32_t  acc   = 1L << 14;      /* rounding offset for the final >> 15 */
+    uint16_t pairs = n >> 1;
+
+    while (pairs >= 4U)
+    {
+        acc = PPG_FIR_SMLAD(PPG_FIR_Load2(w),     PPG_FIR_Load2(h),     acc);
+        acc = PPG_FIR_SMLAD(PPG_FIR_Load2(w + 2), PPG_FIR_Load2(h + 2), acc);
+        acc = PPG_FIR_SMLAD(PPG_FIR_Load2(w + 4), PPG_FIR_Load2(h + 4), acc);
+        acc = PPG_FIR_SMLAD(PPG_FIR_Load2(w + 6), PPG_FIR_Load2(h + 6), acc);
+        w += 8;
+        h += 8;
+        pairs -= 4U;
+    }
+
+    while (pairs > 0U)
+    {
+        acc = PPG_FIR_SMLAD(PPG_FIR_Load2(w), PPG_FIR_Load2(h), acc);
+        w += 2;
+        h += 2;
+        pairs--;
+    }
+
+    if (n & 1U)
+        acc = (int32_t)((uint32_t)acc + (uint32_t)((int32_t)*w * (int32_t)*h));
+
+    return PPG_FIR_SAT16(acc >> 15);
+}
+
+void PPG_FIR_ProcessBlock(PPG_FIR_t *fir, const int16_t *in, int16_t *out, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++)
+        out[i] = PPG_FIR_Process(fir, in[i]);
+}
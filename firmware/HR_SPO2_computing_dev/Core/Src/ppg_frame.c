@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * @file    ppg_frame.c
+ * @brief   Multi-channel sample frames and frame pool implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_frame.h"
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_FramePool_Init(PPG_FramePool_t *pool)
+{
+    for (uint32_t i = 0; i < PPG_FRAME_POOL_SIZE; i++)
+        __atomic_store_n(&pool->frames[i].refs, 0U, __ATOMIC_RELEASE);
+
+    pool->next = 0;
+}
+
+PPG_Frame_t *PPG_FramePool_Acquire(PPG_FramePool_t *pool, uint32_t sequence, uint32_t timestamp)
+{
+    for (uint32_t n = 0; n < PPG_FRAME_POOL_SIZE; n++)
+    {
+        uint32_t     i     = (pool->next + n) % PPG_FRAME_POOL_SIZE;
+        PPG_Frame_t *frame = &pool->frames[i];
+
+        /* Only the producer turns 0 into 1, so a plain store is enough */
+        if (__atomic_load_n(&frame->refs, __ATOMIC_ACQUIRE) != 0U)
+            continue;
+
+        frame->sequence     = sequence;
+        frame->timestamp    = timestamp;
+        frame->count        = 0;
+        frame->channel_mask = 0;
+        frame->flags        = 0;
+        memset(&frame->results, 0, sizeof(frame->results));
+        __atomic_store_n(&frame->refs, 1U, __ATOMIC_RELEASE);
+
+        pool->next = (i + 1U) % PPG_FRAME_POOL_SIZE;
+        return frame;
+    }
+
+    return NULL;
+}
+
+void PPG_Frame_Retain(PPG_Frame_t *frame, uint32_t count)
+{
+    __atomic_fetch_add(&frame->refs, count, __ATOMIC_RELAXED);
+}
+
+bool PPG_Frame_Release(PPG_Frame_t *frame)
+{
+    return (__atomic_sub_fetch(&frame->refs, 1U, __ATOMIC_ACQ_REL) == 0U);
+}
+
+uint32_t PPG_Frame_CheckSequence(uint32_t *expected, const PPG_Frame_t *frame)
+{
+    uint32_t missing = frame->sequence - *expected;
+
+    /* An older frame (restart) resynchronizes without reporting a gap */
+    if (missing > (UINT32_MAX / 2U))
+        missing = 0;
+
+    *expected = frame->sequence + 1U;
+    return missing;
+}
@@ -0,0 +1,184 @@
+/**
+ ******************************************************************************
+ * @file    ppg_hr_spectral.c
+ * @brief   Streaming spectral HR estimator implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_hr_spectral.h"
+#include <math.h>
+#include <stddef.h>
+
+#define PPG_SPECTRAL_TWO_PI    6.28318530718f
+
+/* Hamming window w[n] = A - B cos(2 pi n / N) (periodic, as scipy's welch) */
+#define PPG_SPECTRAL_HAMMING_A 0.54f
+#define PPG_SPECTRAL_HAMMING_B 0.46f
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static void PPG_Spectral_StartSegment(PPG_SpectralSegment_t *seg)
+{
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+    {
+        seg->s1[k] = 0.0f;
+        seg->s2[k] = 0.0f;
+    }
+
+    /* Restarting the phasor each segment bounds its rounding drift */
+    seg->win_cos = 1.0f;
+    seg->win_sin = 0.0f;
+    seg->pos     = 0;
+    seg->active  = true;
+}
+
+/** Feed one sample to a segment, return true when it is complete */
+static bool PPG_Spectral_Accumulate(PPG_Spectral_t *sp, PPG_SpectralSegment_t *seg, float x)
+{
+    float v = x * (PPG_SPECTRAL_HAMMING_A - PPG_SPECTRAL_HAMMING_B * seg->win_cos);
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+    {
+        float s0 = v + sp->coeff[k] * seg->s1[k] - seg->s2[k];
+        seg->s2[k] = seg->s1[k];
+        seg->s1[k] = s0;
+    }
+
+    float c = seg->win_cos;
+    seg->win_cos = c * sp->rot_cos - seg->win_sin * sp->rot_sin;
+    seg->win_sin = seg->win_sin * sp->rot_cos + c * sp->rot_sin;
+
+    return (++seg->pos == sp->seg_len);
+}
+
+/** Average the bin powers of a completed segment into the PSD */
+static void PPG_Spectral_AddSegment(PPG_Spectral_t *sp, const PPG_SpectralSegment_t *seg)
+{
+    if (sp->segments_done < PPG_SPECTRAL_AVG)
+        sp->segments_done++;
+
+    float alpha = 1.0f / (float)sp->segments_done;
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+    {
+        float s1 = seg->s1[k];
+        float s2 = seg->s2[k];
+        float power = (s1 * s1 + s2 * s2 - sp->coeff[k] * s1 * s2) * sp->win_norm;
+
+        sp->psd[k] += alpha * (power - sp->psd[k]);
+    }
+}
+
+/** Dominant PSD bin with parabolic interpolation */
+static void PPG_Spectral_Estimate(const PPG_Spectral_t *sp, PPG_SpectralHR_t *est)
+{
+    uint32_t peak  = 0;
+    float    total = 0.0f;
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+    {
+        total += sp->psd[k];
+        if (sp->psd[k] > sp->psd[peak])
+            peak = k;
+    }
+
+    float delta = 0.0f;
+
+    if ((peak > 0U) && (peak < (PPG_SPECTRAL_NUM_BINS - 1U)))
+    {
+        float a = sp->psd[peak - 1U];
+        float b = sp->psd[peak];
+        float c = sp->psd[peak + 1U];
+        float den = a - 2.0f * b + c;
+
+        if (den < 0.0f)
+            delta = 0.5f * (a - c) / den;
+    }
+
+    est->peak_hz = ((float)(PPG_SPECTRAL_FIRST_BIN + peak) + delta) * (float)sp->fs / (float)sp->seg_len;
+    est->hr_bpm  = est->peak_hz * 60.0f;
+    est->quality = (total > 0.0f) ? (sp->psd[peak] / total) : 0.0f;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Spectral_Init(PPG_Spectral_t *sp, uint16_t fs_hz)
+{
+    sp->fs      = fs_hz;
+    sp->seg_len = ((uint32_t)fs_hz * PPG_SPECTRAL_SEGMENT_MS) / 1000U;
+    sp->hop     = sp->seg_len / PPG_SPECTRAL_SEGMENTS;
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+    {
+        float w = PPG_SPECTRAL_TWO_PI * (float)(PPG_SPECTRAL_FIRST_BIN + k) / (float)sp->seg_len;
+        sp->coeff[k] = 2.0f * cosf(w);
+    }
+
+    sp->rot_cos = cosf(PPG_SPECTRAL_TWO_PI / (float)sp->seg_len);
+    sp->rot_sin = sinf(PPG_SPECTRAL_TWO_PI / (float)sp->seg_len);
+
+    /*
+     * One-sided density as scipy.signal.welch(scaling='density'):
+     * 2 |X[k]|^2 / (fs * sum(w^2)), with sum(w^2) = N (A^2 + B^2 / 2)
+     * for the periodic Hamming window.
+     */
+    float sum_w2 = (float)sp->seg_len *
+        (PPG_SPECTRAL_HAMMING_A * PPG_SPECTRAL_HAMMING_A +
+         0.5f * PPG_SPECTRAL_HAMMING_B * PPG_SPECTRAL_HAMMING_B);
+    sp->win_norm = 2.0f / ((float)fs_hz * sum_w2);
+
+    PPG_Spectral_Reset(sp);
+}
+
+void PPG_Spectral_Reset(PPG_Spectral_t *sp)
+{
+    sp->n = 0;
+
+    for (uint32_t i = 0; i < PPG_SPECTRAL_SEGMENTS; i++)
+        sp->segment[i].active = false;
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+        sp->psd[k] = 0.0f;
+
+    sp->segments_done = 0;
+}
+
+bool PPG_Spectral_Update(PPG_Spectral_t *sp, int16_t x, PPG_SpectralHR_t *est)
+{
+    bool completed = false;
+
+    /* Segment i starts at sample i * hop, then restarts as soon as it ends */
+    if ((sp->n % sp->hop) == 0U)
+    {
+        uint32_t i = (sp->n / sp->hop) % PPG_SPECTRAL_SEGMENTS;
+        if (!sp->segment[i].active)
+            PPG_Spectral_StartSegment(&sp->segment[i]);
+    }
+    sp->n++;
+
+    for (uint32_t i = 0; i < PPG_SPECTRAL_SEGMENTS; i++)
+    {
+        PPG_SpectralSegment_t *seg = &sp->segment[i];
+
+        if (seg->active && PPG_Spectral_Accumulate(sp, seg, (float)x))
+        {
+            PPG_Spectral_AddSegment(sp, seg);
+            PPG_Spectral_StartSegment(seg);
+            completed = true;
+        }
+    }
+
+    if (completed && (est != NULL))
+        PPG_Spectral_Estimate(sp, est);
+
+    return completed;
+}
+
+float PPG_Spectral_BinHz(const PPG_Spectral_t *sp, uint32_t bin)
+{
+    return (float)(PPG_SPECTRAL_FIRST_BIN + bin) * (float)sp->fs / (float)sp->seg_len;
+}
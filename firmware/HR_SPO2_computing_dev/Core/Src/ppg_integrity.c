@@ -0,0 +1,187 @@
+/**
+ ******************************************************************************
+ * @file    ppg_integrity.c
+ * @brief   Sample-timing integrity monitor implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_integrity.h"
+#include <stdio.h>
+#include <string.h>
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static const char *const integ_sources[PPG_INTEG_SOURCE_COUNT] =
+{
+    "sample_tick", "adc_block", "frame",
+};
+
+static const char *const integ_counters[PPG_INTEG_COUNTER_COUNT] =
+{
+    "period_gaps", "pool_empty", "ring_overruns", "sequence_gaps", "consumer_drops",
+};
+
+/** Histogram bucket: 0, then [2^(b-1), 2^b - 1] in bucket b */
+static uint32_t BucketOf(uint32_t error)
+{
+    return (error == 0U) ? 0U : (32U - (uint32_t)__builtin_clz(error));
+}
+
+static uint32_t BucketMax(uint32_t bucket)
+{
+    return (bucket >= 32U) ? UINT32_MAX : ((1UL << bucket) - 1U);
+}
+
+static unsigned long TicksToNs(uint32_t ticks, uint32_t tick_hz)
+{
+    return (unsigned long)(((uint64_t)ticks * 1000000000ULL) / tick_hz);
+}
+
+/** Advance *len by an snprintf() result, clamped to the buffer */
+static void Append(size_t size, size_t *len, int n)
+{
+    if (n > 0)
+        *len += ((size_t)n < (size - *len)) ? (size_t)n : (size - *len - 1U);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Integrity_Reset(PPG_Integrity_t *mon)
+{
+    for (uint32_t s = 0; s < PPG_INTEG_SOURCE_COUNT; s++)
+    {
+        PPG_IntegrityTiming_t *t = &mon->timing[s];
+        uint32_t nominal = t->nominal;
+
+        memset(t, 0, sizeof(*t));
+        t->nominal = nominal;
+        t->min     = UINT32_MAX;
+    }
+
+    memset(mon->counters, 0, sizeof(mon->counters));
+    mon->next_period   = 0;
+    mon->period_synced = false;
+}
+
+void PPG_Integrity_SetNominal(PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t nominal)
+{
+    if ((uint32_t)src < PPG_INTEG_SOURCE_COUNT)
+        mon->timing[src].nominal = nominal;
+}
+
+void PPG_Integrity_Mark(PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t now)
+{
+    PPG_IntegrityTiming_t *t = &mon->timing[src];
+    uint32_t interval = now - t->last;
+
+    t->last = now;
+    if ((t->events++ == 0U) || (t->nominal == 0U))
+        return;
+
+    if (interval < t->min)
+        t->min = interval;
+    if (interval > t->max)
+        t->max = interval;
+
+    /* Half a period late or more: the events in between never came */
+    if (interval >= (t->nominal + t->nominal / 2U))
+    {
+        t->late++;
+        t->missed += (interval - t->nominal / 2U) / t->nominal;
+        return;
+    }
+
+    uint32_t error = (interval > t->nominal) ? (interval - t->nominal) : (t->nominal - interval);
+
+    if (error > t->worst)
+        t->worst = error;
+    t->hist[BucketOf(error)]++;
+}
+
+void PPG_Integrity_CheckPeriod(PPG_Integrity_t *mon, uint32_t period)
+{
+    if (mon->period_synced)
+    {
+        uint32_t skipped = period - mon->next_period;
+
+        if (skipped <= (UINT32_MAX / 2U))
+            mon->counters[PPG_INTEG_PERIOD_GAPS] += skipped;
+    }
+
+    mon->next_period   = period + 1U;
+    mon->period_synced = true;
+}
+
+uint32_t PPG_Integrity_Jitter(const PPG_Integrity_t *mon, PPG_IntegritySource_t src, uint32_t percent)
+{
+    if ((uint32_t)src >= PPG_INTEG_SOURCE_COUNT)
+        return 0U;
+
+    const PPG_IntegrityTiming_t *t = &mon->timing[src];
+    uint64_t total = 0;
+
+    for (uint32_t b = 0; b < PPG_INTEGRITY_BUCKETS; b++)
+        total += t->hist[b];
+    if (total == 0U)
+        return 0U;
+
+    if (percent > 100U)
+        percent = 100U;
+
+    /* Nearest rank, 1-based */
+    uint64_t rank = (total * percent + 99U) / 100U;
+    uint64_t seen = 0;
+
+    if (rank == 0U)
+        rank = 1U;
+
+    for (uint32_t b = 0; b < PPG_INTEGRITY_BUCKETS; b++)
+    {
+        seen += t->hist[b];
+        if (seen >= rank)
+            return (BucketMax(b) < t->worst) ? BucketMax(b) : t->worst;
+    }
+
+    return t->worst;
+}
+
+size_t PPG_Integrity_Format(const PPG_Integrity_t *mon, uint32_t tick_hz, char *buf, size_t size)
+{
+    size_t len = 0;
+
+    if ((buf == NULL) || (size == 0U))
+        return 0U;
+
+    buf[0] = '\0';
+    if (tick_hz == 0U)
+        tick_hz = 1000000000U;
+
+    /* Integer nanoseconds: no float printf on target */
+    Append(size, &len, snprintf(buf, size,
+           "source         events     late   missed  nominal      p50      p99    worst [ns]\r\n"));
+
+    for (uint32_t s = 0; (s < PPG_INTEG_SOURCE_COUNT) && (len < size - 1U); s++)
+    {
+        const PPG_IntegrityTiming_t *t = &mon->timing[s];
+
+        Append(size, &len, snprintf(buf + len, size - len,
+               "%-12s %8lu %8lu %8lu %8lu %8lu %8lu %8lu\r\n", integ_sources[s],
+               (unsigned long)t->events, (unsigned long)t->late, (unsigned long)t->missed,
+               TicksToNs(t->nominal, tick_hz),
+               TicksToNs(PPG_Integrity_Jitter(mon, (PPG_IntegritySource_t)s, 50U), tick_hz),
+               TicksToNs(PPG_Integrity_Jitter(mon, (PPG_IntegritySource_t)s, 99U), tick_hz),
+               TicksToNs(t->worst, tick_hz)));
+    }
+
+    for (uint32_t c = 0; (c < PPG_INTEG_COUNTER_COUNT) && (len < size - 1U); c++)
+    {
+        Append(size, &len, snprintf(buf + len, size - len, "%s %lu%s", integ_counters[c],
+               (unsigned long)mon->counters[c], (c + 1U < PPG_INTEG_COUNTER_COUNT) ? "  " : "\r\n"));
+    }
+
+    return len;
+}
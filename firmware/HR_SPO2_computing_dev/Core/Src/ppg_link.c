@@ -0,0 +1,170 @@
+/**
+ ******************************************************************************
+ * @file    ppg_link.c
+ * @brief   Simulation link framing implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_link.h"
+#include <string.h>
+
+/* CRC-16/CCITT-FALSE, one nibble at a time */
+static const uint16_t link_crc_nibble[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static inline uint16_t PPG_Link_CrcByte(uint16_t crc, uint8_t byte)
+{
+    crc = (uint16_t)((crc << 4) ^ link_crc_nibble[((crc >> 12) ^ (byte >> 4)) & 0x0FU]);
+    crc = (uint16_t)((crc << 4) ^ link_crc_nibble[((crc >> 12) ^ byte) & 0x0FU]);
+    return crc;
+}
+
+/* Queue the bytes of the rejected frame after its sync word ahead of the
+ * ones still pending, so the sync hunt resumes from the byte after it */
+static void PPG_Link_Rescan(PPG_LinkParser_t *parser)
+{
+    const PPG_LinkFrame_t *f = &parser->frame;
+    uint8_t *r    = parser->rescan;
+    uint16_t n    = (uint16_t)(PPG_LINK_HEADER_SIZE - 2U + f->length + PPG_LINK_CRC_SIZE);
+    uint16_t left = (uint16_t)(parser->rescan_len - parser->rescan_pos);
+
+    /* Cannot happen: frames returned meanwhile consume more than arrives */
+    if (left > PPG_LINK_RESCAN_SIZE - n)
+        left = (uint16_t)(PPG_LINK_RESCAN_SIZE - n);
+
+    memmove(&r[n], &r[parser->rescan_pos], left);
+    r[0] = f->type;
+    r[1] = f->length;
+    PPG_Link_Put16(&r[2], f->sequence);
+    memcpy(&r[4], f->payload, f->length);
+    PPG_Link_Put16(&r[4U + f->length], parser->crc_rx);
+
+    parser->rescan_pos = 0;
+    parser->rescan_len = (uint16_t)(n + left);
+}
+
+static const PPG_LinkFrame_t *PPG_Link_Step(PPG_LinkParser_t *parser, uint8_t byte)
+{
+    PPG_LinkFrame_t *f = &parser->frame;
+    uint16_t i = parser->index;
+
+    /* Sync word hunt: 0xA5 0xA5 0x5A still syncs on the second 0xA5 */
+    if (i == 0U)
+    {
+        parser->index = (byte == PPG_LINK_SYNC0) ? 1U : 0U;
+        return NULL;
+    }
+    if (i == 1U)
+    {
+        parser->index = (byte == PPG_LINK_SYNC1) ? 2U : ((byte == PPG_LINK_SYNC0) ? 1U : 0U);
+        parser->crc   = 0xFFFFU;
+        return NULL;
+    }
+
+    uint16_t end = (uint16_t)(PPG_LINK_HEADER_SIZE + f->length);
+
+    if (i < end)
+    {
+        parser->crc = PPG_Link_CrcByte(parser->crc, byte);
+
+        switch (i)
+        {
+        case 2:  f->type = byte; break;
+        case 3:  f->length = byte; break;
+        case 4:  f->sequence = byte; break;
+        case 5:  f->sequence |= (uint16_t)byte << 8; break;
+        default: f->payload[i - PPG_LINK_HEADER_SIZE] = byte; break;
+        }
+        parser->index++;
+        return NULL;
+    }
+
+    if (i == end)
+    {
+        parser->crc_rx = byte;
+        parser->index++;
+        return NULL;
+    }
+
+    /* Last CRC byte: frame complete, hunt for the next sync word */
+    parser->crc_rx |= (uint16_t)byte << 8;
+    parser->index = 0;
+
+    if (parser->crc_rx != parser->crc)
+    {
+        parser->crc_errors++;
+        PPG_Link_Rescan(parser);
+        return NULL;
+    }
+    return f;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+uint16_t PPG_Link_Crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        crc = PPG_Link_CrcByte(crc, data[i]);
+
+    return crc;
+}
+
+size_t PPG_Link_Encode(uint8_t *buf, uint8_t type, uint16_t sequence,
+                       const uint8_t *payload, uint8_t len)
+{
+    buf[0] = PPG_LINK_SYNC0;
+    buf[1] = PPG_LINK_SYNC1;
+    buf[2] = type;
+    buf[3] = len;
+    PPG_Link_Put16(&buf[4], sequence);
+    if (len > 0U)
+        memcpy(&buf[PPG_LINK_HEADER_SIZE], payload, len);
+
+    size_t end = PPG_LINK_HEADER_SIZE + len;
+    PPG_Link_Put16(&buf[end], PPG_Link_Crc16(0xFFFFU, &buf[2], end - 2U));
+
+    return end + PPG_LINK_CRC_SIZE;
+}
+
+void PPG_Link_ParserReset(PPG_LinkParser_t *parser)
+{
+    parser->index      = 0;
+    parser->crc        = 0xFFFFU;
+    parser->crc_rx     = 0;
+    parser->crc_errors = 0;
+    parser->rescan_pos = 0;
+    parser->rescan_len = 0;
+}
+
+const PPG_LinkFrame_t *PPG_Link_Parse(PPG_LinkParser_t *parser, uint8_t byte)
+{
+    const PPG_LinkFrame_t *f = NULL;
+
+    /* Bytes awaiting a rescan come first: queue this one behind them */
+    if (parser->rescan_pos < parser->rescan_len)
+    {
+        if (parser->rescan_len == PPG_LINK_RESCAN_SIZE)
+        {
+            parser->rescan_len = (uint16_t)(parser->rescan_len - parser->rescan_pos);
+            memmove(parser->rescan, &parser->rescan[parser->rescan_pos], parser->rescan_len);
+            parser->rescan_pos = 0;
+        }
+        parser->rescan[parser->rescan_len++] = byte;
+    }
+    else
+        f = PPG_Link_Step(parser, byte);
+
+    while ((f == NULL) && (parser->rescan_pos < parser->rescan_len))
+        f = PPG_Link_Step(parser, parser->rescan[parser->rescan_pos++]);
+
+    return f;
+}
@@ -0,0 +1,955 @@
+/**
+ ******************************************************************************
+ * @file    ppg_log_format.c
+ * @brief   Compact binary session log implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_log_format.h"
+#include "ppg_link.h"
+#include <string.h>
+
+_Static_assert(PPG_FRAME_MAX_SAMPLES <= PPG_LOG_MAX_SAMPLES, "the decoder must hold the frames of this build");
+_Static_assert(PPG_LOG_BLOCK_FRAMES > 0U, "a block holds at least one frame");
+_Static_assert(((PPG_LOG_INDEX_ENTRIES % 2U) == 0U) && (PPG_LOG_INDEX_ENTRIES <= UINT16_MAX),
+               "index entries are merged in pairs");
+_Static_assert(PPG_LOG_INDEX_EVENTS <= UINT16_MAX, "event count is a uint16");
+_Static_assert(PPG_LOG_EVENT_COUNT <= 16, "event bits are a uint16");
+
+#define PPG_LOG_TAG_KNOWN      (PPG_LOG_TAG_FRAME | PPG_LOG_TAG_GAP | PPG_LOG_TAG_LAYOUT | \
+                                PPG_LOG_TAG_RESULTS | PPG_LOG_TAG_EVENTS)
+#define PPG_LOG_CH_ALL         (PPG_CH_MASK(PPG_CH_COUNT) - 1U)
+
+/** What the index takes from a frame, encoded or decoded */
+typedef struct
+{
+    uint32_t        sequence;
+    uint32_t        timestamp;
+    uint16_t        count;
+    uint16_t        channel_mask;
+    const uint16_t *samples[PPG_CH_COUNT];
+    uint32_t        hr;     /* 0.01 bpm */
+    uint32_t        spo2;   /* 0.01 % */
+    uint16_t        events; /* PPG_FRAME_EVENT_* */
+} PPG_LogIndexFrame_t;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static inline uint32_t PPG_Log_ZigZag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t PPG_Log_UnZigZag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1U);
+}
+
+static void PPG_Log_PutVarint(PPG_BitWriter_t *bw, uint32_t v)
+{
+    while (v >= 0x80U)
+    {
+        PPG_BitWriter_Put(bw, (v & 0x7FU) | 0x80U, 8U);
+        v >>= 7;
+    }
+    PPG_BitWriter_Put(bw, v, 8U);
+}
+
+/** Cleared br->ok on a read past the end or a malformed varint */
+static uint32_t PPG_Log_GetVarint(PPG_BitReader_t *br)
+{
+    uint32_t v = 0;
+
+    for (uint32_t shift = 0; (shift < (7U * PPG_LOG_VARINT_MAX)) && br->ok; shift += 7U)
+    {
+        uint32_t b = PPG_BitReader_Get(br, 8U);
+
+        v |= (b & 0x7FU) << shift;
+        if ((b & 0x80U) == 0U)
+            return v;
+    }
+
+    br->ok = false;
+    return 0;
+}
+
+/** Plain frame: one bit; else a zero bit and the tag (0: end of the block) */
+static void PPG_Log_PutTag(PPG_BitWriter_t *bw, uint32_t tag)
+{
+    if (tag == PPG_LOG_TAG_FRAME)
+        PPG_BitWriter_Put(bw, 1U, 1U);
+    else
+        PPG_BitWriter_Put(bw, tag, 1U + PPG_LOG_TAG_BITS);
+}
+
+/** Tag of the next frame: a byte before version 5 */
+static uint8_t PPG_Log_GetTag(PPG_BitReader_t *br, uint16_t version)
+{
+    if (version < 5U)
+        return (uint8_t)PPG_BitReader_Get(br, 8U);
+    if (PPG_BitReader_Get(br, 1U) != 0U)
+        return PPG_LOG_TAG_FRAME;
+    return (uint8_t)PPG_BitReader_Get(br, PPG_LOG_TAG_BITS);
+}
+
+/** Result in hundredths; negative and NaN as 0 */
+static uint32_t PPG_Log_Centi(float x)
+{
+    if (!(x > 0.0f))
+        return 0;
+    if (x >= 42949672.0f)
+        return UINT32_MAX;
+    return (uint32_t)((x * 100.0f) + 0.5f);
+}
+
+/** Fresh block state: no previous sample, codec reset points */
+static void PPG_Log_ResetState(PPG_LogState_t *s, uint32_t sequence, uint32_t timestamp)
+{
+    memset(s, 0, sizeof(*s));
+    s->sequence  = sequence;
+    s->timestamp = timestamp;
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_Codec_Reset(&s->codec[ch]);
+}
+
+/** Decode the frame after its tag into frame, advancing the block state */
+static bool PPG_Log_DecodeFrame(PPG_BitReader_t *br, uint8_t tag, const PPG_LogHeader_t *header,
+                                PPG_LogState_t *s, PPG_LogFrame_t *frame)
+{
+    uint32_t order = PPG_LOG_FLAG_GET_ORDER(header->flags);
+
+    if ((tag & PPG_LOG_TAG_GAP) != 0U)
+    {
+        s->sequence  += PPG_Log_GetVarint(br);
+        s->timestamp += (uint32_t)PPG_Log_UnZigZag(PPG_Log_GetVarint(br));
+    }
+
+    if ((tag & PPG_LOG_TAG_LAYOUT) != 0U)
+    {
+        uint32_t count = PPG_Log_GetVarint(br);
+        uint32_t mask  = PPG_Log_GetVarint(br);
+
+        if ((count > PPG_LOG_MAX_SAMPLES) || ((mask & ~PPG_LOG_CH_ALL) != 0U))
+            return false;
+
+        s->count        = (uint16_t)count;
+        s->channel_mask = (uint16_t)mask;
+    }
+
+    frame->sequence     = s->sequence;
+    frame->timestamp    = s->timestamp;
+    frame->count        = s->count;
+    frame->channel_mask = s->channel_mask;
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        if ((s->channel_mask & PPG_CH_MASK(ch)) == 0U)
+        {
+            memset(frame->samples[ch], 0, s->count * sizeof(uint16_t));
+            continue;
+        }
+
+        if (order > 0U)
+        {
+            if (!PPG_Codec_Decode(&s->codec[ch], order, br, frame->samples[ch], s->count))
+                return false;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < s->count; i++)
+        {
+            int32_t v = (int32_t)s->last[ch] + PPG_Log_UnZigZag(PPG_Log_GetVarint(br));
+
+            if ((v < 0) || (v > (int32_t)UINT16_MAX))
+                return false;
+
+            s->last[ch]           = (uint16_t)v;
+            frame->samples[ch][i] = (uint16_t)v;
+        }
+    }
+
+    /* Before version 5 the samples of each frame end on a byte */
+    if ((header->version < 5U) && (order > 0U))
+        (void)PPG_BitReader_Align(br);
+
+    uint32_t outputs = PPG_LOG_HAS_BANDPASS(header) ? PPG_Log_GetVarint(br) : 0U;
+
+    if (outputs > (PPG_LOG_MAX_SAMPLES + 1U))
+        return false;
+
+    frame->outputs = (uint16_t)outputs;
+    for (uint32_t i = 0; i < outputs; i++)
+    {
+        int32_t v = (int32_t)s->last_bandpassed + PPG_Log_UnZigZag(PPG_Log_GetVarint(br));
+
+        if ((v < INT16_MIN) || (v > INT16_MAX))
+            return false;
+
+        s->last_bandpassed   = (int16_t)v;
+        frame->bandpassed[i] = (int16_t)v;
+    }
+
+    if ((tag & PPG_LOG_TAG_RESULTS) != 0U)
+    {
+        for (uint32_t i = 0; i < 4U; i++)
+            s->results[i] = PPG_Log_GetVarint(br);
+    }
+
+    frame->hr_bpm          = (float)s->results[0] * 0.01f;
+    frame->hr_spectral_bpm = (float)s->results[1] * 0.01f;
+    frame->spo2_percent    = (float)s->results[2] * 0.01f;
+    frame->beat_count      = s->results[3];
+    frame->events          = ((tag & PPG_LOG_TAG_EVENTS) != 0U) ? (uint16_t)PPG_Log_GetVarint(br) : 0U;
+
+    s->sequence  += 1U;
+    s->timestamp += s->count;
+    return br->ok;
+}
+
+/** Start reading the block at pos (sync word): first sequence and timestamp, fresh state */
+static void PPG_Log_DecodeBlockStart(PPG_BitReader_t *br, const uint8_t *data, size_t pos, size_t end,
+                                     PPG_LogState_t *s)
+{
+    PPG_BitReader_Init(br, &data[pos + 2U], end - pos - 2U);
+
+    uint32_t sequence  = PPG_Log_GetVarint(br);
+    uint32_t timestamp = PPG_Log_GetVarint(br);
+
+    PPG_Log_ResetState(s, sequence, timestamp);
+}
+
+/** Parse the block at pos (sync word) to its end and check the CRC */
+static bool PPG_LogReader_CheckBlock(PPG_LogReader_t *reader, size_t pos, PPG_LogFrame_t *scratch)
+{
+    PPG_BitReader_t br;
+    PPG_LogState_t  s;
+    uint32_t        frames = 0;
+
+    PPG_Log_DecodeBlockStart(&br, reader->data, pos, reader->size, &s);
+
+    while (br.ok)
+    {
+        uint8_t tag = PPG_Log_GetTag(&br, reader->header.version);
+
+        if (!br.ok)
+            return false;
+        if (tag == 0U)
+            break;
+
+        /* The first frame sets the layout and the results */
+        if (((tag & ~PPG_LOG_TAG_KNOWN) != 0U) || ((tag & PPG_LOG_TAG_FRAME) == 0U) ||
+            ((frames == 0U) && ((tag & (PPG_LOG_TAG_LAYOUT | PPG_LOG_TAG_RESULTS)) !=
+                                (PPG_LOG_TAG_LAYOUT | PPG_LOG_TAG_RESULTS))) ||
+            !PPG_Log_DecodeFrame(&br, tag, &reader->header, &s, scratch))
+            return false;
+
+        frames++;
+    }
+
+    /* The stream ends on a byte, the CRC follows */
+    size_t end = pos + 2U + PPG_BitReader_Align(&br);
+
+    if (!br.ok || (frames == 0U) || ((end + 2U) > reader->size))
+        return false;
+
+    if (PPG_Link_Crc16(reader->header.crc, &reader->data[pos], end - pos) != PPG_Link_Get16(&reader->data[end]))
+        return false;
+
+    reader->block_end = end;
+    return true;
+}
+
+static inline uint16_t PPG_Log_Sat16(uint32_t v)
+{
+    return (v > UINT16_MAX) ? UINT16_MAX : (uint16_t)v;
+}
+
+static void PPG_LogIndex_Event(PPG_LogIndex_t *idx, uint32_t timestamp, PPG_LogEventType_t type,
+                               uint32_t value)
+{
+    if (idx->entry_count > 0U)
+        idx->entries[idx->entry_count - 1U].events |= PPG_LOG_EVENT_BIT(type);
+
+    if (idx->event_count >= PPG_LOG_INDEX_EVENTS)
+    {
+        idx->dropped++;
+        return;
+    }
+
+    PPG_LogEvent_t *e = &idx->events[idx->event_count++];
+
+    e->timestamp = timestamp;
+    e->type      = (uint16_t)type;
+    e->value     = PPG_Log_Sat16(value);
+}
+
+/** A block starts: it joins the last entry or opens one, merging pairs of entries when full */
+static void PPG_LogIndex_Block(PPG_LogIndex_t *idx, uint32_t offset, const PPG_LogIndexFrame_t *f)
+{
+    idx->blocks++;
+
+    if ((idx->entry_count > 0U) && (idx->entry_blocks < idx->stride))
+    {
+        idx->entry_blocks++;
+        return;
+    }
+
+    if (idx->entry_count == PPG_LOG_INDEX_ENTRIES)
+    {
+        /* Entry i takes 2i and 2i + 1: both read before it is written */
+        for (uint32_t i = 0; i < (PPG_LOG_INDEX_ENTRIES / 2U); i++)
+        {
+            PPG_LogIndexEntry_t       *d = &idx->entries[i];
+            const PPG_LogIndexEntry_t *b = &idx->entries[(2U * i) + 1U];
+            PPG_LogIndexEntry_t        a = idx->entries[2U * i];
+
+            for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+            {
+                a.min[ch] = (b->min[ch] < a.min[ch]) ? b->min[ch] : a.min[ch];
+                a.max[ch] = (b->max[ch] > a.max[ch]) ? b->max[ch] : a.max[ch];
+            }
+            a.hr      = b->hr;
+            a.spo2    = b->spo2;
+            a.events |= b->events;
+            *d = a;
+        }
+
+        idx->entry_count = PPG_LOG_INDEX_ENTRIES / 2U;
+        idx->stride     *= 2U;
+    }
+
+    PPG_LogIndexEntry_t *e = &idx->entries[idx->entry_count++];
+
+    memset(e, 0, sizeof(*e));
+    memset(e->min, 0xFF, sizeof(e->min));
+    e->offset       = offset;
+    e->sequence     = f->sequence;
+    e->timestamp    = f->timestamp;
+    idx->entry_blocks = 1U;
+}
+
+static void PPG_LogIndex_Add(PPG_LogIndex_t *idx, bool block, uint32_t offset, const PPG_LogIndexFrame_t *f)
+{
+    if (block)
+        PPG_LogIndex_Block(idx, offset, f);
+    if (idx->entry_count == 0U)
+        return;
+
+    PPG_LogIndexEntry_t *e = &idx->entries[idx->entry_count - 1U];
+
+    if (idx->frames == 0U)
+        PPG_LogIndex_Event(idx, f->timestamp, PPG_LOG_EVENT_START, 0U);
+    else if (f->sequence != idx->sequence)
+        PPG_LogIndex_Event(idx, f->timestamp, PPG_LOG_EVENT_GAP, f->sequence - idx->sequence);
+
+    if ((f->events & PPG_FRAME_EVENT_WINDOW) != 0U)
+        PPG_LogIndex_Event(idx, f->timestamp, PPG_LOG_EVENT_WINDOW, f->channel_mask);
+    if ((f->events & PPG_FRAME_EVENT_SETTLED) != 0U)
+        PPG_LogIndex_Event(idx, f->timestamp, PPG_LOG_EVENT_SETTLED, f->channel_mask);
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        if ((f->channel_mask & PPG_CH_MASK(ch)) == 0U)
+            continue;
+
+        for (uint32_t i = 0; i < f->count; i++)
+        {
+            uint16_t x = f->samples[ch][i];
+
+            e->min[ch] = (x < e->min[ch]) ? x : e->min[ch];
+            e->max[ch] = (x > e->max[ch]) ? x : e->max[ch];
+        }
+    }
+
+    e->hr   = PPG_Log_Sat16(f->hr);
+    e->spo2 = PPG_Log_Sat16(f->spo2);
+
+    idx->frames++;
+    idx->sequence      = f->sequence + 1U;
+    idx->end_timestamp = f->timestamp + f->count;
+}
+
+/** Check an index (head to CRC) and attach it to the reader */
+static bool PPG_LogReader_AttachIndex(PPG_LogReader_t *reader, const uint8_t *buf, size_t len)
+{
+    if ((len < (PPG_LOG_IDX_HEAD_SIZE + 2U)) || (memcmp(&buf[PPG_LOG_IDX_MAGIC], "PPGI", 4U) != 0))
+        return false;
+
+    uint32_t entries = PPG_Link_Get16(&buf[PPG_LOG_IDX_ENTRIES]);
+    uint32_t events  = PPG_Link_Get16(&buf[PPG_LOG_IDX_EVENTS]);
+    size_t   body    = PPG_LOG_IDX_HEAD_SIZE + (entries * PPG_LOG_IDX_ENTRY_SIZE) +
+                       (events * PPG_LOG_IDX_EVENT_SIZE);
+
+    if ((len != (body + 2U)) ||
+        (PPG_Link_Crc16(reader->header.crc, buf, body) != PPG_Link_Get16(&buf[body])))
+        return false;
+
+    PPG_LogIndexView_t *v = &reader->index;
+
+    v->data          = buf;
+    v->entries       = entries;
+    v->events        = events;
+    v->stride        = PPG_Link_Get32(&buf[PPG_LOG_IDX_STRIDE]);
+    v->blocks        = PPG_Link_Get32(&buf[PPG_LOG_IDX_BLOCKS]);
+    v->frames        = PPG_Link_Get32(&buf[PPG_LOG_IDX_FRAMES]);
+    v->dropped       = PPG_Link_Get32(&buf[PPG_LOG_IDX_DROPPED]);
+    v->end_timestamp = PPG_Link_Get32(&buf[PPG_LOG_IDX_END_TS]);
+    return true;
+}
+
+/** First valid block starting in [from, to): offset and first timestamp */
+static bool PPG_LogReader_FindBlock(PPG_LogReader_t *reader, size_t from, size_t to, size_t *at,
+                                    uint32_t *timestamp, PPG_LogFrame_t *scratch)
+{
+    const uint8_t *data = reader->data;
+
+    for (size_t pos = from; (pos < to) && ((pos + 2U) <= reader->size); pos++)
+    {
+        if ((data[pos] != PPG_LOG_SYNC0) || (data[pos + 1U] != PPG_LOG_SYNC1) ||
+            !PPG_LogReader_CheckBlock(reader, pos, scratch))
+            continue;
+
+        PPG_BitReader_t br;
+        PPG_LogState_t  s;
+
+        PPG_Log_DecodeBlockStart(&br, data, pos, reader->size, &s);
+        *timestamp = s.timestamp;
+        *at        = pos;
+        return true;
+    }
+
+    return false;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Log_EncodeHeader(uint8_t *buf, PPG_LogHeader_t *header)
+{
+    memset(buf, 0, PPG_LOG_HEADER_SIZE);
+    memcpy(&buf[PPG_LOG_HDR_MAGIC], "PPGL", 4U);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_VERSION], header->version);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_SIZE], PPG_LOG_HEADER_SIZE);
+    PPG_Link_Put32(&buf[PPG_LOG_HDR_CAPTURE_HZ], header->capture_hz);
+    PPG_Link_Put32(&buf[PPG_LOG_HDR_ACQ_HZ], header->acq_hz);
+    PPG_Link_Put32(&buf[PPG_LOG_HDR_TOTAL], header->total_samples);
+    PPG_Link_Put32(&buf[PPG_LOG_HDR_START_MS], header->start_ms);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_PPG_FS], header->ppg_fs);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_FRAME], header->frame_samples);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_MASK], header->channel_mask);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_FLAGS], header->flags);
+
+    for (uint32_t i = 0; i < 2U; i++)
+    {
+        PPG_Link_Put16(&buf[PPG_LOG_HDR_LED_US + (2U * i)], header->led_us[i]);
+        PPG_Link_Put16(&buf[PPG_LOG_HDR_LED_LEVEL + (2U * i)], header->led_level[i]);
+    }
+
+    memcpy(&buf[PPG_LOG_HDR_BUILD], header->build, strnlen(header->build, PPG_LOG_BUILD_SIZE));
+
+    header->crc = PPG_Link_Crc16(0xFFFFU, buf, PPG_LOG_HDR_CRC);
+    PPG_Link_Put16(&buf[PPG_LOG_HDR_CRC], header->crc);
+}
+
+bool PPG_Log_DecodeHeader(const uint8_t *buf, size_t len, PPG_LogHeader_t *header)
+{
+    if ((len < PPG_LOG_HEADER_SIZE) || (memcmp(&buf[PPG_LOG_HDR_MAGIC], "PPGL", 4U) != 0))
+        return false;
+
+    /* Later versions may only append to the header */
+    uint16_t version = PPG_Link_Get16(&buf[PPG_LOG_HDR_VERSION]);
+    uint16_t size    = PPG_Link_Get16(&buf[PPG_LOG_HDR_SIZE]);
+
+    if ((version == 0U) || (version > PPG_LOG_VERSION) || (size < PPG_LOG_HEADER_SIZE) || (size > len))
+        return false;
+
+    if (PPG_LOG_FLAG_GET_ORDER(PPG_Link_Get16(&buf[PPG_LOG_HDR_FLAGS])) > PPG_CODEC_MAX_ORDER)
+        return false;
+
+    header->crc = PPG_Link_Get16(&buf[PPG_LOG_HDR_CRC]);
+    if (PPG_Link_Crc16(0xFFFFU, buf, PPG_LOG_HDR_CRC) != header->crc)
+        return false;
+
+    header->version       = version;
+    header->capture_hz    = PPG_Link_Get32(&buf[PPG_LOG_HDR_CAPTURE_HZ]);
+    header->acq_hz        = PPG_Link_Get32(&buf[PPG_LOG_HDR_ACQ_HZ]);
+    header->total_samples = PPG_Link_Get32(&buf[PPG_LOG_HDR_TOTAL]);
+    header->start_ms      = PPG_Link_Get32(&buf[PPG_LOG_HDR_START_MS]);
+    header->ppg_fs        = PPG_Link_Get16(&buf[PPG_LOG_HDR_PPG_FS]);
+    header->frame_samples = PPG_Link_Get16(&buf[PPG_LOG_HDR_FRAME]);
+    header->channel_mask  = PPG_Link_Get16(&buf[PPG_LOG_HDR_MASK]);
+    header->flags         = PPG_Link_Get16(&buf[PPG_LOG_HDR_FLAGS]);
+
+    for (uint32_t i = 0; i < 2U; i++)
+    {
+        header->led_us[i]    = PPG_Link_Get16(&buf[PPG_LOG_HDR_LED_US + (2U * i)]);
+        header->led_level[i] = PPG_Link_Get16(&buf[PPG_LOG_HDR_LED_LEVEL + (2U * i)]);
+    }
+
+    memcpy(header->build, &buf[PPG_LOG_HDR_BUILD], PPG_LOG_BUILD_SIZE);
+    header->build[PPG_LOG_BUILD_SIZE] = '\0';
+    return true;
+}
+
+void PPG_LogEncoder_Init(PPG_LogEncoder_t *enc, const PPG_LogHeader_t *header)
+{
+    memset(enc, 0, sizeof(*enc));
+    enc->seed  = header->crc;
+    enc->order    = (uint16_t)PPG_LOG_FLAG_GET_ORDER(header->flags);
+    enc->bandpass = PPG_LOG_HAS_BANDPASS(header);
+}
+
+size_t PPG_LogEncoder_Frame(PPG_LogEncoder_t *enc, const PPG_Frame_t *frame, uint8_t *buf)
+{
+    PPG_LogState_t  *s       = &enc->state;
+    PPG_BitWriter_t *bw      = &enc->bits;
+    uint16_t         count   = (frame->count < PPG_FRAME_MAX_SAMPLES) ? frame->count : PPG_FRAME_MAX_SAMPLES;
+    uint16_t         mask    = frame->channel_mask & PPG_LOG_CH_ALL;
+    uint16_t         outputs = (frame->results.count < PPG_FRAME_MAX_OUTPUTS) ?
+                               frame->results.count : PPG_FRAME_MAX_OUTPUTS;
+    uint32_t         results[4];
+    uint8_t          tag = PPG_LOG_TAG_FRAME;
+    size_t           n   = 0;
+
+    results[0] = PPG_Log_Centi(frame->results.hr_bpm);
+    results[1] = PPG_Log_Centi(frame->results.hr_spectral_bpm);
+    results[2] = PPG_Log_Centi(frame->results.spo2_percent);
+    results[3] = frame->results.beat_count;
+
+    if (enc->frames >= PPG_LOG_BLOCK_FRAMES)
+        n = PPG_LogEncoder_End(enc, buf);
+
+    size_t start = n;
+
+    if (enc->frames == 0U)
+    {
+        enc->block_start = (uint16_t)n;
+        buf[n++] = PPG_LOG_SYNC0;
+        buf[n++] = PPG_LOG_SYNC1;
+        PPG_BitWriter_Init(bw, &buf[n]);
+        PPG_Log_PutVarint(bw, frame->sequence);
+        PPG_Log_PutVarint(bw, frame->timestamp);
+
+        PPG_Log_ResetState(s, frame->sequence, frame->timestamp);
+        enc->crc = enc->seed;
+        tag         |= PPG_LOG_TAG_LAYOUT | PPG_LOG_TAG_RESULTS;
+    }
+    else
+    {
+        PPG_BitWriter_Resume(bw, &buf[n]);
+    }
+
+    if ((frame->sequence != s->sequence) || (frame->timestamp != s->timestamp))
+        tag |= PPG_LOG_TAG_GAP;
+    if ((count != s->count) || (mask != s->channel_mask))
+        tag |= PPG_LOG_TAG_LAYOUT;
+    if (memcmp(results, s->results, sizeof(results)) != 0)
+        tag |= PPG_LOG_TAG_RESULTS;
+    if (frame->results.events != 0U)
+        tag |= PPG_LOG_TAG_EVENTS;
+
+    PPG_Log_PutTag(bw, tag);
+
+    if ((tag & PPG_LOG_TAG_GAP) != 0U)
+    {
+        PPG_Log_PutVarint(bw, frame->sequence - s->sequence);
+        PPG_Log_PutVarint(bw, PPG_Log_ZigZag((int32_t)(frame->timestamp - s->timestamp)));
+    }
+
+    if ((tag & PPG_LOG_TAG_LAYOUT) != 0U)
+    {
+        PPG_Log_PutVarint(bw, count);
+        PPG_Log_PutVarint(bw, mask);
+    }
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        if ((mask & PPG_CH_MASK(ch)) == 0U)
+            continue;
+
+        const uint16_t *x = frame->samples[ch];
+
+        if (enc->order > 0U)
+        {
+            PPG_Codec_Encode(&s->codec[ch], enc->order, bw, x, count);
+            continue;
+        }
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            PPG_Log_PutVarint(bw, PPG_Log_ZigZag((int32_t)x[i] - (int32_t)s->last[ch]));
+            s->last[ch] = x[i];
+        }
+    }
+
+    if (enc->bandpass)
+    {
+        PPG_Log_PutVarint(bw, outputs);
+        for (uint32_t i = 0; i < outputs; i++)
+        {
+            int16_t y = frame->results.bandpassed[i];
+
+            PPG_Log_PutVarint(bw, PPG_Log_ZigZag((int32_t)y - (int32_t)s->last_bandpassed));
+            s->last_bandpassed = y;
+        }
+    }
+
+    if ((tag & PPG_LOG_TAG_RESULTS) != 0U)
+    {
+        for (uint32_t i = 0; i < 4U; i++)
+            PPG_Log_PutVarint(bw, results[i]);
+    }
+
+    if ((tag & PPG_LOG_TAG_EVENTS) != 0U)
+        PPG_Log_PutVarint(bw, frame->results.events);
+
+    /* Whole bytes out, the last bits stay pending in the encoder */
+    n += bw->pos;
+
+    s->sequence     = frame->sequence + 1U;
+    s->timestamp    = frame->timestamp + count;
+    s->count        = count;
+    s->channel_mask = mask;
+    memcpy(s->results, results, sizeof(results));
+
+    enc->crc = PPG_Link_Crc16(enc->crc, &buf[start], n - start);
+    enc->frames++;
+    return n;
+}
+
+size_t PPG_LogEncoder_End(PPG_LogEncoder_t *enc, uint8_t *buf)
+{
+    if (enc->frames == 0U)
+        return 0;
+
+    PPG_BitWriter_Resume(&enc->bits, buf);
+    PPG_Log_PutTag(&enc->bits, 0U);
+
+    size_t n = PPG_BitWriter_Flush(&enc->bits);
+
+    PPG_Link_Put16(&buf[n], PPG_Link_Crc16(enc->crc, buf, n));
+    enc->frames = 0;
+    return n + 2U;
+}
+
+void PPG_LogIndex_Init(PPG_LogIndex_t *idx)
+{
+    memset(idx, 0, sizeof(*idx));
+    idx->stride = 1U;
+}
+
+void PPG_LogIndex_Frame(PPG_LogIndex_t *idx, const PPG_LogEncoder_t *enc, uint32_t offset,
+                        const PPG_Frame_t *frame)
+{
+    PPG_LogIndexFrame_t f = {
+        .sequence     = frame->sequence,
+        .timestamp    = frame->timestamp,
+        .count        = (frame->count < PPG_FRAME_MAX_SAMPLES) ? frame->count : PPG_FRAME_MAX_SAMPLES,
+        .channel_mask = frame->channel_mask & PPG_LOG_CH_ALL,
+        .hr           = PPG_Log_Centi(frame->results.hr_bpm),
+        .spo2         = PPG_Log_Centi(frame->results.spo2_percent),
+        .events       = frame->results.events,
+    };
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        f.samples[ch] = frame->samples[ch];
+
+    PPG_LogIndex_Add(idx, enc->frames == 1U, offset + enc->block_start, &f);
+}
+
+void PPG_LogIndex_Finish(PPG_LogIndex_t *idx, PPG_LogIndexWriter_t *w, uint16_t seed, uint32_t offset)
+{
+    if (idx->frames > 0U)
+        PPG_LogIndex_Event(idx, idx->end_timestamp, PPG_LOG_EVENT_END, 0U);
+
+    w->part   = 0;
+    w->offset = offset;
+    w->crc    = seed;
+}
+
+size_t PPG_LogIndex_Encode(const PPG_LogIndex_t *idx, PPG_LogIndexWriter_t *w, uint8_t *buf)
+{
+    uint32_t part = w->part;
+    size_t   n;
+
+    if (part == 0U)
+    {
+        memcpy(&buf[PPG_LOG_IDX_MAGIC], "PPGI", 4U);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_ENTRIES], (uint16_t)idx->entry_count);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_EVENTS], (uint16_t)idx->event_count);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_STRIDE], idx->stride);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_BLOCKS], idx->blocks);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_FRAMES], idx->frames);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_DROPPED], idx->dropped);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_END_TS], idx->end_timestamp);
+        n = PPG_LOG_IDX_HEAD_SIZE;
+    }
+    else if (part <= idx->entry_count)
+    {
+        const PPG_LogIndexEntry_t *e = &idx->entries[part - 1U];
+
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_E_OFFSET], e->offset);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_E_SEQUENCE], e->sequence);
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_E_TIMESTAMP], e->timestamp);
+        for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        {
+            PPG_Link_Put16(&buf[PPG_LOG_IDX_E_MIN + (2U * ch)], e->min[ch]);
+            PPG_Link_Put16(&buf[PPG_LOG_IDX_E_MAX + (2U * ch)], e->max[ch]);
+        }
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_E_HR], e->hr);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_E_SPO2], e->spo2);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_E_EVENTS], e->events);
+        n = PPG_LOG_IDX_ENTRY_SIZE;
+    }
+    else if (part <= (idx->entry_count + idx->event_count))
+    {
+        const PPG_LogEvent_t *e = &idx->events[part - idx->entry_count - 1U];
+
+        PPG_Link_Put32(&buf[PPG_LOG_IDX_V_TIMESTAMP], e->timestamp);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_V_TYPE], e->type);
+        PPG_Link_Put16(&buf[PPG_LOG_IDX_V_VALUE], e->value);
+        n = PPG_LOG_IDX_EVENT_SIZE;
+    }
+    else if (part == (idx->entry_count + idx->event_count + 1U))
+    {
+        PPG_Link_Put16(buf, w->crc);
+        w->part++;
+        return 2U;
+    }
+    else if (part == (idx->entry_count + idx->event_count + 2U))
+    {
+        PPG_Link_Put32(buf, w->offset);
+        memcpy(&buf[4], "PPGX", 4U);
+        w->part++;
+        return PPG_LOG_TRAILER_SIZE;
+    }
+    else
+    {
+        return 0;
+    }
+
+    w->crc = PPG_Link_Crc16(w->crc, buf, n);
+    w->part++;
+    return n;
+}
+
+bool PPG_LogReader_Open(PPG_LogReader_t *reader, const uint8_t *data, size_t size)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->data = data;
+    reader->size = size;
+
+    if (!PPG_Log_DecodeHeader(data, size, &reader->header))
+        return false;
+
+    reader->pos = PPG_Link_Get16(&data[PPG_LOG_HDR_SIZE]);
+
+    /* Closed session: the trailer points back to the index, the blocks end there */
+    if ((size >= (reader->pos + PPG_LOG_TRAILER_SIZE)) &&
+        (memcmp(&data[size - 4U], "PPGX", 4U) == 0))
+    {
+        size_t at = PPG_Link_Get32(&data[size - PPG_LOG_TRAILER_SIZE]);
+
+        if ((at >= reader->pos) && (at < (size - PPG_LOG_TRAILER_SIZE)) &&
+            PPG_LogReader_AttachIndex(reader, &data[at], size - PPG_LOG_TRAILER_SIZE - at))
+            reader->size = at;
+    }
+
+    return true;
+}
+
+bool PPG_LogReader_Next(PPG_LogReader_t *reader, PPG_LogFrame_t *frame)
+{
+    const uint8_t *data = reader->data;
+
+    for (;;)
+    {
+        /* Between blocks: hunt for the next sync word that starts a valid block */
+        while (reader->block_end == 0U)
+        {
+            size_t pos = reader->pos;
+
+            if ((pos + 2U) > reader->size)
+            {
+                reader->skipped += reader->size - pos;
+                reader->pos      = reader->size;
+                return false;
+            }
+
+            if ((data[pos] == PPG_LOG_SYNC0) && (data[pos + 1U] == PPG_LOG_SYNC1))
+            {
+                if (PPG_LogReader_CheckBlock(reader, pos, frame))
+                {
+                    PPG_Log_DecodeBlockStart(&reader->bits, data, pos, reader->block_end, &reader->state);
+                    reader->block_start = pos;
+                    reader->blocks++;
+                    break;
+                }
+                reader->bad_blocks++;
+            }
+
+            reader->pos++;
+            reader->skipped++;
+        }
+
+        /* Checked by PPG_LogReader_CheckBlock() */
+        uint8_t tag = PPG_Log_GetTag(&reader->bits, reader->header.version);
+
+        if (tag == 0U)
+        {
+            reader->pos       = reader->block_end + 2U;
+            reader->block_end = 0;
+            continue;
+        }
+
+        (void)PPG_Log_DecodeFrame(&reader->bits, tag, &reader->header, &reader->state, frame);
+        reader->frames++;
+        return true;
+    }
+}
+
+void PPG_LogReader_Rewind(PPG_LogReader_t *reader)
+{
+    reader->pos         = PPG_Link_Get16(&reader->data[PPG_LOG_HDR_SIZE]);
+    reader->block_end   = 0;
+    reader->block_start = 0;
+    reader->blocks      = 0;
+    reader->bad_blocks  = 0;
+    reader->frames      = 0;
+    reader->skipped     = 0;
+}
+
+bool PPG_LogReader_Seek(PPG_LogReader_t *reader, uint32_t timestamp, PPG_LogFrame_t *scratch)
+{
+    const PPG_LogIndexView_t *v  = &reader->index;
+    size_t                    lo = PPG_Link_Get16(&reader->data[PPG_LOG_HDR_SIZE]);
+    size_t                    hi = reader->size;
+    size_t                    at;
+    uint32_t                  ts;
+    PPG_LogIndexEntry_t       e;
+
+    /* Last entry starting at or before the timestamp, and the next one */
+    if (v->entries > 0U)
+    {
+        uint32_t l = 0;
+        uint32_t h = v->entries;
+
+        while ((h - l) > 1U)
+        {
+            uint32_t m = l + ((h - l) / 2U);
+
+            (void)PPG_LogReader_IndexEntry(reader, m, &e);
+            if (e.timestamp <= timestamp)
+                l = m;
+            else
+                h = m;
+        }
+
+        (void)PPG_LogReader_IndexEntry(reader, l, &e);
+        lo = e.offset;
+        if (PPG_LogReader_IndexEntry(reader, l + 1U, &e))
+            hi = e.offset;
+    }
+
+    if (!PPG_LogReader_FindBlock(reader, lo, reader->size, &lo, &ts, scratch))
+    {
+        reader->block_end = 0;
+        return false;
+    }
+
+    /* Bisect the blocks: lo starts at or before the timestamp, none from hi on does */
+    if (ts <= timestamp)
+    {
+        while ((hi - lo) > 2U)
+        {
+            size_t mid = lo + ((hi - lo) / 2U);
+
+            if (PPG_LogReader_FindBlock(reader, mid, hi, &at, &ts, scratch) && (ts <= timestamp))
+                lo = at;
+            else
+                hi = mid;
+        }
+    }
+
+    reader->pos       = lo;
+    reader->block_end = 0;
+    return true;
+}
+
+bool PPG_LogReader_IndexEntry(const PPG_LogReader_t *reader, uint32_t i, PPG_LogIndexEntry_t *entry)
+{
+    if (i >= reader->index.entries)
+        return false;
+
+    const uint8_t *p = &reader->index.data[PPG_LOG_IDX_HEAD_SIZE + (i * PPG_LOG_IDX_ENTRY_SIZE)];
+
+    entry->offset    = PPG_Link_Get32(&p[PPG_LOG_IDX_E_OFFSET]);
+    entry->sequence  = PPG_Link_Get32(&p[PPG_LOG_IDX_E_SEQUENCE]);
+    entry->timestamp = PPG_Link_Get32(&p[PPG_LOG_IDX_E_TIMESTAMP]);
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        entry->min[ch] = PPG_Link_Get16(&p[PPG_LOG_IDX_E_MIN + (2U * ch)]);
+        entry->max[ch] = PPG_Link_Get16(&p[PPG_LOG_IDX_E_MAX + (2U * ch)]);
+    }
+    entry->hr     = PPG_Link_Get16(&p[PPG_LOG_IDX_E_HR]);
+    entry->spo2   = PPG_Link_Get16(&p[PPG_LOG_IDX_E_SPO2]);
+    entry->events = PPG_Link_Get16(&p[PPG_LOG_IDX_E_EVENTS]);
+    return true;
+}
+
+bool PPG_LogReader_IndexEvent(const PPG_LogReader_t *reader, uint32_t i, PPG_LogEvent_t *event)
+{
+    if (i >= reader->index.events)
+        return false;
+
+    const uint8_t *p = &reader->index.data[PPG_LOG_IDX_HEAD_SIZE +
+                                           (reader->index.entries * PPG_LOG_IDX_ENTRY_SIZE) +
+                                           (i * PPG_LOG_IDX_EVENT_SIZE)];
+
+    event->timestamp = PPG_Link_Get32(&p[PPG_LOG_IDX_V_TIMESTAMP]);
+    event->type      = PPG_Link_Get16(&p[PPG_LOG_IDX_V_TYPE]);
+    event->value     = PPG_Link_Get16(&p[PPG_LOG_IDX_V_VALUE]);
+    return true;
+}
+
+void PPG_LogReader_BuildIndex(PPG_LogReader_t *reader, PPG_LogIndex_t *idx, uint8_t *buf,
+                              PPG_LogFrame_t *scratch)
+{
+    PPG_LogIndexWriter_t w;
+    uint32_t             blocks = 0;
+    size_t               n      = 0;
+    size_t               piece;
+
+    PPG_LogIndex_Init(idx);
+    PPG_LogReader_Rewind(reader);
+
+    while (PPG_LogReader_Next(reader, scratch))
+    {
+        PPG_LogIndexFrame_t f = {
+            .sequence     = scratch->sequence,
+            .timestamp    = scratch->timestamp,
+            .count        = scratch->count,
+            .channel_mask = scratch->channel_mask,
+            .hr           = PPG_Log_Centi(scratch->hr_bpm),
+            .spo2         = PPG_Log_Centi(scratch->spo2_percent),
+            .events       = scratch->events,
+        };
+
+        for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+            f.samples[ch] = scratch->samples[ch];
+
+        PPG_LogIndex_Add(idx, reader->blocks != blocks, (uint32_t)reader->block_start, &f);
+        blocks = reader->blocks;
+    }
+
+    PPG_LogIndex_Finish(idx, &w, reader->header.crc, (uint32_t)reader->size);
+    while ((piece = PPG_LogIndex_Encode(idx, &w, &buf[n])) > 0U)
+        n += piece;
+
+    (void)PPG_LogReader_AttachIndex(reader, buf, n - PPG_LOG_TRAILER_SIZE);
+    PPG_LogReader_Rewind(reader);
+}
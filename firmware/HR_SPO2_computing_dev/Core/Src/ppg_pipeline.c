@@ -0,0 +1,254 @@
+/**
+ ******************************************************************************
+ * @file    ppg_pipeline.c
+ * @brief   Hardware-independent PPG processing pipeline implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_pipeline.h"
+#include "ppg_fir_coeffs.h"
+#include "ppg_profile.h"
+#include <string.h>
+
+#if (PPG_FIR_BP_FS != PPG_FS)
+#error "ppg_fir_coeffs.h was designed for another sampling rate: re-run export_fir_coeffs.py"
+#endif
+
+#if (PPG_FIR_BP_NUM_TAPS != PPG_PIPELINE_FIR_TAPS)
+#error "PPG_PIPELINE_FIR_TAPS does not match ppg_fir_coeffs.h"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** LED-lit sample minus the ambient light of the same period, floored at 0 */
+static inline uint16_t PPG_Pipeline_SubtractAmbient(uint16_t lit, uint16_t ambient)
+{
+    return (lit > ambient) ? (uint16_t)(lit - ambient) : 0U;
+}
+
+/** Beat detector and spectral HR on the band-passed HR channel (no beat while blanked) */
+static void PPG_Pipeline_TrackHeartRate(PPG_Pipeline_t *pipeline, bool blanked)
+{
+    PPG_PipelineOutput_t *out = &pipeline->out;
+
+    PPG_PROFILE_BEGIN(PPG_PROF_BEAT);
+    PPG_Beat_t beat;
+    if (blanked)
+    {
+        PPG_BeatDetector_Blank(&pipeline->beat_detector, out->bandpassed);
+    }
+    else if (PPG_BeatDetector_Update(&pipeline->beat_detector, out->bandpassed, &beat))
+    {
+        out->beat_count++;
+        if (beat.hr_bpm > 0.0f)
+            out->hr_bpm = beat.hr_bpm;
+
+        float spo2, ratio;
+        if (PPG_SpO2_OnBeat(&pipeline->spo2, &spo2, &ratio))
+        {
+            out->spo2_percent = spo2;
+            out->spo2_ratio   = ratio;
+        }
+    }
+    PPG_PROFILE_END(PPG_PROF_BEAT);
+
+    PPG_PROFILE_BEGIN(PPG_PROF_SPECTRAL);
+    PPG_SpectralHR_t spectral;
+    if (PPG_Spectral_Update(&pipeline->spectral, out->bandpassed, &spectral))
+        out->hr_spectral_bpm = spectral.hr_bpm;
+    PPG_PROFILE_END(PPG_PROF_SPECTRAL);
+}
+
+/** Capture rate * interpolation / decimation = PPG_FS */
+static void PPG_Pipeline_SetRatio(PPG_Pipeline_t *pipeline, uint32_t interpolation,
+                                  uint32_t decimation, uint32_t frame_samples)
+{
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_CIC_Init(&pipeline->decimator[ch], decimation);
+
+    pipeline->interpolation = interpolation;
+    pipeline->frame_samples = frame_samples;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Pipeline_Init(PPG_Pipeline_t *pipeline)
+{
+    PPG_FIR_Init(&pipeline->bp_fir, ppg_fir_bp_coeffs, PPG_FIR_BP_NUM_TAPS, pipeline->bp_fir_state);
+    PPG_FIR_Init(&pipeline->red_fir, ppg_fir_bp_coeffs, PPG_FIR_BP_NUM_TAPS, pipeline->red_fir_state);
+    PPG_BeatDetector_Init(&pipeline->beat_detector, PPG_FS);
+    PPG_SpO2_Init(&pipeline->spo2, PPG_FS);
+    PPG_Spectral_Init(&pipeline->spectral, PPG_FS);
+    PPG_Pipeline_SetRatio(pipeline, 1U, 1U, PPG_BLOCK_SIZE);
+
+    PPG_Pipeline_Reset(pipeline);
+}
+
+bool PPG_Pipeline_SetRate(PPG_Pipeline_t *pipeline, const PPG_RateConfig_t *rate)
+{
+    if ((rate->interpolation == 0U) || (rate->interpolation > rate->decimation) ||
+        (rate->decimation > PPG_FRAME_MAX_DECIMATION) || (rate->frame_samples > PPG_FRAME_MAX_SAMPLES))
+        return false;
+
+    PPG_Pipeline_SetRatio(pipeline, rate->interpolation, rate->decimation, rate->frame_samples);
+    return true;
+}
+
+void PPG_Pipeline_Reset(PPG_Pipeline_t *pipeline)
+{
+    PPG_FilterBank_Reset(&pipeline->filter_bank);
+    PPG_FIR_Reset(&pipeline->bp_fir);
+    PPG_FIR_Reset(&pipeline->red_fir);
+    PPG_BeatDetector_Reset(&pipeline->beat_detector);
+    PPG_SpO2_Reset(&pipeline->spo2);
+    PPG_Spectral_Reset(&pipeline->spectral);
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_CIC_Reset(&pipeline->decimator[ch]);
+
+    memset(&pipeline->out, 0, sizeof(pipeline->out));
+}
+
+PPG_Channel_t PPG_Pipeline_WindowChannel(uint32_t n)
+{
+    return (((n / PPG_WINDOW_SAMPLES) % 2U) == 0U) ? PPG_CH_RED : PPG_CH_IR;
+}
+
+void PPG_Pipeline_ProcessSample(PPG_Pipeline_t *pipeline, uint32_t n,
+                                PPG_Channel_t channel, uint16_t sample)
+{
+    PPG_PipelineOutput_t *out = &pipeline->out;
+    uint32_t in_window = n % PPG_WINDOW_SAMPLES;
+    bool     settled   = (in_window >= (SETTLING_TIME + PPG_FIR_BP_NUM_TAPS / 2U));
+
+    sample &= 0x0FFF;
+
+    out->channel = channel;
+
+    PPG_PROFILE_BEGIN(PPG_PROF_FILTER_BANK);
+    out->filtered[channel] = PPG_FilterBank_Update(&pipeline->filter_bank, channel, sample);
+    PPG_PROFILE_END(PPG_PROF_FILTER_BANK);
+
+    PPG_PROFILE_BEGIN(PPG_PROF_FIR);
+    out->bandpassed = PPG_FIR_Process(&pipeline->bp_fir, PPG_FIR_FromAdc12(sample));
+    PPG_PROFILE_END(PPG_PROF_FIR);
+
+    /*
+     * New window: the current beat is incomplete, and the band-pass output
+     * still carries the previous channel for its group delay. SpO2 and the
+     * beat detector skip the photodiode settling time plus that delay.
+     */
+    PPG_PROFILE_BEGIN(PPG_PROF_SPO2);
+    if (in_window == 0U)
+    {
+        PPG_SpO2_Discard(&pipeline->spo2, channel);
+        out->events |= PPG_FRAME_EVENT_WINDOW;
+    }
+    if (in_window == (SETTLING_TIME + PPG_FIR_BP_NUM_TAPS / 2U))
+        out->events |= PPG_FRAME_EVENT_SETTLED;
+    if (settled)
+        PPG_SpO2_Update(&pipeline->spo2, channel, sample, out->bandpassed);
+    PPG_PROFILE_END(PPG_PROF_SPO2);
+
+    PPG_Pipeline_TrackHeartRate(pipeline, !settled);
+}
+
+void PPG_Pipeline_ProcessSimultaneous(PPG_Pipeline_t *pipeline, uint32_t n,
+                                      uint16_t red, uint16_t ir, uint16_t ambient)
+{
+    PPG_PipelineOutput_t *out = &pipeline->out;
+
+    ambient &= 0x0FFF;
+    red = PPG_Pipeline_SubtractAmbient(red & 0x0FFF, ambient);
+    ir  = PPG_Pipeline_SubtractAmbient(ir & 0x0FFF, ambient);
+
+    out->channel = PPG_CH_IR;
+
+    PPG_PROFILE_BEGIN(PPG_PROF_FILTER_BANK);
+    out->filtered[PPG_CH_RED]     = PPG_FilterBank_Update(&pipeline->filter_bank, PPG_CH_RED, red);
+    out->filtered[PPG_CH_IR]      = PPG_FilterBank_Update(&pipeline->filter_bank, PPG_CH_IR, ir);
+    out->filtered[PPG_CH_AMBIENT] = PPG_FilterBank_Update(&pipeline->filter_bank, PPG_CH_AMBIENT, ambient);
+    PPG_PROFILE_END(PPG_PROF_FILTER_BANK);
+
+    PPG_PROFILE_BEGIN(PPG_PROF_FIR);
+    out->bandpassed = PPG_FIR_Process(&pipeline->bp_fir, PPG_FIR_FromAdc12(ir));
+    int16_t red_bp  = PPG_FIR_Process(&pipeline->red_fir, PPG_FIR_FromAdc12(red));
+    PPG_PROFILE_END(PPG_PROF_FIR);
+
+    /* No window switches: only the band-pass start-up is skipped */
+    PPG_PROFILE_BEGIN(PPG_PROF_SPO2);
+    if (n == (PPG_FIR_BP_NUM_TAPS / 2U))
+        out->events |= PPG_FRAME_EVENT_SETTLED;
+    if (n >= (PPG_FIR_BP_NUM_TAPS / 2U))
+    {
+        PPG_SpO2_Update(&pipeline->spo2, PPG_CH_RED, red, red_bp);
+        PPG_SpO2_Update(&pipeline->spo2, PPG_CH_IR, ir, out->bandpassed);
+    }
+    PPG_PROFILE_END(PPG_PROF_SPO2);
+
+    PPG_Pipeline_TrackHeartRate(pipeline, false);
+}
+
+void PPG_Pipeline_ProcessFrame(PPG_Pipeline_t *pipeline, PPG_Frame_t *frame)
+{
+    PPG_CIC_t *dec   = pipeline->decimator;
+    uint32_t   up    = pipeline->interpolation;
+    uint32_t   first = frame->sequence * pipeline->frame_samples;
+    bool simultaneous = ((frame->flags & PPG_FRAME_FLAG_SIMULTANEOUS) != 0U);
+    bool ambient      = ((frame->channel_mask & PPG_CH_MASK(PPG_CH_AMBIENT)) != 0U);
+    uint16_t k = 0;
+
+    PPG_PROFILE_BEGIN(PPG_PROF_FRAME);
+
+    pipeline->out.events = 0;
+
+    for (uint16_t i = 0; i < frame->count; i++)
+    {
+        for (uint32_t u = 0; u < up; u++)
+        {
+            /* PPG_FS sample this hold belongs to: complete every decimation holds */
+            uint32_t n = ((first + i) * up + u) / dec[0].ratio;
+
+            if (simultaneous)
+            {
+                uint16_t red, ir, amb = 0;
+                bool ready = PPG_CIC_Process(&dec[PPG_CH_RED], frame->samples[PPG_CH_RED][i], &red);
+
+                PPG_CIC_Process(&dec[PPG_CH_IR], frame->samples[PPG_CH_IR][i], &ir);
+                if (ambient)
+                    PPG_CIC_Process(&dec[PPG_CH_AMBIENT], frame->samples[PPG_CH_AMBIENT][i], &amb);
+                if (!ready)
+                    continue;
+
+                PPG_Pipeline_ProcessSimultaneous(pipeline, n, red, ir, amb);
+            }
+            else
+            {
+                /* Window edges fall on PPG_FS samples: one decimator for the stream */
+                PPG_Channel_t channel = PPG_Pipeline_WindowChannel(n);
+                uint16_t      sample;
+
+                if (!PPG_CIC_Process(&dec[0], frame->samples[channel][i], &sample))
+                    continue;
+
+                PPG_Pipeline_ProcessSample(pipeline, n, channel, sample);
+            }
+
+            if (k < PPG_FRAME_MAX_OUTPUTS)
+                frame->results.bandpassed[k++] = pipeline->out.bandpassed;
+        }
+    }
+
+    frame->results.count           = k;
+    frame->results.hr_bpm          = pipeline->out.hr_bpm;
+    frame->results.hr_spectral_bpm = pipeline->out.hr_spectral_bpm;
+    frame->results.spo2_percent    = pipeline->out.spo2_percent;
+    frame->results.beat_count      = pipeline->out.beat_count;
+    frame->results.events          = pipeline->out.events;
+
+    PPG_PROFILE_END(PPG_PROF_FRAME);
+}
@@ -6,31 +6,88 @@
  */
 
 #include "ppg_processing.h"
+#include "ppg_profile.h"
+#include "adc_scan.h"
+#include "led_phase.h"
+#include "ppg_decimator.h"
+#include "ppg_ring.h"
+#include "ppg_sim.h"
 #include "cmsis_os.h"
 #include "stm32f4xx_hal_adc.h"
 #include "FreeRTOS.h"
+#include "task.h"
 #include "queue.h"
 
 /* ------------------------------------------------------------------------- */
 /* Private state                                                             */
 /* ------------------------------------------------------------------------- */
 
-static ADC_HandleTypeDef *adc_red_h = NULL;
-static ADC_HandleTypeDef *adc_ir_h  = NULL;
-static QueueHandle_t ppgQueue = NULL;
+/* Acquisition ISR -> processing task: lock-free, the task is notified per frame */
+static void        *frame_ring_slots[PPG_FRAME_RING_LENGTH];
+static PPG_Ring_t   frame_ring;
+static TaskHandle_t ppg_task = NULL;
 
+/* Capture-rate profile: PPG_RATE_DEFAULT until PPG_SetRate() */
+static PPG_Rate_t       rate_profile = PPG_RATE_DEFAULT;
+static PPG_RateConfig_t rate_cfg;
+static bool             rate_known   = false;
 
-static uint16_t filter_buffer[PPG_FILTER_WINDOW];
-static uint8_t  filter_index = 0;
-static uint8_t  filter_count = 0;
+/* Sample timing and losses of the session (ISRs and processing task) */
+static PPG_Integrity_t integrity;
+static uint32_t        integrity_expected   = 0;   /* Next frame sequence at the processing task */
+static uint32_t        integrity_report_age = 0;   /* Seconds since the last report */
+
+#if !defined(USE_SIMULATION)
+/* Text of the integrity report, sent by interrupt */
+static char integrity_text[512];
+#endif
+
+/* Session state for the application tasks (PPG_EVENT_IDLE) */
+static osEventFlagsId_t ppg_events = NULL;
+
+static QueueHandle_t consumerQueue[PPG_CONSUMER_COUNT] = { NULL };
+
+/* DSP state of every stage (hardware independent, see ppg_pipeline.h) */
+static PPG_Pipeline_t pipeline;
+
+/* Acquisition frames (filled by ISR, passed by pointer to every stage) */
+static PPG_FramePool_t frame_pool;
+static PPG_Frame_t    *fill_frame = NULL;
+static uint32_t        acq_sample_count = 0;
+static volatile uint32_t ppg_sample_clock = 0;
+
+/* Oversampled acquisition -> capture rate, per channel (runs between sessions: no ramp-up) */
+static PPG_CIC_t acq_cic[PPG_CH_COUNT];
+
+#ifndef USE_SIMULATION
+/* Frame channel of each LED phase */
+static const PPG_Channel_t phase_channel[LED_PHASES] =
+{
+    [LED_PHASE_RED]  = PPG_CH_RED,
+    [LED_PHASE_IR]   = PPG_CH_IR,
+    [LED_PHASE_DARK] = PPG_CH_AMBIENT,
+};
+#endif
+
+/* Load statistics measurement window */
+static TickType_t stats_window_start = 0;
+static uint32_t   stats_wakeups      = 0;
+static uint32_t   stats_ctx_start    = 0;
+static uint32_t   stats_total_start  = 0;
+static uint32_t   stats_idle_start   = 0;
+static uint32_t   stats_adc_errors   = 0;
+static volatile bool stats_reset_pending = false;
+
+#ifdef PPG_PROFILE_UART
+/* Text of the stage profile sent at the end of a session */
+static char profile_text[768];
+#endif
 
 static volatile bool     ppg_running = false;
 static volatile uint32_t ppg_sample_count = 0;
 
 #ifdef USE_SIMULATION
 volatile uint16_t adc_raw = 0;
-volatile uint8_t  uart_ready = 0;
-uint8_t usart_rx_buffer[BUFFER_SIZE];
 #endif
 
 /* ------------------------------------------------------------------------- */
@@ -38,13 +95,18 @@ uint8_t usart_rx_buffer[BUFFER_SIZE];
 /* ------------------------------------------------------------------------- */
 
 volatile float    filtered_signal       = 0.0f;
+volatile int16_t  ppg_bandpassed        = 0;
 volatile uint32_t ppg_red_filtered      = 0;
 volatile uint32_t ppg_ir_filtered       = 0;
 volatile float    ppg_heart_rate_bpm    = 0.0f;
+volatile float    ppg_hr_spectral_bpm   = 0.0f;
 volatile float    ppg_spo2_percent      = 0.0f;
+volatile float    ppg_spo2_ratio        = 0.0f;
+volatile uint32_t ppg_beat_count        = 0;
+
+volatile PPG_LoadStats_t ppg_load_stats;
 
 volatile uint8_t dbg_start_called = 0;
-volatile uint32_t uart_rx_cnt = 0;
 
 
 
@@ -52,72 +114,388 @@ volatile uint32_t uart_rx_cnt = 0;
 /* Private helpers                                                           */
 /* ------------------------------------------------------------------------- */
 
-static uint16_t PPG_FilterMA(uint16_t sample)
+/**
+ * @brief Append one sample period to the frame being filled (ISR context).
+ *
+ * A frame is taken from the pool at the first sample of each block and
+ * pushed to the processing task when full. If no frame is free, or the
+ * ring is full, the block is dropped: its sequence number is skipped so
+ * every consumer sees the gap.
+ *
+ * @param[in] samples   One sample per channel, only those in mask are read.
+ * @param[in] mask      PPG_CH_MASK() of the channels acquired.
+ * @param[in] timestamp Sample clock at which this sample was taken.
+ */
+static void PPG_PushSampleFromISR(const uint16_t samples[PPG_CH_COUNT], uint16_t mask,
+                                  uint32_t timestamp, BaseType_t *pxHigherPriorityTaskWoken)
 {
+    if (!ppg_running)
+        return;
+
+    PPG_PROFILE_BEGIN(PPG_PROF_ACQ_ISR);
+
+    const uint16_t both = (uint16_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR));
+    uint32_t n = acq_sample_count++;
+    uint16_t i = (uint16_t)(n % rate_cfg.frame_samples);
+
+    if (i == 0U)
+    {
+        fill_frame = PPG_FramePool_Acquire(&frame_pool, n / rate_cfg.frame_samples, timestamp);
+        if (fill_frame == NULL)
+        {
+            ppg_load_stats.block_overruns++;
+            PPG_Integrity_Count(&integrity, PPG_INTEG_POOL_EMPTY, 1U);
+        }
+    }
+
+    if (fill_frame == NULL)
+    {
+        PPG_PROFILE_END(PPG_PROF_ACQ_ISR);
+        return;
+    }
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        if ((mask & PPG_CH_MASK(ch)) != 0U)
+            fill_frame->samples[ch][i] = samples[ch];
+    }
+    fill_frame->channel_mask |= mask;
+    if ((mask & both) == both)
+        fill_frame->flags |= PPG_FRAME_FLAG_SIMULTANEOUS;
+    fill_frame->count = (uint16_t)(i + 1U);
+
+    if (fill_frame->count < rate_cfg.frame_samples)
+    {
+        PPG_PROFILE_END(PPG_PROF_ACQ_ISR);
+        return;
+    }
+
+    fill_frame->queued_at = PPG_Profile_Now();
+    PPG_Integrity_Mark(&integrity, PPG_INTEG_FRAME, fill_frame->queued_at);
+
+    if (PPG_Ring_Push(&frame_ring, fill_frame))
+    {
+        if (ppg_task != NULL)
+            vTaskNotifyGiveFromISR(ppg_task, pxHigherPriorityTaskWoken);
+    }
+    else
+    {
+        PPG_Frame_Release(fill_frame);
+        ppg_load_stats.block_overruns++;
+        PPG_Integrity_Count(&integrity, PPG_INTEG_RING_OVERRUNS, 1U);
+    }
+    fill_frame = NULL;
+
+    PPG_PROFILE_END(PPG_PROF_ACQ_ISR);
+}
+
+#ifndef USE_SIMULATION
+/**
+ * @brief Append the RED / IR / ambient / battery samples of an ADC scan
+ *        block (DMA ISR).
+ *
+ * Reads the photodiode rank of each LED phase, and the battery rank of
+ * the dark phase (no LED current), in place through their strided views
+ * (adc_scan.h). The acquisition period index is the hardware sample clock.
+ */
+static void PPG_OnAdcBlockFromISR(const AdcScan_Block_t *block)
+{
+    const uint16_t mask = (uint16_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR) |
+                                     PPG_CH_MASK(PPG_CH_AMBIENT) | PPG_CH_MASK(PPG_CH_BATTERY));
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+    AdcScan_View_t view[LED_PHASES];
+    AdcScan_View_t battery = AdcScan_GetPhaseView(block, ADC_SCAN_BATTERY, LED_PHASE_DARK);
+    uint16_t samples[PPG_CH_COUNT] = { 0 };
+    uint32_t period = block->first / LED_PHASES;
+
+    if (ppg_running)
+        PPG_Integrity_Mark(&integrity, PPG_INTEG_ADC_BLOCK, PPG_Profile_Now());
+
+    for (uint32_t p = 0; p < LED_PHASES; p++)
+        view[p] = AdcScan_GetPhaseView(block, ADC_SCAN_PHOTODIODE, (LedPhase_t)p);
+
+    for (uint32_t k = 0; k < view[0].count; k++)
+    {
+        for (uint32_t p = 0; p < LED_PHASES; p++)
+            samples[phase_channel[p]] = view[p].base[k * view[p].stride];
+        samples[PPG_CH_BATTERY] = battery.base[k * battery.stride];
+
+        PPG_AcquireFromISR(samples, mask, period + k, &xHigherPriorityTaskWoken);
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
+
+/** Counter clock of the APB2 timers (TIM1, TIM9): twice PCLK2 when APB2 is divided */
+static uint32_t PPG_TimerClockHz(void)
+{
+    uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+
+    return ((RCC->CFGR & RCC_CFGR_PPRE2_2) != 0U) ? (2U * pclk2) : pclk2;
+}
+
+/**
+ * @brief Nominal intervals of the timed sources for the current profile.
+ *
+ * In ticks of the profiling time base (ppg_profile_tick_hz), rounded.
+ */
+static void PPG_SetIntegrityNominal(void)
+{
+    const uint32_t frame_periods = (uint32_t)rate_cfg.frame_samples * PPG_OVERSAMPLE;
+    uint64_t hz  = ppg_profile_tick_hz;
+    uint64_t acq = rate_cfg.acq_hz;
+
+    PPG_Integrity_SetNominal(&integrity, PPG_INTEG_SAMPLE_TICK, (uint32_t)((hz + acq / 2U) / acq));
+#ifdef USE_SIMULATION
+    /* No ADC block; frames complete on sample ticks */
+    PPG_Integrity_SetNominal(&integrity, PPG_INTEG_ADC_BLOCK, 0U);
+#else
+    const uint32_t block_periods = ADC_SCAN_HALF_SCANS / ADC_SCAN_PHASES;
+
+    PPG_Integrity_SetNominal(&integrity, PPG_INTEG_ADC_BLOCK, (uint32_t)((hz * block_periods + acq / 2U) / acq));
+#endif
+    PPG_Integrity_SetNominal(&integrity, PPG_INTEG_FRAME, (uint32_t)((hz * frame_periods + acq / 2U) / acq));
+}
+
+/**
+ * @brief Send the integrity statistics on USART2.
+ *
+ * Simulation: a REPORT frame of the link (ppg_sim.h). Hardware: text,
+ * by interrupt; skipped while the previous report is still going out.
+ */
+static void PPG_ReportIntegrity(void)
+{
+    static PPG_Integrity_t stats;      /* Off the task stack */
+
+    PPG_GetIntegrity(&stats);
+    integrity_report_age = 0;
+
 #ifdef USE_SIMULATION
-    PPG_PushSimulatedSample(sample);
+    PPG_Sim_Report(&stats, ppg_profile_tick_hz);
 #else
-    adc_raw = sample;
+    if (huart2.gState != HAL_UART_STATE_READY)
+        return;
+
+    size_t len = PPG_Integrity_Format(&stats, ppg_profile_tick_hz, integrity_text, sizeof(integrity_text));
+    HAL_UART_Transmit_IT(&huart2, (uint8_t *)integrity_text, (uint16_t)len);
 #endif
-    filter_buffer[filter_index] = adc_raw;
-    filter_index = (filter_index + 1U) % PPG_FILTER_WINDOW;
+}
+
+/** Hand a processed frame to every consumer with room in its queue */
+static void PPG_DispatchFrame(PPG_Frame_t *frame)
+{
+    for (uint32_t c = 0; c < PPG_CONSUMER_COUNT; c++)
+    {
+        PPG_Frame_Retain(frame, 1U);
+        if (xQueueSend(consumerQueue[c], &frame, 0) != pdPASS)
+        {
+            PPG_Frame_Release(frame);
+            ppg_load_stats.consumer_drops++;
+            PPG_Integrity_Count(&integrity, PPG_INTEG_CONSUMER_DROPS, 1U);
+        }
+    }
+}
+
+/** Give back the frames still queued for processing after a stop */
+static void PPG_DrainFrames(void)
+{
+    void *frame;
 
-    if (filter_count < PPG_FILTER_WINDOW)
-        filter_count++;
+    while (PPG_Ring_Pop(&frame_ring, &frame))
+        PPG_Frame_Release(frame);
+}
 
-    uint32_t sum = 0;
-    for (uint8_t i = 0; i < filter_count; i++)
-        sum += filter_buffer[i];
+/** Copy the pipeline outputs to the JScope variables */
+static void PPG_PublishDebug(void)
+{
+    const PPG_PipelineOutput_t *out = &pipeline.out;
+
+    filtered_signal     = (float)out->filtered[out->channel];
+    ppg_red_filtered    = out->filtered[PPG_CH_RED];
+    ppg_ir_filtered     = out->filtered[PPG_CH_IR];
+    ppg_bandpassed      = out->bandpassed;
+    ppg_heart_rate_bpm  = out->hr_bpm;
+    ppg_hr_spectral_bpm = out->hr_spectral_bpm;
+    ppg_spo2_percent    = out->spo2_percent;
+    ppg_spo2_ratio      = out->spo2_ratio;
+    ppg_beat_count      = out->beat_count;
+}
 
-    return (uint16_t)(sum / filter_count);
+static void PPG_ResetLoadStats(void)
+{
+    ppg_load_stats.blocks             = 0;
+    ppg_load_stats.block_overruns     = 0;
+    ppg_load_stats.consumer_drops     = 0;
+    ppg_load_stats.acq_errors         = 0;
+    ppg_load_stats.wakeups_per_s      = 0;
+    ppg_load_stats.ctx_switches_per_s = 0;
+    ppg_load_stats.cpu_load_permille  = 0;
+    PPG_Profile_Reset();
+
+    stats_window_start = xTaskGetTickCount();
+    stats_wakeups      = 0;
+    stats_ctx_start    = os_context_switches;
+    stats_total_start  = portGET_RUN_TIME_COUNTER_VALUE();
+    stats_idle_start   = ulTaskGetIdleRunTimeCounter();
+    stats_adc_errors   = AdcScan_GetErrors();
+}
+
+/**
+ * @brief Latch wakeups, context switches and CPU load once per second.
+ *
+ * CPU load is derived from the idle task run time (DWT cycle counter,
+ * see configGENERATE_RUN_TIME_STATS in FreeRTOSConfig.h).
+ */
+static void PPG_UpdateLoadStats(void)
+{
+    stats_wakeups++;
+
+    if ((xTaskGetTickCount() - stats_window_start) < configTICK_RATE_HZ)
+        return;
+
+    uint32_t total = portGET_RUN_TIME_COUNTER_VALUE() - stats_total_start;
+    uint32_t idle  = ulTaskGetIdleRunTimeCounter() - stats_idle_start;
+
+    ppg_load_stats.wakeups_per_s      = stats_wakeups;
+    ppg_load_stats.ctx_switches_per_s = os_context_switches - stats_ctx_start;
+    ppg_load_stats.cpu_load_permille  =
+        (total > 0U) ? (uint32_t)(1000U - (uint32_t)(((uint64_t)idle * 1000U) / total)) : 0U;
+    ppg_load_stats.acq_errors         = AdcScan_GetErrors() - stats_adc_errors;
+    PPG_Profile_Report();
+
+#if (PPG_INTEGRITY_REPORT_S > 0U)
+    if (++integrity_report_age >= PPG_INTEGRITY_REPORT_S)
+        PPG_ReportIntegrity();
+#endif
+
+    stats_window_start = xTaskGetTickCount();
+    stats_wakeups      = 0;
+    stats_ctx_start    = os_context_switches;
+    stats_total_start  = portGET_RUN_TIME_COUNTER_VALUE();
+    stats_idle_start   = ulTaskGetIdleRunTimeCounter();
+}
+
+/**
+ * @brief Publish the stage profile of the finished session.
+ *
+ * Always refreshes ppg_profile[] (JScope). With PPG_PROFILE_UART the
+ * report is also printed on USART2: the simulation script shares that
+ * port, so keep it for hardware runs with a plain terminal.
+ */
+static void PPG_ExportProfile(void)
+{
+    PPG_Profile_Report();
+
+#ifdef PPG_PROFILE_UART
+    size_t len = PPG_Profile_Format(profile_text, sizeof(profile_text));
+    HAL_UART_Transmit(&huart2, (uint8_t *)profile_text, (uint16_t)len, HAL_MAX_DELAY);
+#endif
 }
 
 /* ------------------------------------------------------------------------- */
 /* Public API                                                                */
 /* ------------------------------------------------------------------------- */
 
-void PPG_Init(ADC_HandleTypeDef *adc_red, ADC_HandleTypeDef *adc_ir)
+void PPG_Init(void)
 {
-    adc_red_h = adc_red;
-    adc_ir_h  = adc_ir;
-
-    filter_index = 0;
-    filter_count = 0;
+    configASSERT(PPG_GetRateConfig() != NULL);
+
+    PPG_Pipeline_Init(&pipeline);
+    PPG_Pipeline_SetRate(&pipeline, &rate_cfg);
+    PPG_FramePool_Init(&frame_pool);
+    PPG_Profile_Init(SystemCoreClock);
+    PPG_SetIntegrityNominal();
+    PPG_Integrity_Reset(&integrity);
     ppg_running  = false;
     ppg_sample_count = 0;
 
-    if (ppgQueue == NULL)
+    PPG_Ring_Init(&frame_ring, frame_ring_slots, PPG_FRAME_RING_LENGTH);
+
+    for (uint32_t c = 0; c < PPG_CONSUMER_COUNT; c++)
     {
-        ppgQueue = xQueueCreate(30, sizeof(uint16_t));
-        configASSERT(ppgQueue != NULL);
+        if (consumerQueue[c] == NULL)
+        {
+            consumerQueue[c] = xQueueCreate(PPG_CONSUMER_QUEUE_LENGTH, sizeof(PPG_Frame_t *));
+            configASSERT(consumerQueue[c] != NULL);
+        }
     }
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_CIC_Init(&acq_cic[ch], PPG_OVERSAMPLE);
+
+#ifdef USE_SIMULATION
+    PPG_Sim_Init(&huart2);
+#else
+    static bool listening = false;
+
+    if (!listening)
+        listening = AdcScan_AddListener(PPG_OnAdcBlockFromISR);
+#endif
+}
+
+void PPG_BindEvents(osEventFlagsId_t events)
+{
+    ppg_events = events;
+
+    if (!ppg_running)
+        osEventFlagsSet(ppg_events, PPG_EVENT_IDLE);
 }
 
 void PPG_Start(void)
 {
-    filter_index = 0;
-    filter_count = 0;
+    if (ppg_events != NULL)
+        osEventFlagsClear(ppg_events, PPG_EVENT_IDLE);
+
+    PPG_Pipeline_Reset(&pipeline);
+    PPG_PublishDebug();
     ppg_sample_count = 0;
 
+    /* A partially filled frame of the previous session goes back to the pool */
+    if (fill_frame != NULL)
+    {
+        PPG_Frame_Release(fill_frame);
+        fill_frame = NULL;
+    }
+    acq_sample_count = 0;
+    stats_reset_pending = true;
+
+    /* No source records until ppg_running is set */
+    PPG_Integrity_Reset(&integrity);
+    integrity_expected   = 0;
+    integrity_report_age = 0;
+
+#ifdef USE_SIMULATION
+    /* No stream between sessions: restart the decimators from rest */
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        PPG_CIC_Reset(&acq_cic[ch]);
+#else
+    /* Lit from the next phase on; the SpO2 start-up skip covers the settling */
+    LedPhase_SetEnabled(true);
+#endif
+
     dbg_start_called = 1;
     ppg_running = true;
 
 #ifdef USE_SIMULATION
-    uart_ready = 0;
-    HAL_UART_Receive_DMA(&huart2, usart_rx_buffer, BUFFER_SIZE); 
+    PPG_Sim_Start(rate_cfg.total_samples * PPG_OVERSAMPLE, rate_cfg.acq_hz);
 #endif
-
 }
 
 void PPG_Stop(void)
 {
     ppg_running = false;
 
-#ifndef USE_SIMULATION
-    // TODO: Replace simulation input with ADC DMA acquisition
+    /* Wake the processing task if it waits for a frame that will not come */
+    if ((ppg_task != NULL) && (xTaskGetCurrentTaskHandle() != ppg_task))
+        xTaskNotifyGive(ppg_task);
 
-    // HAL_ADC_Stop(...)
-    // HAL_TIM_Base_Stop_IT(...)
+#ifdef USE_SIMULATION
+    /* Queued ahead of STOP: the simulation script exits on STOP */
+    PPG_ReportIntegrity();
+    PPG_Sim_Stop();
+#else
+    LedPhase_SetEnabled(false);
 #endif
 }
 
@@ -129,63 +507,184 @@ bool PPG_IsRunning(void)
 
 void PPG_WaitUntilDone(void)
 {
-    while (ppg_running)
+    configASSERT(ppg_events != NULL);
+
+    osEventFlagsWait(ppg_events, PPG_EVENT_IDLE, osFlagsWaitAny | osFlagsNoClear, osWaitForever);
+}
+
+bool PPG_SetRate(PPG_Rate_t rate)
+{
+    PPG_RateConfig_t cfg;
+
+    if (ppg_running || !PPG_Rate_GetConfig(rate, PPG_TimerClockHz(), &cfg))
+        return false;
+
+    if (!PPG_Pipeline_SetRate(&pipeline, &cfg))
+        return false;
+
+#ifndef USE_SIMULATION
+    if (!LedPhase_SetRate(cfg.acq_hz, cfg.timer_clock_hz))
     {
-        osDelay(1);
+        PPG_Pipeline_SetRate(&pipeline, &rate_cfg);
+        return false;
     }
+#endif
+
+    rate_profile = rate;
+    rate_cfg     = cfg;
+    rate_known   = true;
+    PPG_SetIntegrityNominal();
+
+    /* Prescaler loaded at the next update, counter restarted under the new period */
+    __HAL_TIM_SET_PRESCALER(&htim9, cfg.tick_prescaler);
+    __HAL_TIM_SET_AUTORELOAD(&htim9, cfg.tick_period);
+    __HAL_TIM_SET_COUNTER(&htim9, 0U);
+    return true;
 }
 
-#ifdef USE_SIMULATION
-void PPG_PushSimulatedSample(uint16_t sample)
+void PPG_GetIntegrity(PPG_Integrity_t *stats)
+{
+    /* No lock: each field has one writer, a torn copy is off by a few events */
+    *stats = integrity;
+}
+
+const PPG_RateConfig_t *PPG_GetRateConfig(void)
 {
-    adc_raw = sample & 0x0FFF;
-    uart_ready = 1;
+    if (!rate_known)
+        rate_known = PPG_Rate_GetConfig(rate_profile, PPG_TimerClockHz(), &rate_cfg);
+
+    return rate_known ? &rate_cfg : NULL;
 }
+
+/** Run every stage over one frame and hand it to the consumers */
+static void PPG_ProcessFrame(PPG_Frame_t *frame)
+{
+#if PPG_PROFILE_ENABLE
+    PPG_Profile_Record(PPG_PROF_QUEUE_HOP, PPG_Profile_Now() - frame->queued_at);
 #endif
 
+    /* The session ends at total_samples, possibly inside this frame */
+    uint32_t first = frame->sequence * rate_cfg.frame_samples;
+    uint32_t total = rate_cfg.total_samples;
+
+    PPG_Integrity_Count(&integrity, PPG_INTEG_SEQUENCE_GAPS,
+                        PPG_Frame_CheckSequence(&integrity_expected, frame));
+
+    if (first >= total)
+        frame->count = 0;
+    else if ((first + frame->count) > total)
+        frame->count = (uint16_t)(total - first);
+
+    PPG_Pipeline_ProcessFrame(&pipeline, frame);
+    PPG_PublishDebug();
+
+    ppg_sample_count = first + frame->count;
+    if (ppg_sample_count >= total)
+        PPG_Stop();
+
+    PPG_DispatchFrame(frame);
+    PPG_Frame_Release(frame);
+
+    ppg_load_stats.blocks++;
+    PPG_UpdateLoadStats();
+}
+
 void PPG_ProcessStep(void)
 {
     if (!ppg_running)
         return;
 
-    uint16_t sample;
+    if (stats_reset_pending)
+    {
+        stats_reset_pending = false;
+        PPG_ResetLoadStats();
+    }
 
-    if (xQueueReceive(ppgQueue, &sample, portMAX_DELAY) != pdPASS)
-        return;
+    void    *items[PPG_PROCESS_BATCH];
+    uint32_t n;
 
-    filtered_signal = (float)PPG_FilterMA(sample);
-    ppg_red_filtered = (uint32_t)filtered_signal;
+    ppg_task = xTaskGetCurrentTaskHandle();
 
-    ppg_sample_count++;
+    /* A push between the pop and the take leaves the notification pending */
+    while (((n = PPG_Ring_PopBatch(&frame_ring, items, PPG_PROCESS_BATCH)) == 0U) && ppg_running)
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-    if (ppg_sample_count >= (PPG_TOTAL_SAMPLES))
+    for (uint32_t i = 0; i < n; i++)
     {
-        ppg_running = false;
-        PPG_Stop();
+        /* Frames past the end of the session go straight back to the pool */
+        if (ppg_running)
+            PPG_ProcessFrame(items[i]);
+        else
+            PPG_Frame_Release(items[i]);
+    }
+
+    if (!ppg_running)
+    {
+        PPG_DrainFrames();
+        PPG_ExportProfile();
+#ifndef USE_SIMULATION
+        /* After the blocking profile transmit (simulation: sent by PPG_Stop()) */
+        PPG_ReportIntegrity();
+#endif
+
+        if (ppg_events != NULL)
+            osEventFlagsSet(ppg_events, PPG_EVENT_IDLE);
     }
 }
 
+PPG_Frame_t *PPG_ReceiveFrame(PPG_Consumer_t consumer, uint32_t timeout_ms)
+{
+    PPG_Frame_t *frame = NULL;
 
-/* ------------------------------------------------------------------------- */
-/* UART ISR hook (simulation only)                                           */
-/* ------------------------------------------------------------------------- */
+    if ((consumer >= PPG_CONSUMER_COUNT) || (consumerQueue[consumer] == NULL))
+        return NULL;
 
-#ifdef USE_SIMULATION
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+    TickType_t ticks = (timeout_ms == osWaitForever) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+    if (xQueueReceive(consumerQueue[consumer], &frame, ticks) != pdPASS)
+        return NULL;
+
+    return frame;
+}
+
+void PPG_ReleaseFrame(PPG_Frame_t *frame)
 {
-    if (huart->Instance == USART2)
-    {
-        uart_rx_cnt++;
+    if (frame != NULL)
+        PPG_Frame_Release(frame);
+}
 
-        uint16_t sample =
-            ((uint16_t)usart_rx_buffer[1] << 8) |
-             usart_rx_buffer[0];
+void PPG_AcquireFromISR(const uint16_t samples[PPG_CH_COUNT], uint16_t mask,
+                        uint32_t clock, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    uint16_t out[PPG_CH_COUNT] = { 0 };
+    bool     ready = false;
 
-        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-        xQueueSendFromISR(ppgQueue, &sample, &xHigherPriorityTaskWoken);
+    if (ppg_running)
+        PPG_Integrity_CheckPeriod(&integrity, clock);
 
-        HAL_UART_Receive_DMA(&huart2, usart_rx_buffer, BUFFER_SIZE);
-        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    /* The decimators of a period run in lockstep: all ready together */
+    PPG_PROFILE_BEGIN(PPG_PROF_DECIMATOR);
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+    {
+        if ((mask & PPG_CH_MASK(ch)) != 0U)
+            ready = PPG_CIC_Process(&acq_cic[ch], samples[ch], &out[ch]);
     }
+    PPG_PROFILE_END(PPG_PROF_DECIMATOR);
+
+    if (ready)
+        PPG_PushSampleFromISR(out, mask, clock / PPG_OVERSAMPLE, pxHigherPriorityTaskWoken);
 }
+
+void PPG_SampleTickFromISR(void)
+{
+    uint32_t clock = ppg_sample_clock++;
+
+    if (ppg_running)
+        PPG_Integrity_Mark(&integrity, PPG_INTEG_SAMPLE_TICK, PPG_Profile_Now());
+
+#ifdef USE_SIMULATION
+    PPG_Sim_TickFromISR(clock);
+#else
+    (void)clock;
 #endif
+}
@@ -0,0 +1,252 @@
+/**
+ ******************************************************************************
+ * @file    ppg_profile.c
+ * @brief   Cycle-accurate profiling implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_profile.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__arm__)
+/* Cortex-M debug registers (same as the run-time stats in FreeRTOSConfig.h) */
+#define PROF_DEMCR        (*(volatile uint32_t *)0xE000EDFCUL)
+#define PROF_DWT_CTRL     (*(volatile uint32_t *)0xE0001000UL)
+#define PROF_DWT_CYCCNT   (*(volatile uint32_t *)0xE0001004UL)
+#else
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROF_USE_TSC      1
+#endif
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static PPG_ProfileStat_t prof_stats[PPG_PROF_COUNT];
+
+/* ------------------------------------------------------------------------- */
+/* Public debug variables (JScope)                                            */
+/* ------------------------------------------------------------------------- */
+
+volatile PPG_ProfileReport_t ppg_profile[PPG_PROF_COUNT];
+volatile uint32_t ppg_profile_tick_hz = 0;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static const char *const prof_names[PPG_PROF_COUNT] =
+{
+    "acq_isr", "decimator", "queue_hop", "frame", "filter_bank",
+    "fir", "spo2", "beat", "spectral", "log_encode",
+};
+
+#if !defined(__arm__)
+static uint64_t NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+/** Histogram bucket: exact below 4, then 4 buckets per octave */
+static uint32_t BucketOf(uint32_t ticks)
+{
+    if (ticks < 4U)
+        return ticks;
+
+    uint32_t msb = 31U - (uint32_t)__builtin_clz(ticks);
+    uint32_t sub = (ticks >> (msb - 2U)) & 3U;
+
+    return 4U + (msb - 2U) * 4U + sub;
+}
+
+/** Centre of a bucket [ticks] */
+static uint32_t BucketValue(uint32_t bucket)
+{
+    if (bucket < 4U)
+        return bucket;
+
+    uint32_t shift = (bucket - 4U) / 4U;
+    uint32_t sub   = (bucket - 4U) % 4U;
+    uint64_t low   = (uint64_t)(4U + sub) << shift;
+
+    return (uint32_t)(low + (((uint64_t)1U << shift) >> 1));
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Profile_Init(uint32_t tick_hz)
+{
+#if defined(__arm__)
+    /* CYCCNT is not cleared: the RTOS run-time stats share it */
+    PROF_DEMCR    |= (1UL << 24);
+    PROF_DWT_CTRL |= 1UL;
+#elif defined(PROF_USE_TSC)
+    if (tick_hz == 0U)
+    {
+        uint64_t ns0 = NowNs();
+        uint64_t c0  = __rdtsc();
+        while ((NowNs() - ns0) < 20000000ULL)
+            ;
+        uint64_t c1  = __rdtsc();
+        uint64_t ns1 = NowNs();
+
+        tick_hz = (uint32_t)(((c1 - c0) * 1000000000ULL) / (ns1 - ns0));
+    }
+#else
+    tick_hz = 1000000000U;
+#endif
+
+    ppg_profile_tick_hz = tick_hz;
+    PPG_Profile_Reset();
+}
+
+void PPG_Profile_Reset(void)
+{
+    memset(prof_stats, 0, sizeof(prof_stats));
+    for (uint32_t s = 0; s < PPG_PROF_COUNT; s++)
+        prof_stats[s].min = UINT32_MAX;
+
+    memset((void *)ppg_profile, 0, sizeof(ppg_profile));
+}
+
+uint32_t PPG_Profile_Now(void)
+{
+#if defined(__arm__)
+    return PROF_DWT_CYCCNT;
+#elif defined(PROF_USE_TSC)
+    return (uint32_t)__rdtsc();
+#else
+    return (uint32_t)NowNs();
+#endif
+}
+
+void PPG_Profile_Record(PPG_ProfileStage_t stage, uint32_t ticks)
+{
+    if ((uint32_t)stage >= PPG_PROF_COUNT)
+        return;
+
+    PPG_ProfileStat_t *st = &prof_stats[stage];
+    uint32_t b = BucketOf(ticks);
+
+    st->count++;
+    st->sum += ticks;
+    if (ticks < st->min)
+        st->min = ticks;
+    if (ticks > st->max)
+        st->max = ticks;
+
+    /* Halve the whole histogram before a bucket overflows: keeps the shape */
+    if (st->hist[b] == UINT16_MAX)
+    {
+        for (uint32_t i = 0; i < PPG_PROFILE_BUCKETS; i++)
+            st->hist[i] >>= 1;
+    }
+    st->hist[b]++;
+}
+
+uint32_t PPG_Profile_Percentile(PPG_ProfileStage_t stage, uint32_t percent)
+{
+    if ((uint32_t)stage >= PPG_PROF_COUNT)
+        return 0U;
+
+    const PPG_ProfileStat_t *st = &prof_stats[stage];
+    uint32_t total = 0;
+
+    for (uint32_t i = 0; i < PPG_PROFILE_BUCKETS; i++)
+        total += st->hist[i];
+    if (total == 0U)
+        return 0U;
+
+    if (percent > 100U)
+        percent = 100U;
+
+    /* Rank of the percentile, 1-based (nearest-rank method) */
+    uint32_t rank = (uint32_t)(((uint64_t)total * percent + 99U) / 100U);
+    if (rank == 0U)
+        rank = 1U;
+
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < PPG_PROFILE_BUCKETS; i++)
+    {
+        seen += st->hist[i];
+        if (seen >= rank)
+        {
+            uint32_t v = BucketValue(i);
+            if (v < st->min)
+                v = st->min;
+            if (v > st->max)
+                v = st->max;
+            return v;
+        }
+    }
+
+    return st->max;
+}
+
+void PPG_Profile_Report(void)
+{
+    for (uint32_t s = 0; s < PPG_PROF_COUNT; s++)
+    {
+        const PPG_ProfileStat_t *st = &prof_stats[s];
+        volatile PPG_ProfileReport_t *r = &ppg_profile[s];
+
+        if (st->count == 0U)
+        {
+            r->count = 0;
+            r->min = r->mean = r->p50 = r->p99 = r->max = 0;
+            continue;
+        }
+
+        r->count = st->count;
+        r->min   = st->min;
+        r->mean  = (uint32_t)(st->sum / st->count);
+        r->p50   = PPG_Profile_Percentile((PPG_ProfileStage_t)s, 50U);
+        r->p99   = PPG_Profile_Percentile((PPG_ProfileStage_t)s, 99U);
+        r->max   = st->max;
+    }
+}
+
+size_t PPG_Profile_Format(char *buf, size_t size)
+{
+    size_t len = 0;
+
+    if ((buf == NULL) || (size == 0U))
+        return 0U;
+
+    buf[0] = '\0';
+
+    /* Integer nanoseconds: no float printf on target */
+    uint64_t hz = (ppg_profile_tick_hz != 0U) ? ppg_profile_tick_hz : 1000000000U;
+
+    int n = snprintf(buf, size, "stage          count      min     mean      p50      p99      max [ns]\r\n");
+
+    for (uint32_t s = 0; (n >= 0) && (s < PPG_PROF_COUNT); s++)
+    {
+        len += ((size_t)n < (size - len)) ? (size_t)n : (size - len - 1U);
+        if (len >= size - 1U)
+            break;
+
+        const volatile PPG_ProfileReport_t *r = &ppg_profile[s];
+        unsigned long v[5] = { r->min, r->mean, r->p50, r->p99, r->max };
+
+        for (uint32_t k = 0; k < 5U; k++)
+            v[k] = (unsigned long)(((uint64_t)v[k] * 1000000000ULL) / hz);
+
+        n = snprintf(buf + len, size - len, "%-12s %8lu %8lu %8lu %8lu %8lu %8lu\r\n",
+                     prof_names[s], (unsigned long)r->count, v[0], v[1], v[2], v[3], v[4]);
+    }
+
+    if ((n >= 0) && (len < size - 1U))
+        len += ((size_t)n < (size - len)) ? (size_t)n : (size - len - 1U);
+
+    return len;
+}
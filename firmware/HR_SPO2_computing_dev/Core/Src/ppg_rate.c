@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ * @file    ppg_rate.c
+ * @brief   Capture-rate profiles implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_rate.h"
+#include "ppg_pipeline.h"
+#include "ppg_decimator.h"
+#include <stddef.h>
+
+/** 16-bit timer: prescaler and period registers hold value - 1 */
+#define PPG_RATE_TIMER_MAX     65536U
+
+_Static_assert(PPG_FRAME_MAX_DECIMATION <= PPG_CIC_MAX_RATIO, "PPG_FRAME_MAX_DECIMATION exceeds the CIC ratio");
+
+static const uint16_t rate_hz[PPG_RATE_COUNT] = { 100U, 250U, 500U, 1000U };
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static uint32_t PPG_Rate_Gcd(uint32_t a, uint32_t b)
+{
+    while (b != 0U)
+    {
+        uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+uint32_t PPG_Rate_Hz(PPG_Rate_t rate)
+{
+    return ((uint32_t)rate < PPG_RATE_COUNT) ? rate_hz[rate] : 0U;
+}
+
+bool PPG_Rate_GetConfig(PPG_Rate_t rate, uint32_t timer_clock_hz, PPG_RateConfig_t *cfg)
+{
+    uint32_t hz = PPG_Rate_Hz(rate);
+
+    if ((cfg == NULL) || (hz < PPG_FS))
+        return false;
+
+    /* hz * up / down = PPG_FS; up divides PPG_FS, so every total is whole */
+    uint32_t g    = PPG_Rate_Gcd(hz, PPG_FS);
+    uint32_t up   = PPG_FS / g;
+    uint32_t down = hz / g;
+
+    if (down > PPG_FRAME_MAX_DECIMATION)
+        return false;
+
+    uint32_t acq_hz = hz * PPG_OVERSAMPLE;
+
+    if ((timer_clock_hz % acq_hz) != 0U)
+        return false;
+
+    /* Smallest prescaler that divides the period exactly and fits 16 bits */
+    uint32_t ticks = timer_clock_hz / acq_hz;
+    uint32_t psc   = 1U;
+
+    while ((psc <= PPG_RATE_TIMER_MAX) && (((ticks % psc) != 0U) || ((ticks / psc) > PPG_RATE_TIMER_MAX)))
+        psc++;
+
+    if ((psc > PPG_RATE_TIMER_MAX) || ((ticks / psc) < 2U))
+        return false;
+
+    cfg->capture_hz     = hz;
+    cfg->acq_hz         = acq_hz;
+    cfg->timer_clock_hz = timer_clock_hz;
+    cfg->tick_prescaler = (uint16_t)(psc - 1U);
+    cfg->tick_period    = (uint16_t)((ticks / psc) - 1U);
+    cfg->interpolation  = (uint16_t)up;
+    cfg->decimation     = (uint16_t)down;
+    cfg->frame_samples  = (uint16_t)((PPG_BLOCK_SIZE * down + up - 1U) / up);
+    cfg->total_samples  = (PPG_TOTAL_SAMPLES / up) * down;
+    return true;
+}
@@ -0,0 +1,70 @@
+/**
+ ******************************************************************************
+ * @file    ppg_ring.c
+ * @brief   Lock-free SPSC pointer ring implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_ring.h"
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool PPG_Ring_Init(PPG_Ring_t *ring, void **slots, uint32_t capacity)
+{
+    if ((slots == NULL) || (capacity == 0U) || ((capacity & (capacity - 1U)) != 0U))
+        return false;
+
+    ring->slots = slots;
+    ring->mask  = capacity - 1U;
+    __atomic_store_n(&ring->overruns, 0U, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->tail, 0U, __ATOMIC_RELAXED);
+    __atomic_store_n(&ring->head, 0U, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool PPG_Ring_Push(PPG_Ring_t *ring, void *item)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+    /* Acquire: the consumer is done with the slot it released */
+    if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) > ring->mask)
+    {
+        __atomic_store_n(&ring->overruns, ring->overruns + 1U, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    ring->slots[head & ring->mask] = item;
+
+    /* Release: the slot is written before the consumer can see it */
+    __atomic_store_n(&ring->head, head + 1U, __ATOMIC_RELEASE);
+    return true;
+}
+
+uint32_t PPG_Ring_PopBatch(PPG_Ring_t *ring, void **items, uint32_t max)
+{
+    uint32_t tail  = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t avail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    uint32_t n     = (avail < max) ? avail : max;
+
+    for (uint32_t i = 0; i < n; i++)
+        items[i] = ring->slots[(tail + i) & ring->mask];
+
+    /* Release: the slots are read before the producer may reuse them */
+    __atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+uint32_t PPG_Ring_Count(const PPG_Ring_t *ring)
+{
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+}
+
+uint32_t PPG_Ring_Overruns(const PPG_Ring_t *ring)
+{
+    return __atomic_load_n(&ring->overruns, __ATOMIC_RELAXED);
+}
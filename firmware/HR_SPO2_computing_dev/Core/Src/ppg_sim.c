@@ -0,0 +1,353 @@
+/**
+ ******************************************************************************
+ * @file    ppg_sim.c
+ * @brief   Simulated acquisition over the framed UART link.
+ ******************************************************************************
+ */
+
+#include "ppg_sim.h"
+#include "ppg_link.h"
+#include "ppg_processing.h"
+#include "uart_rx.h"
+
+#ifdef USE_SIMULATION
+
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/** CREDIT keep-alives per second: one every 100 ms */
+#define PPG_SIM_KEEPALIVE_HZ   10U
+
+#if ((PPG_SIM_FIFO_PERIODS & (PPG_SIM_FIFO_PERIODS - 1U)) != 0U)
+#error "PPG_SIM_FIFO_PERIODS must be a power of two"
+#endif
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static UART_HandleTypeDef *sim_uart = NULL;
+static PPG_LinkParser_t    sim_parser;
+static uint8_t             sim_tx[PPG_LINK_MAX_FRAME];
+static uint16_t            sim_tx_sequence = 0;
+
+/* Received periods: written by the link task, read by the TIM9 ISR */
+static uint16_t          fifo_samples[PPG_SIM_FIFO_PERIODS][PPG_CH_COUNT];
+static uint16_t          fifo_mask[PPG_SIM_FIFO_PERIODS];
+static volatile uint32_t fifo_head = 0;            /* Periods written */
+static volatile uint32_t fifo_tail = 0;            /* Periods read */
+
+static volatile uint32_t sim_rx_next     = 0;      /* Next period index expected */
+static uint16_t          sim_rx_sequence = 0;      /* Next DATA sequence expected */
+static bool              sim_rx_synced   = false;  /* sim_rx_sequence is known */
+static uint32_t          sim_malformed   = 0;      /* DATA frames with a bad layout */
+static uint32_t          sim_uart_errors = 0;      /* UartRx errors + overruns at session start */
+static uint32_t          sim_credit_tail = 0;      /* fifo_tail at the last CREDIT */
+static uint32_t          sim_credit_age  = 0;      /* Ticks since the last CREDIT */
+
+static uint32_t      sim_keepalive    = 1U;     /* CREDIT keep-alive period [ticks] */
+static volatile bool sim_active       = false;
+static volatile bool sim_restart      = false;    /* New session: the link task resets */
+static volatile bool sim_stop_pending = false;
+
+/* REPORT payload: written by a task while not pending, sent by the TIM9 ISR */
+static uint8_t       sim_report[PPG_LINK_REPORT_SIZE];
+static volatile bool sim_report_pending = false;
+
+volatile PPG_SimStats_t ppg_sim_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static uint32_t PPG_Sim_ChannelCount(uint16_t mask)
+{
+    uint32_t n = 0;
+
+    for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        n += (mask >> ch) & 1U;
+
+    return n;
+}
+
+/** Highest period index the PC may send next, exclusive */
+static uint32_t PPG_Sim_CreditLimit(void)
+{
+    return sim_rx_next + (PPG_SIM_FIFO_PERIODS - (fifo_head - fifo_tail));
+}
+
+/** Send a frame if the transmitter is idle (ISR context, one priority level) */
+static bool PPG_Sim_Send(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    if (sim_uart->gState != HAL_UART_STATE_READY)
+        return false;
+
+    size_t n = PPG_Link_Encode(sim_tx, type, sim_tx_sequence, payload, len);
+    if (HAL_UART_Transmit_IT(sim_uart, sim_tx, (uint16_t)n) != HAL_OK)
+        return false;
+
+    sim_tx_sequence++;
+    return true;
+}
+
+static void PPG_Sim_SendCredit(void)
+{
+    uint8_t p[PPG_LINK_CREDIT_SIZE];
+
+    PPG_Link_Put32(&p[PPG_LINK_CREDIT_LIMIT], PPG_Sim_CreditLimit());
+    PPG_Link_Put32(&p[PPG_LINK_CREDIT_NEXT], sim_rx_next);
+    PPG_Link_Put16(&p[PPG_LINK_CREDIT_LOST], (uint16_t)ppg_sim_stats.lost_frames);
+    PPG_Link_Put16(&p[PPG_LINK_CREDIT_CRC], (uint16_t)ppg_sim_stats.crc_errors);
+
+    if (PPG_Sim_Send(PPG_LINK_CREDIT, p, sizeof(p)))
+    {
+        sim_credit_tail = fifo_tail;
+        sim_credit_age  = 0;
+    }
+}
+
+static void PPG_Sim_SendStop(void)
+{
+    uint8_t p[PPG_LINK_STOP_SIZE];
+
+    PPG_Link_Put32(&p[PPG_LINK_STOP_PERIODS], ppg_sim_stats.periods);
+    PPG_Link_Put32(&p[PPG_LINK_STOP_UNDERRUNS], ppg_sim_stats.underruns);
+    PPG_Link_Put16(&p[PPG_LINK_STOP_LOST], (uint16_t)ppg_sim_stats.lost_frames);
+    PPG_Link_Put16(&p[PPG_LINK_STOP_CRC], (uint16_t)ppg_sim_stats.crc_errors);
+
+    if (PPG_Sim_Send(PPG_LINK_STOP, p, sizeof(p)))
+        sim_stop_pending = false;
+}
+
+static uint32_t PPG_Sim_TicksToNs(uint32_t ticks, uint32_t tick_hz)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000000ULL) / tick_hz);
+}
+
+static void PPG_Sim_SendReport(void)
+{
+    if (PPG_Sim_Send(PPG_LINK_REPORT, sim_report, sizeof(sim_report)))
+        sim_report_pending = false;
+}
+
+/** Total UART receive errors, restarts and overruns */
+static uint32_t PPG_Sim_UartErrors(void)
+{
+    UartRx_Stats_t rx;
+
+    UartRx_GetStats(&rx);
+    return rx.errors + rx.overruns;
+}
+
+/** Clear the receive side for a new session (link task, TIM9 idle) */
+static void PPG_Sim_ResetReceiver(void)
+{
+    fifo_head       = 0;
+    fifo_tail       = 0;
+    sim_rx_next     = 0;
+    sim_rx_synced   = false;
+    sim_malformed   = 0;
+    sim_credit_tail = 0;
+    sim_credit_age  = 0;
+    sim_uart_errors = PPG_Sim_UartErrors();
+    ppg_sim_stats   = (PPG_SimStats_t){ 0 };
+    PPG_Link_ParserReset(&sim_parser);
+}
+
+/** Queue the periods of a DATA frame (link task) */
+static void PPG_Sim_OnData(const PPG_LinkFrame_t *f)
+{
+    if (f->length < PPG_LINK_DATA_SAMPLES)
+    {
+        sim_malformed++;
+        return;
+    }
+
+    uint32_t first = PPG_Link_Get32(&f->payload[PPG_LINK_DATA_FIRST]);
+    uint16_t mask  = f->payload[PPG_LINK_DATA_MASK];
+    uint32_t count = f->payload[PPG_LINK_DATA_COUNT];
+    uint32_t nch   = PPG_Sim_ChannelCount(mask);
+
+    if ((nch == 0U) || (mask >= (1U << PPG_CH_COUNT)) ||
+        (f->length != (PPG_LINK_DATA_SAMPLES + count * nch * 2U)))
+    {
+        sim_malformed++;
+        return;
+    }
+
+    if (sim_rx_synced)
+        ppg_sim_stats.lost_frames += (uint16_t)(f->sequence - sim_rx_sequence);
+    sim_rx_sequence = (uint16_t)(f->sequence + 1U);
+    sim_rx_synced   = true;
+    ppg_sim_stats.frames++;
+
+    const uint8_t *s = &f->payload[PPG_LINK_DATA_SAMPLES];
+
+    for (uint32_t k = 0; k < count; k++, s += nch * 2U)
+    {
+        int32_t ahead = (int32_t)(first + k - sim_rx_next);
+
+        /* Already received (the PC resent after a stall) */
+        if (ahead < 0)
+            continue;
+
+        /* Periods of lost frames are skipped, not waited for */
+        ppg_sim_stats.lost_periods += (uint32_t)ahead;
+
+        if ((fifo_head - fifo_tail) >= PPG_SIM_FIFO_PERIODS)
+        {
+            ppg_sim_stats.overflows++;
+        }
+        else
+        {
+            uint32_t slot = fifo_head & (PPG_SIM_FIFO_PERIODS - 1U);
+            const uint8_t *v = s;
+
+            for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+            {
+                if ((mask & PPG_CH_MASK(ch)) != 0U)
+                {
+                    fifo_samples[slot][ch] = PPG_Link_Get16(v) & 0x0FFFU;
+                    v += 2;
+                }
+            }
+            fifo_mask[slot] = mask;
+
+            /* Period visible to TIM9 only once written */
+            __DMB();
+            fifo_head++;
+        }
+
+        /* After the FIFO level: a tick in between under-, never over-credits */
+        sim_rx_next = first + k + 1U;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_Sim_Init(UART_HandleTypeDef *uart)
+{
+    sim_uart = uart;
+    PPG_Link_ParserReset(&sim_parser);
+}
+
+void PPG_Sim_Start(uint32_t periods, uint32_t rate_hz)
+{
+    uint8_t p[PPG_LINK_START_SIZE];
+
+    /* TIM9 stays idle until the link task has reset the receive side */
+    sim_active         = false;
+    sim_stop_pending   = false;
+    sim_report_pending = false;
+    HAL_UART_AbortTransmit(sim_uart);
+
+    sim_keepalive = (rate_hz >= PPG_SIM_KEEPALIVE_HZ) ? (rate_hz / PPG_SIM_KEEPALIVE_HZ) : 1U;
+
+    PPG_Link_Put16(&p[PPG_LINK_START_RATE], (uint16_t)rate_hz);
+    p[PPG_LINK_START_MASK] = (uint8_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR) |
+                                       PPG_CH_MASK(PPG_CH_AMBIENT));
+    p[PPG_LINK_START_MASK + 1U] = 0;
+    PPG_Link_Put32(&p[PPG_LINK_START_PERIODS], periods);
+    PPG_Link_Put32(&p[PPG_LINK_START_LIMIT], PPG_SIM_FIFO_PERIODS);
+    PPG_Sim_Send(PPG_LINK_START, p, sizeof(p));
+
+    /* Only now: the link task may preempt the caller and let TIM9 send */
+    sim_restart = true;
+}
+
+void PPG_Sim_Stop(void)
+{
+    sim_active       = false;
+    sim_restart      = false;
+    sim_stop_pending = true;
+}
+
+void PPG_Sim_Report(const PPG_Integrity_t *stats, uint32_t tick_hz)
+{
+    const PPG_IntegrityTiming_t *tick = &stats->timing[PPG_INTEG_SAMPLE_TICK];
+    uint32_t p99   = PPG_Integrity_Jitter(stats, PPG_INTEG_SAMPLE_TICK, 99U);
+    uint32_t drops = stats->counters[PPG_INTEG_POOL_EMPTY] + stats->counters[PPG_INTEG_RING_OVERRUNS];
+
+    /* Withdraw a pending one: the ISR encodes it into sim_tx, never while preempted */
+    sim_report_pending = false;
+    __DMB();
+
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_TICKS], tick->events);
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_MISSED], tick->missed);
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_P99], PPG_Sim_TicksToNs(p99, tick_hz));
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_WORST], PPG_Sim_TicksToNs(tick->worst, tick_hz));
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_GAPS], stats->counters[PPG_INTEG_PERIOD_GAPS]);
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_DROPS], drops);
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_SEQ], stats->counters[PPG_INTEG_SEQUENCE_GAPS]);
+    PPG_Link_Put32(&sim_report[PPG_LINK_REPORT_QUEUES], stats->counters[PPG_INTEG_CONSUMER_DROPS]);
+
+    __DMB();
+    sim_report_pending = true;
+}
+
+void PPG_Sim_ReceiveStep(void)
+{
+    const uint8_t *data;
+    uint32_t       n = UartRx_Wait(&data, osWaitForever);
+
+    if (sim_restart)
+    {
+        sim_restart = false;
+        PPG_Sim_ResetReceiver();
+        sim_active = true;
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const PPG_LinkFrame_t *f = PPG_Link_Parse(&sim_parser, data[i]);
+
+        if ((f != NULL) && (f->type == PPG_LINK_DATA) && sim_active)
+            PPG_Sim_OnData(f);
+    }
+    UartRx_Consume(n);
+
+    ppg_sim_stats.crc_errors  = sim_parser.crc_errors + sim_malformed;
+    ppg_sim_stats.uart_errors = PPG_Sim_UartErrors() - sim_uart_errors;
+}
+
+void PPG_Sim_TickFromISR(uint32_t clock)
+{
+    if (sim_active)
+    {
+        if (fifo_head != fifo_tail)
+        {
+            uint32_t   slot = fifo_tail & (PPG_SIM_FIFO_PERIODS - 1U);
+            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+            adc_raw = fifo_samples[slot][(fifo_mask[slot] & PPG_CH_MASK(PPG_CH_RED)) ? PPG_CH_RED : PPG_CH_IR];
+            PPG_AcquireFromISR(fifo_samples[slot], fifo_mask[slot], clock, &xHigherPriorityTaskWoken);
+            fifo_tail++;
+            ppg_sim_stats.periods++;
+
+            portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+        }
+        else if (ppg_sim_stats.frames > 0U)
+        {
+            ppg_sim_stats.underruns++;
+        }
+
+        if ((++sim_credit_age >= sim_keepalive) ||
+            ((fifo_tail - sim_credit_tail) >= PPG_SIM_CREDIT_BATCH))
+            PPG_Sim_SendCredit();
+        else if (sim_report_pending)
+            PPG_Sim_SendReport();
+    }
+    else if (sim_report_pending)
+    {
+        PPG_Sim_SendReport();
+    }
+    else if (sim_stop_pending)
+    {
+        PPG_Sim_SendStop();
+    }
+}
+
+#endif /* USE_SIMULATION */
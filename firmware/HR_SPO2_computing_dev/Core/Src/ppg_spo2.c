@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ * @file    ppg_spo2.c
+ * @brief   Streaming SpO2 estimation implementation.
+ ******************************************************************************
+ */
+
+#include "ppg_spo2.h"
+#include <math.h>
+#include <stddef.h>
+
+/* ------------------------------------------------------------------------- */
+/* Calibration                                                               */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * SpO2 [%] at R = i * PPG_SPO2_CAL_STEP.
+ * Sampled from the MAX30101 quadratic used offline: 104 - 17 R - 10 R^2
+ * (see filter_design.ipynb). Replace with device-specific points once
+ * calibrated against a reference oximeter.
+ */
+static const float spo2_calibration[PPG_SPO2_CAL_POINTS] =
+{
+    104.0f, 102.2f, 100.2f, 98.0f, 95.6f, 93.0f, 90.2f, 87.2f, 84.0f, 80.6f,
+     77.0f,  73.2f,  69.2f, 65.0f, 60.6f, 56.0f, 51.2f, 46.2f, 41.0f, 35.6f,
+     30.0f
+};
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static PPG_SpO2_Channel_t *PPG_SpO2_Channel(PPG_SpO2_t *spo2, PPG_Channel_t channel)
+{
+    if (channel == PPG_CH_RED)
+        return &spo2->red;
+    if (channel == PPG_CH_IR)
+        return &spo2->ir;
+    return NULL;
+}
+
+static void PPG_SpO2_StartBeat(PPG_SpO2_Channel_t *ch)
+{
+    ch->beat_max = INT16_MIN;
+    ch->beat_min = INT16_MAX;
+    ch->samples  = 0;
+    ch->partial  = false;
+}
+
+static void PPG_SpO2_ResetChannel(PPG_SpO2_Channel_t *ch)
+{
+    ch->dc       = 0.0f;
+    ch->ac       = 0.0f;
+    ch->dc_valid = false;
+    ch->ac_valid = false;
+    PPG_SpO2_StartBeat(ch);
+
+    /* The first beat after a reset starts mid-cycle */
+    ch->partial = true;
+}
+
+/** Close the beat of one channel: keep its peak-to-trough if complete */
+static void PPG_SpO2_CloseBeat(PPG_SpO2_Channel_t *ch)
+{
+    if (!ch->partial && (ch->samples > 0U))
+    {
+        /* Q15 band-pass back to ADC counts (PPG_FIR_FromAdc12 scales by 16) */
+        ch->ac       = (float)((int32_t)ch->beat_max - (int32_t)ch->beat_min) / 16.0f;
+        ch->ac_valid = true;
+    }
+
+    PPG_SpO2_StartBeat(ch);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+void PPG_SpO2_Init(PPG_SpO2_t *spo2, uint16_t fs_hz)
+{
+    float tau_samples = ((float)fs_hz * (float)PPG_SPO2_DC_TAU_MS) / 1000.0f;
+
+    spo2->dc_alpha = 1.0f - expf(-1.0f / tau_samples);
+    PPG_SpO2_Reset(spo2);
+}
+
+void PPG_SpO2_Reset(PPG_SpO2_t *spo2)
+{
+    PPG_SpO2_ResetChannel(&spo2->red);
+    PPG_SpO2_ResetChannel(&spo2->ir);
+}
+
+void PPG_SpO2_Update(PPG_SpO2_t *spo2, PPG_Channel_t channel, uint16_t raw, int16_t bandpass)
+{
+    PPG_SpO2_Channel_t *ch = PPG_SpO2_Channel(spo2, channel);
+
+    if (ch == NULL)
+        return;
+
+    if (!ch->dc_valid)
+    {
+        ch->dc       = (float)raw;
+        ch->dc_valid = true;
+    }
+    else
+    {
+        ch->dc += spo2->dc_alpha * ((float)raw - ch->dc);
+    }
+
+    if (bandpass > ch->beat_max)
+        ch->beat_max = bandpass;
+    if (bandpass < ch->beat_min)
+        ch->beat_min = bandpass;
+
+    ch->samples++;
+}
+
+void PPG_SpO2_Discard(PPG_SpO2_t *spo2, PPG_Channel_t channel)
+{
+    PPG_SpO2_Channel_t *ch = PPG_SpO2_Channel(spo2, channel);
+
+    if (ch != NULL)
+        ch->partial = true;
+}
+
+bool PPG_SpO2_OnBeat(PPG_SpO2_t *spo2, float *percent, float *ratio)
+{
+    PPG_SpO2_CloseBeat(&spo2->red);
+    PPG_SpO2_CloseBeat(&spo2->ir);
+
+    const PPG_SpO2_Channel_t *red = &spo2->red;
+    const PPG_SpO2_Channel_t *ir  = &spo2->ir;
+
+    if (!red->ac_valid || !ir->ac_valid)
+        return false;
+
+    if ((red->dc < PPG_SPO2_MIN_DC) || (ir->dc < PPG_SPO2_MIN_DC) || (ir->ac <= 0.0f))
+        return false;
+
+    float r = (red->ac / red->dc) / (ir->ac / ir->dc);
+
+    *percent = PPG_SpO2_FromRatio(r);
+    if (ratio != NULL)
+        *ratio = r;
+
+    return true;
+}
+
+float PPG_SpO2_FromRatio(float ratio)
+{
+    float pos = ratio / PPG_SPO2_CAL_STEP;
+    float spo2;
+
+    if (pos <= 0.0f)
+    {
+        spo2 = spo2_calibration[0];
+    }
+    else if (pos >= (float)(PPG_SPO2_CAL_POINTS - 1U))
+    {
+        spo2 = spo2_calibration[PPG_SPO2_CAL_POINTS - 1U];
+    }
+    else
+    {
+        uint32_t i    = (uint32_t)pos;
+        float    frac = pos - (float)i;
+        spo2 = spo2_calibration[i] + frac * (spo2_calibration[i + 1U] - spo2_calibration[i]);
+    }
+
+    if (spo2 > 100.0f)
+        spo2 = 100.0f;
+    if (spo2 < 0.0f)
+        spo2 = 0.0f;
+
+    return spo2;
+}
@@ -0,0 +1,621 @@
+/**
+ ******************************************************************************
+ * @file    sd_spi.c
+ * @brief   SD card block driver over SPI with DMA implementation.
+ ******************************************************************************
+ */
+
+#include "sd_spi.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <string.h>
+
+/* Commands; ACMD<n> is CMD55 then CMD<n>, flagged by bit 7 */
+#define SD_CMD0         0U              /* GO_IDLE_STATE */
+#define SD_CMD8         8U              /* SEND_IF_COND */
+#define SD_CMD9         9U              /* SEND_CSD */
+#define SD_CMD12        12U             /* STOP_TRANSMISSION */
+#define SD_CMD16        16U             /* SET_BLOCKLEN */
+#define SD_CMD17        17U             /* READ_SINGLE_BLOCK */
+#define SD_CMD18        18U             /* READ_MULTIPLE_BLOCK */
+#define SD_CMD24        24U             /* WRITE_BLOCK */
+#define SD_CMD25        25U             /* WRITE_MULTIPLE_BLOCK */
+#define SD_CMD55        55U             /* APP_CMD */
+#define SD_CMD58        58U             /* READ_OCR */
+#define SD_ACMD13       (0x80U | 13U)   /* SD_STATUS */
+#define SD_ACMD23       (0x80U | 23U)   /* SET_WR_BLK_ERASE_COUNT */
+#define SD_ACMD41       (0x80U | 41U)   /* SD_SEND_OP_COND */
+
+#define SD_R1_IDLE      0x01U
+#define SD_R1_NONE      0xFFU           /* No response */
+
+/* Data tokens */
+#define SD_TOKEN_BLOCK  0xFEU           /* Read block, single block write */
+#define SD_TOKEN_MULTI  0xFCU           /* Multiple block write */
+#define SD_TOKEN_STOP   0xFDU           /* End of a multiple block write */
+
+#define SD_DATA_RESP_MASK      0x1FU
+#define SD_DATA_ACCEPTED       0x05U
+
+#define SD_OCR_CCS             (1UL << 30)    /* Card capacity status: block addressed */
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static SPI_HandleTypeDef *sd_spi     = NULL;
+static GPIO_TypeDef      *sd_cs_port = NULL;
+static uint16_t           sd_cs_pin  = 0;
+
+static SdSpi_Card_t sd_card        = SD_SPI_CARD_NONE;
+static uint32_t     sd_sectors     = 0;
+static uint32_t     sd_erase_block = 1;
+
+/* Task blocked on the current DMA transfer, notified by the HAL callbacks */
+static TaskHandle_t  sd_waiter    = NULL;
+static volatile bool sd_dma_error = false;
+
+static SdSpi_Stats_t sd_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** Exchange one byte by register access: no HAL call per command byte */
+static uint8_t SdSpi_Xchg(uint8_t tx)
+{
+    SPI_TypeDef *spi = sd_spi->Instance;
+
+    while ((spi->SR & SPI_SR_TXE) == 0U)
+        ;
+    *(volatile uint8_t *)&spi->DR = tx;
+
+    while ((spi->SR & SPI_SR_RXNE) == 0U)
+        ;
+    return *(volatile uint8_t *)&spi->DR;
+}
+
+static void SdSpi_Deselect(void)
+{
+    HAL_GPIO_WritePin(sd_cs_port, sd_cs_pin, GPIO_PIN_SET);
+    (void)SdSpi_Xchg(0xFFU);        /* The card releases DO on the next clock */
+}
+
+static void SdSpi_Select(void)
+{
+    HAL_GPIO_WritePin(sd_cs_port, sd_cs_pin, GPIO_PIN_RESET);
+    (void)SdSpi_Xchg(0xFFU);
+}
+
+/**
+ * @brief Block the calling task one tick while waiting for the card.
+ *
+ * @return false once timeout_ms has elapsed since start.
+ */
+static bool SdSpi_Sleep(TickType_t start, uint32_t timeout_ms)
+{
+    if ((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeout_ms))
+        return false;
+
+    sd_stats.busy_blocks++;
+    vTaskDelay(1);
+    return true;
+}
+
+/**
+ * @brief Wait until the card releases DO (not busy).
+ *
+ * A few bytes are probed first; a card still programming blocks the
+ * task one tick per probe.
+ */
+static bool SdSpi_WaitReady(uint32_t timeout_ms)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    for (;;)
+    {
+        for (uint32_t n = 0; n < SD_SPI_SPIN_BYTES; n++)
+        {
+            if (SdSpi_Xchg(0xFFU) == 0xFFU)
+                return true;
+        }
+
+        if (!SdSpi_Sleep(start, timeout_ms))
+            return false;
+    }
+}
+
+/** Select the card and wait until it is ready, deselected on timeout */
+static bool SdSpi_Begin(void)
+{
+    SdSpi_Select();
+
+    if (SdSpi_WaitReady(SD_SPI_BUSY_TIMEOUT_MS))
+        return true;
+
+    SdSpi_Deselect();
+    return false;
+}
+
+/** CRC7 of a command frame, shifted and with the end bit */
+static uint8_t SdSpi_Crc7(const uint8_t *data, uint32_t len)
+{
+    uint8_t crc = 0;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        uint8_t b = data[i];
+
+        for (uint32_t bit = 0; bit < 8U; bit++, b <<= 1)
+        {
+            crc <<= 1;
+            if (((b ^ crc) & 0x80U) != 0U)
+                crc ^= 0x09U << 1;
+        }
+    }
+
+    return (uint8_t)(crc | 0x01U);
+}
+
+/**
+ * @brief Send a command, return its R1 response.
+ *
+ * Selects the card and waits until it is ready, except for CMD12 which
+ * interrupts a multiple block read. The card stays selected.
+ */
+static uint8_t SdSpi_Command(uint8_t cmd, uint32_t arg)
+{
+    if ((cmd & 0x80U) != 0U)
+    {
+        uint8_t r1 = SdSpi_Command(SD_CMD55, 0U);
+
+        if (r1 > SD_R1_IDLE)
+            return r1;
+        cmd &= 0x7FU;
+    }
+
+    if (cmd != SD_CMD12)
+    {
+        SdSpi_Deselect();
+        if (!SdSpi_Begin())
+            return SD_R1_NONE;
+    }
+
+    uint8_t frame[6] =
+    {
+        (uint8_t)(0x40U | cmd),
+        (uint8_t)(arg >> 24), (uint8_t)(arg >> 16), (uint8_t)(arg >> 8), (uint8_t)arg,
+        0U,
+    };
+    frame[5] = SdSpi_Crc7(frame, 5U);
+
+    for (uint32_t i = 0; i < sizeof(frame); i++)
+        (void)SdSpi_Xchg(frame[i]);
+
+    /* Stuff byte after CMD12 */
+    if (cmd == SD_CMD12)
+        (void)SdSpi_Xchg(0xFFU);
+
+    /* R1 within 8 bytes (NCR) */
+    uint8_t r1 = SD_R1_NONE;
+
+    for (uint32_t n = 0; (n < 10U) && ((r1 & 0x80U) != 0U); n++)
+        r1 = SdSpi_Xchg(0xFFU);
+
+    return r1;
+}
+
+/**
+ * @brief Wait for the end of the DMA transfer started by the caller.
+ *
+ * The calling task blocks on its notification (set before the start).
+ */
+static bool SdSpi_WaitDma(uint32_t timeout_ms)
+{
+    bool done = (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) != 0U);
+
+    sd_waiter = NULL;
+    if (!done)
+        HAL_SPI_Abort(sd_spi);
+
+    return done && !sd_dma_error;
+}
+
+/** Receive a data block by DMA: 0xFF is clocked out while reading */
+static bool SdSpi_ReceiveBlock(uint8_t *buf, uint32_t len)
+{
+    TickType_t start = xTaskGetTickCount();
+    uint8_t    token;
+
+    /* Data token after the access time: probe, then block per tick */
+    for (;;)
+    {
+        uint32_t n = 0;
+
+        while (((token = SdSpi_Xchg(0xFFU)) == 0xFFU) && (++n < SD_SPI_SPIN_BYTES))
+            ;
+        if (token != 0xFFU)
+            break;
+        if (!SdSpi_Sleep(start, SD_SPI_READ_TIMEOUT_MS))
+            return false;
+    }
+
+    if (token != SD_TOKEN_BLOCK)
+        return false;
+
+    /* TX reads each byte before RX overwrites it: the buffer sends 0xFF */
+    memset(buf, 0xFF, len);
+    sd_dma_error = false;
+    sd_waiter    = xTaskGetCurrentTaskHandle();
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+
+    if (HAL_SPI_Receive_DMA(sd_spi, buf, (uint16_t)len) != HAL_OK)
+    {
+        sd_waiter = NULL;
+        return false;
+    }
+    if (!SdSpi_WaitDma(SD_SPI_READ_TIMEOUT_MS))
+        return false;
+
+    /* CRC, not checked (CRC mode off) */
+    (void)SdSpi_Xchg(0xFFU);
+    (void)SdSpi_Xchg(0xFFU);
+    return true;
+}
+
+/**
+ * @brief Send a data block by DMA, or the stop token (buf NULL).
+ *
+ * Waits for the card to be ready first, so the programming of the
+ * previous block overlaps the caller's work.
+ */
+static bool SdSpi_SendBlock(const uint8_t *buf, uint8_t token)
+{
+    if (!SdSpi_WaitReady(SD_SPI_BUSY_TIMEOUT_MS))
+        return false;
+
+    (void)SdSpi_Xchg(token);
+    if (token == SD_TOKEN_STOP)
+        return true;
+
+    sd_dma_error = false;
+    sd_waiter    = xTaskGetCurrentTaskHandle();
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+
+    if (HAL_SPI_Transmit_DMA(sd_spi, (uint8_t *)buf, SD_SPI_SECTOR_SIZE) != HAL_OK)
+    {
+        sd_waiter = NULL;
+        return false;
+    }
+    if (!SdSpi_WaitDma(SD_SPI_BUSY_TIMEOUT_MS))
+        return false;
+
+    /* Dummy CRC, then the data response */
+    (void)SdSpi_Xchg(0xFFU);
+    (void)SdSpi_Xchg(0xFFU);
+
+    return (SdSpi_Xchg(0xFFU) & SD_DATA_RESP_MASK) == SD_DATA_ACCEPTED;
+}
+
+/** Fastest prescaler giving at most max_hz */
+static void SdSpi_SetClock(uint32_t max_hz)
+{
+    /* SPI2 / SPI3 on APB1, the others on APB2 */
+    uint32_t pclk = ((sd_spi->Instance == SPI2) || (sd_spi->Instance == SPI3)) ?
+                    HAL_RCC_GetPCLK1Freq() : HAL_RCC_GetPCLK2Freq();
+    uint32_t br   = 0;
+
+    while ((br < 7U) && ((pclk >> (br + 1U)) > max_hz))
+        br++;
+
+    __HAL_SPI_DISABLE(sd_spi);
+    MODIFY_REG(sd_spi->Instance->CR1, SPI_CR1_BR, br << SPI_CR1_BR_Pos);
+    sd_spi->Init.BaudRatePrescaler = br << SPI_CR1_BR_Pos;
+    __HAL_SPI_ENABLE(sd_spi);
+}
+
+/** Read a register block (CSD, SD status) after its command */
+static bool SdSpi_ReadRegister(uint8_t cmd, uint8_t *buf, uint32_t len)
+{
+    bool ok = (SdSpi_Command(cmd, 0U) == 0U) && SdSpi_ReceiveBlock(buf, len);
+
+    SdSpi_Deselect();
+    return ok;
+}
+
+/** Capacity and erase block size from the CSD (and SD status for SD 2.0+) */
+static bool SdSpi_ReadGeometry(void)
+{
+    uint8_t csd[16];
+    uint8_t status[64];
+
+    if (!SdSpi_ReadRegister(SD_CMD9, csd, sizeof(csd)))
+        return false;
+
+    if ((csd[0] >> 6) == 1U)
+    {
+        /* CSD 2.0: (C_SIZE + 1) * 512 KiB */
+        uint32_t c_size = ((uint32_t)(csd[7] & 0x3FU) << 16) | ((uint32_t)csd[8] << 8) | csd[9];
+
+        sd_sectors = (c_size + 1U) << 10;
+    }
+    else
+    {
+        /* CSD 1.0: (C_SIZE + 1) << (C_SIZE_MULT + 2 + READ_BL_LEN) bytes */
+        uint32_t read_bl_len = csd[5] & 0x0FU;
+        uint32_t c_size      = ((uint32_t)(csd[6] & 0x03U) << 10) | ((uint32_t)csd[7] << 2) | (csd[8] >> 6);
+        uint32_t c_size_mult = ((uint32_t)(csd[9] & 0x03U) << 1) | (csd[10] >> 7);
+
+        sd_sectors = (c_size + 1U) << (c_size_mult + 2U + read_bl_len - 9U);
+    }
+
+    /* Allocation unit: SD status for SD 2.0+, SECTOR_SIZE of the CSD otherwise */
+    if ((sd_card != SD_SPI_CARD_SDV1) && SdSpi_ReadRegister(SD_ACMD13, status, sizeof(status)))
+        sd_erase_block = 16UL << (status[10] >> 4);
+    else
+        sd_erase_block = ((((uint32_t)(csd[10] & 0x3FU) << 1) | (csd[11] >> 7)) + 1U) <<
+                         ((csd[13] >> 6) - 1U);
+
+    if (sd_erase_block == 0U)
+        sd_erase_block = 1U;
+
+    return sd_sectors > 0U;
+}
+
+/* ------------------------------------------------------------------------- */
+/* HAL callbacks                                                             */
+/* ------------------------------------------------------------------------- */
+
+static void SdSpi_DmaDoneFromISR(SPI_HandleTypeDef *hspi, bool error)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if ((hspi != sd_spi) || (sd_waiter == NULL))
+        return;
+
+    sd_dma_error = error;
+    vTaskNotifyGiveFromISR(sd_waiter, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    SdSpi_DmaDoneFromISR(hspi, false);
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    SdSpi_DmaDoneFromISR(hspi, false);
+}
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    SdSpi_DmaDoneFromISR(hspi, false);
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    SdSpi_DmaDoneFromISR(hspi, true);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool SdSpi_Init(SPI_HandleTypeDef *spi, GPIO_TypeDef *cs_port, uint16_t cs_pin)
+{
+    if ((spi == NULL) || (cs_port == NULL) || (spi->hdmarx == NULL) || (spi->hdmatx == NULL))
+        return false;
+
+    sd_spi     = spi;
+    sd_cs_port = cs_port;
+    sd_cs_pin  = cs_pin;
+    sd_card    = SD_SPI_CARD_NONE;
+    sd_sectors = 0;
+    memset(&sd_stats, 0, sizeof(sd_stats));
+
+    HAL_GPIO_WritePin(sd_cs_port, sd_cs_pin, GPIO_PIN_SET);
+    __HAL_SPI_ENABLE(sd_spi);
+    return true;
+}
+
+bool SdSpi_InitCard(void)
+{
+    uint8_t  r7[4];
+    uint8_t  r1;
+    uint32_t acmd41_arg = 0;
+
+    if (sd_spi == NULL)
+        return false;
+
+    sd_card    = SD_SPI_CARD_NONE;
+    sd_sectors = 0;
+
+    /* At least 74 clocks with CS and DI high: the card enters SPI mode at CMD0 */
+    SdSpi_SetClock(SD_SPI_INIT_HZ);
+    HAL_GPIO_WritePin(sd_cs_port, sd_cs_pin, GPIO_PIN_SET);
+    for (uint32_t i = 0; i < 10U; i++)
+        (void)SdSpi_Xchg(0xFFU);
+
+    for (uint32_t tries = 0; ((r1 = SdSpi_Command(SD_CMD0, 0U)) != SD_R1_IDLE) && (tries < 10U); tries++)
+        ;
+    if (r1 != SD_R1_IDLE)
+    {
+        SdSpi_Deselect();
+        return false;
+    }
+
+    /* SD 2.0+ echoes the check pattern with the 2.7-3.6 V range */
+    if (SdSpi_Command(SD_CMD8, 0x1AAU) == SD_R1_IDLE)
+    {
+        for (uint32_t i = 0; i < sizeof(r7); i++)
+            r7[i] = SdSpi_Xchg(0xFFU);
+
+        if ((r7[2] != 0x01U) || (r7[3] != 0xAAU))
+        {
+            SdSpi_Deselect();
+            return false;
+        }
+        acmd41_arg = SD_OCR_CCS;        /* Host supports high capacity */
+        sd_card    = SD_SPI_CARD_SDV2;
+    }
+    else
+    {
+        sd_card = SD_SPI_CARD_SDV1;
+    }
+
+    /* Leave idle: initialization takes up to a second, the task sleeps meanwhile */
+    TickType_t start = xTaskGetTickCount();
+
+    while ((r1 = SdSpi_Command(SD_ACMD41, acmd41_arg)) == SD_R1_IDLE)
+    {
+        if (!SdSpi_Sleep(start, SD_SPI_INIT_TIMEOUT_MS))
+            break;
+    }
+
+    if (r1 != 0U)
+    {
+        sd_card = SD_SPI_CARD_NONE;
+        SdSpi_Deselect();
+        return false;
+    }
+
+    if (sd_card == SD_SPI_CARD_SDV2)
+    {
+        uint8_t ocr[4];
+
+        if (SdSpi_Command(SD_CMD58, 0U) != 0U)
+        {
+            sd_card = SD_SPI_CARD_NONE;
+            SdSpi_Deselect();
+            return false;
+        }
+        for (uint32_t i = 0; i < sizeof(ocr); i++)
+            ocr[i] = SdSpi_Xchg(0xFFU);
+
+        if ((ocr[0] & (uint8_t)(SD_OCR_CCS >> 24)) != 0U)
+            sd_card = SD_SPI_CARD_SDHC;
+    }
+
+    /* Byte addressed cards: 512-byte blocks */
+    if ((sd_card != SD_SPI_CARD_SDHC) && (SdSpi_Command(SD_CMD16, SD_SPI_SECTOR_SIZE) != 0U))
+    {
+        sd_card = SD_SPI_CARD_NONE;
+        SdSpi_Deselect();
+        return false;
+    }
+    SdSpi_Deselect();
+
+    SdSpi_SetClock(SD_SPI_FAST_HZ);
+
+    if (!SdSpi_ReadGeometry())
+    {
+        sd_card = SD_SPI_CARD_NONE;
+        return false;
+    }
+
+    return true;
+}
+
+SdSpi_Card_t SdSpi_GetCardType(void)
+{
+    return sd_card;
+}
+
+bool SdSpi_Read(uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    if ((sd_card == SD_SPI_CARD_NONE) || (buf == NULL) || (count == 0U))
+        return false;
+
+    uint32_t addr = (sd_card == SD_SPI_CARD_SDHC) ? sector : (sector * SD_SPI_SECTOR_SIZE);
+    uint32_t done = 0;
+
+    sd_stats.read_cmds++;
+
+    if (count == 1U)
+    {
+        if ((SdSpi_Command(SD_CMD17, addr) == 0U) && SdSpi_ReceiveBlock(buf, SD_SPI_SECTOR_SIZE))
+            done = 1U;
+    }
+    else if (SdSpi_Command(SD_CMD18, addr) == 0U)
+    {
+        while ((done < count) && SdSpi_ReceiveBlock(buf + done * SD_SPI_SECTOR_SIZE, SD_SPI_SECTOR_SIZE))
+            done++;
+
+        (void)SdSpi_Command(SD_CMD12, 0U);
+    }
+
+    SdSpi_Deselect();
+    sd_stats.sectors_read += done;
+
+    if (done != count)
+        sd_stats.errors++;
+
+    return done == count;
+}
+
+bool SdSpi_Write(const uint8_t *buf, uint32_t sector, uint32_t count)
+{
+    if ((sd_card == SD_SPI_CARD_NONE) || (buf == NULL) || (count == 0U))
+        return false;
+
+    uint32_t addr = (sd_card == SD_SPI_CARD_SDHC) ? sector : (sector * SD_SPI_SECTOR_SIZE);
+    uint32_t done = 0;
+
+    sd_stats.write_cmds++;
+
+    if (count == 1U)
+    {
+        if ((SdSpi_Command(SD_CMD24, addr) == 0U) && SdSpi_SendBlock(buf, SD_TOKEN_BLOCK))
+            done = 1U;
+    }
+    else
+    {
+        /* Pre-erase hint: the card may erase the whole run ahead of the data */
+        (void)SdSpi_Command(SD_ACMD23, count);
+
+        if (SdSpi_Command(SD_CMD25, addr) == 0U)
+        {
+            while ((done < count) && SdSpi_SendBlock(buf + done * SD_SPI_SECTOR_SIZE, SD_TOKEN_MULTI))
+                done++;
+
+            if (!SdSpi_SendBlock(NULL, SD_TOKEN_STOP))
+                done = 0;
+        }
+    }
+
+    /* Programming goes on after the deselect: the next command waits for it */
+    SdSpi_Deselect();
+    sd_stats.sectors_written += done;
+
+    if (done != count)
+        sd_stats.errors++;
+
+    return done == count;
+}
+
+bool SdSpi_Sync(void)
+{
+    if (sd_card == SD_SPI_CARD_NONE)
+        return false;
+
+    bool ready = SdSpi_Begin();
+
+    SdSpi_Deselect();
+    return ready;
+}
+
+uint32_t SdSpi_GetSectorCount(void)
+{
+    return sd_sectors;
+}
+
+uint32_t SdSpi_GetEraseBlock(void)
+{
+    return sd_erase_block;
+}
+
+void SdSpi_GetStats(SdSpi_Stats_t *stats)
+{
+    *stats = sd_stats;
+}
@@ -0,0 +1,176 @@
+/**
+ ******************************************************************************
+ * @file    uart_rx.c
+ * @brief   UART receive engine implementation.
+ ******************************************************************************
+ */
+
+#include "uart_rx.h"
+#include "cmsis_os.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stddef.h>
+
+#define UART_RX_MASK            (UART_RX_RING_SIZE - 1U)
+
+_Static_assert((UART_RX_RING_SIZE & UART_RX_MASK) == 0U, "UART_RX_RING_SIZE must be a power of two");
+_Static_assert(UART_RX_RING_SIZE <= 0xFFFFU, "UART_RX_RING_SIZE exceeds one DMA transfer");
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static UART_HandleTypeDef *rx_uart = NULL;
+
+/* Circular DMA target */
+static uint8_t rx_ring[UART_RX_RING_SIZE];
+
+/* Free-running byte counts: rx_head written by the ISRs, rx_tail by the reader */
+static volatile uint32_t rx_head   = 0;
+static volatile uint32_t rx_tail   = 0;
+static volatile uint32_t rx_resync = 0;     /* First valid byte after a DMA restart */
+static uint32_t          rx_pos    = 0;     /* DMA position at the last event */
+
+static volatile TaskHandle_t   rx_reader = NULL;
+static volatile UartRx_Stats_t rx_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+/** (Re)start the DMA at ring offset 0 */
+static bool UartRx_Arm(void)
+{
+    rx_pos = 0;
+    return HAL_UARTEx_ReceiveToIdle_DMA(rx_uart, rx_ring, UART_RX_RING_SIZE) == HAL_OK;
+}
+
+/** Unread bytes; skips what a restart or an overrun made invalid (reader) */
+static uint32_t UartRx_Available(void)
+{
+    uint32_t head = rx_head;
+
+    if ((int32_t)(rx_resync - rx_tail) > 0)
+        rx_tail = rx_resync;
+
+    uint32_t avail = head - rx_tail;
+
+    if (avail > UART_RX_RING_SIZE)
+    {
+        rx_stats.overruns++;
+        rx_tail = head;
+        avail   = 0;
+    }
+
+    return avail;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool UartRx_Start(UART_HandleTypeDef *uart)
+{
+    if ((uart == NULL) || (uart->hdmarx == NULL) || (uart->hdmarx->Init.Mode != DMA_CIRCULAR))
+        return false;
+
+    rx_uart   = uart;
+    rx_head   = 0;
+    rx_tail   = 0;
+    rx_resync = 0;
+    rx_stats  = (UartRx_Stats_t){ 0 };
+
+    return UartRx_Arm();
+}
+
+uint32_t UartRx_Wait(const uint8_t **data, uint32_t timeout_ms)
+{
+    rx_reader = xTaskGetCurrentTaskHandle();
+
+    uint32_t avail = UartRx_Available();
+
+    /* An event between the check and the take leaves the notification pending */
+    if (avail == 0U)
+    {
+        TickType_t ticks = (timeout_ms == osWaitForever) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+        ulTaskNotifyTake(pdTRUE, ticks);
+        avail = UartRx_Available();
+    }
+
+    uint32_t offset = rx_tail & UART_RX_MASK;
+    uint32_t span   = UART_RX_RING_SIZE - offset;
+
+    *data = &rx_ring[offset];
+    return (avail < span) ? avail : span;
+}
+
+void UartRx_Consume(uint32_t n)
+{
+    rx_tail += n;
+}
+
+void UartRx_GetStats(UartRx_Stats_t *stats)
+{
+    *stats = rx_stats;
+}
+
+/* ------------------------------------------------------------------------- */
+/* UART ISR hooks                                                            */
+/* ------------------------------------------------------------------------- */
+
+/**
+ * @brief Half / full transfer or idle line: publish the new DMA position.
+ *
+ * size is the write offset in the ring (UART_RX_RING_SIZE after a full
+ * transfer). Events are at most half a ring apart, so the distance from
+ * the previous position is unambiguous.
+ */
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t size)
+{
+    if (huart != rx_uart)
+        return;
+
+    uint32_t pos = size & UART_RX_MASK;
+    uint32_t n   = (pos - rx_pos) & UART_RX_MASK;
+
+    rx_pos = pos;
+    rx_stats.events++;
+
+    if (n == 0U)
+        return;
+
+    rx_head += n;
+    rx_stats.bytes += n;
+
+    if (rx_reader != NULL)
+    {
+        BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+        vTaskNotifyGiveFromISR(rx_reader, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+}
+
+/**
+ * @brief UART error: the HAL has stopped the DMA, restart it.
+ *
+ * The DMA starts again at ring offset 0: the head jumps to the next lap
+ * and the reader skips the bytes in between.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if (huart != rx_uart)
+        return;
+
+    rx_stats.errors++;
+
+    if (huart->RxState != HAL_UART_STATE_READY)
+        return;
+
+    uint32_t lap = (rx_head + UART_RX_MASK) & ~UART_RX_MASK;
+
+    rx_head   = lap;
+    rx_resync = lap;
+    UartRx_Arm();
+}
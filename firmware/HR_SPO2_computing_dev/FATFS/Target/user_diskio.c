@@ -35,6 +35,7 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h>
 #include "ff_gen_drv.h"
+#include "sd_spi.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -81,7 +82,7 @@ DSTATUS USER_initialize (
 )
 {
   /* USER CODE BEGIN INIT */
-    Stat = STA_NOINIT;
+    Stat = SdSpi_InitCard() ? 0U : STA_NOINIT;
     return Stat;
   /* USER CODE END INIT */
 }
@@ -96,7 +97,8 @@ DSTATUS USER_status (
 )
 {
   /* USER CODE BEGIN STATUS */
-    Stat = STA_NOINIT;
+    if (SdSpi_GetCardType() == SD_SPI_CARD_NONE)
+        Stat = STA_NOINIT;
     return Stat;
   /* USER CODE END STATUS */
 }
@@ -117,7 +119,11 @@ DRESULT USER_read (
 )
 {
   /* USER CODE BEGIN READ */
-    return RES_OK;
+    if ((Stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    /* Multi-sector requests stay one CMD18 */
+    return SdSpi_Read(buff, sector, count) ? RES_OK : RES_ERROR;
   /* USER CODE END READ */
 }
 
@@ -138,8 +144,11 @@ DRESULT USER_write (
 )
 {
   /* USER CODE BEGIN WRITE */
-  /* USER CODE HERE */
-    return RES_OK;
+    if ((Stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    /* Multi-sector requests stay one ACMD23 + CMD25 */
+    return SdSpi_Write(buff, sector, count) ? RES_OK : RES_ERROR;
   /* USER CODE END WRITE */
 }
 #endif /* _USE_WRITE == 1 */
@@ -160,6 +169,37 @@ DRESULT USER_ioctl (
 {
   /* USER CODE BEGIN IOCTL */
     DRESULT res = RES_ERROR;
+
+    if ((Stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        res = SdSpi_Sync() ? RES_OK : RES_ERROR;
+        break;
+
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = SdSpi_GetSectorCount();
+        res = RES_OK;
+        break;
+
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = SD_SPI_SECTOR_SIZE;
+        res = RES_OK;
+        break;
+
+    case GET_BLOCK_SIZE:
+        /* f_mkfs aligns the data area to the card's erase block */
+        *(DWORD *)buff = SdSpi_GetEraseBlock();
+        res = RES_OK;
+        break;
+
+    default:
+        res = RES_PARERR;
+        break;
+    }
+
     return res;
   /* USER CODE END IOCTL */
 }
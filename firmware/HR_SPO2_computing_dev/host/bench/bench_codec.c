@@ -0,0 +1,390 @@
+/**
+ ******************************************************************************
+ * @file    bench_codec.c
+ * @brief   Host benchmark of the lossless sample codec on recordings.
+ *
+ * @details
+ * Codes every channel of a recording the way the session log does
+ * (ppg_log_format.h): frames of -f samples in blocks of -b frames, each
+ * block a reset point and one bit stream padded to a byte. For the zig-zag varint deltas (order 0)
+ * and the ppg_codec.h predictor orders 1..3 reports:
+ *   - bytes, ratio against 16-bit samples and bits per sample
+ *   - encode time per sample: host ns and time base ticks (TSC cycles on
+ *     x86-64, ppg_profile.h)
+ *   - decode throughput in MB/s of 16-bit samples
+ * and checks that decoding gives back every sample (exit status 1 if not).
+ *
+ * Inputs:
+ *   - J-Scope exports (';'-separated): the adc_raw column while
+ *     ppg_running != 0, at the J-Scope rate
+ *   - PPG CSVs (','-separated, e.g. the 500 Hz s10_sit.csv of
+ *     filter_design.ipynb): every pleth* column, else every column
+ * Integer columns within 0..65535 are coded as they are; others are
+ * rescaled to 12 bits (reported).
+ *
+ * On target the encoding is timed by the "log_encode" stage of
+ * ppg_profile.h.
+ *
+ * Usage: bench_codec [-f frame_samples] [-b block_frames] recording.csv ...
+ ******************************************************************************
+ */
+
+#include "ppg_codec.h"
+#include "ppg_profile.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_LINE      4096U
+#define BENCH_MAX_COLUMNS   64U
+#define BENCH_MIN_NS        2e8         /**< Shortest timing run */
+#define BENCH_ORDERS        4U          /**< 0 (varint deltas) .. PPG_CODEC_MAX_ORDER */
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+    uint16_t *x[BENCH_MAX_COLUMNS];
+    unsigned  channels;
+    size_t    length;
+    int       rescaled;
+} BenchSignal_t;
+
+static uint8_t  *code_buf;
+static uint16_t *out_buf;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static unsigned SplitLine(char *line, char delim, char **fields)
+{
+    unsigned n = 0;
+    char    *p = line;
+
+    while ((n < BENCH_MAX_COLUMNS) && (p != NULL))
+    {
+        fields[n++] = p;
+        p = strchr(p, delim);
+        if (p != NULL)
+            *p++ = '\0';
+    }
+    return n;
+}
+
+static int LoadRecording(const char *path, BenchSignal_t *sig)
+{
+    static char line[BENCH_MAX_LINE];
+    static char header[BENCH_MAX_LINE];
+    char  *names[BENCH_MAX_COLUMNS];
+    char  *fields[BENCH_MAX_COLUMNS];
+    int    cols[BENCH_MAX_COLUMNS];
+    int    gate = -1;
+    double *v[BENCH_MAX_COLUMNS];
+    size_t cap = 0;
+    FILE  *f = fopen(path, "r");
+
+    memset(sig, 0, sizeof(*sig));
+    if ((f == NULL) || (fgets(header, sizeof(header), f) == NULL))
+    {
+        perror(path);
+        if (f != NULL)
+            fclose(f);
+        return -1;
+    }
+
+    header[strcspn(header, "\r\n")] = '\0';
+    char     delim = (strchr(header, ';') != NULL) ? ';' : ',';
+    unsigned count = SplitLine(header, delim, names);
+
+    for (unsigned c = 0; c < count; c++)
+    {
+        if (strcmp(names[c], "ppg_running") == 0)
+            gate = (int)c;
+        if ((strcmp(names[c], "adc_raw") == 0) || (strncmp(names[c], "pleth", 5U) == 0))
+            cols[sig->channels++] = (int)c;
+    }
+
+    /* No known column: every column */
+    for (unsigned c = 0; (sig->channels == 0U) && (c < count); c++)
+        cols[c] = (int)c;
+    if (sig->channels == 0U)
+        sig->channels = count;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (SplitLine(line, delim, fields) != count)
+            continue;
+        if ((gate >= 0) && (atof(fields[gate]) == 0.0))
+            continue;
+
+        if (sig->length == cap)
+        {
+            cap = (cap == 0U) ? 4096U : (2U * cap);
+            for (unsigned c = 0; c < sig->channels; c++)
+                v[c] = realloc((cap == 4096U) ? NULL : v[c], cap * sizeof(double));
+        }
+
+        for (unsigned c = 0; c < sig->channels; c++)
+            v[c][sig->length] = atof(fields[cols[c]]);
+        sig->length++;
+    }
+    fclose(f);
+
+    for (unsigned c = 0; c < sig->channels; c++)
+    {
+        double lo = INFINITY, hi = -INFINITY;
+        int    exact = 1;
+
+        for (size_t i = 0; i < sig->length; i++)
+        {
+            lo = fmin(lo, v[c][i]);
+            hi = fmax(hi, v[c][i]);
+            exact = exact && (v[c][i] == floor(v[c][i]));
+        }
+
+        exact = exact && (lo >= 0.0) && (hi <= 65535.0);
+        sig->rescaled |= !exact;
+        sig->x[c] = malloc((sig->length + 1U) * sizeof(uint16_t));
+
+        for (size_t i = 0; i < sig->length; i++)
+            sig->x[c][i] = exact ? (uint16_t)v[c][i] :
+                           (uint16_t)lround((hi > lo) ? ((v[c][i] - lo) * 4095.0 / (hi - lo)) : 0.0);
+        free(v[c]);
+    }
+
+    return (sig->length > 0U) ? 0 : -1;
+}
+
+static size_t PutVarint(uint8_t *buf, uint32_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80U)
+    {
+        buf[n++] = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+    return n;
+}
+
+/** One channel, frame by frame; returns the coded size */
+static size_t Encode(const uint16_t *x, size_t len, uint32_t order, uint32_t frame, uint32_t block)
+{
+    PPG_CodecChannel_t ch;
+    PPG_BitWriter_t    bw;
+    uint16_t           last = 0;
+    size_t             n    = 0;
+
+    for (size_t i = 0, f = 0; i < len; i += frame, f++)
+    {
+        uint32_t cnt = ((len - i) < frame) ? (uint32_t)(len - i) : frame;
+
+        if ((f % block) == 0U)
+        {
+            if ((order > 0U) && (f > 0U))
+                n += PPG_BitWriter_Flush(&bw);
+            PPG_BitWriter_Init(&bw, &code_buf[n]);
+            PPG_Codec_Reset(&ch);
+            last = 0;
+        }
+
+        if (order == 0U)
+        {
+            for (uint32_t j = 0; j < cnt; j++)
+            {
+                int32_t e = (int32_t)x[i + j] - (int32_t)last;
+
+                n   += PutVarint(&code_buf[n], ((uint32_t)e << 1) ^ (uint32_t)(e >> 31));
+                last = x[i + j];
+            }
+            continue;
+        }
+
+        PPG_Codec_Encode(&ch, order, &bw, &x[i], cnt);
+    }
+
+    if ((order > 0U) && (len > 0U))
+        n += PPG_BitWriter_Flush(&bw);
+    return n;
+}
+
+static int Decode(size_t coded, size_t len, uint32_t order, uint32_t frame, uint32_t block)
+{
+    PPG_CodecChannel_t ch;
+    PPG_BitReader_t    br;
+    uint16_t           last = 0;
+    size_t             pos  = 0;
+
+    for (size_t i = 0, f = 0; i < len; i += frame, f++)
+    {
+        uint32_t cnt = ((len - i) < frame) ? (uint32_t)(len - i) : frame;
+
+        if ((f % block) == 0U)
+        {
+            if ((order > 0U) && (f > 0U))
+                pos += PPG_BitReader_Align(&br);
+            PPG_BitReader_Init(&br, &code_buf[pos], coded - pos);
+            PPG_Codec_Reset(&ch);
+            last = 0;
+        }
+
+        if (order == 0U)
+        {
+            for (uint32_t j = 0; j < cnt; j++)
+            {
+                uint32_t u = 0, shift = 0;
+                uint8_t  b;
+
+                do
+                {
+                    b = code_buf[pos++];
+                    u |= (uint32_t)(b & 0x7FU) << shift;
+                    shift += 7U;
+                } while ((b & 0x80U) != 0U);
+
+                last = (uint16_t)(last + ((int32_t)(u >> 1) ^ -(int32_t)(u & 1U)));
+                out_buf[i + j] = last;
+            }
+            continue;
+        }
+
+        if (!PPG_Codec_Decode(&ch, order, &br, &out_buf[i], cnt))
+            return -1;
+    }
+
+    if ((order > 0U) && (len > 0U))
+        pos += PPG_BitReader_Align(&br);
+    return (pos == coded) ? 0 : -1;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f frame_samples] [-b block_frames] recording.csv ...\n", prog);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    uint32_t frame = 10U;
+    uint32_t block = 32U;
+    int      ok    = 1;
+    int      c;
+
+    while ((c = getopt(argc, argv, "f:b:h")) != -1)
+    {
+        switch (c)
+        {
+        case 'f': frame = (uint32_t)strtoul(optarg, NULL, 0); break;
+        case 'b': block = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((optind >= argc) || (frame == 0U) || (block == 0U))
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    PPG_Profile_Init(0U);
+    printf("frames of %u samples, reset point every %u frames; time base %lu ticks/s\n",
+           (unsigned)frame, (unsigned)block, (unsigned long)ppg_profile_tick_hz);
+
+    for (int a = optind; a < argc; a++)
+    {
+        BenchSignal_t sig;
+
+        if (LoadRecording(argv[a], &sig) != 0)
+        {
+            fprintf(stderr, "%s: no samples\n", argv[a]);
+            return EXIT_FAILURE;
+        }
+
+        code_buf = malloc(((sig.length * PPG_CODEC_MAX_BITS) / 8U) + sig.length + 16U);
+        out_buf  = malloc((sig.length + 1U) * sizeof(uint16_t));
+
+        printf("\n%s: %u channel(s) x %zu samples%s\n", argv[a], sig.channels, sig.length,
+               sig.rescaled ? " (rescaled to 12 bits)" : "");
+        printf("%-8s %10s %7s %9s %12s %11s %9s\n", "coding", "bytes", "ratio", "bits/smp",
+               "enc ticks/smp", "enc ns/smp", "dec MB/s");
+
+        for (uint32_t order = 0; order < BENCH_ORDERS; order++)
+        {
+            size_t bytes = 0;
+            double enc_ns = 0.0, dec_ns = 0.0, enc_ticks = 0.0;
+            size_t enc_samples = 0, dec_samples = 0;
+
+            for (unsigned ch = 0; ch < sig.channels; ch++)
+            {
+                const uint16_t *x = sig.x[ch];
+                size_t coded = 0;
+
+                /* Repeat until the run is long enough to time */
+                do
+                {
+                    uint32_t t0 = PPG_Profile_Now();
+                    double   n0 = NowNs();
+
+                    coded        = Encode(x, sig.length, order, frame, block);
+                    enc_ns      += NowNs() - n0;
+                    enc_ticks   += (double)(PPG_Profile_Now() - t0);
+                    enc_samples += sig.length;
+                } while (enc_ns < (BENCH_MIN_NS * (ch + 1U) / sig.channels));
+
+                do
+                {
+                    double n0 = NowNs();
+
+                    if (Decode(coded, sig.length, order, frame, block) != 0)
+                        ok = 0;
+                    dec_ns      += NowNs() - n0;
+                    dec_samples += sig.length;
+                } while (dec_ns < (BENCH_MIN_NS * (ch + 1U) / sig.channels));
+
+                if (memcmp(out_buf, x, sig.length * sizeof(uint16_t)) != 0)
+                {
+                    printf("  order %u channel %u: decoded samples differ\n", (unsigned)order, ch);
+                    ok = 0;
+                }
+                bytes += coded;
+            }
+
+            size_t raw = sig.length * sig.channels * 2U;
+
+            printf("%-8s %10zu %6.2fx %9.2f %12.1f %11.2f %9.1f\n",
+                   (order == 0U) ? "varint" : ((order == 1U) ? "rice o1" : ((order == 2U) ? "rice o2" : "rice o3")),
+                   bytes, (double)raw / (double)bytes, 8.0 * (double)bytes / (double)(raw / 2U),
+                   enc_ticks / (double)enc_samples, enc_ns / (double)enc_samples,
+                   (double)dec_samples * 2.0 * 1e3 / dec_ns);
+        }
+
+        for (unsigned ch = 0; ch < sig.channels; ch++)
+            free(sig.x[ch]);
+        free(code_buf);
+        free(out_buf);
+    }
+
+    printf("\n%s\n", ok ? "PASS" : "FAIL");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
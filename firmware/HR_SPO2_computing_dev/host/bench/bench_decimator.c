@@ -0,0 +1,166 @@
+/**
+ ******************************************************************************
+ * @file    bench_decimator.c
+ * @brief   Host benchmark and noise check of the CIC decimator.
+ *
+ * @details
+ * For each decimation ratio R (ADC rate = R * PPG_FS) reports:
+ *   - operations per output sample (N*R integrator adds, N comb
+ *     subtractions, one multiply) and ns per input / output sample
+ *   - the cycle budget of one output period at the 16 MHz core clock,
+ *     and the operations above as a share of it
+ *   - RMS error against the noise-free signal of the CIC output and of
+ *     plain x[::R] slicing (notebook), for white ADC noise
+ *
+ * On target the decimator is timed by the "decimator" stage of
+ * ppg_profile.h.
+ *
+ * Usage: bench_decimator [noise_lsb]
+ ******************************************************************************
+ */
+
+#include "ppg_decimator.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_FS_OUT      100U          /**< Processing rate (PPG_FS) */
+#define BENCH_CORE_HZ     16000000U     /**< STM32F411 HSI, no PLL */
+#define BENCH_OUTPUTS     200000U       /**< Output samples per timing run */
+#define BENCH_CHECK_OUT   20000U        /**< Output samples of the noise check */
+
+static const uint32_t bench_ratios[] = { 2U, 4U, 5U, 8U, 10U, 16U };
+
+static volatile uint32_t sink;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** Noise-free PPG-like signal in LSB at time t [s] */
+static double Clean(double t)
+{
+    return 2048.0 + 300.0 * sin(2.0 * M_PI * 1.2 * t) + 90.0 * sin(2.0 * M_PI * 2.4 * t + 0.8);
+}
+
+/** Zero-mean Gaussian noise (Box-Muller) */
+static double Noise(double sigma)
+{
+    double u1 = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+    double u2 = ((double)rand() + 1.0) / ((double)RAND_MAX + 2.0);
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+static uint16_t Quantize(double v)
+{
+    long q = lround(v);
+    return (uint16_t)((q < 0) ? 0 : ((q > 4095) ? 4095 : q));
+}
+
+/* ------------------------------------------------------------------------- */
+/* Benchmarks                                                                */
+/* ------------------------------------------------------------------------- */
+
+static double BenchTiming(uint32_t ratio)
+{
+    static uint16_t input[4096];
+    PPG_CIC_t cic;
+    uint32_t acc = 0;
+    uint16_t y;
+
+    for (uint32_t i = 0; i < 4096U; i++)
+        input[i] = Quantize(Clean((double)i / (BENCH_FS_OUT * ratio)) + Noise(8.0));
+
+    PPG_CIC_Init(&cic, ratio);
+
+    uint32_t inputs = BENCH_OUTPUTS * ratio;
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < inputs; n++)
+    {
+        if (PPG_CIC_Process(&cic, input[n & 4095U], &y))
+            acc += y;
+    }
+    double t1 = NowNs();
+
+    sink = acc;
+    return (t1 - t0) / (double)inputs;
+}
+
+static void NoiseCheck(uint32_t ratio, double sigma, double *rms_cic, double *rms_slice)
+{
+    PPG_CIC_t cic;
+    double fs_in = (double)BENCH_FS_OUT * ratio;
+
+    /* CIC group delay: N (R - 1) / 2 input samples */
+    double delay = (double)PPG_CIC_ORDER * (double)(ratio - 1U) / 2.0;
+
+    double e_cic = 0.0, e_slice = 0.0;
+    uint32_t m = 0, outputs = 0, slices = 0;
+    uint16_t y;
+
+    PPG_CIC_Init(&cic, ratio);
+
+    for (uint32_t n = 0; outputs < BENCH_CHECK_OUT; n++)
+    {
+        double   t = (double)n / fs_in;
+        uint16_t x = Quantize(Clean(t) + Noise(sigma));
+
+        if ((n % ratio) == 0U)
+        {
+            double d = (double)x - Clean(t);
+            e_slice += d * d;
+            slices++;
+        }
+
+        if (PPG_CIC_Process(&cic, x, &y))
+        {
+            /* Skip the ramp-up of the first outputs */
+            if (++m > PPG_CIC_ORDER)
+            {
+                double d = (double)y - Clean(((double)n - delay) / fs_in);
+                e_cic += d * d;
+                outputs++;
+            }
+        }
+    }
+
+    *rms_cic   = sqrt(e_cic / outputs);
+    *rms_slice = sqrt(e_slice / slices);
+}
+
+int main(int argc, char **argv)
+{
+    double sigma = (argc > 1) ? atof(argv[1]) : 8.0;
+
+    srand(1234);
+
+    printf("CIC order %u, output %u Hz, core %u MHz, ADC noise %.1f LSB rms\n",
+           (unsigned)PPG_CIC_ORDER, BENCH_FS_OUT, BENCH_CORE_HZ / 1000000U, sigma);
+    printf("   R  fs_in[Hz]  ops/out  ns/in  ns/out  cycles/out_period  ops/budget  rms_slice  rms_cic\n");
+
+    for (size_t i = 0; i < sizeof(bench_ratios) / sizeof(bench_ratios[0]); i++)
+    {
+        uint32_t r   = bench_ratios[i];
+        uint32_t ops = PPG_CIC_ORDER * r + PPG_CIC_ORDER + 1U;
+        uint32_t budget = BENCH_CORE_HZ / BENCH_FS_OUT;
+        double   ns  = BenchTiming(r);
+        double   rms_cic, rms_slice;
+
+        NoiseCheck(r, sigma, &rms_cic, &rms_slice);
+
+        printf("%4u  %9u  %7u  %5.2f  %6.2f  %17u  %9.3f%%  %9.2f  %7.2f\n",
+               (unsigned)r, (unsigned)(BENCH_FS_OUT * r), (unsigned)ops, ns, ns * r,
+               (unsigned)budget, 100.0 * ops / budget, rms_slice, rms_cic);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,306 @@
+/**
+ ******************************************************************************
+ * @file    bench_fatfs.c
+ * @brief   Host FatFs throughput and correctness run on a disk image.
+ *
+ * @details
+ * Formats a disk image (disk_image.h, same driver table as the SD card
+ * drive) with the firmware FatFs configuration, then:
+ *   - writes a file of known pseudo-random content in chunks of the
+ *     given size and closes it
+ *   - remounts, reads it back in the same chunks and compares every byte
+ *   - reads 512-byte records at scattered offsets (f_lseek) and compares
+ *   - writes a second file the way the session logger does
+ *     (data_logger.c): allocated contiguous up front (f_expand), mapped
+ *     by a fast seek table, truncated to the data at the close; then
+ *     reads it back
+ * Reports MB/s of each pass and the driver counters: sectors per request
+ * shows whether a chunk size reaches the multi-sector (CMD18 / CMD25)
+ * path of sd_spi.c. Driver reads during a write pass are FAT and
+ * directory accesses; for the preallocated file the reads between the
+ * first and the last f_write() are also printed: none with chunks of
+ * whole sectors, one per sector otherwise (FatFs reads a sector of an
+ * allocated file back before writing part of it). Host MB/s measure
+ * FatFs overhead against the page cache, not the card. Exits with status
+ * 1 on any mismatch.
+ *
+ * Usage: bench_fatfs [image [file_kib [chunk_bytes [image_mib]]]]
+ ******************************************************************************
+ */
+
+#include "disk_image.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_ERASE_BLOCK   8192U       /**< 4 MiB allocation unit, as SDHC cards */
+#define BENCH_RECORDS       2000U       /**< Scattered reads */
+#define BENCH_MAX_CHUNK     65536U
+
+static uint8_t chunk_buf[BENCH_MAX_CHUNK];
+static uint8_t work_buf[_MAX_SS * 8U];
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** Content of the file at a byte offset */
+static uint8_t Pattern(uint32_t offset)
+{
+    uint32_t x = offset * 2654435761U;
+
+    x ^= x >> 15;
+    return (uint8_t)(x ^ (offset >> 9));
+}
+
+static void Fill(uint8_t *buf, uint32_t offset, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        buf[i] = Pattern(offset + i);
+}
+
+static bool Check(const uint8_t *buf, uint32_t offset, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+    {
+        if (buf[i] != Pattern(offset + i))
+        {
+            printf("  mismatch at byte %u\n", (unsigned)(offset + i));
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintPass(const char *name, uint32_t bytes, double ns,
+                      const DiskImage_Stats_t *before, const DiskImage_Stats_t *after)
+{
+    uint32_t reads   = after->read_cmds - before->read_cmds;
+    uint32_t writes  = after->write_cmds - before->write_cmds;
+    uint32_t sectors = (after->sectors_read - before->sectors_read) +
+                       (after->sectors_written - before->sectors_written);
+
+    printf("%-10s %10u %10.1f %10u %10u %10.1f\n", name, (unsigned)bytes,
+           (double)bytes / (ns * 1e-3), (unsigned)reads, (unsigned)writes,
+           ((reads + writes) > 0U) ? (double)sectors / (reads + writes) : 0.0);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Passes                                                                    */
+/* ------------------------------------------------------------------------- */
+
+static bool WritePass(const char *name, uint32_t size, uint32_t chunk)
+{
+    FIL      fil;
+    UINT     done;
+    uint32_t offset = 0;
+
+    if (f_open(&fil, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return false;
+
+    while (offset < size)
+    {
+        uint32_t len = ((size - offset) < chunk) ? (size - offset) : chunk;
+
+        Fill(chunk_buf, offset, len);
+        if ((f_write(&fil, chunk_buf, len, &done) != FR_OK) || (done != len))
+        {
+            (void)f_close(&fil);
+            return false;
+        }
+        offset += len;
+    }
+
+    return f_close(&fil) == FR_OK;
+}
+
+static bool ReadPass(const char *name, uint32_t size, uint32_t chunk)
+{
+    FIL      fil;
+    UINT     done;
+    uint32_t offset = 0;
+    bool     ok     = true;
+
+    if ((f_open(&fil, name, FA_READ) != FR_OK) || (f_size(&fil) != size))
+        return false;
+
+    while (ok && (offset < size))
+    {
+        uint32_t len = ((size - offset) < chunk) ? (size - offset) : chunk;
+
+        ok = (f_read(&fil, chunk_buf, len, &done) == FR_OK) && (done == len) &&
+             Check(chunk_buf, offset, len);
+        offset += len;
+    }
+
+    return (f_close(&fil) == FR_OK) && ok;
+}
+
+/** Logger file handling: contiguous allocation, fast seek, truncate at the close */
+static bool PreallocPass(const char *name, uint32_t size, uint32_t chunk)
+{
+    static DWORD clmt[8];
+    FIL      fil;
+    UINT     done;
+    uint32_t offset = 0;
+    bool     ok;
+    DiskImage_Stats_t before, after;
+
+    if (f_open(&fil, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+        return false;
+
+    /* Allocation a quarter larger than the data, as a session estimate */
+    clmt[0] = sizeof(clmt) / sizeof(clmt[0]);
+    ok = (f_expand(&fil, size + size / 4U, 1) == FR_OK);
+    fil.cltbl = clmt;
+    ok = ok && (f_lseek(&fil, CREATE_LINKMAP) == FR_OK) && (f_lseek(&fil, 0) == FR_OK);
+    ok = ok && (f_sync(&fil) == FR_OK);
+    if (!ok)
+        printf("  no contiguous area of %u bytes\n", (unsigned)(size + size / 4U));
+
+    DiskImage_GetStats(&before);
+    while (ok && (offset < size))
+    {
+        uint32_t len = ((size - offset) < chunk) ? (size - offset) : chunk;
+
+        Fill(chunk_buf, offset, len);
+        ok = (f_write(&fil, chunk_buf, len, &done) == FR_OK) && (done == len);
+        offset += len;
+    }
+    DiskImage_GetStats(&after);
+    printf("  prealloc: %u driver reads between the writes\n",
+           (unsigned)(after.read_cmds - before.read_cmds));
+
+    fil.cltbl = NULL;
+    ok = ok && (f_truncate(&fil) == FR_OK);
+    return (f_close(&fil) == FR_OK) && ok;
+}
+
+static bool SeekPass(const char *name, uint32_t size)
+{
+    FIL      fil;
+    UINT     done;
+    bool     ok = true;
+    uint32_t x  = 12345U;
+
+    if (f_open(&fil, name, FA_READ) != FR_OK)
+        return false;
+
+    for (uint32_t r = 0; ok && (r < BENCH_RECORDS); r++)
+    {
+        x = x * 1664525U + 1013904223U;
+
+        uint32_t offset = (uint32_t)(((uint64_t)x * size) >> 32);
+        uint32_t len    = ((size - offset) < 512U) ? (size - offset) : 512U;
+
+        ok = (f_lseek(&fil, offset) == FR_OK) &&
+             (f_read(&fil, chunk_buf, len, &done) == FR_OK) && (done == len) &&
+             Check(chunk_buf, offset, len);
+    }
+
+    return (f_close(&fil) == FR_OK) && ok;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    const char *image     = (argc > 1) ? argv[1] : "bench_fatfs.img";
+    uint32_t    file_kib  = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : 16384U;
+    uint32_t    chunk     = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : 4096U;
+    uint32_t    image_mib = (argc > 4) ? (uint32_t)strtoul(argv[4], NULL, 0) : 256U;
+    uint32_t    size      = file_kib * 1024U;
+    const char *name      = "BENCH.BIN";
+    const char *log_name  = "PPG00000.BIN";
+
+    static FATFS fs;
+    static char  path[4];
+    DiskImage_Stats_t s0, s1, s2, s3, s4;
+    double t0, t1, t2, t3, t4;
+
+    if ((chunk == 0U) || (chunk > BENCH_MAX_CHUNK) || (size == 0U))
+    {
+        fprintf(stderr, "chunk_bytes: 1..%u, file_kib > 0\n", (unsigned)BENCH_MAX_CHUNK);
+        return 1;
+    }
+
+    if (!DiskImage_Open(image, image_mib * 2048U, BENCH_ERASE_BLOCK) ||
+        (FATFS_LinkDriver(&DiskImage_Driver, path) != 0U))
+    {
+        fprintf(stderr, "cannot open %s\n", image);
+        return 1;
+    }
+
+    if ((f_mkfs(path, FM_ANY, 0, work_buf, sizeof(work_buf)) != FR_OK) ||
+        (f_mount(&fs, path, 1) != FR_OK))
+    {
+        fprintf(stderr, "f_mkfs / f_mount failed\n");
+        return 1;
+    }
+
+    printf("image %s: %u MiB, FAT%s, cluster %u B; file %u KiB, chunk %u B\n\n", image,
+           (unsigned)image_mib, (fs.fs_type == FS_FAT32) ? "32" : "16",
+           (unsigned)(fs.csize * _MAX_SS), (unsigned)file_kib, (unsigned)chunk);
+    printf("%-10s %10s %10s %10s %10s %10s\n", "pass", "bytes", "MB/s", "reads", "writes", "sect/req");
+
+    bool ok = true;
+
+    DiskImage_GetStats(&s0);
+    t0 = NowNs();
+    ok = ok && WritePass(name, size, chunk);
+    t1 = NowNs();
+    DiskImage_GetStats(&s1);
+    PrintPass("write", size, t1 - t0, &s0, &s1);
+
+    /* Remount: nothing left in the FatFs window */
+    ok = ok && (f_mount(NULL, path, 0) == FR_OK) && (f_mount(&fs, path, 1) == FR_OK);
+
+    DiskImage_GetStats(&s1);
+    t1 = NowNs();
+    ok = ok && ReadPass(name, size, chunk);
+    t2 = NowNs();
+    DiskImage_GetStats(&s2);
+    PrintPass("read", size, t2 - t1, &s1, &s2);
+
+    t2 = NowNs();
+    ok = ok && SeekPass(name, size);
+    t3 = NowNs();
+    DiskImage_GetStats(&s3);
+    PrintPass("seek+read", BENCH_RECORDS * 512U, t3 - t2, &s2, &s3);
+
+    t3 = NowNs();
+    ok = ok && PreallocPass(log_name, size, chunk);
+    t4 = NowNs();
+    DiskImage_GetStats(&s4);
+    PrintPass("prealloc", size, t4 - t3, &s3, &s4);
+
+    ok = ok && (f_mount(NULL, path, 0) == FR_OK) && (f_mount(&fs, path, 1) == FR_OK);
+    DiskImage_GetStats(&s3);
+    t3 = NowNs();
+    ok = ok && ReadPass(log_name, size, chunk);
+    t4 = NowNs();
+    DiskImage_GetStats(&s4);
+    PrintPass("read", size, t4 - t3, &s3, &s4);
+
+    printf("\nlongest request %u sectors, %u syncs, %u driver errors\n",
+           (unsigned)s4.max_run, (unsigned)s4.syncs, (unsigned)s4.errors);
+
+    (void)f_mount(NULL, path, 0);
+    (void)FATFS_UnLinkDriver(path);
+    DiskImage_Close();
+
+    printf("%s\n", (ok && (s4.errors == 0U)) ? "PASS" : "FAIL");
+    return (ok && (s4.errors == 0U)) ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+/**
+ ******************************************************************************
+ * @file    bench_pipeline.c
+ * @brief   Host throughput benchmark of the PPG processing pipeline.
+ *
+ * @details
+ * Feeds a synthetic 12-bit PPG signal (72 bpm pulse, RED/IR windows with
+ * different amplitudes, noise) through every stage of the ppg_dsp
+ * library and reports ns/sample and samples/s for:
+ *   - each stage alone (filter bank, FIR, SpO2, beat detector, spectral)
+ *   - the whole chain per sample (PPG_Pipeline_ProcessSample)
+ *   - the whole chain per frame (PPG_Pipeline_ProcessFrame)
+ *   - the whole chain per frame with simultaneous RED/IR/ambient channels
+ *     (LED phase scheduler): one sample period = three channels
+ *
+ * Usage: bench_pipeline [samples]
+ ******************************************************************************
+ */
+
+#include "ppg_pipeline.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SAMPLES   4000000U    /**< Default samples per stage */
+#define BENCH_SIGNAL_N  65536U      /**< Length of the synthetic input table (power of two) */
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static uint16_t signal_table[BENCH_SIGNAL_N];
+static int16_t  bandpass_table[BENCH_SIGNAL_N];
+static volatile int32_t sink;
+
+static uint32_t bench_samples = BENCH_SAMPLES;
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void FillSignal(void)
+{
+    srand(1234);
+    for (uint32_t n = 0; n < BENCH_SIGNAL_N; n++)
+    {
+        double t = (double)n / PPG_FS;
+        double amplitude = (PPG_Pipeline_WindowChannel(n) == PPG_CH_RED) ? 300.0 : 400.0;
+        double pulse = sin(2.0 * M_PI * 1.2 * t) + 0.3 * sin(2.0 * M_PI * 2.4 * t + 0.8);
+        int32_t v = (int32_t)(2048.0 + amplitude * pulse) + (rand() % 32) - 16;
+        signal_table[n] = (uint16_t)(v & 0x0FFF);
+    }
+
+    /* Band-passed copy feeds the stages that follow the FIR */
+    static PPG_Pipeline_t p;
+    PPG_Pipeline_Init(&p);
+    for (uint32_t n = 0; n < BENCH_SIGNAL_N; n++)
+    {
+        PPG_Pipeline_ProcessSample(&p, n, PPG_Pipeline_WindowChannel(n), signal_table[n]);
+        bandpass_table[n] = p.out.bandpassed;
+    }
+}
+
+static void Report(const char *stage, double t0, double t1)
+{
+    double ns = (t1 - t0) / (double)bench_samples;
+    printf("%-16s %9.2f ns/sample  %9.3f Msamples/s\n", stage, ns, 1e3 / ns);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Benchmarks                                                                */
+/* ------------------------------------------------------------------------- */
+
+static void BenchFilterBank(void)
+{
+    static PPG_FilterBank_t bank;
+    uint32_t acc = 0;
+
+    PPG_FilterBank_Reset(&bank);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+    {
+        uint32_t i = n & (BENCH_SIGNAL_N - 1U);
+        acc += PPG_FilterBank_Update(&bank, PPG_Pipeline_WindowChannel(i), signal_table[i]);
+    }
+    Report("filter_bank", t0, NowNs());
+    sink = (int32_t)acc;
+}
+
+static void BenchFir(void)
+{
+    static PPG_Pipeline_t p;
+    int32_t acc = 0;
+
+    PPG_Pipeline_Init(&p);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+        acc += PPG_FIR_Process(&p.bp_fir, PPG_FIR_FromAdc12(signal_table[n & (BENCH_SIGNAL_N - 1U)]));
+    Report("fir_bandpass", t0, NowNs());
+    sink = acc;
+}
+
+static void BenchSpO2(void)
+{
+    static PPG_SpO2_t spo2;
+    float percent = 0.0f;
+
+    PPG_SpO2_Init(&spo2, PPG_FS);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+    {
+        uint32_t i = n & (BENCH_SIGNAL_N - 1U);
+        PPG_SpO2_Update(&spo2, PPG_Pipeline_WindowChannel(i), signal_table[i], bandpass_table[i]);
+
+        /* One beat every 0.83 s at 72 bpm */
+        if ((i % 83U) == 0U)
+            (void)PPG_SpO2_OnBeat(&spo2, &percent, NULL);
+    }
+    Report("spo2", t0, NowNs());
+    sink = (int32_t)percent;
+}
+
+static void BenchBeatDetector(void)
+{
+    static PPG_BeatDetector_t det;
+    PPG_Beat_t beat;
+    int32_t beats = 0;
+
+    PPG_BeatDetector_Init(&det, PPG_FS);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+        beats += PPG_BeatDetector_Update(&det, bandpass_table[n & (BENCH_SIGNAL_N - 1U)], &beat) ? 1 : 0;
+    Report("beat_detector", t0, NowNs());
+    sink = beats;
+}
+
+static void BenchSpectral(void)
+{
+    static PPG_Spectral_t sp;
+    PPG_SpectralHR_t est = {0};
+
+    PPG_Spectral_Init(&sp, PPG_FS);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+        (void)PPG_Spectral_Update(&sp, bandpass_table[n & (BENCH_SIGNAL_N - 1U)], &est);
+    Report("hr_spectral", t0, NowNs());
+    sink = (int32_t)est.hr_bpm;
+}
+
+static void BenchPipelineSample(void)
+{
+    static PPG_Pipeline_t p;
+
+    PPG_Pipeline_Init(&p);
+
+    double t0 = NowNs();
+    for (uint32_t n = 0; n < bench_samples; n++)
+    {
+        uint32_t i = n & (BENCH_SIGNAL_N - 1U);
+        PPG_Pipeline_ProcessSample(&p, n, PPG_Pipeline_WindowChannel(n), signal_table[i]);
+    }
+    Report("pipeline/sample", t0, NowNs());
+    sink = (int32_t)p.out.beat_count;
+}
+
+static void BenchPipelineFrame(void)
+{
+    static PPG_Pipeline_t p;
+    static PPG_Frame_t frame;
+    uint32_t frames = bench_samples / PPG_BLOCK_SIZE;
+
+    PPG_Pipeline_Init(&p);
+
+    double t0 = NowNs();
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        frame.sequence = f;
+        frame.count    = PPG_BLOCK_SIZE;
+        for (uint32_t i = 0; i < PPG_BLOCK_SIZE; i++)
+        {
+            uint32_t n = f * PPG_BLOCK_SIZE + i;
+            frame.samples[PPG_Pipeline_WindowChannel(n)][i] = signal_table[n & (BENCH_SIGNAL_N - 1U)];
+        }
+        PPG_Pipeline_ProcessFrame(&p, &frame);
+    }
+    Report("pipeline/frame", t0, NowNs());
+    sink = (int32_t)frame.results.beat_count;
+}
+
+static void BenchPipelineSimultaneous(void)
+{
+    static PPG_Pipeline_t p;
+    static PPG_Frame_t frame;
+    uint32_t frames = bench_samples / PPG_BLOCK_SIZE;
+
+    PPG_Pipeline_Init(&p);
+    frame.channel_mask = (uint16_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR) |
+                                    PPG_CH_MASK(PPG_CH_AMBIENT));
+    frame.flags        = PPG_FRAME_FLAG_SIMULTANEOUS;
+
+    double t0 = NowNs();
+    for (uint32_t f = 0; f < frames; f++)
+    {
+        frame.sequence = f;
+        frame.count    = PPG_BLOCK_SIZE;
+        for (uint32_t i = 0; i < PPG_BLOCK_SIZE; i++)
+        {
+            uint32_t n = (f * PPG_BLOCK_SIZE + i) & (BENCH_SIGNAL_N - 1U);
+            frame.samples[PPG_CH_RED][i]     = signal_table[n];
+            frame.samples[PPG_CH_IR][i]      = signal_table[(n + PPG_WINDOW_SAMPLES) & (BENCH_SIGNAL_N - 1U)];
+            frame.samples[PPG_CH_AMBIENT][i] = 64U;
+        }
+        PPG_Pipeline_ProcessFrame(&p, &frame);
+    }
+    Report("pipeline/simult", t0, NowNs());
+    sink = (int32_t)frame.results.beat_count;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        bench_samples = (uint32_t)strtoul(argv[1], NULL, 10);
+
+    FillSignal();
+
+    printf("%u samples per stage, fs=%d Hz, block=%u\n",
+           (unsigned)bench_samples, PPG_FS, (unsigned)PPG_BLOCK_SIZE);
+
+    BenchFilterBank();
+    BenchFir();
+    BenchSpO2();
+    BenchBeatDetector();
+    BenchSpectral();
+    BenchPipelineSample();
+    BenchPipelineFrame();
+    BenchPipelineSimultaneous();
+
+    return EXIT_SUCCESS;
+}
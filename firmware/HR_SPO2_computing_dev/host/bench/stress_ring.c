@@ -0,0 +1,167 @@
+/**
+ ******************************************************************************
+ * @file    stress_ring.c
+ * @brief   Host multithreaded stress run of the SPSC ring (ppg_ring.h).
+ *
+ * @details
+ * One producer and one consumer thread, on different cores, exchange
+ * sequence numbers through the firmware ring. Two runs:
+ *   - lossless: the producer retries on a full ring (each refused push
+ *     still counts an overrun); every item must arrive exactly once, in
+ *     order
+ *   - drop: the producer gives up on a full ring, like the acquisition
+ *     ISR; items must arrive in increasing order and received + overruns
+ *     must equal pushed
+ * The consumer pops in batches of 1..batch items. Reports the transfer
+ * rate in items/s and exits with status 1 on any violation.
+ *
+ * Usage: stress_ring [items [capacity [batch]]]
+ ******************************************************************************
+ */
+
+#include "ppg_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define STRESS_ITEMS      20000000UL    /**< Items per run */
+#define STRESS_CAPACITY   32U           /**< PPG_FRAME_POOL_SIZE */
+#define STRESS_BATCH      8U
+#define STRESS_MAX_BATCH  256U
+
+typedef struct
+{
+    PPG_Ring_t    ring;
+    uint64_t      items;
+    uint32_t      batch;
+    int           lossless;
+    volatile int  done;         /* Producer finished */
+    uint64_t      received;
+    uint64_t      errors;
+} Stress_t;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/* Items are 1..items: never NULL */
+static void *Producer(void *arg)
+{
+    Stress_t *s = arg;
+
+    for (uint64_t i = 1; i <= s->items; i++)
+    {
+        /* Yield when full: lets the consumer run on a single core too */
+        while (!PPG_Ring_Push(&s->ring, (void *)(uintptr_t)i))
+        {
+            sched_yield();
+            if (!s->lossless)
+                break;
+        }
+    }
+
+    __atomic_store_n(&s->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void *Consumer(void *arg)
+{
+    Stress_t *s = arg;
+    void     *items[STRESS_MAX_BATCH];
+    uint64_t  last = 0;
+    uint32_t  want = 1;
+
+    for (;;)
+    {
+        /* Read done before popping: an empty ring then means all received */
+        int      done = __atomic_load_n(&s->done, __ATOMIC_ACQUIRE);
+        uint32_t n    = PPG_Ring_PopBatch(&s->ring, items, want);
+
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint64_t v = (uint64_t)(uintptr_t)items[i];
+
+            if ((s->lossless && (v != last + 1U)) || (v <= last))
+                s->errors++;
+            last = v;
+        }
+        s->received += n;
+        want = (want % s->batch) + 1U;
+
+        if (n == 0U)
+        {
+            if (done)
+                break;
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static int Run(uint64_t items, uint32_t capacity, uint32_t batch, int lossless)
+{
+    static void *slots[1U << 20];
+    Stress_t s = { .items = items, .batch = batch, .lossless = lossless };
+    pthread_t producer, consumer;
+
+    if ((capacity > (sizeof(slots) / sizeof(slots[0]))) ||
+        !PPG_Ring_Init(&s.ring, slots, capacity))
+    {
+        fprintf(stderr, "capacity must be a power of two <= %zu\n", sizeof(slots) / sizeof(slots[0]));
+        return 1;
+    }
+
+    double t0 = NowNs();
+    pthread_create(&consumer, NULL, Consumer, &s);
+    pthread_create(&producer, NULL, Producer, &s);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    double t1 = NowNs();
+
+    uint32_t overruns = PPG_Ring_Overruns(&s.ring);
+    int      ok       = (s.errors == 0U) &&
+                        (lossless ? (s.received == items) : ((s.received + overruns) == items));
+
+    printf("%-9s %10llu items  %8.1f M items/s  received %10llu  overruns %10u  order errors %llu  %s\n",
+           lossless ? "lossless" : "drop",
+           (unsigned long long)items, (double)items * 1e3 / (t1 - t0),
+           (unsigned long long)s.received, overruns, (unsigned long long)s.errors,
+           ok ? "OK" : "FAIL");
+
+    return ok ? 0 : 1;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    uint64_t items    = (argc > 1) ? strtoull(argv[1], NULL, 10) : STRESS_ITEMS;
+    uint32_t capacity = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 10) : STRESS_CAPACITY;
+    uint32_t batch    = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 10) : STRESS_BATCH;
+
+    if ((batch == 0U) || (batch > STRESS_MAX_BATCH))
+    {
+        fprintf(stderr, "batch must be in 1..%u\n", STRESS_MAX_BATCH);
+        return 1;
+    }
+
+    printf("SPSC ring: capacity %u, consumer batches 1..%u\n", capacity, batch);
+
+    int status = Run(items, capacity, batch, 1);
+    status |= Run(items, capacity, batch, 0);
+    return status;
+}
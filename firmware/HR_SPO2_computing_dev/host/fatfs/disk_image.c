@@ -0,0 +1,194 @@
+/**
+ ******************************************************************************
+ * @file    disk_image.c
+ * @brief   Host FatFs drive on a disk image file implementation.
+ ******************************************************************************
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "disk_image.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* ------------------------------------------------------------------------- */
+/* Private state                                                             */
+/* ------------------------------------------------------------------------- */
+
+static int      image_fd          = -1;
+static uint32_t image_sectors     = 0;
+static uint32_t image_erase_block = 1;
+
+static DSTATUS           image_stat = STA_NOINIT;
+static DiskImage_Stats_t image_stats;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static bool InRange(DWORD sector, UINT count)
+{
+    return (count > 0U) && (sector < image_sectors) && (count <= (image_sectors - sector));
+}
+
+static void CountRun(UINT count)
+{
+    if (count > image_stats.max_run)
+        image_stats.max_run = count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Driver table                                                              */
+/* ------------------------------------------------------------------------- */
+
+static DSTATUS DiskImage_Initialize(BYTE pdrv)
+{
+    (void)pdrv;
+    image_stat = (image_fd >= 0) ? 0U : STA_NOINIT;
+    return image_stat;
+}
+
+static DSTATUS DiskImage_Status(BYTE pdrv)
+{
+    (void)pdrv;
+    return image_stat;
+}
+
+static DRESULT DiskImage_Read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    if ((image_stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    size_t len = (size_t)count * DISK_IMAGE_SECTOR_SIZE;
+
+    image_stats.read_cmds++;
+    if (!InRange(sector, count) ||
+        (pread(image_fd, buff, len, (off_t)sector * DISK_IMAGE_SECTOR_SIZE) != (ssize_t)len))
+    {
+        image_stats.errors++;
+        return RES_ERROR;
+    }
+
+    image_stats.sectors_read += count;
+    CountRun(count);
+    return RES_OK;
+}
+
+static DRESULT DiskImage_Write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    if ((image_stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    size_t len = (size_t)count * DISK_IMAGE_SECTOR_SIZE;
+
+    image_stats.write_cmds++;
+    if (!InRange(sector, count) ||
+        (pwrite(image_fd, buff, len, (off_t)sector * DISK_IMAGE_SECTOR_SIZE) != (ssize_t)len))
+    {
+        image_stats.errors++;
+        return RES_ERROR;
+    }
+
+    image_stats.sectors_written += count;
+    CountRun(count);
+    return RES_OK;
+}
+
+static DRESULT DiskImage_Ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void)pdrv;
+    if ((image_stat & STA_NOINIT) != 0U)
+        return RES_NOTRDY;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        image_stats.syncs++;
+        return RES_OK;
+
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = image_sectors;
+        return RES_OK;
+
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = DISK_IMAGE_SECTOR_SIZE;
+        return RES_OK;
+
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = image_erase_block;
+        return RES_OK;
+
+    default:
+        return RES_PARERR;
+    }
+}
+
+const Diskio_drvTypeDef DiskImage_Driver =
+{
+    DiskImage_Initialize,
+    DiskImage_Status,
+    DiskImage_Read,
+    DiskImage_Write,
+    DiskImage_Ioctl,
+};
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+bool DiskImage_Open(const char *path, uint32_t sectors, uint32_t erase_block)
+{
+    DiskImage_Close();
+
+    image_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (image_fd < 0)
+        return false;
+
+    if (ftruncate(image_fd, (off_t)sectors * DISK_IMAGE_SECTOR_SIZE) != 0)
+    {
+        DiskImage_Close();
+        return false;
+    }
+
+    image_sectors     = sectors;
+    image_erase_block = (erase_block > 0U) ? erase_block : 1U;
+    memset(&image_stats, 0, sizeof(image_stats));
+    return true;
+}
+
+void DiskImage_Close(void)
+{
+    if (image_fd >= 0)
+    {
+        (void)fsync(image_fd);
+        (void)close(image_fd);
+    }
+
+    image_fd      = -1;
+    image_sectors = 0;
+    image_stat    = STA_NOINIT;
+}
+
+void DiskImage_GetStats(DiskImage_Stats_t *stats)
+{
+    *stats = image_stats;
+}
+
+/** FAT timestamps from the host clock (the firmware has no RTC: 0) */
+DWORD get_fattime(void)
+{
+    time_t    now = time(NULL);
+    struct tm tm;
+
+    if ((localtime_r(&now, &tm) == NULL) || (tm.tm_year < 80))
+        return 0;
+
+    return ((DWORD)(tm.tm_year - 80) << 25) | ((DWORD)(tm.tm_mon + 1) << 21) |
+           ((DWORD)tm.tm_mday << 16) | ((DWORD)tm.tm_hour << 11) |
+           ((DWORD)tm.tm_min << 5) | ((DWORD)tm.tm_sec >> 1);
+}
@@ -0,0 +1,77 @@
+/**
+ ******************************************************************************
+ * @file    disk_image.h
+ * @author  A. Bellina
+ * @brief   Host FatFs drive on a disk image file (stand-in for sd_spi.h).
+ *
+ * @details
+ * Implements the same driver table as FATFS/Target/user_diskio.c
+ * (Diskio_drvTypeDef) on a regular file, one pread() / pwrite() per
+ * request so multi-sector requests stay one transfer as on the card.
+ * GET_BLOCK_SIZE reports the configured erase block, like
+ * SdSpi_GetEraseBlock(), so f_mkfs lays out the volume the same way.
+ * The counters show how FatFs batches sectors for a given workload.
+ ******************************************************************************
+ */
+
+#ifndef DISK_IMAGE_H
+#define DISK_IMAGE_H
+
+#include "ff_gen_drv.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* ------------------------------------------------------------------------- */
+/* Configuration                                                             */
+/* ------------------------------------------------------------------------- */
+
+/** Sector size [bytes] (SD_SPI_SECTOR_SIZE) */
+#define DISK_IMAGE_SECTOR_SIZE   512U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** Transfer counters since DiskImage_Open() (fields of SdSpi_Stats_t) */
+typedef struct
+{
+    uint32_t read_cmds;         /**< disk_read() calls */
+    uint32_t write_cmds;        /**< disk_write() calls */
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+    uint32_t max_run;           /**< Most sectors in one request */
+    uint32_t syncs;             /**< CTRL_SYNC requests */
+    uint32_t errors;            /**< Out of range, short I/O */
+} DiskImage_Stats_t;
+
+/* ------------------------------------------------------------------------- */
+/* Public API                                                                */
+/* ------------------------------------------------------------------------- */
+
+/** Driver table for FATFS_LinkDriver() */
+extern const Diskio_drvTypeDef DiskImage_Driver;
+
+/**
+ * @brief Open (create, resize) the image backing the drive.
+ *
+ * @param[in] path        Image file.
+ * @param[in] sectors     Drive size [sectors].
+ * @param[in] erase_block Erase block reported to f_mkfs [sectors].
+ *
+ * @return false if the file cannot be opened or sized.
+ */
+bool DiskImage_Open(const char *path, uint32_t sectors, uint32_t erase_block);
+
+/**
+ * @brief Flush and close the image.
+ */
+void DiskImage_Close(void);
+
+/**
+ * @brief Copy the transfer counters.
+ *
+ * @param[out] stats Counters since DiskImage_Open().
+ */
+void DiskImage_GetStats(DiskImage_Stats_t *stats);
+
+#endif /* DISK_IMAGE_H */
@@ -0,0 +1,291 @@
+/**
+ ******************************************************************************
+ * @file    codec_roundtrip.c
+ * @brief   Round trip of the lossless sample codec (ppg_codec.h) on signals
+ *          built to reach its edge cases.
+ *
+ * @details
+ * Every signal is coded with predictor orders 1..3, one sample at a time,
+ * and decoded back. Checked:
+ *   - every sample comes back, and the decoder state equals the encoder
+ *     state after each sample
+ *   - escapes: a sample coded in PPG_CODEC_QMAX + PPG_CODEC_ESCAPE_BITS
+ *     bits, up to full-scale steps at order 3 (largest residual)
+ *   - the Rice statistics roll over (count halved at PPG_CODEC_RESET)
+ *     many times, across quiet and noisy stretches
+ *   - reset points: decoding starts at any of them
+ *   - the stream written in pieces (PPG_BitWriter_Resume()) is the same
+ *   - a stream cut short fails to decode
+ * Exit status 1 on any failure.
+ *
+ * Usage: codec_roundtrip
+ ******************************************************************************
+ */
+
+#include "ppg_codec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_LENGTH     4096U
+#define TEST_RESET_AT   1000U       /**< Reset point inside the signal */
+#define TEST_PIECE      7U          /**< Samples per piece for the resumed writer */
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+    const char *name;
+    uint16_t    x[TEST_LENGTH];
+} TestSignal_t;
+
+typedef struct
+{
+    uint32_t escapes;
+    uint32_t rollovers;
+} TestCounts_t;
+
+static uint8_t  code_buf[(TEST_LENGTH * PPG_CODEC_MAX_BITS) / 8U + 8U];
+static uint8_t  piece_buf[sizeof(code_buf)];
+static uint16_t out_buf[TEST_LENGTH];
+static size_t   start_bit[TEST_LENGTH];    /**< First bit of each sample's code */
+static int      failures;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static uint32_t Random(uint32_t *state)
+{
+    *state = (*state * 1664525U) + 1013904223U;
+    return *state >> 8;
+}
+
+static void Fail(const char *name, uint32_t order, const char *what, uint32_t i)
+{
+    fprintf(stderr, "FAIL %s, order %u: %s at sample %u\n", name, (unsigned)order, what, (unsigned)i);
+    failures++;
+}
+
+/** Bits written so far */
+static size_t Bits(const PPG_BitWriter_t *bw)
+{
+    return (bw->pos * 8U) + bw->bits;
+}
+
+/** Slow ramp, noise bursts, full-scale steps and a full-scale square wave */
+static void MakeSignals(TestSignal_t *s)
+{
+    uint32_t seed = 12345U;
+
+    s[0].name = "slow ramp";
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+        s[0].x[i] = (uint16_t)(2048U + (i / 8U));
+
+    s[1].name = "noise bursts";
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+    {
+        uint32_t amp = (((i / 256U) % 2U) != 0U) ? 4095U : 3U;
+
+        s[1].x[i] = (uint16_t)(2048U + (Random(&seed) % (amp + 1U)) - (amp / 2U));
+    }
+
+    s[2].name = "full-scale steps";
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+    {
+        uint32_t r = Random(&seed);
+
+        s[2].x[i] = ((r % 97U) == 0U) ? (uint16_t)(((r >> 8) & 1U) ? UINT16_MAX : 0U)
+                                      : (uint16_t)(30000U + (r % 5U));
+    }
+
+    s[3].name = "square 0/65535";
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+        s[3].x[i] = (((i / ((i % 3U) + 1U)) % 2U) != 0U) ? UINT16_MAX : 0U;
+}
+
+/** Code x with a reset point at 0 and TEST_RESET_AT, one sample per call */
+static size_t Encode(const TestSignal_t *s, uint32_t order, TestCounts_t *counts)
+{
+    PPG_CodecChannel_t ch;
+    PPG_BitWriter_t    bw;
+    PPG_BitReader_t    br;
+
+    PPG_BitWriter_Init(&bw, code_buf);
+    PPG_Codec_Reset(&ch);
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+    {
+        if (i == TEST_RESET_AT)
+        {
+            PPG_BitWriter_Flush(&bw);
+            PPG_Codec_Reset(&ch);
+        }
+
+        uint32_t count = ch.count;
+
+        start_bit[i] = Bits(&bw);
+        PPG_Codec_Encode(&ch, order, &bw, &s->x[i], 1U);
+        if (ch.count < count)
+            counts->rollovers++;
+        if (ch.count >= PPG_CODEC_RESET)
+            Fail(s->name, order, "count not halved", i);
+    }
+    size_t len = PPG_BitWriter_Flush(&bw);
+
+    /* An escape starts with PPG_CODEC_QMAX zeros, a Rice code has a one
+     * in its first PPG_CODEC_QMAX bits (raw samples at the reset points) */
+    for (uint32_t i = 0; i < TEST_LENGTH; i++)
+    {
+        if ((i == 0U) || (i == TEST_RESET_AT))
+            continue;
+        PPG_BitReader_Init(&br, &code_buf[start_bit[i] / 8U], len - (start_bit[i] / 8U));
+        (void)PPG_BitReader_Get(&br, (uint32_t)(start_bit[i] % 8U));
+        if (PPG_BitReader_Get(&br, PPG_CODEC_QMAX) == 0U)
+            counts->escapes++;
+    }
+    return len;
+}
+
+/** Decode from the reset point at sample first, byte offset start */
+static void Decode(const TestSignal_t *s, uint32_t order, size_t len, uint32_t first, size_t start)
+{
+    PPG_CodecChannel_t ch;
+    PPG_CodecChannel_t ref;
+    PPG_BitWriter_t    bw;
+    PPG_BitReader_t    br;
+
+    PPG_BitReader_Init(&br, &code_buf[start], len - start);
+    PPG_Codec_Reset(&ch);
+    PPG_Codec_Reset(&ref);
+    PPG_BitWriter_Init(&bw, piece_buf);
+    for (uint32_t i = first; i < TEST_LENGTH; i++)
+    {
+        if ((i == TEST_RESET_AT) && (first < TEST_RESET_AT))
+        {
+            PPG_BitReader_Align(&br);
+            PPG_Codec_Reset(&ch);
+            PPG_Codec_Reset(&ref);
+        }
+
+        if (!PPG_Codec_Decode(&ch, order, &br, &out_buf[i], 1U))
+        {
+            Fail(s->name, order, "decode error", i);
+            return;
+        }
+        PPG_Codec_Encode(&ref, order, &bw, &s->x[i], 1U);
+        bw.pos = 0;
+        if (out_buf[i] != s->x[i])
+        {
+            Fail(s->name, order, "sample differs", i);
+            return;
+        }
+        if (memcmp(&ch, &ref, sizeof(ch)) != 0)
+        {
+            Fail(s->name, order, "decoder state differs", i);
+            return;
+        }
+    }
+}
+
+/** Same stream, written TEST_PIECE samples at a time into a fresh buffer */
+static void CheckPieces(const TestSignal_t *s, uint32_t order, size_t segment)
+{
+    PPG_CodecChannel_t ch;
+    PPG_BitWriter_t    bw;
+    uint8_t            piece[(TEST_PIECE * PPG_CODEC_MAX_BITS) / 8U + 4U];
+    size_t             out = 0;
+
+    PPG_BitWriter_Init(&bw, piece);
+    PPG_Codec_Reset(&ch);
+    for (uint32_t i = 0; i < TEST_RESET_AT; i += TEST_PIECE)
+    {
+        uint32_t n = ((TEST_RESET_AT - i) < TEST_PIECE) ? (TEST_RESET_AT - i) : TEST_PIECE;
+
+        PPG_BitWriter_Resume(&bw, piece);
+        PPG_Codec_Encode(&ch, order, &bw, &s->x[i], n);
+        memcpy(&piece_buf[out], piece, bw.pos);
+        out += bw.pos;
+    }
+    PPG_BitWriter_Resume(&bw, piece);
+    memcpy(&piece_buf[out], piece, PPG_BitWriter_Flush(&bw));
+    out += bw.pos;
+
+    if ((out != segment) || (memcmp(piece_buf, code_buf, out) != 0))
+        Fail(s->name, order, "resumed writer differs", 0U);
+}
+
+/** Streams cut short of the first segment must fail */
+static void CheckTruncated(const TestSignal_t *s, uint32_t order, size_t segment)
+{
+    PPG_CodecChannel_t ch;
+    PPG_BitReader_t    br;
+
+    for (size_t cut = 0; cut < segment; cut += (segment / 16U) + 1U)
+    {
+        PPG_BitReader_Init(&br, code_buf, cut);
+        PPG_Codec_Reset(&ch);
+        if (PPG_Codec_Decode(&ch, order, &br, out_buf, TEST_RESET_AT))
+            Fail(s->name, order, "truncated stream decoded", (uint32_t)cut);
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(void)
+{
+    static TestSignal_t signals[4];
+    TestCounts_t        total = {0};
+
+    MakeSignals(signals);
+
+    for (uint32_t s = 0; s < (sizeof(signals) / sizeof(signals[0])); s++)
+    {
+        for (uint32_t order = 1U; order <= PPG_CODEC_MAX_ORDER; order++)
+        {
+            TestCounts_t counts = {0};
+            size_t       len = Encode(&signals[s], order, &counts);
+            PPG_BitWriter_t bw;
+            size_t       segment;
+
+            /* Byte offset of the reset point: re-encode the first segment */
+            {
+                PPG_CodecChannel_t ch;
+
+                PPG_BitWriter_Init(&bw, piece_buf);
+                PPG_Codec_Reset(&ch);
+                PPG_Codec_Encode(&ch, order, &bw, signals[s].x, TEST_RESET_AT);
+                segment = PPG_BitWriter_Flush(&bw);
+            }
+
+            Decode(&signals[s], order, len, 0U, 0U);
+            Decode(&signals[s], order, len, TEST_RESET_AT, segment);
+            CheckPieces(&signals[s], order, segment);
+            CheckTruncated(&signals[s], order, segment);
+
+            printf("%-18s order %u: %6zu bytes, %5.2f bits/sample, %4u escapes, %4u rollovers\n",
+                   signals[s].name, (unsigned)order, len, (double)len * 8.0 / TEST_LENGTH,
+                   (unsigned)counts.escapes, (unsigned)counts.rollovers);
+            total.escapes   += counts.escapes;
+            total.rollovers += counts.rollovers;
+        }
+    }
+
+    if (total.escapes == 0U)
+    {
+        fprintf(stderr, "FAIL no escaped sample\n");
+        failures++;
+    }
+    if (total.rollovers == 0U)
+    {
+        fprintf(stderr, "FAIL no statistics rollover\n");
+        failures++;
+    }
+
+    printf("%s\n", (failures == 0) ? "PASS" : "FAIL");
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
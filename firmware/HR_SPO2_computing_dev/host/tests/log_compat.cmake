@@ -0,0 +1,55 @@
+#
+# Decodes a log written by an older format version (host/tests/data) and
+# checks its samples against a replay of the recording it was written from.
+# The fixtures were written by ppg_replay -l from data/log_input.csv at the
+# first build of each version:
+#   log_v1.bin  v1, one-sample frames, no predictor, band-pass kept
+#   log_v2.bin  v2, 10-sample frames, predictor order 1, band-pass kept
+#   log_v3.bin  v3, 10-sample frames, predictor order 2, band-pass kept, index
+#   log_v4.bin  v4, one-sample frames, no predictor, band-pass left out, index
+# Frame sequences follow the frame size of the writer, so they are left out
+# of the comparison.
+#
+#   cmake -DREPLAY=<ppg_replay> -DDUMP=<ppg_log_dump> -DLOG=<log_vN.bin>
+#         -DCSV=<log_input.csv> -DWORK=<dir> -P log_compat.cmake
+#
+
+foreach(var REPLAY DUMP LOG CSV WORK)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} not set")
+    endif()
+endforeach()
+
+file(MAKE_DIRECTORY ${WORK})
+get_filename_component(name ${LOG} NAME_WE)
+
+execute_process(COMMAND ${REPLAY} -c adc_raw -f 100 -d ${WORK}/${name}_replay.csv -o /dev/null ${CSV}
+                RESULT_VARIABLE result
+                ERROR_VARIABLE  report
+                OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${REPLAY} failed (${result}):\n${report}")
+endif()
+
+execute_process(COMMAND ${DUMP} -o ${WORK}/${name}.csv -r /dev/null ${LOG}
+                RESULT_VARIABLE result
+                ERROR_VARIABLE  report
+                OUTPUT_QUIET)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${DUMP} ${LOG} failed (${result}):\n${report}")
+endif()
+if(NOT report MATCHES "decoded   : [0-9]+ blocks, 0 bad, 0 bytes skipped; [0-9]+ frames, 0 missing")
+    message(FATAL_ERROR "${LOG} decoded with errors:\n${report}")
+endif()
+
+file(READ ${WORK}/${name}_replay.csv expected)
+file(READ ${WORK}/${name}.csv actual)
+string(REGEX REPLACE "\n([0-9]+),[0-9]+," "\n\\1,," expected "${expected}")
+string(REGEX REPLACE "\n([0-9]+),[0-9]+," "\n\\1,," actual "${actual}")
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "${LOG}: samples differ from the replay of ${CSV}\n"
+                        "  ${WORK}/${name}.csv, ${WORK}/${name}_replay.csv")
+endif()
+
+string(REGEX MATCH "log       : [^\n]*" header "${report}")
+message(STATUS "${header}")
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * @file    log_damage.c
+ * @brief   Damages a copy of a session log for the decoder tests.
+ *
+ * @details
+ * Copies a file and either inverts one byte or cuts the copy short, like a
+ * bit error on the card or a session that lost power before its index.
+ *
+ * Usage: log_damage in.bin out.bin flip <offset>
+ *        log_damage in.bin out.bin cut  <length>
+ ******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv)
+{
+    if ((argc != 5) || ((strcmp(argv[3], "flip") != 0) && (strcmp(argv[3], "cut") != 0)))
+    {
+        fprintf(stderr, "Usage: %s in.bin out.bin flip <offset> | cut <length>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+
+    unsigned char *data = malloc((size_t)size + 1U);
+    if ((data == NULL) || (fread(data, 1, (size_t)size, in) != (size_t)size))
+    {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    fclose(in);
+
+    long arg = strtol(argv[4], NULL, 0);
+    if ((arg < 0) || (arg >= size))
+    {
+        fprintf(stderr, "%s %ld is outside the %ld-byte file\n", argv[3], arg, size);
+        return EXIT_FAILURE;
+    }
+    if (strcmp(argv[3], "flip") == 0)
+        data[arg] ^= 0xFFU;
+    else
+        size = arg;
+
+    FILE *out = fopen(argv[2], "wb");
+    if ((out == NULL) || (fwrite(data, 1, (size_t)size, out) != (size_t)size) || (fclose(out) != 0))
+    {
+        perror(argv[2]);
+        return EXIT_FAILURE;
+    }
+    free(data);
+    return EXIT_SUCCESS;
+}
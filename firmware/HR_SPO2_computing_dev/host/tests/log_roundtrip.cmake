@@ -0,0 +1,139 @@
+#
+# Replays CSV with a session log (-l) and its samples (-d), decodes the log
+# with ppg_log_dump and checks:
+#   - the samples come back bit-exact
+#   - the per-frame results match the replay trace (HR, spectral HR, SpO2,
+#     beats, traced once per frame)
+#   - one inverted byte in a block loses that block only: exit status 2,
+#     "1 bad", every other sample intact
+#   - a session cut short inside a block (no index) decodes to the samples
+#     of its complete blocks
+#
+#   cmake -DREPLAY=<ppg_replay> -DDUMP=<ppg_log_dump> -DDAMAGE=<log_damage>
+#         -DCSV=<file> -DWORK=<dir> -P log_roundtrip.cmake
+#
+
+foreach(var REPLAY DUMP DAMAGE CSV WORK)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} not set")
+    endif()
+endforeach()
+
+file(MAKE_DIRECTORY ${WORK})
+
+function(run_tool expected_result report_var)
+    execute_process(COMMAND ${ARGN}
+                    RESULT_VARIABLE result
+                    ERROR_VARIABLE  report
+                    OUTPUT_QUIET)
+    if(NOT result EQUAL expected_result)
+        message(FATAL_ERROR "${ARGN}\nexit ${result}, expected ${expected_result}:\n${report}")
+    endif()
+    set(${report_var} "${report}" PARENT_SCOPE)
+endfunction()
+
+function(check_equal what expected actual)
+    if(NOT actual STREQUAL expected)
+        file(WRITE ${WORK}/expected.txt "${expected}")
+        file(WRITE ${WORK}/actual.txt "${actual}")
+        message(FATAL_ERROR "${what} differ: ${WORK}/expected.txt, ${WORK}/actual.txt")
+    endif()
+endfunction()
+
+# Round trip
+run_tool(0 report ${REPLAY} -l ${WORK}/log.bin -d ${WORK}/replay.csv -o /dev/null ${CSV})
+run_tool(0 report ${DUMP} -o ${WORK}/samples.csv -r ${WORK}/results.csv -s ${WORK}/overview.csv
+         ${WORK}/log.bin)
+if(NOT report MATCHES "decoded   : [0-9]+ blocks, 0 bad, 0 bytes skipped; [0-9]+ frames, 0 missing")
+    message(FATAL_ERROR "clean log decoded with errors:\n${report}")
+endif()
+string(REGEX MATCH "([0-9]+) samples/frame" frame_samples "${report}")
+set(frame_samples ${CMAKE_MATCH_1})
+
+file(READ ${WORK}/replay.csv expected)
+file(READ ${WORK}/samples.csv actual)
+check_equal("samples" "${expected}" "${actual}")
+
+# One trace line per frame, at its last sample: line k is frame k's results
+run_tool(0 report ${REPLAY} -t ${frame_samples} -o ${WORK}/trace.csv ${CSV})
+file(READ ${WORK}/trace.csv trace)
+file(READ ${WORK}/results.csv results)
+foreach(text trace results)
+    string(FIND "${${text}}" "\n" header_end)
+    math(EXPR header_end "${header_end} + 1")
+    string(SUBSTRING "${${text}}" ${header_end} -1 ${text})
+endforeach()
+string(REGEX REPLACE "[^,\n]+,([^,\n]+),([^,\n]+),([^,\n]+),[^,\n]+,([0-9]+)\n" "\\1,\\2,\\3,\\4\n"
+       trace "${trace}")
+string(REGEX REPLACE "[0-9]+,[0-9]+,[^,\n]*,([^,\n]+),([^,\n]+),([^,\n]+),([0-9]+)\n" "\\1,\\2,\\3,\\4\n"
+       results "${results}")
+string(LENGTH "${trace}" trace_length)
+if(trace_length EQUAL 0)
+    message(FATAL_ERROR "empty trace")
+endif()
+string(SUBSTRING "${results}" 0 ${trace_length} results)
+check_equal("results and trace" "${trace}" "${results}")
+
+# Block offsets and first sequences from the index
+file(STRINGS ${WORK}/overview.csv overview)
+list(REMOVE_AT overview 0)
+list(LENGTH overview blocks)
+if(blocks LESS 4)
+    message(FATAL_ERROR "${blocks} index entries, the damage cases need 4")
+endif()
+set(offsets)
+set(sequences)
+foreach(row ${overview})
+    string(REGEX MATCH "^[^,]+,([0-9]+),([0-9]+)," row "${row}")
+    list(APPEND sequences ${CMAKE_MATCH_1})
+    list(APPEND offsets ${CMAKE_MATCH_2})
+endforeach()
+
+# Expected text up to the first sample of the block i (ppg_replay: the
+# timestamp of a frame is its sequence times the frame size)
+function(block_start i out_var)
+    list(GET sequences ${i} sequence)
+    math(EXPR timestamp "${sequence} * ${frame_samples}")
+    string(FIND "${expected}" "\n${timestamp},${sequence}," position)
+    if(position LESS 0)
+        message(FATAL_ERROR "no sample row for sequence ${sequence}")
+    endif()
+    math(EXPR position "${position} + 1")
+    set(${out_var} ${position} PARENT_SCOPE)
+endfunction()
+
+# Inverted byte in the middle of a block: that block alone is lost
+math(EXPR bad "${blocks} / 2")
+math(EXPR next "${bad} + 1")
+list(GET offsets ${bad} bad_offset)
+list(GET offsets ${next} next_offset)
+math(EXPR flip "(${bad_offset} + ${next_offset}) / 2")
+run_tool(0 report ${DAMAGE} ${WORK}/log.bin ${WORK}/flipped.bin flip ${flip})
+run_tool(2 report ${DUMP} -o ${WORK}/flipped.csv ${WORK}/flipped.bin)
+if(NOT report MATCHES "decoded   : [0-9]+ blocks, 1 bad,")
+    message(FATAL_ERROR "byte ${flip} inverted, expected 1 bad block:\n${report}")
+endif()
+block_start(${bad} cut_from)
+block_start(${next} cut_to)
+string(SUBSTRING "${expected}" 0 ${cut_from} head)
+string(SUBSTRING "${expected}" ${cut_to} -1 tail)
+file(READ ${WORK}/flipped.csv actual)
+check_equal("samples around the bad block" "${head}${tail}" "${actual}")
+
+# Cut inside a later block, before the index is written
+math(EXPR last "${blocks} - 2")
+math(EXPR after "${last} + 1")
+list(GET offsets ${last} last_offset)
+list(GET offsets ${after} after_offset)
+math(EXPR cut "(${last_offset} + ${after_offset}) / 2")
+run_tool(0 report ${DAMAGE} ${WORK}/log.bin ${WORK}/cut.bin cut ${cut})
+run_tool(2 report ${DUMP} -o ${WORK}/cut.csv ${WORK}/cut.bin)
+if(NOT report MATCHES "index     : none")
+    message(FATAL_ERROR "log cut at ${cut} still has an index:\n${report}")
+endif()
+block_start(${last} cut_from)
+string(SUBSTRING "${expected}" 0 ${cut_from} head)
+file(READ ${WORK}/cut.csv actual)
+check_equal("samples of the cut log" "${head}" "${actual}")
+
+message(STATUS "${blocks} blocks of ${frame_samples}-sample frames: round trip, bad block and cut log")
@@ -0,0 +1,36 @@
+#
+# Replays CSV with two ppg_replay builds of different PPG_BLOCK_SIZE and
+# checks that both end on the same HR / SpO2 ("final" report line): the
+# pipeline processes sample by sample, so frame boundaries must not matter.
+#
+#   cmake -DREFERENCE=<ppg_replay> -DREPLAY=<ppg_replay_blockN> -DCSV=<file> -P replay_blocks.cmake
+#
+
+foreach(var REFERENCE REPLAY CSV)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} not set")
+    endif()
+endforeach()
+
+function(replay_final tool out_var)
+    execute_process(COMMAND ${tool} -o /dev/null ${CSV}
+                    RESULT_VARIABLE result
+                    ERROR_VARIABLE  report
+                    OUTPUT_QUIET)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "${tool} failed (${result}):\n${report}")
+    endif()
+    string(REGEX MATCH "final     : [^\n]*" final "${report}")
+    if(final STREQUAL "")
+        message(FATAL_ERROR "${tool}: no final line:\n${report}")
+    endif()
+    set(${out_var} "${final}" PARENT_SCOPE)
+endfunction()
+
+replay_final(${REFERENCE} expected)
+replay_final(${REPLAY} actual)
+
+if(NOT actual STREQUAL expected)
+    message(FATAL_ERROR "block size changes the results\n  reference: ${expected}\n  replay   : ${actual}")
+endif()
+message(STATUS "${actual}")
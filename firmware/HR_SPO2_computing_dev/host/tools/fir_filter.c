@@ -0,0 +1,55 @@
+/**
+ ******************************************************************************
+ * @file    fir_filter.c
+ * @brief   Host driver for the firmware Q15 FIR engine.
+ *
+ * @details
+ * Reads 12-bit ADC samples (one integer per line) from a file or stdin,
+ * converts them to Q15 exactly like the firmware (PPG_FIR_FromAdc12) and
+ * writes one "input_q15 output_q15" pair per line, filtered with the HR
+ * band-pass of ppg_fir_coeffs.h.
+ *
+ * Used by offline_analysis/scripts/check_fir_bitexact.py to compare the
+ * kernel with scipy.signal.lfilter.
+ *
+ * Usage: fir_filter [samples.txt] > out.txt
+ ******************************************************************************
+ */
+
+#include "ppg_fir.h"
+#include "ppg_fir_coeffs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int16_t fir_state[2U * PPG_FIR_BP_NUM_TAPS];
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+
+    if (argc > 1)
+    {
+        in = fopen(argv[1], "r");
+        if (in == NULL)
+        {
+            perror(argv[1]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    PPG_FIR_t fir;
+    PPG_FIR_Init(&fir, ppg_fir_bp_coeffs, PPG_FIR_BP_NUM_TAPS, fir_state);
+
+    long adc;
+    while (fscanf(in, "%ld", &adc) == 1)
+    {
+        int16_t x = PPG_FIR_FromAdc12((uint16_t)adc);
+        printf("%d %d\n", x, PPG_FIR_Process(&fir, x));
+    }
+
+    if (in != stdin)
+        fclose(in);
+
+    return EXIT_SUCCESS;
+}
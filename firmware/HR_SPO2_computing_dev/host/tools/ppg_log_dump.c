@@ -0,0 +1,526 @@
+/**
+ ******************************************************************************
+ * @file    ppg_log_dump.c
+ * @brief   Session log (PPGnnnnn.BIN) decoder: CSV or NumPy output.
+ *
+ * @details
+ * Decodes a log written by the SD card logger (data_logger.h, format in
+ * ppg_log_format.h) with the firmware decoder and writes:
+ *   - samples: one row per capture sample, columns timestamp (sample
+ *     clock), sequence, red, ir, ambient, battery; a channel missing from
+ *     a frame is an empty CSV field, -1 in NumPy
+ *   - results (-r): columns sequence, timestamp, bandpassed (Q15), hr_bpm,
+ *     hr_spectral_bpm, spo2_percent, beat_count; one row per PPG_FS output
+ *     when the log keeps the band-pass output (PPG_LOG_HAS_BANDPASS()),
+ *     else one row per frame with bandpassed empty (NaN in NumPy)
+ *   - overview (-s): one row per session index entry, columns time [s],
+ *     sequence, file offset, min / max of red, ir, ambient, battery (-1
+ *     for a channel absent), hr_bpm, spo2_percent, event bits
+ *   - events (-e): time [s], event, value
+ * NumPy files are .npy v1.0, 2-D: int32 samples, float64 results,
+ * overview and events (numpy.load()).
+ *
+ * Times are seconds from the first block. With -t only the frames that
+ * overlap the range are decoded: the reader seeks through the index.
+ * The file is mapped, so a closed session of any length opens without
+ * reading its blocks. A log without an index (session cut short) is
+ * scanned once to rebuild it when -s or -e asks for it.
+ *
+ * The header, the index (its events with -i), the block counters (bad blocks are skipped by
+ * their CRC), the sequence gaps and the size against raw 16-bit samples and
+ * against the CSV text are printed on stderr.
+ *
+ * Usage: ppg_log_dump [options] log.bin
+ *   -f csv|npy    output format (default csv)
+ *   -o <file>     samples (default stdout unless only -s / -e are given;
+ *                 required for npy)
+ *   -r <file>     results
+ *   -s <file>     overview from the index
+ *   -e <file>     events from the index
+ *   -t from:to    time range [s], either end may be left out
+ *   -i            header, index and counters only (no decoding with an index)
+ ******************************************************************************
+ */
+
+#include "ppg_log_format.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DUMP_NPY_HEADER     128U        /**< Fixed .npy header, rewritten with the row count */
+#define DUMP_SAMPLE_COLS    6U
+#define DUMP_RESULT_COLS    7U
+#define DUMP_OVERVIEW_COLS  14U
+#define DUMP_EVENT_COLS     3U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+/** One output file */
+typedef struct
+{
+    FILE       *file;
+    int         npy;
+    const char *descr;      /**< NumPy dtype */
+    unsigned    cols;
+    size_t      rows;
+    size_t      bytes;      /**< Bytes written (CSV text size) */
+} DumpOutput_t;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static const char *const event_names[PPG_LOG_EVENT_COUNT] =
+{
+    "start", "end", "gap", "window", "settled",
+};
+
+/** Read-only mapping of the whole file: pages are read as they are decoded */
+static const uint8_t *MapFile(const char *path, size_t *size)
+{
+    struct stat st;
+    void       *data;
+    int         fd = open(path, O_RDONLY);
+
+    if ((fd < 0) || (fstat(fd, &st) != 0) || (st.st_size == 0))
+    {
+        if (fd >= 0)
+            close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    *size = (size_t)st.st_size;
+    return (data == MAP_FAILED) ? NULL : data;
+}
+
+static const char *EventName(uint32_t type)
+{
+    return (type < PPG_LOG_EVENT_COUNT) ? event_names[type] : "?";
+}
+
+/** .npy v1.0 header padded to DUMP_NPY_HEADER bytes */
+static void WriteNpyHeader(DumpOutput_t *out)
+{
+    char     dict[DUMP_NPY_HEADER];
+    uint16_t len = (uint16_t)(DUMP_NPY_HEADER - 10U);
+    int      n;
+
+    n = snprintf(dict, sizeof(dict), "{'descr': '%s', 'fortran_order': False, 'shape': (%zu, %u), }",
+                 out->descr, out->rows, out->cols);
+    memset(&dict[n], ' ', len - (size_t)n - 1U);
+    dict[len - 1U] = '\n';
+
+    fwrite("\x93NUMPY\x01\x00", 1, 8, out->file);
+    fputc(len & 0xFF, out->file);
+    fputc(len >> 8, out->file);
+    fwrite(dict, 1, len, out->file);
+}
+
+static int OpenOutput(DumpOutput_t *out, const char *path, int npy, const char *descr, unsigned cols)
+{
+    memset(out, 0, sizeof(*out));
+    out->npy   = npy;
+    out->descr = descr;
+    out->cols  = cols;
+
+    if (path == NULL)
+    {
+        out->file = stdout;
+        return 0;
+    }
+
+    out->file = fopen(path, npy ? "wb" : "w");
+    if (out->file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (npy)
+        WriteNpyHeader(out);
+    return 0;
+}
+
+static void CloseOutput(DumpOutput_t *out)
+{
+    if (out->file == NULL)
+        return;
+
+    if (out->npy)
+    {
+        fseek(out->file, 0, SEEK_SET);
+        WriteNpyHeader(out);
+    }
+
+    if (out->file != stdout)
+        fclose(out->file);
+    out->file = NULL;
+}
+
+static void WriteSamples(DumpOutput_t *out, const PPG_LogFrame_t *f)
+{
+    for (uint32_t i = 0; i < f->count; i++)
+    {
+        if (out->npy)
+        {
+            int32_t row[DUMP_SAMPLE_COLS] = { (int32_t)(f->timestamp + i), (int32_t)f->sequence };
+
+            for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+                row[2U + ch] = ((f->channel_mask & PPG_CH_MASK(ch)) != 0U) ? f->samples[ch][i] : -1;
+            fwrite(row, sizeof(row[0]), DUMP_SAMPLE_COLS, out->file);
+        }
+        else
+        {
+            int n = fprintf(out->file, "%u,%u", (unsigned)(f->timestamp + i), (unsigned)f->sequence);
+
+            for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+            {
+                if ((f->channel_mask & PPG_CH_MASK(ch)) != 0U)
+                    n += fprintf(out->file, ",%u", (unsigned)f->samples[ch][i]);
+                else
+                    n += fprintf(out->file, ",");
+            }
+            n += fprintf(out->file, "\n");
+            out->bytes += (size_t)n;
+        }
+        out->rows++;
+    }
+}
+
+static void WriteResults(DumpOutput_t *out, const PPG_LogFrame_t *f, bool bandpass)
+{
+    uint32_t rows = bandpass ? f->outputs : 1U;
+
+    for (uint32_t i = 0; i < rows; i++)
+    {
+        if (out->npy)
+        {
+            double row[DUMP_RESULT_COLS] = {
+                f->sequence, f->timestamp, bandpass ? f->bandpassed[i] : NAN, f->hr_bpm,
+                f->hr_spectral_bpm, f->spo2_percent, f->beat_count
+            };
+
+            fwrite(row, sizeof(row[0]), DUMP_RESULT_COLS, out->file);
+        }
+        else
+        {
+            char y[8] = "";
+
+            if (bandpass)
+                snprintf(y, sizeof(y), "%d", f->bandpassed[i]);
+            out->bytes += (size_t)fprintf(out->file, "%u,%u,%s,%.2f,%.2f,%.2f,%u\n",
+                                          (unsigned)f->sequence, (unsigned)f->timestamp, y,
+                                          f->hr_bpm, f->hr_spectral_bpm, f->spo2_percent,
+                                          (unsigned)f->beat_count);
+        }
+        out->rows++;
+    }
+}
+
+static void WriteOverview(DumpOutput_t *out, const PPG_LogReader_t *reader, double t0, double hz)
+{
+    PPG_LogIndexEntry_t e;
+
+    for (uint32_t i = 0; PPG_LogReader_IndexEntry(reader, i, &e); i++)
+    {
+        double row[DUMP_OVERVIEW_COLS] = { (e.timestamp - t0) / hz, e.sequence, e.offset };
+
+        for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        {
+            bool present = (e.min[ch] <= e.max[ch]);
+
+            row[3U + (2U * ch)] = present ? e.min[ch] : -1.0;
+            row[4U + (2U * ch)] = present ? e.max[ch] : -1.0;
+        }
+        row[11] = e.hr * 0.01;
+        row[12] = e.spo2 * 0.01;
+        row[13] = e.events;
+
+        if (out->npy)
+        {
+            fwrite(row, sizeof(row[0]), DUMP_OVERVIEW_COLS, out->file);
+        }
+        else
+        {
+            fprintf(out->file, "%.3f", row[0]);
+            for (uint32_t c = 1; c < DUMP_OVERVIEW_COLS; c++)
+                fprintf(out->file, ((c == 11U) || (c == 12U)) ? ",%.2f" : ",%.0f", row[c]);
+            fprintf(out->file, "\n");
+        }
+        out->rows++;
+    }
+}
+
+static void WriteEvents(DumpOutput_t *out, const PPG_LogReader_t *reader, double t0, double hz)
+{
+    PPG_LogEvent_t e;
+
+    for (uint32_t i = 0; PPG_LogReader_IndexEvent(reader, i, &e); i++)
+    {
+        double row[DUMP_EVENT_COLS] = { (e.timestamp - t0) / hz, e.type, e.value };
+
+        if (out->npy)
+            fwrite(row, sizeof(row[0]), DUMP_EVENT_COLS, out->file);
+        else
+            fprintf(out->file, "%.3f,%s,%u\n", row[0], EventName(e.type), (unsigned)e.value);
+        out->rows++;
+    }
+}
+
+static void PrintHeader(const char *path, size_t size, const PPG_LogHeader_t *h)
+{
+    fprintf(stderr, "log       : %s, %zu bytes, format v%u, predictor order %u, build \"%s\"%s%s\n",
+            path, size, (unsigned)h->version, (unsigned)PPG_LOG_FLAG_GET_ORDER(h->flags), h->build,
+            ((h->flags & PPG_LOG_FLAG_SIMULATION) != 0U) ? ", simulation" : "",
+            PPG_LOG_HAS_BANDPASS(h) ? ", band-pass output" : "");
+    fprintf(stderr, "rate      : capture %u Hz, acquisition %u Hz, PPG_FS %u Hz, %u samples/frame, "
+            "session %u samples\n", (unsigned)h->capture_hz, (unsigned)h->acq_hz, (unsigned)h->ppg_fs,
+            (unsigned)h->frame_samples, (unsigned)h->total_samples);
+    fprintf(stderr, "channels  : mask 0x%X; LEDs RED %u us %.1f %%, IR %u us %.1f %%; start %u ms\n",
+            (unsigned)h->channel_mask, (unsigned)h->led_us[0], h->led_level[0] * 0.1,
+            (unsigned)h->led_us[1], h->led_level[1] * 0.1, (unsigned)h->start_ms);
+}
+
+static void PrintIndex(const PPG_LogReader_t *reader, double t0, double hz, bool rebuilt, bool list)
+{
+    const PPG_LogIndexView_t *v = &reader->index;
+    PPG_LogEvent_t            e;
+
+    fprintf(stderr, "index     : %s%u entries of %u blocks (%u blocks, %u frames), %.1f s, %u events",
+            rebuilt ? "rebuilt by a scan (session not closed), " : "",
+            (unsigned)v->entries, (unsigned)v->stride, (unsigned)v->blocks, (unsigned)v->frames,
+            (v->end_timestamp - t0) / hz, (unsigned)v->events);
+    if (v->dropped > 0U)
+        fprintf(stderr, " (%u more in the frames only)", (unsigned)v->dropped);
+    fprintf(stderr, "\n");
+
+    for (uint32_t i = 0; list && PPG_LogReader_IndexEvent(reader, i, &e); i++)
+        fprintf(stderr, "            %9.3f s  %-8s %u\n", (e.timestamp - t0) / hz, EventName(e.type),
+                (unsigned)e.value);
+}
+
+/** Time [s] to sample clock, clamped to the uint32 range */
+static uint32_t ToTimestamp(double seconds, double t0, double hz)
+{
+    double ts = floor(t0 + (seconds * hz));
+
+    return (ts <= 0.0) ? 0U : ((ts >= 4294967295.0) ? UINT32_MAX : (uint32_t)ts);
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f csv|npy] [-o samples] [-r results] [-s overview] [-e events] "
+            "[-t from:to] [-i] log.bin\n", prog);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    const char *samples_path  = NULL;
+    const char *results_path  = NULL;
+    const char *overview_path = NULL;
+    const char *events_path   = NULL;
+    const char *range         = NULL;
+    int         npy           = 0;
+    int         info_only     = 0;
+    int         c;
+
+    while ((c = getopt(argc, argv, "f:o:r:s:e:t:ih")) != -1)
+    {
+        switch (c)
+        {
+        case 'f':
+            if ((strcmp(optarg, "csv") != 0) && (strcmp(optarg, "npy") != 0))
+            {
+                Usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            npy = (strcmp(optarg, "npy") == 0);
+            break;
+        case 'o': samples_path = optarg; break;
+        case 'r': results_path = optarg; break;
+        case 's': overview_path = optarg; break;
+        case 'e': events_path = optarg; break;
+        case 't': range = optarg; break;
+        case 'i': info_only = 1; break;
+        default:
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Only the index asked for: no samples on stdout */
+    if ((overview_path != NULL || events_path != NULL) && (samples_path == NULL) && (results_path == NULL))
+        info_only = 1;
+
+    if ((optind >= argc) || (npy && !info_only && (samples_path == NULL)) ||
+        ((range != NULL) && (strchr(range, ':') == NULL)))
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char    *path = argv[optind];
+    size_t         size = 0;
+    const uint8_t *data = MapFile(path, &size);
+
+    static PPG_LogReader_t reader;
+    static PPG_LogFrame_t  frame;
+    static PPG_LogIndex_t  rebuilt;
+    static uint8_t         rebuilt_buf[PPG_LOG_INDEX_MAX_SIZE];
+
+    if (data == NULL)
+    {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    if (!PPG_LogReader_Open(&reader, data, size))
+    {
+        fprintf(stderr, "%s: no valid session header\n", path);
+        return EXIT_FAILURE;
+    }
+
+    PrintHeader(path, size, &reader.header);
+
+    /* Cut short: the overview and the events need the whole log decoded once */
+    bool rebuild = (reader.index.data == NULL) && ((overview_path != NULL) || (events_path != NULL));
+
+    if (rebuild)
+        PPG_LogReader_BuildIndex(&reader, &rebuilt, rebuilt_buf, &frame);
+
+    /* Times from the first block */
+    double             hz = (reader.header.capture_hz > 0U) ? (double)reader.header.capture_hz : 1.0;
+    double             t0 = 0.0;
+    PPG_LogIndexEntry_t first;
+
+    if (PPG_LogReader_IndexEntry(&reader, 0, &first))
+        t0 = first.timestamp;
+    else if (PPG_LogReader_Next(&reader, &frame))
+        t0 = frame.timestamp;
+
+    if (reader.index.data != NULL)
+        PrintIndex(&reader, t0, hz, rebuild, info_only != 0);
+    else
+        fprintf(stderr, "index     : none (session not closed)\n");
+
+    DumpOutput_t overview = {0};
+    DumpOutput_t events   = {0};
+
+    if ((overview_path != NULL) &&
+        (OpenOutput(&overview, overview_path, npy, "<f8", DUMP_OVERVIEW_COLS) == 0))
+    {
+        if (!npy)
+            fprintf(overview.file, "time,sequence,offset,red_min,red_max,ir_min,ir_max,ambient_min,"
+                    "ambient_max,battery_min,battery_max,hr_bpm,spo2_percent,events\n");
+        WriteOverview(&overview, &reader, t0, hz);
+        CloseOutput(&overview);
+    }
+
+    if ((events_path != NULL) && (OpenOutput(&events, events_path, npy, "<f8", DUMP_EVENT_COLS) == 0))
+    {
+        if (!npy)
+            fprintf(events.file, "time,event,value\n");
+        WriteEvents(&events, &reader, t0, hz);
+        CloseOutput(&events);
+    }
+
+    DumpOutput_t samples = {0};
+    DumpOutput_t results = {0};
+
+    if (!info_only)
+    {
+        if (OpenOutput(&samples, samples_path, npy, "<i4", DUMP_SAMPLE_COLS) != 0)
+            return EXIT_FAILURE;
+        if (!npy)
+            samples.bytes = (size_t)fprintf(samples.file, "timestamp,sequence,red,ir,ambient,battery\n");
+
+        if ((results_path != NULL) &&
+            (OpenOutput(&results, results_path, npy, "<f8", DUMP_RESULT_COLS) != 0))
+            return EXIT_FAILURE;
+        if ((results.file != NULL) && !npy)
+            results.bytes = (size_t)fprintf(results.file,
+                "sequence,timestamp,bandpassed,hr_bpm,hr_spectral_bpm,spo2_percent,beat_count\n");
+    }
+
+    /* Time range: seek to its first block, stop past its end */
+    uint32_t from = 0;
+    uint32_t to   = UINT32_MAX;
+
+    if (range != NULL)
+    {
+        const char *colon = strchr(range, ':');
+
+        if (colon != range)
+            from = ToTimestamp(atof(range), t0, hz);
+        if (colon[1] != '\0')
+            to = ToTimestamp(atof(&colon[1]), t0, hz);
+    }
+
+    /* With an index, -i needs no decoding */
+    bool decode = !info_only || (reader.index.data == NULL);
+
+    PPG_LogReader_Rewind(&reader);
+    if ((from > 0U) && !PPG_LogReader_Seek(&reader, from, &frame))
+        decode = false;
+
+    size_t   sample_count = 0;
+    size_t   raw_bytes    = 0;
+    uint32_t expected     = 0;
+    uint32_t lost         = 0;
+    uint32_t frames       = 0;
+
+    while (decode && PPG_LogReader_Next(&reader, &frame))
+    {
+        if (frame.timestamp >= to)
+            break;
+        if ((frame.timestamp + frame.count) <= from)
+            continue;
+
+        if ((frames++ > 0U) && (frame.sequence > expected))
+            lost += frame.sequence - expected;
+        expected = frame.sequence + 1U;
+
+        sample_count += frame.count;
+        raw_bytes    += (size_t)__builtin_popcount(frame.channel_mask) * frame.count * 2U;
+
+        if (samples.file != NULL)
+            WriteSamples(&samples, &frame);
+        if (results.file != NULL)
+            WriteResults(&results, &frame, PPG_LOG_HAS_BANDPASS(&reader.header));
+    }
+
+    size_t text_bytes = samples.bytes + results.bytes;
+
+    CloseOutput(&samples);
+    CloseOutput(&results);
+
+    if (!decode)
+        return EXIT_SUCCESS;
+
+    fprintf(stderr, "decoded   : %u blocks, %u bad, %zu bytes skipped; %u frames, %u missing; %zu samples\n",
+            (unsigned)reader.blocks, (unsigned)reader.bad_blocks, reader.skipped,
+            (unsigned)frames, (unsigned)lost, sample_count);
+    if ((raw_bytes > 0U) && (range == NULL))
+        fprintf(stderr, "size      : raw 16-bit samples %zu bytes (the log is %.2fx)\n",
+                raw_bytes, (double)size / (double)raw_bytes);
+    if (!npy && (text_bytes > 0U) && (range == NULL))
+        fprintf(stderr, "            CSV text %zu bytes (the log is %.2fx)\n",
+                text_bytes, (double)size / (double)text_bytes);
+
+    return (reader.bad_blocks == 0U) ? EXIT_SUCCESS : 2;
+}
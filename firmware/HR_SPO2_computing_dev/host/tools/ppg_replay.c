@@ -0,0 +1,602 @@
+/**
+ ******************************************************************************
+ * @file    ppg_replay.c
+ * @brief   Faster-than-real-time replay of CSV recordings through the
+ *          processing pipeline.
+ *
+ * @details
+ * Streams a recorded signal into the host build of the firmware pipeline
+ * (ppg_dsp) as fast as the CPU allows, frame by frame exactly like the
+ * processing task, and writes HR/SpO2 traces plus a throughput report.
+ *
+ * Supported inputs:
+ *   - J-Scope exports (';'-separated, Timestamp in us): the adc_raw column
+ *     while ppg_running != 0, decimated from the J-Scope rate to PPG_FS
+ *   - multi-column PPG CSVs (','-separated) such as the notebook's
+ *     s10_sit.csv: pleth_1 (RED) and pleth_2 (IR) are interleaved in
+ *     RED/IR acquisition windows like the firmware (PPG_WINDOW_SAMPLES),
+ *     decimated from -f to PPG_FS and rescaled to 12 bits with one gain
+ *     for both channels (AC/DC ratios are kept); with -m both are fed in
+ *     every sample, like the LED phase scheduler (no ambient channel)
+ *
+ * Decimation keeps every k-th sample, as the notebook does.
+ *
+ * Usage: ppg_replay [options] recording.csv
+ *   -c <name>     single signal column (default: adc_raw)
+ *   -r <name>     RED column (default: pleth_1 if present)
+ *   -i <name>     IR column  (default: pleth_2 if present)
+ *   -g <name>     gate column, rows used only when != 0 (default: ppg_running if present)
+ *   -f <hz>       input sampling rate (default: from Timestamp [us], else PPG_FS)
+ *   -s            scale the signal up to 0..4095 (automatic outside 0..4095)
+ *   -m            simultaneous RED/IR instead of acquisition windows
+ *   -n <count>    replay the recording <count> times (default 1)
+ *   -t <samples>  trace period in samples (default PPG_FS: one line per second)
+ *   -o <file>     trace output (default stdout)
+ *   -l <file>     also write the frames as a session log (ppg_log_format.h)
+ *                 with its index, as the SD card logger would, and report
+ *                 its size
+ *   -b            keep the band-pass output in the log (PPG_LOG_FLAG_BANDPASS)
+ *   -d <file>     also write the replayed samples as CSV, in the ppg_log_dump
+ *                 -o format, to check a log against its input
+ *   -p            print the per-stage profile (host build with -DPPG_PROFILE=ON)
+ ******************************************************************************
+ */
+
+#include "ppg_pipeline.h"
+#include "ppg_profile.h"
+#include "ppg_log_format.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define REPLAY_MAX_LINE     4096U
+#define REPLAY_MAX_COLUMNS  64U
+
+/* ------------------------------------------------------------------------- */
+/* Types                                                                     */
+/* ------------------------------------------------------------------------- */
+
+typedef struct
+{
+    const char *signal;     /**< Single-stream column name */
+    const char *red;        /**< RED column name */
+    const char *ir;         /**< IR column name */
+    const char *gate;       /**< Gate column name */
+    double      fs_in;      /**< Input rate (0 = auto) */
+    int         rescale;    /**< Force rescaling to 12 bits */
+    int         simultaneous; /**< RED and IR in every sample */
+    unsigned    repeat;     /**< Replays of the whole recording */
+    unsigned    trace_period;
+    const char *output;
+    const char *log;        /**< Session log output */
+    int         bandpass;   /**< Band-pass output in the log */
+    const char *samples;    /**< Samples CSV output (ppg_log_dump -o format) */
+    int         profile;    /**< Print the stage profile */
+    const char *path;
+} ReplayOptions_t;
+
+/** Recording decimated to PPG_FS, as 12-bit codes */
+typedef struct
+{
+    uint16_t *red;          /**< RED (or single) stream */
+    uint16_t *ir;           /**< IR stream (NULL in single-stream mode) */
+    size_t    length;
+    double    fs_in;
+    unsigned  decimation;
+} ReplaySignal_t;
+
+/* ------------------------------------------------------------------------- */
+/* Private helpers                                                           */
+/* ------------------------------------------------------------------------- */
+
+static double NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/** Split a CSV line in place, return the number of fields */
+static unsigned SplitLine(char *line, char delim, char **fields)
+{
+    unsigned n = 0;
+    char *p = line;
+
+    while ((n < REPLAY_MAX_COLUMNS) && (p != NULL))
+    {
+        char *next = strchr(p, delim);
+        if (next != NULL)
+            *next++ = '\0';
+
+        /* Trim spaces, quotes and line endings */
+        while ((*p == ' ') || (*p == '"'))
+            p++;
+        char *end = p + strlen(p);
+        while ((end > p) && ((end[-1] == '\n') || (end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '"')))
+            *--end = '\0';
+
+        fields[n++] = p;
+        p = next;
+    }
+    return n;
+}
+
+static int FindColumn(char **names, unsigned count, const char *name)
+{
+    if (name == NULL)
+        return -1;
+
+    for (unsigned i = 0; i < count; i++)
+        if (strcmp(names[i], name) == 0)
+            return (int)i;
+    return -1;
+}
+
+static int Append(double **buf, size_t *len, size_t *cap, double v)
+{
+    if (*len == *cap)
+    {
+        size_t new_cap = (*cap == 0U) ? 65536U : (*cap * 2U);
+        double *p = realloc(*buf, new_cap * sizeof(double));
+        if (p == NULL)
+            return -1;
+        *buf = p;
+        *cap = new_cap;
+    }
+    (*buf)[(*len)++] = v;
+    return 0;
+}
+
+static void Range(const double *x, size_t len, double *lo, double *hi)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (x[i] < *lo) *lo = x[i];
+        if (x[i] > *hi) *hi = x[i];
+    }
+}
+
+/** Convert a stream to 12-bit codes: (x - offset) * gain, clamped */
+static uint16_t *ToAdc12(const double *x, size_t len, double offset, double gain)
+{
+    uint16_t *out = malloc((len > 0U ? len : 1U) * sizeof(uint16_t));
+    if (out == NULL)
+        return NULL;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        double v = floor((x[i] - offset) * gain + 0.5);
+        out[i] = (uint16_t)((v < 0.0) ? 0.0 : ((v > 4095.0) ? 4095.0 : v));
+    }
+    return out;
+}
+
+/** Read, gate and decimate the recording */
+static int LoadRecording(const ReplayOptions_t *opt, ReplaySignal_t *sig)
+{
+    FILE *in = fopen(opt->path, "r");
+    if (in == NULL)
+    {
+        perror(opt->path);
+        return -1;
+    }
+
+    static char line[REPLAY_MAX_LINE];
+    char *names[REPLAY_MAX_COLUMNS];
+    char *fields[REPLAY_MAX_COLUMNS];
+
+    if (fgets(line, sizeof(line), in) == NULL)
+    {
+        fprintf(stderr, "%s: empty file\n", opt->path);
+        fclose(in);
+        return -1;
+    }
+
+    char delim = (strchr(line, ';') != NULL) ? ';' : ',';
+    static char header[REPLAY_MAX_LINE];
+    memcpy(header, line, sizeof(header));
+    unsigned columns = SplitLine(header, delim, names);
+
+    int c_red  = FindColumn(names, columns, (opt->red != NULL) ? opt->red : "pleth_1");
+    int c_ir   = FindColumn(names, columns, (opt->ir  != NULL) ? opt->ir  : "pleth_2");
+    int c_sig  = FindColumn(names, columns, (opt->signal != NULL) ? opt->signal : "adc_raw");
+    int c_gate = FindColumn(names, columns, (opt->gate != NULL) ? opt->gate : "ppg_running");
+    int c_time = FindColumn(names, columns, "Timestamp");
+
+    /* An explicit single column wins over the RED/IR defaults */
+    int dual = (opt->signal == NULL) && (c_red >= 0) && (c_ir >= 0);
+    if (!dual)
+    {
+        c_red = c_sig;
+        c_ir  = -1;
+    }
+
+    if (c_red < 0)
+    {
+        fprintf(stderr, "%s: no signal column (use -c, or -r and -i)\n", opt->path);
+        fclose(in);
+        return -1;
+    }
+
+    double *red = NULL, *ir = NULL;
+    size_t red_len = 0, red_cap = 0, ir_len = 0, ir_cap = 0;
+    double t_first = NAN, t_second = NAN;
+    int err = 0;
+
+    while (!err && (fgets(line, sizeof(line), in) != NULL))
+    {
+        unsigned n = SplitLine(line, delim, fields);
+
+        if ((n <= (unsigned)c_red) || (dual && (n <= (unsigned)c_ir)))
+            continue;
+
+        if ((c_time >= 0) && ((unsigned)c_time < n))
+        {
+            if (isnan(t_first))
+                t_first = atof(fields[c_time]);
+            else if (isnan(t_second))
+                t_second = atof(fields[c_time]);
+        }
+
+        if ((c_gate >= 0) && ((unsigned)c_gate < n) && (atof(fields[c_gate]) == 0.0))
+            continue;
+
+        err |= Append(&red, &red_len, &red_cap, atof(fields[c_red]));
+        if (dual)
+            err |= Append(&ir, &ir_len, &ir_cap, atof(fields[c_ir]));
+    }
+    fclose(in);
+
+    if (err)
+    {
+        fprintf(stderr, "out of memory\n");
+        free(red);
+        free(ir);
+        return -1;
+    }
+
+    /* Input rate: option, J-Scope Timestamp [us], or already PPG_FS */
+    sig->fs_in = opt->fs_in;
+    if ((sig->fs_in <= 0.0) && !isnan(t_second) && (t_second > t_first))
+        sig->fs_in = 1e6 / (t_second - t_first);
+    if (sig->fs_in <= 0.0)
+        sig->fs_in = PPG_FS;
+
+    double ratio = sig->fs_in / PPG_FS;
+    sig->decimation = (unsigned)floor(ratio + 0.5);
+    if (sig->decimation < 1U)
+    {
+        fprintf(stderr, "input rate %.1f Hz is below PPG_FS (%d Hz)\n", sig->fs_in, PPG_FS);
+        free(red);
+        free(ir);
+        return -1;
+    }
+    if (fabs(ratio - sig->decimation) > 1e-3)
+        fprintf(stderr, "warning: %.1f Hz is not a multiple of %d Hz, decimating by %u\n",
+                sig->fs_in, PPG_FS, sig->decimation);
+
+    /* Keep every k-th sample, as the notebook does */
+    size_t out_len = 0;
+    for (size_t i = 0; i < red_len; i += sig->decimation)
+    {
+        red[out_len] = red[i];
+        if (dual)
+            ir[out_len] = ir[i];
+        out_len++;
+    }
+
+    /*
+     * Rescale when asked or when the data is not 12-bit: one gain for both
+     * channels and no offset unless the data goes negative, so the AC/DC
+     * ratios used by SpO2 are preserved.
+     */
+    double lo = INFINITY, hi = -INFINITY;
+    Range(red, out_len, &lo, &hi);
+    if (dual)
+        Range(ir, out_len, &lo, &hi);
+
+    double offset = 0.0, gain = 1.0;
+    if ((opt->rescale || (lo < 0.0) || (hi > 4095.0)) && (hi > lo))
+    {
+        offset = (lo < 0.0) ? lo : 0.0;
+        gain   = 4095.0 / (hi - offset);
+    }
+
+    sig->length = out_len;
+    sig->red = ToAdc12(red, out_len, offset, gain);
+    sig->ir  = dual ? ToAdc12(ir, out_len, offset, gain) : NULL;
+
+    free(red);
+    free(ir);
+
+    if ((sig->red == NULL) || (dual && (sig->ir == NULL)))
+    {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+/** Frame's samples as ppg_log_dump CSV rows */
+static void WriteSamples(FILE *file, const PPG_Frame_t *frame)
+{
+    for (uint32_t i = 0; i < frame->count; i++)
+    {
+        fprintf(file, "%u,%u", (unsigned)(frame->timestamp + i), (unsigned)frame->sequence);
+        for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        {
+            if ((frame->channel_mask & PPG_CH_MASK(ch)) != 0U)
+                fprintf(file, ",%u", (unsigned)frame->samples[ch][i]);
+            else
+                fprintf(file, ",");
+        }
+        fprintf(file, "\n");
+    }
+}
+
+/** Bytes of the frame's samples as ppg_log_dump CSV rows */
+static size_t CsvBytes(const PPG_Frame_t *frame)
+{
+    size_t n = 0;
+
+    for (uint32_t i = 0; i < frame->count; i++)
+    {
+        n += (size_t)snprintf(NULL, 0, "%u,%u", (unsigned)(frame->timestamp + i),
+                              (unsigned)frame->sequence) + PPG_CH_COUNT + 1U;
+        for (uint32_t ch = 0; ch < PPG_CH_COUNT; ch++)
+        {
+            if ((frame->channel_mask & PPG_CH_MASK(ch)) != 0U)
+                n += (size_t)snprintf(NULL, 0, "%u", (unsigned)frame->samples[ch][i]);
+        }
+    }
+    return n;
+}
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-c col] [-r col -i col] [-g col] [-f hz] [-s] [-m] [-n count] "
+            "[-t samples] [-o trace.csv] [-l log.bin [-b]] [-d samples.csv] [-p] recording.csv\n", prog);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Main                                                                      */
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    ReplayOptions_t opt = { .repeat = 1U, .trace_period = PPG_FS };
+    int c;
+
+    while ((c = getopt(argc, argv, "c:r:i:g:f:smn:t:o:l:bd:ph")) != -1)
+    {
+        switch (c)
+        {
+        case 'c': opt.signal = optarg; break;
+        case 'r': opt.red = optarg; break;
+        case 'i': opt.ir = optarg; break;
+        case 'g': opt.gate = optarg; break;
+        case 'f': opt.fs_in = atof(optarg); break;
+        case 's': opt.rescale = 1; break;
+        case 'm': opt.simultaneous = 1; break;
+        case 'n': opt.repeat = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 't': opt.trace_period = (unsigned)strtoul(optarg, NULL, 10); break;
+        case 'o': opt.output = optarg; break;
+        case 'l': opt.log = optarg; break;
+        case 'b': opt.bandpass = 1; break;
+        case 'd': opt.samples = optarg; break;
+        case 'p': opt.profile = 1; break;
+        default:
+            Usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ((optind >= argc) || (opt.trace_period == 0U))
+    {
+        Usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    opt.path = argv[optind];
+
+    ReplaySignal_t sig = {0};
+    double t_load = NowNs();
+    if (LoadRecording(&opt, &sig) != 0)
+        return EXIT_FAILURE;
+    t_load = NowNs() - t_load;
+
+    FILE *out = stdout;
+    if (opt.output != NULL)
+    {
+        out = fopen(opt.output, "w");
+        if (out == NULL)
+        {
+            perror(opt.output);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *samples = NULL;
+    if (opt.samples != NULL)
+    {
+        samples = fopen(opt.samples, "w");
+        if (samples == NULL)
+        {
+            perror(opt.samples);
+            return EXIT_FAILURE;
+        }
+        fprintf(samples, "timestamp,sequence,red,ir,ambient,battery\n");
+    }
+
+    static PPG_Pipeline_t pipeline;
+    static PPG_Frame_t    frame;
+    static uint8_t        log_buf[PPG_LOG_FRAME_MAX];
+    static PPG_LogIndex_t log_index;
+    PPG_LogEncoder_t      log_enc;
+    FILE                 *log = NULL;
+    size_t                log_bytes = 0;
+    size_t                raw_bytes = 0;
+    size_t                csv_bytes = 0;
+
+    if (opt.log != NULL)
+    {
+        PPG_LogHeader_t hdr = {
+            .version       = PPG_LOG_VERSION,
+            .capture_hz    = PPG_FS,
+            .acq_hz        = PPG_FS,
+            .ppg_fs        = PPG_FS,
+            .frame_samples = PPG_BLOCK_SIZE,
+            .flags         = PPG_LOG_FLAG_ORDER(PPG_LOG_PREDICTOR_ORDER) |
+                             ((opt.bandpass || (PPG_LOG_BANDPASS != 0U)) ? PPG_LOG_FLAG_BANDPASS : 0U),
+            .build         = "ppg_replay",
+        };
+        uint8_t head[PPG_LOG_HEADER_SIZE];
+
+        log = fopen(opt.log, "wb");
+        if (log == NULL)
+        {
+            perror(opt.log);
+            return EXIT_FAILURE;
+        }
+
+        hdr.total_samples = (uint32_t)(sig.length * opt.repeat);
+        hdr.channel_mask  = (uint16_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR));
+        PPG_Log_EncodeHeader(head, &hdr);
+        PPG_LogEncoder_Init(&log_enc, &hdr);
+        PPG_LogIndex_Init(&log_index);
+        log_bytes = fwrite(head, 1, sizeof(head), log);
+    }
+
+    PPG_Pipeline_Init(&pipeline);
+    PPG_Profile_Init(0U);
+    fprintf(out, "time_s,hr_bpm,hr_spectral_bpm,spo2_percent,spo2_ratio,beat_count\n");
+
+    if (opt.simultaneous && (sig.ir == NULL))
+    {
+        fprintf(stderr, "-m needs RED and IR columns\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t total = sig.length * opt.repeat;
+    double t_proc = 0.0;
+    size_t n = 0;
+
+    while (n < total)
+    {
+        /* One acquisition frame, filled like PPG_PushSampleFromISR() */
+        frame.sequence     = (uint32_t)(n / PPG_BLOCK_SIZE);
+        frame.timestamp    = (uint32_t)n;
+        frame.count        = 0;
+        frame.channel_mask = 0;
+        frame.flags        = opt.simultaneous ? PPG_FRAME_FLAG_SIMULTANEOUS : 0U;
+
+        while ((frame.count < PPG_BLOCK_SIZE) && (n < total) && opt.simultaneous)
+        {
+            size_t k = n % sig.length;
+
+            frame.samples[PPG_CH_RED][frame.count] = sig.red[k];
+            frame.samples[PPG_CH_IR][frame.count++] = sig.ir[k];
+            frame.channel_mask = (uint16_t)(PPG_CH_MASK(PPG_CH_RED) | PPG_CH_MASK(PPG_CH_IR));
+            n++;
+        }
+
+        while ((frame.count < PPG_BLOCK_SIZE) && (n < total) && !opt.simultaneous)
+        {
+            size_t        k  = n % sig.length;
+            PPG_Channel_t ch = PPG_Pipeline_WindowChannel((uint32_t)n);
+            const uint16_t *src = ((ch == PPG_CH_IR) && (sig.ir != NULL)) ? sig.ir : sig.red;
+
+            frame.samples[ch][frame.count++] = src[k];
+            frame.channel_mask |= (uint16_t)PPG_CH_MASK(ch);
+            n++;
+        }
+
+        double t0 = NowNs();
+        PPG_Pipeline_ProcessFrame(&pipeline, &frame);
+        t_proc += NowNs() - t0;
+
+        if (log != NULL)
+        {
+            size_t len = PPG_LogEncoder_Frame(&log_enc, &frame, log_buf);
+
+            PPG_LogIndex_Frame(&log_index, &log_enc, (uint32_t)log_bytes, &frame);
+            log_bytes += fwrite(log_buf, 1, len, log);
+            raw_bytes += (size_t)__builtin_popcount(frame.channel_mask) * frame.count * 2U;
+            csv_bytes += CsvBytes(&frame);
+        }
+
+        if (samples != NULL)
+            WriteSamples(samples, &frame);
+
+        /* Trace lines at every multiple of the trace period in this frame */
+        size_t first = n - frame.count;
+        for (size_t m = first; m < n; m++)
+        {
+            if (((m + 1U) % opt.trace_period) != 0U)
+                continue;
+
+            const PPG_PipelineOutput_t *o = &pipeline.out;
+            fprintf(out, "%.2f,%.2f,%.2f,%.2f,%.4f,%u\n",
+                    (double)(m + 1U) / PPG_FS, o->hr_bpm, o->hr_spectral_bpm,
+                    o->spo2_percent, o->spo2_ratio, (unsigned)o->beat_count);
+        }
+    }
+
+    if (out != stdout)
+        fclose(out);
+    if (samples != NULL)
+        fclose(samples);
+
+    if (log != NULL)
+    {
+        PPG_LogIndexWriter_t w;
+        size_t               len;
+
+        log_bytes += fwrite(log_buf, 1, PPG_LogEncoder_End(&log_enc, log_buf), log);
+        PPG_LogIndex_Finish(&log_index, &w, log_enc.seed, (uint32_t)log_bytes);
+        while ((len = PPG_LogIndex_Encode(&log_index, &w, log_buf)) > 0U)
+            log_bytes += fwrite(log_buf, 1, len, log);
+        fclose(log);
+    }
+
+    double audio_s = (double)total / PPG_FS;
+    fprintf(stderr, "input     : %s (%s, %.1f Hz, decimation %u)\n", opt.path,
+            (sig.ir == NULL) ? "single column" :
+            (opt.simultaneous ? "RED/IR columns, simultaneous" : "RED/IR columns"),
+            sig.fs_in, sig.decimation);
+    fprintf(stderr, "replayed  : %zu samples x %u = %.1f s of signal, block %u\n",
+            sig.length, opt.repeat, audio_s, (unsigned)PPG_BLOCK_SIZE);
+    fprintf(stderr, "load      : %.1f ms\n", t_load / 1e6);
+    fprintf(stderr, "final     : HR %.2f bpm, spectral %.2f bpm, SpO2 %.2f %%, R %.4f, %u beats\n",
+            pipeline.out.hr_bpm, pipeline.out.hr_spectral_bpm, pipeline.out.spo2_percent,
+            pipeline.out.spo2_ratio, (unsigned)pipeline.out.beat_count);
+    if ((log != NULL) && (total > 0U))
+        fprintf(stderr, "log       : %s, %zu bytes, %.2f B/sample; raw 16-bit samples %zu bytes "
+                "(log %.2fx), CSV %zu bytes (log %.2fx)\n",
+                opt.log, log_bytes, (double)log_bytes / (double)total, raw_bytes,
+                (double)log_bytes / (double)raw_bytes, csv_bytes, (double)log_bytes / (double)csv_bytes);
+    if (total > 0U)
+        fprintf(stderr, "processing: %.1f ms, %.1f ns/sample, %.2f Msamples/s, %.0fx real time\n",
+                t_proc / 1e6, t_proc / (double)total, (double)total * 1e3 / t_proc,
+                audio_s / (t_proc / 1e9));
+
+    if (opt.profile)
+    {
+        static char text[2048];
+
+        if (!PPG_PROFILE_ENABLE)
+            fprintf(stderr, "profile   : compiled out, configure with -DPPG_PROFILE=ON\n");
+
+        PPG_Profile_Report();
+        PPG_Profile_Format(text, sizeof(text));
+        fprintf(stderr, "profile   : %lu ticks/s\n%s", (unsigned long)ppg_profile_tick_hz, text);
+    }
+
+    free(sig.red);
+    free(sig.ir);
+    return EXIT_SUCCESS;
+}
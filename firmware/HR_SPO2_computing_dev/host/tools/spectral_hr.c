@@ -0,0 +1,77 @@
+/**
+ ******************************************************************************
+ * @file    spectral_hr.c
+ * @brief   Host driver for the firmware spectral HR estimator.
+ *
+ * @details
+ * Reads 12-bit ADC samples (one integer per line) from a file or stdin and
+ * runs them through the firmware path: Q15 conversion, HR band-pass
+ * (ppg_fir_coeffs.h) and Goertzel spectral estimator. Writes
+ *   - "est <sample> <hr_bpm> <peak_hz> <quality>" at every completed segment
+ *   - "psd <hz> <power>" for every bin of the final averaged PSD
+ *
+ * Used by offline_analysis/scripts/compare_spectral_hr.py to compare the
+ * estimator with the notebook's scipy.signal.welch result.
+ *
+ * Usage: spectral_hr [-f fs_hz] [samples.txt] > out.txt
+ ******************************************************************************
+ */
+
+#include "ppg_fir.h"
+#include "ppg_fir_coeffs.h"
+#include "ppg_hr_spectral.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int16_t fir_state[2U * PPG_FIR_BP_NUM_TAPS];
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    long fs = PPG_FIR_BP_FS;
+    int arg = 1;
+
+    if ((argc > 2) && (strcmp(argv[1], "-f") == 0))
+    {
+        fs = strtol(argv[2], NULL, 10);
+        arg = 3;
+    }
+
+    if (argc > arg)
+    {
+        in = fopen(argv[arg], "r");
+        if (in == NULL)
+        {
+            perror(argv[arg]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    PPG_FIR_t fir;
+    PPG_FIR_Init(&fir, ppg_fir_bp_coeffs, PPG_FIR_BP_NUM_TAPS, fir_state);
+
+    PPG_Spectral_t spectral;
+    PPG_Spectral_Init(&spectral, (uint16_t)fs);
+
+    long adc;
+    unsigned long n = 0;
+    while (fscanf(in, "%ld", &adc) == 1)
+    {
+        int16_t x = PPG_FIR_Process(&fir, PPG_FIR_FromAdc12((uint16_t)adc));
+        PPG_SpectralHR_t est;
+
+        n++;
+        if (PPG_Spectral_Update(&spectral, x, &est))
+            printf("est %lu %.3f %.5f %.4f\n", n, est.hr_bpm, est.peak_hz, est.quality);
+    }
+
+    for (uint32_t k = 0; k < PPG_SPECTRAL_NUM_BINS; k++)
+        printf("psd %.5f %.6e\n", PPG_Spectral_BinHz(&spectral, k), spectral.psd[k]);
+
+    if (in != stdin)
+        fclose(in);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,82 @@
+"""
+Bit-exact check of the firmware Q15 FIR engine against scipy.signal.lfilter.
+
+The 100 Hz ADC stream is recovered from the J-Scope export
+(ppg_signal_emu.csv, 1 kHz, active while ppg_running == 1), filtered by the
+host build of the firmware kernel (fir_filter) and by lfilter on the same
+Q15 integers. With integer data and taps lfilter is exact in float64, so
+applying the kernel's rounding (+2^14, >> 15) and Q15 saturation must give
+identical outputs.
+
+Usage:
+    python check_fir_bitexact.py --tool ../../firmware/HR_SPO2_computing_dev/build/host/fir_filter
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+from scipy.signal import lfilter
+
+ROOT = Path(__file__).resolve().parents[2]
+DEFAULT_CSV = ROOT / "offline_analysis" / "notebooks" / "ppg_signal_emu.csv"
+DEFAULT_HEADER = ROOT / "firmware" / "HR_SPO2_computing_dev" / "Core" / "Inc" / "ppg_fir_coeffs.h"
+
+FS_JSCOPE = 1000        # Hz, J-Scope sampling of the exported variables
+FS_MCU = 100            # Hz, ADC sampling
+
+
+def load_adc_stream(csv_path):
+    """100 Hz adc_raw samples of the active part of a J-Scope export."""
+    df = pd.read_csv(csv_path, sep=";")
+    active = df[df["ppg_running"] == 1]
+    return active["adc_raw"].to_numpy()[::FS_JSCOPE // FS_MCU].astype(np.int64)
+
+
+def load_coeffs(header_path):
+    text = Path(header_path).read_text()
+    body = text[text.index("=\n{") + 3:text.index("};")]
+    return np.array([int(v) for v in re.findall(r"-?\d+", body)], dtype=np.int64)
+
+
+def reference(x_q15, h_q15):
+    y = lfilter(h_q15.astype(np.float64), [1.0], x_q15.astype(np.float64))
+    y = np.floor((y + 16384.0) / 32768.0)
+    return np.clip(y, -32768, 32767).astype(np.int64)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", type=Path, required=True, help="host fir_filter executable")
+    parser.add_argument("--csv", type=Path, default=DEFAULT_CSV)
+    parser.add_argument("--header", type=Path, default=DEFAULT_HEADER)
+    args = parser.parse_args()
+
+    adc = load_adc_stream(args.csv)
+    h = load_coeffs(args.header)
+
+    run = subprocess.run([str(args.tool)], input="\n".join(map(str, adc)),
+                         capture_output=True, text=True, check=True)
+    out = np.array(run.stdout.split(), dtype=np.int64).reshape(-1, 2)
+    x_q15, y_mcu = out[:, 0], out[:, 1]
+
+    y_ref = reference(x_q15, h)
+    mismatch = np.flatnonzero(y_ref != y_mcu)
+
+    print(f"{len(adc)} samples, {len(h)} taps")
+    if mismatch.size:
+        i = mismatch[0]
+        print(f"FAIL: {mismatch.size} mismatches, first at {i}: kernel={y_mcu[i]} scipy={y_ref[i]}")
+        return 1
+
+    print("OK: kernel output is bit-exact with scipy.signal.lfilter")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
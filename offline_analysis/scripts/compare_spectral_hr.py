@@ -0,0 +1,124 @@
+"""
+Compare the firmware spectral HR estimator with the notebook's Welch PSD.
+
+The same 100 Hz signal is run through the host build of the firmware path
+(spectral_hr: Q15 band-pass + Goertzel bank) and through scipy:
+
+  1. PSD check: scipy.signal.spectrogram with the estimator's segmentation
+     (Hamming, 10 s, 50 % overlap) on the bit-exact band-passed signal,
+     averaged like the firmware. The Goertzel bins must match it.
+  2. HR check: the notebook method (welch on the mean-removed signal,
+     0.5-4 Hz band, find_peaks) against the estimator's last HR value.
+
+Input is either the J-Scope export (default, ppg_signal_emu.csv) or a
+PhysioNet-style CSV with pleth_1/pleth_2 columns at 500 Hz (s10_sit.csv
+in the notebook), decimated to 100 Hz and rescaled to 12 bits.
+
+Usage:
+    python compare_spectral_hr.py --tool ../../firmware/HR_SPO2_computing_dev/build/host/spectral_hr
+    python compare_spectral_hr.py --tool <...>/spectral_hr --pleth s10_sit.csv --column pleth_2
+"""
+
+import argparse
+import subprocess
+import sys
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+from scipy.signal import find_peaks, spectrogram, welch
+
+from check_fir_bitexact import DEFAULT_CSV, DEFAULT_HEADER, load_adc_stream, load_coeffs, reference
+
+FS = 100                # Hz, MCU sampling rate
+SEGMENT_S = 10          # s, notebook nperseg = 1000 @ 100 Hz
+BAND = (0.5, 4.0)       # Hz
+AVG = 4                 # PPG_SPECTRAL_AVG
+PLETH_FS = 500          # Hz, PhysioNet recordings
+
+
+def load_pleth(csv_path, column, seconds):
+    """Notebook preprocessing: first `seconds`, decimated 500 -> 100 Hz, as 12-bit ADC codes."""
+    x = pd.read_csv(csv_path)[column].to_numpy()[:seconds * PLETH_FS][::PLETH_FS // FS]
+    x = (x - x.min()) / max(np.ptp(x), 1e-12)
+    return np.round(x * 4095).astype(np.int64)
+
+
+def firmware_average(periodograms):
+    """PSD average of ppg_hr_spectral.c: mean of the first AVG segments, then exponential."""
+    psd = np.zeros(periodograms.shape[0])
+    for i, p in enumerate(periodograms.T):
+        psd += (p - psd) / min(i + 1, AVG)
+    return psd
+
+
+def notebook_hr(x):
+    """HR of the notebook: welch + find_peaks in the HR band, strongest peak."""
+    f, pxx = welch(x - np.mean(x), fs=FS, window="hamming",
+                   nperseg=SEGMENT_S * FS, noverlap=SEGMENT_S * FS // 2)
+    mask = (f >= BAND[0]) & (f <= BAND[1])
+    f, pxx = f[mask], pxx[mask]
+    peaks, _ = find_peaks(pxx, prominence=np.max(pxx) * 0.1)
+    if peaks.size == 0:
+        return None
+    return f[peaks[np.argmax(pxx[peaks])]] * 60.0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", type=Path, required=True, help="host spectral_hr executable")
+    parser.add_argument("--csv", type=Path, default=DEFAULT_CSV, help="J-Scope export")
+    parser.add_argument("--pleth", type=Path, help="PhysioNet CSV (overrides --csv)")
+    parser.add_argument("--column", default="pleth_2")
+    parser.add_argument("--seconds", type=int, default=30)
+    parser.add_argument("--header", type=Path, default=DEFAULT_HEADER)
+    args = parser.parse_args()
+
+    if args.pleth is not None:
+        adc = load_pleth(args.pleth, args.column, args.seconds)
+    else:
+        adc = load_adc_stream(args.csv)
+
+    run = subprocess.run([str(args.tool), "-f", str(FS)], input="\n".join(map(str, adc)),
+                         capture_output=True, text=True, check=True)
+    est, psd = [], []
+    for line in run.stdout.splitlines():
+        kind, *values = line.split()
+        (est if kind == "est" else psd).append([float(v) for v in values])
+    est, psd = np.array(est), np.array(psd)
+    if est.size == 0:
+        print(f"{len(adc)} samples: shorter than one {SEGMENT_S} s segment")
+        return 1
+
+    # 1. PSD on the identical band-passed input
+    x_q15 = (adc & 0xFFF) * 16 - 32768
+    bp = reference(x_q15, load_coeffs(args.header)).astype(np.float64)
+    f, _, sxx = spectrogram(bp, fs=FS, window="hamming", nperseg=SEGMENT_S * FS,
+                            noverlap=SEGMENT_S * FS // 2, detrend=False, scaling="density")
+    ref = firmware_average(sxx)
+    ref = np.interp(psd[:, 0], f, ref)
+    significant = ref > 0.01 * ref.max()
+    rel_err = np.max(np.abs(psd[significant, 1] - ref[significant]) / ref[significant])
+
+    # 2. HR against the notebook method
+    hr_mcu = est[-1, 1]
+    hr_ref = notebook_hr(adc.astype(np.float64))
+    tolerance = 60.0 / SEGMENT_S / 2.0
+
+    print(f"{len(adc)} samples, {len(est)} segments, {len(psd)} bins")
+    print(f"PSD max relative error vs spectrogram average: {rel_err:.2e}")
+    print("HR per segment [bpm]: " + " ".join(f"{v:.1f}" for v in est[:, 1]))
+    if hr_ref is None:
+        print(f"HR firmware {hr_mcu:.1f} bpm, notebook: no peak found")
+        return 1
+    print(f"HR firmware {hr_mcu:.1f} bpm, notebook Welch {hr_ref:.1f} bpm "
+          f"(difference {hr_mcu - hr_ref:+.1f}, tolerance +/-{tolerance:.1f})")
+
+    ok = rel_err < 1e-2 and abs(hr_mcu - hr_ref) <= tolerance
+    print("OK" if ok else "FAIL")
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
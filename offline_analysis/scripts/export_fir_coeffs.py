@@ -0,0 +1,115 @@
+"""
+Export the HR band-pass FIR designed in filter_design.ipynb to a C header.
+
+The filter is designed with scipy.signal.firwin (same parameters as the
+notebook), forced to exactly zero DC gain, quantized to Q15 and written as
+a const table for the firmware FIR engine (Core/Src/ppg_fir.c).
+
+Usage:
+    python export_fir_coeffs.py
+    python export_fir_coeffs.py --numtaps 160 --band 0.5 4.0 --fs 100
+"""
+
+import argparse
+from pathlib import Path
+
+import numpy as np
+from scipy.signal import firwin
+
+# ===================== DEFAULT DESIGN =====================
+FS = 100                # Hz, MCU sampling rate (PPG_FS)
+BAND = (0.5, 4.0)       # Hz, physiological HR band (30-240 bpm)
+NUMTAPS = 128
+
+DEFAULT_OUTPUT = (Path(__file__).resolve().parents[2]
+                  / "firmware" / "HR_SPO2_computing_dev" / "Core" / "Inc" / "ppg_fir_coeffs.h")
+
+
+def design_bandpass(numtaps=NUMTAPS, band=BAND, fs=FS):
+    """Hamming-window band-pass with the DC gain removed (float taps)."""
+    h = firwin(numtaps, list(band), pass_zero=False, fs=fs)
+    # A short band-pass leaks DC (offset of the photodiode signal): subtract
+    # the mean tap so the response has an exact zero at 0 Hz.
+    return h - np.sum(h) / numtaps
+
+
+def quantize_q15(h):
+    """Round to Q15 and keep the integer taps summing to exactly zero."""
+    q = np.round(h * 32768.0).astype(np.int64)
+    # Rounding can leave a small DC residue: fold it into the centre tap(s),
+    # splitting it over the two middle taps of an even-length filter.
+    residue = int(np.sum(q))
+    mid = len(q) // 2
+    if len(q) % 2 == 0:
+        q[mid - 1] -= residue // 2
+        q[mid] -= residue - residue // 2
+    else:
+        q[mid] -= residue
+    if np.any(q > 32767) or np.any(q < -32768):
+        raise ValueError("coefficient out of Q15 range")
+    # The engine accumulates on 32 bits without saturation.
+    if np.sum(np.abs(q)) >= 65536:
+        raise ValueError("sum(|h|) >= 2.0: Q31 accumulator could overflow")
+    return q
+
+
+def write_header(q, numtaps, band, fs, path):
+    rows = []
+    for i in range(0, len(q), 8):
+        rows.append("    " + ", ".join(f"{int(v):6d}" for v in q[i:i + 8]) + ",")
+
+    text = f"""/**
+ ******************************************************************************
+ * @file    ppg_fir_coeffs.h
+ * @brief   HR band-pass FIR coefficients (Q15).
+ *
+ * @details
+ * GENERATED by offline_analysis/scripts/export_fir_coeffs.py - do not edit.
+ *
+ * Design: scipy.signal.firwin, Hamming window, zero DC gain
+ *   - fs       : {fs} Hz
+ *   - band     : {band[0]} - {band[1]} Hz
+ *   - num taps : {numtaps}
+ *   - sum(|h|) : {np.sum(np.abs(q)) / 32768.0:.4f}
+ ******************************************************************************
+ */
+
+#ifndef PPG_FIR_COEFFS_H
+#define PPG_FIR_COEFFS_H
+
+#include <stdint.h>
+
+/** Sampling rate the band-pass was designed for [Hz] */
+#define PPG_FIR_BP_FS          {fs}U
+
+/** Number of taps of the HR band-pass */
+#define PPG_FIR_BP_NUM_TAPS    {numtaps}U
+
+/** HR band-pass taps h[0..PPG_FIR_BP_NUM_TAPS), Q15 */
+static const int16_t ppg_fir_bp_coeffs[PPG_FIR_BP_NUM_TAPS] __attribute__((aligned(4))) =
+{{
+{chr(10).join(rows)}
+}};
+
+#endif /* PPG_FIR_COEFFS_H */
+"""
+    Path(path).write_text(text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--numtaps", type=int, default=NUMTAPS)
+    parser.add_argument("--band", type=float, nargs=2, default=BAND)
+    parser.add_argument("--fs", type=int, default=FS)
+    parser.add_argument("--output", type=Path, default=DEFAULT_OUTPUT)
+    args = parser.parse_args()
+
+    h = design_bandpass(args.numtaps, args.band, args.fs)
+    q = quantize_q15(h)
+    write_header(q, args.numtaps, args.band, args.fs, args.output)
+    print(f"Wrote {args.numtaps} taps to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
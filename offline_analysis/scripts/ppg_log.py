@@ -0,0 +1,136 @@
+"""
+Random access to session logs (PPGnnnnn.BIN) through the host ppg_log_dump.
+
+A closed session ends with an index: block offsets and timestamps, min / max
+of each channel, HR and SpO2 per index entry, and the session events (start,
+acquisition window changes, settling done, sequence gaps). The overview and
+the events come from the index alone, and a time range decodes only the
+blocks that overlap it, so a multi-hour recording opens in milliseconds.
+
+    log = SessionLog("PPG00003.BIN", tool=".../build/host/ppg_log_dump")
+    log.overview()                     # one row per index entry
+    log.events()                       # time, event, value
+    log.read(3600, 3630)               # samples of 30 s, one hour in
+    log.read_event("window", 4)        # 10 s around the 5th window change
+
+Usage (overview plot and a time range):
+    python ppg_log.py --tool <...>/ppg_log_dump PPG00003.BIN --plot overview.png
+    python ppg_log.py --tool <...>/ppg_log_dump PPG00003.BIN --range 3600 3630
+"""
+
+import argparse
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+import numpy as np
+import pandas as pd
+
+SAMPLE_COLUMNS = ["timestamp", "sequence", "red", "ir", "ambient", "battery"]
+RESULT_COLUMNS = ["sequence", "timestamp", "bandpassed", "hr_bpm", "hr_spectral_bpm",
+                  "spo2_percent", "beat_count"]
+OVERVIEW_COLUMNS = ["time", "sequence", "offset", "red_min", "red_max", "ir_min", "ir_max",
+                    "ambient_min", "ambient_max", "battery_min", "battery_max", "hr_bpm",
+                    "spo2_percent", "events"]
+EVENTS = ["start", "end", "gap", "window", "settled"]   # PPG_LogEventType_t
+
+
+class SessionLog:
+    """One session log, decoded on demand by ppg_log_dump (NumPy output)."""
+
+    def __init__(self, path, tool):
+        self.path = Path(path)
+        self.tool = Path(tool)
+
+    def _dump(self, *options, **outputs):
+        """Run ppg_log_dump with -f npy, one temporary .npy per output option."""
+        with tempfile.TemporaryDirectory() as tmp:
+            files = {opt: Path(tmp) / f"{opt}.npy" for opt in outputs}
+            args = [str(self.tool), "-f", "npy", *options]
+            for opt, f in files.items():
+                args += [f"-{opt}", str(f)]
+            run = subprocess.run(args + [str(self.path)], capture_output=True, text=True)
+            if run.returncode != 0:
+                raise RuntimeError(run.stderr.strip())
+            return {opt: pd.DataFrame(np.load(f), columns=outputs[opt]) for opt, f in files.items()}
+
+    def overview(self):
+        """Index entries: time [s] from the first block, min / max per channel (-1 if absent)."""
+        df = self._dump(s=OVERVIEW_COLUMNS)["s"]
+        return df.astype({"sequence": np.int64, "offset": np.int64, "events": np.int64})
+
+    def events(self):
+        """Session events: time [s], event name, value (window index, frames lost)."""
+        df = self._dump(e=["time", "event", "value"])["e"]
+        df["event"] = [EVENTS[int(t)] if int(t) < len(EVENTS) else str(int(t)) for t in df["event"]]
+        return df.astype({"value": np.int64})
+
+    def read(self, start=None, end=None, results=False):
+        """Samples (and results) of [start, end) seconds; the log is only decoded there."""
+        span = f"{'' if start is None else start}:{'' if end is None else end}"
+        outputs = {"o": SAMPLE_COLUMNS}
+        if results:
+            outputs["r"] = RESULT_COLUMNS
+        dfs = self._dump("-t", span, **outputs)
+        samples = dfs["o"].replace(-1, np.nan)
+        return (samples, dfs["r"]) if results else samples
+
+    def read_event(self, event, n=0, before=2.0, after=8.0, results=False):
+        """Samples around the n-th occurrence of an event."""
+        ev = self.events()
+        t = ev.loc[ev["event"] == event, "time"].to_numpy()
+        if n >= len(t):
+            raise IndexError(f"{event} #{n}: the index holds {len(t)}")
+        return self.read(max(t[n] - before, 0.0), t[n] + after, results)
+
+
+def plot_overview(log, path):
+    """Min / max envelope of each channel, HR and SpO2, events as vertical lines."""
+    import matplotlib
+    matplotlib.use("Agg")
+    import matplotlib.pyplot as plt
+
+    ov, ev = log.overview(), log.events()
+    fig, axes = plt.subplots(3, 1, sharex=True, figsize=(12, 7))
+    for ch in ("red", "ir", "ambient"):
+        lo, hi = ov[f"{ch}_min"], ov[f"{ch}_max"]
+        if (hi >= 0).any():
+            axes[0].fill_between(ov["time"], lo, hi, step="post", alpha=0.5, label=ch)
+    axes[0].set_ylabel("ADC")
+    axes[0].legend(loc="upper right")
+    axes[1].step(ov["time"], ov["hr_bpm"], where="post")
+    axes[1].set_ylabel("HR [bpm]")
+    axes[2].step(ov["time"], ov["spo2_percent"], where="post")
+    axes[2].set_ylabel("SpO2 [%]")
+    axes[2].set_xlabel("time [s]")
+    for t in ev.loc[ev["event"].isin(["window", "gap"]), "time"]:
+        for ax in axes:
+            ax.axvline(t, color="grey", lw=0.5)
+    fig.tight_layout()
+    fig.savefig(path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--tool", type=Path, required=True, help="host ppg_log_dump executable")
+    parser.add_argument("log", type=Path, help="session log (PPGnnnnn.BIN)")
+    parser.add_argument("--plot", type=Path, help="overview plot (PNG)")
+    parser.add_argument("--range", type=float, nargs=2, metavar=("FROM", "TO"),
+                        help="print the samples of a time range [s]")
+    args = parser.parse_args()
+
+    log = SessionLog(args.log, args.tool)
+    ov = log.overview()
+    print(f"{args.log}: {len(ov)} index entries, {ov['time'].iloc[-1]:.1f} s")
+    print(log.events().to_string(index=False))
+    if args.plot:
+        plot_overview(log, args.plot)
+    if args.range:
+        print(log.read(*args.range).to_string(index=False))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,6 +1,13 @@
-import serial
+import binascii
+import struct
 import time
+
 import numpy as np
+import serial
+
+# PC side of the simulation UART link (firmware: ppg_link.h, ppg_sim.h).
+# The MCU opens a session with START, then pulls sample periods with
+# CREDIT frames; this script streams them in DATA frames.
 
 # ===================== SERIAL CONFIG =====================
 SERIAL_PORT = "COM7"
@@ -9,82 +16,190 @@ BAUDRATE = 115200
 ser = serial.Serial(
     port=SERIAL_PORT,
     baudrate=BAUDRATE,
-    timeout=1
+    timeout=0.01
 )
 
 print(f"Serial opened on {SERIAL_PORT}")
 
+# ===================== LINK PROTOCOL (ppg_link.h) =====================
+SYNC = b"\xA5\x5A"
+HEADER_SIZE = 6
+CRC_SIZE = 2
+MAX_PAYLOAD = 255
+DATA_HEADER = 6                # first (u32), mask (u8), count (u8)
+
+START, DATA, CREDIT, STOP, REPORT = 1, 2, 3, 4, 5
+
+CH_RED, CH_IR, CH_AMBIENT = 0, 1, 2
+
+
+def crc16(data):
+    # CRC-16/CCITT-FALSE
+    return binascii.crc_hqx(data, 0xFFFF)
+
+
+def encode(frame_type, seq, payload):
+    body = struct.pack("<BBH", frame_type, len(payload), seq) + payload
+    return SYNC + body + struct.pack("<H", crc16(body))
+
+
+class Parser:
+    def __init__(self):
+        self.buf = bytearray()
+        self.crc_errors = 0
+
+    def feed(self, data):
+        self.buf += data
+        frames = []
+        while True:
+            i = self.buf.find(SYNC)
+            if i < 0:
+                # Keep a trailing first sync byte
+                del self.buf[:max(0, len(self.buf) - 1)]
+                return frames
+            if len(self.buf) < i + HEADER_SIZE:
+                del self.buf[:i]
+                return frames
+            end = i + HEADER_SIZE + self.buf[i + 3] + CRC_SIZE
+            if len(self.buf) < end:
+                del self.buf[:i]
+                return frames
+            body = bytes(self.buf[i + 2:end - CRC_SIZE])
+            (crc,) = struct.unpack_from("<H", self.buf, end - CRC_SIZE)
+            if crc != crc16(body):
+                self.crc_errors += 1
+                del self.buf[:i + 1]
+                continue
+            frame_type, _, seq = struct.unpack_from("<BBH", body)
+            frames.append((frame_type, seq, body[4:]))
+            del self.buf[:end]
+
+
 # ===================== PPG PARAMETERS =====================
-FS = 100
+FS = 100                       # PPG_FS: START gives FS * PPG_OVERSAMPLE
 WINDOW_DURATION = 5.0          # seconds
-SETTLING_TIME = 0.150          # 150 ms
-N_WINDOWS = 6
-WINDOW_ORDER = ["R", "IR"] * 3
+WINDOW_ORDER = ["R", "IR"]     # PPG_Pipeline_WindowChannel()
+HR_HZ = 1.2
+STALL_TIMEOUT = 0.5            # s without credit progress before resending
 
-samples_per_window = int(FS * WINDOW_DURATION)
+# "simultaneous": RED, IR and ambient every period (LED phase scheduler)
+# "windows": one LED per 5 s window, as the single-stream firmware expects
+MODE = "simultaneous"
 
-# ===================== SIGNAL GENERATOR =====================
-def generate_ppg_signal(n_samples, freq=1.2, noise=150, amplitude=1000):
-    t = np.arange(n_samples) / FS
-    sig = 2048 + amplitude * np.sin(2 * np.pi * freq * t)
-    sig += np.random.normal(0, noise, size=n_samples)
-    return np.clip(sig, 0, 4095).astype(np.uint16)
 
-# ===================== PREPARE WINDOWS =====================
-windows = []
-
-for color in WINDOW_ORDER:
-    amp = 900 if color == "R" else 1100
-    sig = generate_ppg_signal(samples_per_window, amplitude=amp)
-    windows.append(sig)
+# ===================== SIGNAL GENERATOR =====================
+def generate_ppg(first, count, rate):
+    t = (first + np.arange(count)) / rate
+    pulse = np.sin(2 * np.pi * HR_HZ * t)
+
+    # Slow ambient drift plus 100 Hz flicker of mains lighting
+    ambient = 300 + 80 * np.sin(2 * np.pi * 0.05 * t) + 40 * np.sin(2 * np.pi * 100 * t)
+
+    red = 1800 + 45 * pulse + ambient + np.random.normal(0, 8, size=count)
+    ir = 2200 + 110 * pulse + ambient + np.random.normal(0, 8, size=count)
+
+    channels = {CH_RED: red, CH_IR: ir, CH_AMBIENT: ambient}
+    return {ch: np.clip(v, 0, 4095).astype("<u2") for ch, v in channels.items()}
+
+
+# ===================== SESSION =====================
+class Session:
+    def __init__(self, rate, mask, periods, limit):
+        self.rate = rate
+        self.mask = mask
+        self.periods = periods
+        self.limit = limit
+        self.next = 0
+        self.seq = 0
+        self.frames = 0
+        self.bytes = 0
+        self.rx_next = 0
+        self.progress_time = time.time()
+        self.start_time = time.time()
+        self.window_periods = int(rate * WINDOW_DURATION)
+
+    def credit(self, limit, rx_next):
+        now = time.time()
+        if rx_next != self.rx_next:
+            self.rx_next = rx_next
+            self.progress_time = now
+        self.limit = max(self.limit, limit)
+
+        # The tail of the stream was lost: resend from what the MCU expects
+        if now - self.progress_time > STALL_TIMEOUT and self.next > rx_next:
+            print(f"Stall at period {rx_next}, resending {self.next - rx_next} periods")
+            self.next = rx_next
+            self.progress_time = now
+
+    def frame_layout(self):
+        if MODE == "windows":
+            window = (self.next // self.window_periods) % len(WINDOW_ORDER)
+            channel = CH_RED if WINDOW_ORDER[window] == "R" else CH_IR
+            room = self.window_periods - self.next % self.window_periods
+            return [channel], room
+        channels = [ch for ch in (CH_RED, CH_IR, CH_AMBIENT) if self.mask & (1 << ch)]
+        return channels, self.limit - self.next
+
+    def pump(self):
+        while self.next < self.limit:
+            channels, room = self.frame_layout()
+            count = min(self.limit - self.next, room,
+                        (MAX_PAYLOAD - DATA_HEADER) // (2 * len(channels)))
+
+            samples = generate_ppg(self.next, count, self.rate)
+            interleaved = np.stack([samples[ch] for ch in channels], axis=1)
+            mask = sum(1 << ch for ch in channels)
+
+            payload = struct.pack("<IBB", self.next, mask, count) + interleaved.tobytes()
+            frame = encode(DATA, self.seq, payload)
+            ser.write(frame)
+
+            self.seq = (self.seq + 1) & 0xFFFF
+            self.next += count
+            self.frames += 1
+            self.bytes += len(frame)
 
-total_samples = samples_per_window * N_WINDOWS
-print(f"Prepared {total_samples} samples")
 
 # ===================== MAIN LOOP =====================
-print("Waiting for MCU trigger (button press)...")
-
-simulation_started = False
-window_idx = 0
-sample_idx = 0
-start_time = None
-last_window_end_time = None
-
-while True:
-    c = ser.read(1)
-
-    # ===== END CONDITION (STATE-DRIVEN) =====
-    if simulation_started and window_idx >= N_WINDOWS:
-        elapsed = time.time() - start_time
-        print(f"Simulation completed in {elapsed:.2f} s")
-        break
-
-    # ===== MCU START =====
-    if c == b'C' and not simulation_started:
-        simulation_started = True
-        window_idx = 0
-        sample_idx = 0
-        start_time = time.time()
-        last_window_end_time = None
-        print("MCU start received → simulation armed")
-
-    # ===== MCU REQUEST SAMPLE =====
-    elif c == b'R' and simulation_started:
-
-        if sample_idx == 0 and last_window_end_time is not None:
-            if time.time() - last_window_end_time < SETTLING_TIME:
-                continue
-
-        val = windows[window_idx][sample_idx]
-        ser.write(bytes([
-            val & 0xFF,
-            (val >> 8) & 0x0F
-        ]))
-
-        sample_idx += 1
-
-        if sample_idx >= samples_per_window:
-            sample_idx = 0
-            window_idx += 1
-            last_window_end_time = time.time()
-
+print(f"Waiting for MCU trigger (button press), mode: {MODE}...")
+
+parser = Parser()
+session = None
+done = False
+
+while not done:
+    for frame_type, seq, payload in parser.feed(ser.read(max(1, ser.in_waiting))):
+
+        # ===== MCU START =====
+        if frame_type == START:
+            rate, mask, periods, limit = struct.unpack_from("<HBxII", payload)
+            session = Session(rate, mask, periods, limit)
+            print(f"MCU start: {rate} periods/s, channel mask 0x{mask:02X}, "
+                  f"{periods} periods ({periods / rate:.1f} s)")
+
+        # ===== MCU CREDIT =====
+        elif frame_type == CREDIT and session is not None:
+            limit, rx_next, lost, crc_errors = struct.unpack_from("<IIHH", payload)
+            session.credit(limit, rx_next)
+
+        # ===== MCU TIMING INTEGRITY (ppg_integrity.h) =====
+        elif frame_type == REPORT:
+            ticks, missed, p99, worst, gaps, drops, seq_gaps, queue_drops = struct.unpack_from("<8I", payload)
+            print(f"MCU integrity: {ticks} ticks, {missed} missed, jitter p99 <= {p99} ns, "
+                  f"worst {worst} ns; {gaps} periods skipped, {drops} frames dropped, "
+                  f"{seq_gaps} sequence gaps, {queue_drops} consumer drops")
+
+        # ===== MCU STOP =====
+        elif frame_type == STOP and session is not None:
+            periods, underruns, lost, crc_errors = struct.unpack_from("<IIHH", payload)
+            elapsed = time.time() - session.start_time
+            print(f"Simulation completed in {elapsed:.2f} s: {periods} periods consumed, "
+                  f"{session.frames} frames / {session.next} periods sent "
+                  f"({session.bytes / elapsed:.0f} B/s)")
+            print(f"MCU counters: {underruns} underruns, {lost} frames lost, "
+                  f"{crc_errors} rejected; PC: {parser.crc_errors} rejected")
+            done = True
+
+    # ===== STREAM WHILE CREDITS ALLOW (until STOP) =====
+    if session is not None and not done:
+        session.pump()